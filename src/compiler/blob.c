@@ -194,6 +194,21 @@ blob_write_uint32(struct blob *blob, uint32_t value)
    return blob_write_bytes(blob, &value, sizeof(value));
 }
 
+bool
+blob_write_varint32(struct blob *blob, uint32_t value)
+{
+   uint8_t bytes[5];
+   size_t size = 0;
+
+   while (value >= 0x80) {
+      bytes[size++] = (value & 0x7f) | 0x80;
+      value >>= 7;
+   }
+   bytes[size++] = value;
+
+   return blob_write_bytes(blob, bytes, size);
+}
+
 #define ASSERT_ALIGNED(_offset, _align) \
    assert(ALIGN((_offset), (_align)) == (_offset))
 
@@ -320,6 +335,27 @@ blob_read_uint32(struct blob_reader *blob)
    return ret;
 }
 
+uint32_t
+blob_read_varint32(struct blob_reader *blob)
+{
+   uint32_t ret = 0;
+
+   for (unsigned shift = 0; shift < 35; shift += 7) {
+      if (! ensure_can_read(blob, 1))
+         return 0;
+
+      uint8_t byte = *blob->current++;
+      ret |= (uint32_t) (byte & 0x7f) << shift;
+
+      if (!(byte & 0x80))
+         return ret;
+   }
+
+   /* More than 5 bytes can't be a valid uint32_t. */
+   blob->overrun = true;
+   return 0;
+}
+
 uint64_t
 blob_read_uint64(struct blob_reader *blob)
 {
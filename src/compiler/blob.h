@@ -185,6 +185,19 @@ blob_overwrite_bytes(struct blob *blob,
 bool
 blob_write_uint32(struct blob *blob, uint32_t value);
 
+/**
+ * Add a uint32_t to a blob as a variable-length quantity: 7 bits per byte,
+ * least significant first, with the high bit set on all bytes but the last.
+ * Values below 128 take a single byte and the largest ones take five.
+ *
+ * \note Unlike blob_write_uint32, no padding is added before the value, so
+ * this must be read back with blob_read_varint32.
+ *
+ * \return True unless allocation failed.
+ */
+bool
+blob_write_varint32(struct blob *blob, uint32_t value);
+
 /**
  * Overwrite a uint32_t previously written to the blob.
  *
@@ -312,6 +325,16 @@ blob_skip_bytes(struct blob_reader *blob, size_t size);
 uint32_t
 blob_read_uint32(struct blob_reader *blob);
 
+/**
+ * Read a uint32_t written by blob_write_varint32 from the current location,
+ * (and update the current location to just past it).
+ *
+ * \return The uint32_t read, or 0 if the value runs past the end of the blob
+ * or is longer than five bytes (in which case the overrun flag is set).
+ */
+uint32_t
+blob_read_varint32(struct blob_reader *blob);
+
 /**
  * Read a uint64_t from the current location, (and update the current location
  * to just past this uint64_t).
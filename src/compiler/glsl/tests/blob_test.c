@@ -29,6 +29,7 @@
 #include <stdbool.h>
 #include <string.h>
 
+#include "util/macros.h"
 #include "util/ralloc.h"
 #include "blob.h"
 
@@ -267,6 +268,61 @@ test_overrun(void)
    blob_finish(&blob);
 }
 
+/* Test that variable-length integers round-trip, with the expected sizes. */
+static void
+test_varint(void)
+{
+   static const uint32_t values[] = {
+      0, 1, 0x7f, 0x80, 0x3fff, 0x4000, 0x1fffff, 0x200000, 0xfffffff,
+      0x10000000, 0xffffffff,
+   };
+   static const size_t sizes[] = { 1, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5 };
+   static const uint8_t too_long[] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0x01 };
+   struct blob blob;
+   struct blob_reader reader;
+   size_t i, last;
+
+   blob_init(&blob);
+
+   for (i = 0; i < ARRAY_SIZE(values); i++) {
+      last = blob.size;
+      blob_write_varint32(&blob, values[i]);
+      expect_equal(sizes[i], blob.size - last, "size of varint");
+   }
+
+   /* No padding is added before varints. */
+   last = blob.size;
+   blob_write_bytes(&blob, "x", 1);
+   blob_write_varint32(&blob, 0x1234);
+   expect_equal(3, blob.size - last, "no padding before varint");
+
+   blob_reader_init(&reader, blob.data, blob.size);
+
+   for (i = 0; i < ARRAY_SIZE(values); i++) {
+      expect_equal(values[i], blob_read_varint32(&reader),
+                   "blob_write/read_varint32");
+   }
+   blob_skip_bytes(&reader, 1);
+   expect_equal(0x1234, blob_read_varint32(&reader),
+                "blob_read_varint32 after unaligned data");
+   expect_equal(reader.end - reader.data, reader.current - reader.data,
+                "read_consumes_all_varint_bytes");
+   expect_equal(false, reader.overrun, "varint read does not overrun");
+
+   /* A truncated varint is an overrun: 0x80 is the fourth value and takes
+    * two bytes.
+    */
+   blob_reader_init(&reader, blob.data + 3, 1);
+   expect_equal(0, blob_read_varint32(&reader), "read of truncated varint");
+   expect_equal(true, reader.overrun, "overrun flag set by truncated varint");
+
+   blob_reader_init(&reader, too_long, sizeof(too_long));
+   expect_equal(0, blob_read_varint32(&reader), "read of too long varint");
+   expect_equal(true, reader.overrun, "overrun flag set by too long varint");
+
+   blob_finish(&blob);
+}
+
 /* Test that we can read and write some large objects, (exercising the code in
  * the blob_write functions to realloc blob->data.
  */
@@ -318,6 +374,7 @@ main (void)
    test_write_and_read_functions ();
    test_alignment ();
    test_overrun ();
+   test_varint ();
    test_big_objects ();
 
    return error ? 1 : 0;
@@ -493,6 +493,188 @@ test_put_key_and_get_key(void)
 
    disk_cache_destroy(cache);
 }
+
+static void
+test_put_and_get_single_file(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   uint8_t blob_key[20];
+   char string[] = "While this string has thirty-four";
+   uint8_t string_key[20];
+   uint8_t *big_item;
+   uint8_t big_item_key[20];
+   uint8_t one_KB_key[20];
+   char *result;
+   size_t size;
+   int count, i;
+
+   setenv("MESA_GLSL_CACHE_SINGLE_FILE", "true", 1);
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1M", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), blob_key);
+   disk_cache_compute_key(cache, string, sizeof(string), string_key);
+
+   /* Simple test of put and get. */
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   result = disk_cache_get(cache, blob_key, &size);
+   expect_equal_str(blob, result, "single file disk_cache_get of existing "
+                    "item (pointer)");
+   expect_equal(size, sizeof(blob), "single file disk_cache_get of existing "
+                "item (size)");
+
+   free(result);
+
+   /* Removed items must no longer be found. */
+   disk_cache_remove(cache, blob_key);
+   expect_true(!does_cache_contain(cache, blob_key),
+               "single file disk_cache_remove");
+
+   /* Items must survive re-opening the cache. */
+   disk_cache_put(cache, string_key, string, sizeof(string), NULL);
+   wait_until_file_written(cache, string_key);
+
+   disk_cache_destroy(cache);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   result = disk_cache_get(cache, string_key, &size);
+   expect_equal_str(string, result, "single file disk_cache_get after "
+                    "re-opening the cache (pointer)");
+   expect_equal(size, sizeof(string), "single file disk_cache_get after "
+                "re-opening the cache (size)");
+
+   free(result);
+
+   /* Set the cache size to 1KB. Use random data for the big items, so that
+    * they don't compress.
+    */
+   disk_cache_destroy(cache);
+
+   setenv("MESA_GLSL_CACHE_MAX_SIZE", "1K", 1);
+   cache = disk_cache_create("test", "make_check", 0);
+
+   big_item = malloc(1024);
+   srand(0);
+   for (i = 0; i < 1024; i++)
+      big_item[i] = rand();
+
+   /* An item larger than the whole cache must be dropped, without evicting
+    * anything. Items are written in order, so wait for one put after it.
+    */
+   disk_cache_compute_key(cache, big_item, 1024, one_KB_key);
+   disk_cache_put(cache, one_KB_key, big_item, 1024, NULL);
+   disk_cache_put(cache, blob_key, blob, sizeof(blob), NULL);
+   wait_until_file_written(cache, blob_key);
+
+   expect_true(!does_cache_contain(cache, one_KB_key),
+               "single file item larger than MAX_SIZE (1KB)");
+   expect_true(does_cache_contain(cache, string_key),
+               "single file no eviction for an item larger than MAX_SIZE");
+
+   /* Add an item which only fits in an empty cache to force an eviction. */
+   disk_cache_compute_key(cache, big_item, 940, big_item_key);
+   disk_cache_put(cache, big_item_key, big_item, 940, NULL);
+   wait_until_file_written(cache, big_item_key);
+
+   free(big_item);
+
+   count = 0;
+   if (does_cache_contain(cache, blob_key))
+       count++;
+
+   if (does_cache_contain(cache, string_key))
+       count++;
+
+   expect_true(does_cache_contain(cache, big_item_key),
+               "single file eviction, last item fits in MAX_SIZE (1KB)");
+   expect_equal(count, 0, "single file eviction with MAX_SIZE=1K");
+
+   disk_cache_destroy(cache);
+
+   unsetenv("MESA_GLSL_CACHE_SINGLE_FILE");
+}
+
+static void
+test_prefetch(void)
+{
+   struct disk_cache *cache;
+   char blob[] = "This is a blob of thirty-seven bytes";
+   char string[] = "While this string has thirty-four";
+   uint8_t missing_key[20] = { 0 };
+   cache_key keys[3];
+   char *result;
+   size_t size;
+   int i;
+
+   /* Make sure nothing gets evicted. */
+   unsetenv("MESA_GLSL_CACHE_MAX_SIZE");
+   cache = disk_cache_create("test", "make_check", 0);
+
+   disk_cache_compute_key(cache, blob, sizeof(blob), keys[0]);
+   disk_cache_compute_key(cache, string, sizeof(string), keys[1]);
+   memcpy(keys[2], missing_key, sizeof(missing_key));
+
+   disk_cache_put(cache, keys[0], blob, sizeof(blob), NULL);
+   disk_cache_put(cache, keys[1], string, sizeof(string), NULL);
+   wait_until_file_written(cache, keys[0]);
+   wait_until_file_written(cache, keys[1]);
+
+   /* Read the items ahead, then wait for the reads to (most likely) be done,
+    * which isn't needed but exercises returning the items from memory.
+    */
+   disk_cache_prefetch(cache, (const cache_key *) keys, 3);
+   usleep(100000);
+
+   result = disk_cache_get(cache, keys[0], &size);
+   expect_equal_str(blob, result, "disk_cache_get of prefetched item "
+                    "(pointer)");
+   expect_equal(size, sizeof(blob), "disk_cache_get of prefetched item "
+                "(size)");
+   free(result);
+
+   result = disk_cache_get(cache, keys[1], &size);
+   expect_equal_str(string, result, "2nd disk_cache_get of prefetched item "
+                    "(pointer)");
+   expect_equal(size, sizeof(string), "2nd disk_cache_get of prefetched item "
+                "(size)");
+   free(result);
+
+   result = disk_cache_get(cache, keys[2], &size);
+   expect_null(result, "disk_cache_get of prefetched missing item");
+
+   /* Items handed out are still in the cache. */
+   expect_true(does_cache_contain(cache, keys[0]),
+               "disk_cache_get again after prefetch");
+
+   /* An item dropped while being read may be prefetched again, before the
+    * first read is done.
+    */
+   for (i = 0; i < 100; i++) {
+      disk_cache_prefetch(cache, (const cache_key *) keys, 2);
+      free(disk_cache_get(cache, keys[0], NULL));
+      disk_cache_prefetch(cache, (const cache_key *) keys, 1);
+      free(disk_cache_get(cache, keys[1], NULL));
+   }
+   usleep(100000);
+
+   result = disk_cache_get(cache, keys[0], &size);
+   expect_equal_str(blob, result, "disk_cache_get of item prefetched twice "
+                    "(pointer)");
+   expect_equal(size, sizeof(blob), "disk_cache_get of item prefetched twice "
+                "(size)");
+   free(result);
+
+   /* Removed items are dropped from memory too. */
+   disk_cache_prefetch(cache, (const cache_key *) keys, 1);
+   disk_cache_remove(cache, keys[0]);
+   expect_true(!does_cache_contain(cache, keys[0]),
+               "disk_cache_remove of prefetched item");
+
+   disk_cache_destroy(cache);
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 int
@@ -507,6 +689,10 @@ main(void)
 
    test_put_key_and_get_key();
 
+   test_put_and_get_single_file();
+
+   test_prefetch();
+
    err = rmrf_local(CACHE_TEST_TMP);
    expect_equal(err, 0, "Removing " CACHE_TEST_TMP " again");
 #endif /* ENABLE_SHADER_CACHE */
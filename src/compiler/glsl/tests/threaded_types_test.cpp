@@ -0,0 +1,217 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include "c11/threads.h"
+#include "main/macros.h"
+#include "compiler/glsl_types.h"
+
+/**
+ * \file threaded_types_test.cpp
+ *
+ * Stress the interning of array, record, interface, subroutine and function
+ * types from many threads at once, like concurrent shader compiles do, and
+ * check that every thread gets the same types.
+ */
+
+#define NUM_THREADS 8
+#define NUM_ITERATIONS 100
+
+/* More than fit in the per-thread type caches, so that the threads also
+ * keep going back to the shared hash tables.  Prime, so that any stride
+ * visits all the keys.
+ */
+#define NUM_KEYS 211
+
+struct thread_types {
+   unsigned thread_index;
+   bool ok;
+
+   const glsl_type *arrays[NUM_KEYS];
+   const glsl_type *arrays_of_arrays[NUM_KEYS];
+   const glsl_type *records[NUM_KEYS];
+   const glsl_type *interfaces[NUM_KEYS];
+   const glsl_type *subroutines[NUM_KEYS];
+   const glsl_type *functions[NUM_KEYS];
+};
+
+static const glsl_type *
+base_type(unsigned key)
+{
+   static const glsl_type *const types[] = {
+      glsl_type::float_type, glsl_type::vec2_type, glsl_type::vec3_type,
+      glsl_type::vec4_type, glsl_type::int_type, glsl_type::ivec4_type,
+      glsl_type::uint_type, glsl_type::mat4_type,
+   };
+
+   return types[key % ARRAY_SIZE(types)];
+}
+
+static void
+get_types(unsigned key, const glsl_type **array,
+          const glsl_type **array_of_arrays, const glsl_type **record,
+          const glsl_type **interface, const glsl_type **subroutine,
+          const glsl_type **function)
+{
+   char name[32];
+
+   *array = glsl_type::get_array_instance(base_type(key), key % 13 + 1);
+   *array_of_arrays = glsl_type::get_array_instance(*array, key % 3 + 2);
+
+   const glsl_struct_field fields[] = {
+      glsl_struct_field(base_type(key + 1), "a"),
+      glsl_struct_field(*array, "b"),
+   };
+
+   snprintf(name, sizeof(name), "s%u", key);
+   *record = glsl_type::get_record_instance(fields, ARRAY_SIZE(fields), name);
+
+   snprintf(name, sizeof(name), "block%u", key);
+   *interface =
+      glsl_type::get_interface_instance(fields, ARRAY_SIZE(fields),
+                                        GLSL_INTERFACE_PACKING_STD140,
+                                        false, name);
+
+   snprintf(name, sizeof(name), "sub%u", key);
+   *subroutine = glsl_type::get_subroutine_instance(name);
+
+   const glsl_function_param params[] = {
+      { *record, true, false },
+      { base_type(key), true, true },
+   };
+   *function = glsl_type::get_function_instance(base_type(key + 2), params,
+                                                ARRAY_SIZE(params));
+}
+
+static int
+thread_func(void *data)
+{
+   struct thread_types *types = (struct thread_types *) data;
+
+   types->ok = true;
+
+   for (unsigned i = 0; i < NUM_ITERATIONS; i++) {
+      /* Visit the keys in a different order in each thread and iteration, so
+       * that the threads race to create the types.
+       */
+      const unsigned stride = 2 * ((types->thread_index + i) % 7) + 1;
+
+      for (unsigned j = 0; j < NUM_KEYS; j++) {
+         const unsigned key = (j * stride + i) % NUM_KEYS;
+         const glsl_type *array, *array_of_arrays, *record, *interface;
+         const glsl_type *subroutine, *function;
+
+         get_types(key, &array, &array_of_arrays, &record, &interface,
+                   &subroutine, &function);
+
+         if (i == 0 && types->arrays[key] == NULL) {
+            types->arrays[key] = array;
+            types->arrays_of_arrays[key] = array_of_arrays;
+            types->records[key] = record;
+            types->interfaces[key] = interface;
+            types->subroutines[key] = subroutine;
+            types->functions[key] = function;
+         } else if (types->arrays[key] != array ||
+                    types->arrays_of_arrays[key] != array_of_arrays ||
+                    types->records[key] != record ||
+                    types->interfaces[key] != interface ||
+                    types->subroutines[key] != subroutine ||
+                    types->functions[key] != function) {
+            types->ok = false;
+         }
+      }
+   }
+
+   return 0;
+}
+
+TEST(threaded_types, same_types_in_all_threads)
+{
+   static struct thread_types types[NUM_THREADS];
+   thrd_t threads[NUM_THREADS];
+
+   for (unsigned i = 0; i < NUM_THREADS; i++) {
+      types[i].thread_index = i;
+      ASSERT_EQ(thrd_success, thrd_create(&threads[i], thread_func, &types[i]));
+   }
+
+   for (unsigned i = 0; i < NUM_THREADS; i++)
+      thrd_join(threads[i], NULL);
+
+   for (unsigned i = 0; i < NUM_THREADS; i++) {
+      EXPECT_TRUE(types[i].ok) << "thread " << i;
+
+      for (unsigned key = 0; key < NUM_KEYS; key++) {
+         EXPECT_EQ(types[0].arrays[key], types[i].arrays[key]);
+         EXPECT_EQ(types[0].arrays_of_arrays[key],
+                   types[i].arrays_of_arrays[key]);
+         EXPECT_EQ(types[0].records[key], types[i].records[key]);
+         EXPECT_EQ(types[0].interfaces[key], types[i].interfaces[key]);
+         EXPECT_EQ(types[0].subroutines[key], types[i].subroutines[key]);
+         EXPECT_EQ(types[0].functions[key], types[i].functions[key]);
+      }
+   }
+
+   for (unsigned key = 0; key < NUM_KEYS; key++) {
+      const glsl_type *array = types[0].arrays[key];
+      const glsl_type *record = types[0].records[key];
+
+      EXPECT_EQ(base_type(key), array->fields.array);
+      EXPECT_EQ(key % 13 + 1, array->length);
+      EXPECT_EQ(array, types[0].arrays_of_arrays[key]->fields.array);
+      EXPECT_TRUE(record->is_record());
+      EXPECT_EQ(array, record->fields.structure[1].type);
+      EXPECT_TRUE(types[0].interfaces[key]->is_interface());
+      EXPECT_TRUE(types[0].subroutines[key]->is_subroutine());
+      EXPECT_EQ(base_type(key + 2),
+                types[0].functions[key]->fields.parameters[0].type);
+   }
+}
+
+TEST(threaded_types, types_recreated_after_release)
+{
+   const glsl_struct_field fields[] = {
+      glsl_struct_field(glsl_type::vec4_type, "v"),
+   };
+
+   const glsl_type *record =
+      glsl_type::get_record_instance(fields, ARRAY_SIZE(fields), "released");
+   EXPECT_EQ(record, glsl_type::get_record_instance(fields, ARRAY_SIZE(fields),
+                                                    "released"));
+
+   _mesa_glsl_release_types();
+
+   /* The type must be looked up again rather than taken from the stale
+    * per-thread cache.
+    */
+   record = glsl_type::get_record_instance(fields, ARRAY_SIZE(fields),
+                                           "released");
+   ASSERT_TRUE(record->is_record());
+   EXPECT_STREQ("released", record->name);
+   EXPECT_EQ(glsl_type::vec4_type, record->fields.structure[0].type);
+
+   const glsl_type *array =
+      glsl_type::get_array_instance(record, 4);
+   EXPECT_EQ(record, array->fields.array);
+   EXPECT_EQ(array, glsl_type::get_array_instance(record, 4));
+}
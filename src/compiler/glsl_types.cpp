@@ -26,6 +26,7 @@
 #include "compiler/glsl/glsl_parser_extras.h"
 #include "glsl_types.h"
 #include "util/hash_table.h"
+#include "util/u_atomic.h"
 #include "util/u_string.h"
 
 
@@ -36,6 +37,54 @@ hash_table *glsl_type::interface_types = NULL;
 hash_table *glsl_type::function_types = NULL;
 hash_table *glsl_type::subroutine_types = NULL;
 
+/**
+ * Number of entries of each table of the per-thread type caches.
+ */
+#define TYPE_CACHE_SIZE 64
+
+/**
+ * Per-thread cache in front of the hash tables of array, record, interface,
+ * subroutine and function types.
+ *
+ * The types in the hash tables are immutable and live until
+ * _mesa_glsl_release_types(), so a thread can keep pointers to them and find
+ * them again without taking glsl_type::hash_mutex, which is contended when
+ * several threads compile shaders at once.  The hash tables stay the only
+ * place where types are created, and each table of the cache is
+ * direct-mapped on a hash of the key, so a miss just falls back to them.
+ */
+struct glsl_type_cache {
+   /** Value of type_cache_generation the entries are valid for. */
+   unsigned generation;
+
+   const glsl_type *array_types[TYPE_CACHE_SIZE];
+   const glsl_type *record_types[TYPE_CACHE_SIZE];
+   const glsl_type *interface_types[TYPE_CACHE_SIZE];
+   const glsl_type *subroutine_types[TYPE_CACHE_SIZE];
+   const glsl_type *function_types[TYPE_CACHE_SIZE];
+};
+
+static thread_local glsl_type_cache type_cache;
+
+/**
+ * Incremented by _mesa_glsl_release_types() to invalidate the type caches of
+ * all the threads.
+ */
+static unsigned type_cache_generation = 0;
+
+static glsl_type_cache *
+get_type_cache(void)
+{
+   const unsigned generation = p_atomic_read(&type_cache_generation);
+
+   if (unlikely(type_cache.generation != generation)) {
+      memset(&type_cache, 0, sizeof(type_cache));
+      type_cache.generation = generation;
+   }
+
+   return &type_cache;
+}
+
 glsl_type::glsl_type(GLenum gl_type,
                      glsl_base_type base_type, unsigned vector_elements,
                      unsigned matrix_columns, const char *name) :
@@ -431,6 +480,9 @@ _mesa_glsl_release_types(void)
       _mesa_hash_table_destroy(glsl_type::subroutine_types, hash_free_type_function);
       glsl_type::subroutine_types = NULL;
    }
+
+   /* The other threads may still have pointers to the freed types. */
+   p_atomic_inc(&type_cache_generation);
 }
 
 
@@ -848,6 +900,14 @@ glsl_type::get_image_instance(enum glsl_sampler_dim dim,
 const glsl_type *
 glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
 {
+   glsl_type_cache *const cache = get_type_cache();
+   const unsigned slot =
+      (_mesa_hash_pointer(base) ^ (array_size * 0x9e3779b1u)) % TYPE_CACHE_SIZE;
+   const glsl_type *t = cache->array_types[slot];
+
+   if (t != NULL && t->fields.array == base && t->length == array_size)
+      return t;
+
    /* Generate a name using the base type pointer in the key.  This is
     * done because the name of the base type may not be unique across
     * shaders.  For example, two shaders may have different record types
@@ -876,9 +936,14 @@ glsl_type::get_array_instance(const glsl_type *base, unsigned array_size)
    assert(((glsl_type *) entry->data)->length == array_size);
    assert(((glsl_type *) entry->data)->fields.array == base);
 
+   /* The entry may move as soon as the table is unlocked. */
+   t = (const glsl_type *) entry->data;
+
    mtx_unlock(&glsl_type::hash_mutex);
 
-   return (glsl_type *) entry->data;
+   cache->array_types[slot] = t;
+
+   return t;
 }
 
 
@@ -1008,6 +1073,14 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
 {
    const glsl_type key(fields, num_fields, name);
 
+   glsl_type_cache *const cache = get_type_cache();
+   const unsigned slot =
+      (record_key_hash(&key) ^ _mesa_hash_string(name)) % TYPE_CACHE_SIZE;
+   const glsl_type *t = cache->record_types[slot];
+
+   if (t != NULL && record_key_compare(t, &key))
+      return t;
+
    mtx_lock(&glsl_type::hash_mutex);
 
    if (record_types == NULL) {
@@ -1018,7 +1091,7 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
    const struct hash_entry *entry = _mesa_hash_table_search(record_types,
                                                             &key);
    if (entry == NULL) {
-      const glsl_type *t = new glsl_type(fields, num_fields, name);
+      t = new glsl_type(fields, num_fields, name);
 
       entry = _mesa_hash_table_insert(record_types, t, (void *) t);
    }
@@ -1027,9 +1100,13 @@ glsl_type::get_record_instance(const glsl_struct_field *fields,
    assert(((glsl_type *) entry->data)->length == num_fields);
    assert(strcmp(((glsl_type *) entry->data)->name, name) == 0);
 
+   t = (const glsl_type *) entry->data;
+
    mtx_unlock(&glsl_type::hash_mutex);
 
-   return (glsl_type *) entry->data;
+   cache->record_types[slot] = t;
+
+   return t;
 }
 
 
@@ -1042,6 +1119,14 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
 {
    const glsl_type key(fields, num_fields, packing, row_major, block_name);
 
+   glsl_type_cache *const cache = get_type_cache();
+   const unsigned slot =
+      (record_key_hash(&key) ^ _mesa_hash_string(block_name)) % TYPE_CACHE_SIZE;
+   const glsl_type *t = cache->interface_types[slot];
+
+   if (t != NULL && record_key_compare(t, &key))
+      return t;
+
    mtx_lock(&glsl_type::hash_mutex);
 
    if (interface_types == NULL) {
@@ -1052,8 +1137,7 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
    const struct hash_entry *entry = _mesa_hash_table_search(interface_types,
                                                             &key);
    if (entry == NULL) {
-      const glsl_type *t = new glsl_type(fields, num_fields,
-                                         packing, row_major, block_name);
+      t = new glsl_type(fields, num_fields, packing, row_major, block_name);
 
       entry = _mesa_hash_table_insert(interface_types, t, (void *) t);
    }
@@ -1062,9 +1146,13 @@ glsl_type::get_interface_instance(const glsl_struct_field *fields,
    assert(((glsl_type *) entry->data)->length == num_fields);
    assert(strcmp(((glsl_type *) entry->data)->name, block_name) == 0);
 
+   t = (const glsl_type *) entry->data;
+
    mtx_unlock(&glsl_type::hash_mutex);
 
-   return (glsl_type *) entry->data;
+   cache->interface_types[slot] = t;
+
+   return t;
 }
 
 const glsl_type *
@@ -1072,6 +1160,14 @@ glsl_type::get_subroutine_instance(const char *subroutine_name)
 {
    const glsl_type key(subroutine_name);
 
+   /* All the subroutine types have the same record_key_hash(). */
+   glsl_type_cache *const cache = get_type_cache();
+   const unsigned slot = _mesa_hash_string(subroutine_name) % TYPE_CACHE_SIZE;
+   const glsl_type *t = cache->subroutine_types[slot];
+
+   if (t != NULL && record_key_compare(t, &key))
+      return t;
+
    mtx_lock(&glsl_type::hash_mutex);
 
    if (subroutine_types == NULL) {
@@ -1082,7 +1178,7 @@ glsl_type::get_subroutine_instance(const char *subroutine_name)
    const struct hash_entry *entry = _mesa_hash_table_search(subroutine_types,
                                                             &key);
    if (entry == NULL) {
-      const glsl_type *t = new glsl_type(subroutine_name);
+      t = new glsl_type(subroutine_name);
 
       entry = _mesa_hash_table_insert(subroutine_types, t, (void *) t);
    }
@@ -1090,9 +1186,13 @@ glsl_type::get_subroutine_instance(const char *subroutine_name)
    assert(((glsl_type *) entry->data)->base_type == GLSL_TYPE_SUBROUTINE);
    assert(strcmp(((glsl_type *) entry->data)->name, subroutine_name) == 0);
 
+   t = (const glsl_type *) entry->data;
+
    mtx_unlock(&glsl_type::hash_mutex);
 
-   return (glsl_type *) entry->data;
+   cache->subroutine_types[slot] = t;
+
+   return t;
 }
 
 
@@ -1125,6 +1225,13 @@ glsl_type::get_function_instance(const glsl_type *return_type,
 {
    const glsl_type key(return_type, params, num_params);
 
+   glsl_type_cache *const cache = get_type_cache();
+   const unsigned slot = function_key_hash(&key) % TYPE_CACHE_SIZE;
+   const glsl_type *t = cache->function_types[slot];
+
+   if (t != NULL && function_key_compare(t, &key))
+      return t;
+
    mtx_lock(&glsl_type::hash_mutex);
 
    if (function_types == NULL) {
@@ -1134,18 +1241,20 @@ glsl_type::get_function_instance(const glsl_type *return_type,
 
    struct hash_entry *entry = _mesa_hash_table_search(function_types, &key);
    if (entry == NULL) {
-      const glsl_type *t = new glsl_type(return_type, params, num_params);
+      t = new glsl_type(return_type, params, num_params);
 
       entry = _mesa_hash_table_insert(function_types, t, (void *) t);
    }
 
-   const glsl_type *t = (const glsl_type *)entry->data;
+   t = (const glsl_type *)entry->data;
 
    assert(t->base_type == GLSL_TYPE_FUNCTION);
    assert(t->length == num_params);
 
    mtx_unlock(&glsl_type::hash_mutex);
 
+   cache->function_types[slot] = t;
+
    return t;
 }
 
@@ -68,6 +68,8 @@ nir_shader_create(void *mem_ctx,
    shader->num_uniforms = 0;
    shader->num_shared = 0;
 
+   shader->instr_slab = ralloc_slab_context(shader);
+
    return shader;
 }
 
@@ -400,6 +402,7 @@ instr_init(nir_instr *instr, nir_instr_type type)
 {
    instr->type = type;
    instr->block = NULL;
+   nir_instr_mark_dirty(instr);
    exec_node_init(&instr->node);
 }
 
@@ -435,8 +438,8 @@ nir_alu_instr_create(nir_shader *shader, nir_op op)
    unsigned num_srcs = nir_op_infos[op].num_inputs;
    /* TODO: don't use rzalloc */
    nir_alu_instr *instr =
-      rzalloc_size(shader,
-                   sizeof(nir_alu_instr) + num_srcs * sizeof(nir_alu_src));
+      rzalloc_slab_size(shader->instr_slab,
+                        sizeof(nir_alu_instr) + num_srcs * sizeof(nir_alu_src));
 
    instr_init(&instr->instr, nir_instr_type_alu);
    instr->op = op;
@@ -451,7 +454,7 @@ nir_deref_instr *
 nir_deref_instr_create(nir_shader *shader, nir_deref_type deref_type)
 {
    nir_deref_instr *instr =
-      rzalloc_size(shader, sizeof(nir_deref_instr));
+      rzalloc_slab_size(shader->instr_slab, sizeof(nir_deref_instr));
 
    instr_init(&instr->instr, nir_instr_type_deref);
 
@@ -470,7 +473,8 @@ nir_deref_instr_create(nir_shader *shader, nir_deref_type deref_type)
 nir_jump_instr *
 nir_jump_instr_create(nir_shader *shader, nir_jump_type type)
 {
-   nir_jump_instr *instr = ralloc(shader, nir_jump_instr);
+   nir_jump_instr *instr =
+      ralloc_slab_size(shader->instr_slab, sizeof(nir_jump_instr));
    instr_init(&instr->instr, nir_instr_type_jump);
    instr->type = type;
    return instr;
@@ -480,7 +484,8 @@ nir_load_const_instr *
 nir_load_const_instr_create(nir_shader *shader, unsigned num_components,
                             unsigned bit_size)
 {
-   nir_load_const_instr *instr = rzalloc(shader, nir_load_const_instr);
+   nir_load_const_instr *instr =
+      rzalloc_slab_size(shader->instr_slab, sizeof(nir_load_const_instr));
    instr_init(&instr->instr, nir_instr_type_load_const);
 
    nir_ssa_def_init(&instr->instr, &instr->def, num_components, bit_size, NULL);
@@ -494,8 +499,8 @@ nir_intrinsic_instr_create(nir_shader *shader, nir_intrinsic_op op)
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
    /* TODO: don't use rzalloc */
    nir_intrinsic_instr *instr =
-      rzalloc_size(shader,
-                  sizeof(nir_intrinsic_instr) + num_srcs * sizeof(nir_src));
+      rzalloc_slab_size(shader->instr_slab,
+                        sizeof(nir_intrinsic_instr) + num_srcs * sizeof(nir_src));
 
    instr_init(&instr->instr, nir_instr_type_intrinsic);
    instr->intrinsic = op;
@@ -514,8 +519,8 @@ nir_call_instr_create(nir_shader *shader, nir_function *callee)
 {
    const unsigned num_params = callee->num_params;
    nir_call_instr *instr =
-      rzalloc_size(shader, sizeof(*instr) +
-                   num_params * sizeof(instr->params[0]));
+      rzalloc_slab_size(shader->instr_slab, sizeof(*instr) +
+                        num_params * sizeof(instr->params[0]));
 
    instr_init(&instr->instr, nir_instr_type_call);
    instr->callee = callee;
@@ -529,7 +534,8 @@ nir_call_instr_create(nir_shader *shader, nir_function *callee)
 nir_tex_instr *
 nir_tex_instr_create(nir_shader *shader, unsigned num_srcs)
 {
-   nir_tex_instr *instr = rzalloc(shader, nir_tex_instr);
+   nir_tex_instr *instr =
+      rzalloc_slab_size(shader->instr_slab, sizeof(nir_tex_instr));
    instr_init(&instr->instr, nir_instr_type_tex);
 
    dest_init(&instr->dest);
@@ -587,7 +593,8 @@ nir_tex_instr_remove_src(nir_tex_instr *tex, unsigned src_idx)
 nir_phi_instr *
 nir_phi_instr_create(nir_shader *shader)
 {
-   nir_phi_instr *instr = ralloc(shader, nir_phi_instr);
+   nir_phi_instr *instr =
+      ralloc_slab_size(shader->instr_slab, sizeof(nir_phi_instr));
    instr_init(&instr->instr, nir_instr_type_phi);
 
    dest_init(&instr->dest);
@@ -598,7 +605,8 @@ nir_phi_instr_create(nir_shader *shader)
 nir_parallel_copy_instr *
 nir_parallel_copy_instr_create(nir_shader *shader)
 {
-   nir_parallel_copy_instr *instr = ralloc(shader, nir_parallel_copy_instr);
+   nir_parallel_copy_instr *instr =
+      ralloc_slab_size(shader->instr_slab, sizeof(nir_parallel_copy_instr));
    instr_init(&instr->instr, nir_instr_type_parallel_copy);
 
    exec_list_make_empty(&instr->entries);
@@ -611,7 +619,8 @@ nir_ssa_undef_instr_create(nir_shader *shader,
                            unsigned num_components,
                            unsigned bit_size)
 {
-   nir_ssa_undef_instr *instr = ralloc(shader, nir_ssa_undef_instr);
+   nir_ssa_undef_instr *instr =
+      ralloc_slab_size(shader->instr_slab, sizeof(nir_ssa_undef_instr));
    instr_init(&instr->instr, nir_instr_type_ssa_undef);
 
    nir_ssa_def_init(&instr->instr, &instr->def, num_components, bit_size, NULL);
@@ -751,11 +760,22 @@ nir_cursors_equal(nir_cursor a, nir_cursor b)
    return a.block == b.block && a.option == b.option;
 }
 
+/* The instruction defining an SSA value is dirty when its uses change, as
+ * some passes look at how a value is used.
+ */
+static inline void
+src_mark_ssa_parent_dirty(const nir_src *src)
+{
+   if (src->is_ssa)
+      nir_instr_mark_dirty(src->ssa->parent_instr);
+}
+
 static bool
 add_use_cb(nir_src *src, void *state)
 {
    nir_instr *instr = state;
 
+   src_mark_ssa_parent_dirty(src);
    src->parent_instr = instr;
    list_addtail(&src->use_link,
                 src->is_ssa ? &src->ssa->uses : &src->reg.reg->uses);
@@ -802,6 +822,8 @@ add_defs_uses(nir_instr *instr)
 void
 nir_instr_insert(nir_cursor cursor, nir_instr *instr)
 {
+   nir_instr_mark_dirty(instr);
+
    switch (cursor.option) {
    case nir_cursor_before_block:
       /* Only allow inserting jumps into empty blocks. */
@@ -858,8 +880,10 @@ remove_use_cb(nir_src *src, void *state)
 {
    (void) state;
 
-   if (src_is_valid(src))
+   if (src_is_valid(src)) {
+      src_mark_ssa_parent_dirty(src);
       list_del(&src->use_link);
+   }
 
    return true;
 }
@@ -1248,6 +1272,7 @@ src_remove_all_uses(nir_src *src)
       if (!src_is_valid(src))
          continue;
 
+      src_mark_ssa_parent_dirty(src);
       list_del(&src->use_link);
    }
 }
@@ -1259,6 +1284,8 @@ src_add_all_uses(nir_src *src, nir_instr *parent_instr, nir_if *parent_if)
       if (!src_is_valid(src))
          continue;
 
+      src_mark_ssa_parent_dirty(src);
+
       if (parent_instr) {
          src->parent_instr = parent_instr;
          if (src->is_ssa)
@@ -1281,6 +1308,7 @@ nir_instr_rewrite_src(nir_instr *instr, nir_src *src, nir_src new_src)
 {
    assert(!src_is_valid(src) || src->parent_instr == instr);
 
+   nir_instr_mark_dirty(instr);
    src_remove_all_uses(src);
    *src = new_src;
    src_add_all_uses(src, instr, NULL);
@@ -1291,6 +1319,7 @@ nir_instr_move_src(nir_instr *dest_instr, nir_src *dest, nir_src *src)
 {
    assert(!src_is_valid(dest) || dest->parent_instr == dest_instr);
 
+   nir_instr_mark_dirty(dest_instr);
    src_remove_all_uses(dest);
    src_remove_all_uses(src);
    *dest = *src;
@@ -1324,6 +1353,8 @@ nir_instr_rewrite_dest(nir_instr *instr, nir_dest *dest, nir_dest new_dest)
    /* We can't re-write with an SSA def */
    assert(!new_dest.is_ssa);
 
+   nir_instr_mark_dirty(instr);
+
    nir_dest_copy(dest, &new_dest, instr);
 
    dest->reg.parent_instr = instr;
@@ -498,6 +498,21 @@ typedef enum {
    nir_instr_type_parallel_copy,
 } nir_instr_type;
 
+/**
+ * Passes which only look again at the instructions which changed since their
+ * last run, when nir_metadata_dirty_instrs is valid.
+ */
+typedef enum {
+   nir_dirty_copy_prop = (1 << 0),
+   nir_dirty_constant_folding = (1 << 1),
+   nir_dirty_dce = (1 << 2),
+   nir_dirty_cse = (1 << 3),
+   nir_dirty_opt_algebraic = (1 << 4),
+   nir_dirty_opt_algebraic_before_ffma = (1 << 5),
+   nir_dirty_opt_algebraic_late = (1 << 6),
+   nir_dirty_all = 0xffff,
+} nir_dirty_pass;
+
 typedef struct nir_instr {
    struct exec_node node;
    nir_instr_type type;
@@ -510,8 +525,20 @@ typedef struct nir_instr {
     * flags.  For instance, DCE uses this to store the "dead/live" info.
     */
    uint8_t pass_flags;
+
+   /** nir_dirty_pass flags of the passes which haven't seen the instruction
+    * since it was inserted, its sources were rewritten or the uses of its
+    * SSA values changed.
+    */
+   uint16_t dirty;
 } nir_instr;
 
+static inline void
+nir_instr_mark_dirty(nir_instr *instr)
+{
+   instr->dirty = nir_dirty_all;
+}
+
 static inline nir_instr *
 nir_instr_next(nir_instr *instr)
 {
@@ -1854,6 +1881,17 @@ typedef enum {
    nir_metadata_live_ssa_defs = 0x4,
    nir_metadata_not_properly_reset = 0x8,
    nir_metadata_loop_analysis = 0x10,
+
+   /**
+    * nir_instr::dirty is up to date.
+    *
+    * The NIR helpers which insert and remove instructions or rewrite sources
+    * and destinations keep it up to date, so a pass can preserve it as long
+    * as it only changes the instructions with them, or marks the other ones
+    * it changes with nir_instr_mark_dirty(), and doesn't change the control
+    * flow.  Requiring it marks all the instructions as dirty.
+    */
+   nir_metadata_dirty_instrs = 0x20,
 } nir_metadata;
 
 typedef struct {
@@ -2172,6 +2210,14 @@ typedef struct nir_shader {
     */
    void *constant_data;
    unsigned constant_data_size;
+
+   /** Slab context the instructions are allocated from.
+    *
+    * The instructions are still ralloc contexts, but ralloc_steal() can't be
+    * used on them and they are only freed by nir_sweep() or along with the
+    * shader.
+    */
+   ralloc_slab_ctx *instr_slab;
 } nir_shader;
 
 static inline nir_function_impl *
@@ -2237,6 +2283,8 @@ nir_function_impl *nir_cf_node_get_function(nir_cf_node *node);
 void nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...);
 /** dirties all but the preserved metadata */
 void nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved);
+/** clears a pass' dirty flag, returns whether any instruction had it */
+bool nir_clear_dirty_instrs(nir_function_impl *impl, nir_dirty_pass pass);
 
 /** creates an instruction with default swizzle/writemask/etc. with NULL registers */
 nir_alu_instr *nir_alu_instr_create(nir_shader *shader, nir_op op);
@@ -25,7 +25,7 @@
 
 from __future__ import print_function
 import ast
-from collections import OrderedDict
+from collections import defaultdict
 import itertools
 import struct
 import sys
@@ -516,6 +516,205 @@ class SearchAndReplace(object):
 
       BitSizeValidator(varset).validate(self.search, self.replace)
 
+class TreeAutomaton(object):
+   """This class computes a bottom-up tree automaton which quickly finds the
+   search expressions that can match at a given instruction.
+
+   Tree automata generalize classical finite automata to trees: the state of
+   a node is given by a transition function of its opcode and of the states
+   of its children.  Here a state is the set of subtrees of the search
+   expressions ("items") which match the node, so every ALU instruction gets
+   its state with a single lookup in the table of its opcode, once the states
+   of its sources are known.  The deterministic automaton is built like in
+   the classical NFA to DFA construction.
+
+   The automaton only looks at opcodes and at whether a value is a constant.
+   Constant values, variable conditions, types, bit sizes and exactness are
+   left to nir_replace_instr(), so the automaton is only a fast filter that
+   never rejects a search expression which could match.
+
+   This is a frontier-to-root deterministic automaton with symbol filtering,
+   in the terms of "Tree Automatons: Two Taxonomies and a Toolkit" by Cleophas.
+   Filtering the source states by the opcode of the parent keeps both the time
+   to build the tables and their size small.
+   """
+   def __init__(self, transforms):
+      self.patterns = [t.search for t in transforms]
+      self._compute_items()
+      self._build_table()
+      assert len(self.states) < (1 << 16), "Too many states for uint16_t"
+
+   class IndexMap(object):
+      """A list of unique objects, which also finds the index of an object in
+      constant time.
+      """
+      def __init__(self):
+         self.objects = []
+         self.map = {}
+
+      def __getitem__(self, i):
+         return self.objects[i]
+
+      def __contains__(self, obj):
+         return obj in self.map
+
+      def __len__(self):
+         return len(self.objects)
+
+      def __iter__(self):
+         return iter(self.objects)
+
+      def clear(self):
+         self.objects = []
+         self.map.clear()
+
+      def index(self, obj):
+         return self.map[obj]
+
+      def add(self, obj):
+         if obj in self.map:
+            return self.map[obj]
+         else:
+            index = len(self.objects)
+            self.objects.append(obj)
+            self.map[obj] = index
+            return index
+
+   class Item(object):
+      """A subtree of some search expressions, i.e. a potential partial match.
+      Identical subtrees of different search expressions share the same item.
+      """
+      def __init__(self, opcode, children):
+         self.opcode = opcode
+         self.children = children
+         # Indices of the search expressions this item is the root of.
+         self.patterns = []
+         # Opcodes of the parents of this item, used for filtering.
+         self.parent_ops = set()
+
+   def _compute_items(self):
+      """Build the set of all the items, deduplicating them."""
+      # Map from (opcode, children) to item.
+      self.items = {}
+
+      # The opcodes used by the search expressions, the others don't get any
+      # table.
+      self.opcodes = self.IndexMap()
+
+      def get_item(opcode, children, pattern=None):
+         commutative = len(children) == 2 and \
+            "commutative" in opcodes[opcode].algebraic_properties
+         item = self.items.setdefault((opcode, children),
+                                      self.Item(opcode, children))
+         if commutative:
+            self.items[opcode, (children[1], children[0])] = item
+         if pattern is not None:
+            item.patterns.append(pattern)
+         return item
+
+      # Matches any value, the actual variable is checked later.
+      self.wildcard = get_item("__wildcard", ())
+      # Matches load_const values, the actual value is checked later.
+      self.const = get_item("__const", ())
+
+      def process_subpattern(src, pattern=None):
+         if isinstance(src, Constant):
+            return self.const
+         elif isinstance(src, Variable):
+            return self.const if src.is_constant else self.wildcard
+         else:
+            assert isinstance(src, Expression)
+            self.opcodes.add(src.opcode)
+            children = tuple(process_subpattern(c) for c in src.sources)
+            item = get_item(src.opcode, children, pattern)
+            for child in children:
+               child.parent_ops.add(src.opcode)
+            return item
+
+      for i, pattern in enumerate(self.patterns):
+         process_subpattern(pattern, i)
+
+   def _build_table(self):
+      """Build the set of reachable states, i.e. sets of items matching some
+      instruction, along with the transition table between them.  This is
+      "Reachability-based tabulation of Cl . Comp_a and Filt_{a,i} using
+      integers to identify match sets" (algorithm 5.7.38 of the above).
+      """
+      # Map from opcode and filtered source state indices to state index.
+      self.table = defaultdict(dict)
+      # All the states found so far.
+      self.states = self.IndexMap()
+      # The search expressions matching at each state, in source order.
+      self.state_patterns = []
+      # Map from state index to filtered state index, for each opcode.
+      self.filter = defaultdict(list)
+      # The filtered states found so far, for each opcode.
+      self.rep = defaultdict(self.IndexMap)
+
+      # The states from worklist_index on have yet to be filtered, and the
+      # filtered states of an opcode from worklist_indices[op] on have yet to
+      # get their transitions computed.
+      self.worklist_index = 0
+      worklist_indices = defaultdict(lambda: 0)
+
+      # Opcodes which got new filtered states.
+      new_opcodes = self.IndexMap()
+
+      def process_new_states():
+         while self.worklist_index < len(self.states):
+            state = self.states[self.worklist_index]
+
+            # Each search expression has a unique root item, so there are no
+            # duplicates, but they must be tried in the order they were given.
+            patterns = sorted(p for item in state for p in item.patterns)
+            self.state_patterns.append(patterns)
+
+            for op in self.opcodes:
+               rep = self.rep[op]
+               filtered = frozenset(item for item in state
+                                    if op in item.parent_ops)
+               if filtered not in rep:
+                  new_opcodes.add(op)
+               self.filter[op].append(rep.add(filtered))
+
+            self.worklist_index += 1
+
+      # The two start states: the state of any non-ALU value, which only
+      # matches as a wildcard, and the state of load_const values.  These
+      # must be in sync with WILDCARD_STATE and CONST_STATE in the C code.
+      self.states.add(frozenset((self.wildcard,)))
+      self.states.add(frozenset((self.const, self.wildcard)))
+      process_new_states()
+
+      while len(new_opcodes) > 0:
+         for op in new_opcodes:
+            rep = self.rep[op]
+            table = self.table[op]
+            op_worklist_index = worklist_indices[op]
+
+            # All the combinations of filtered source states with at least one
+            # new filtered state.
+            for src_indices in itertools.product(range(len(rep)),
+                                                 repeat=opcodes[op].num_inputs):
+               if all(i < op_worklist_index for i in src_indices):
+                  continue
+
+               srcs = tuple(rep[i] for i in src_indices)
+
+               # The items matching all the combinations of source items,
+               # plus the wildcard which always matches.
+               parent = set(self.items[op, item_srcs]
+                            for item_srcs in itertools.product(*srcs)
+                            if (op, item_srcs) in self.items)
+               parent.add(self.wildcard)
+
+               table[src_indices] = self.states.add(frozenset(parent))
+
+            worklist_indices[op] = len(rep)
+
+         new_opcodes.clear()
+         process_new_states()
+
 _algebraic_pass_template = mako.template.Template("""
 #include "nir.h"
 #include "nir_search.h"
@@ -530,27 +729,179 @@ struct transform {
    unsigned condition_offset;
 };
 
+/* Transition table of the tree automaton for a given opcode. */
+struct per_op_table {
+   /* Filtered state of a source for each state. */
+   const uint16_t *filter;
+   unsigned num_filtered_states;
+   /* State of the instruction for each combination of filtered source
+    * states.
+    */
+   const uint16_t *table;
+};
+
+/* Transforms to try at an instruction in a given state. */
+struct state_transforms {
+   const struct transform *xforms;
+   unsigned num_xforms;
+   /* Levels of instructions the transforms look at. */
+   unsigned depth;
+};
+
+/* These must match the start states of TreeAutomaton._build_table().  The
+ * state of non-ALU values, WILDCARD_STATE, is 0 so that it is set by zeroing
+ * the state array.
+ */
+#define CONST_STATE 1
+
 #endif
 
-% for (opcode, xform_list) in xform_dict.items():
-% for xform in xform_list:
+% for xform in xforms:
    ${xform.search.render()}
    ${xform.replace.render()}
 % endfor
 
-static const struct transform ${pass_name}_${opcode}_xforms[] = {
-% for xform in xform_list:
-   { &${xform.search.name}, ${xform.replace.c_ptr}, ${xform.condition_index} },
+% for i, patterns in enumerate(pattern_lists):
+static const struct transform ${pass_name}_xforms${i}[] = {
+% for p in patterns:
+   { &${xforms[p].search.name}, ${xforms[p].replace.c_ptr}, ${xforms[p].condition_index} },
+% endfor
+};
+
+% endfor
+static const struct state_transforms ${pass_name}_state_xforms[] = {
+% for patterns in automaton.state_patterns:
+% if patterns:
+   { ${pass_name}_xforms${pattern_lists.index(tuple(patterns))}, ${len(patterns)}, ${max(depths[p] for p in patterns)} },
+% else:
+   { NULL, 0, 0 },
+% endif
+% endfor
+};
+
+% for op in automaton.opcodes:
+static const uint16_t ${pass_name}_${op}_filter[] = {
+% for i in range(0, len(automaton.filter[op]), 16):
+   ${', '.join(str(e) for e in automaton.filter[op][i:i + 16])},
+% endfor
+};
+
+<% table = [automaton.table[op][indices] for indices in itertools.product(range(len(automaton.rep[op])), repeat=opcodes[op].num_inputs)] %>
+static const uint16_t ${pass_name}_${op}_table[] = {
+% for i in range(0, len(table), 16):
+   ${', '.join(str(e) for e in table[i:i + 16])},
 % endfor
 };
+
+% endfor
+static const struct per_op_table ${pass_name}_table[nir_num_opcodes] = {
+% for op in automaton.opcodes:
+   [nir_op_${op}] = {
+      ${pass_name}_${op}_filter,
+      ${len(automaton.rep[op])},
+      ${pass_name}_${op}_table,
+   },
 % endfor
+};
+
+% if dirty_flag:
+static bool
+${pass_name}_mark_reach(nir_ssa_def *def, void *reach)
+{
+   ((uint8_t *) reach)[def->index] = ${depth};
+   return true;
+}
+
+/* Matching at an instruction looks at the ALU instructions up to the depth
+ * of its transforms minus one sources away, so only the ones that close to
+ * an instruction changed since the last run need another look.  reach[]
+ * holds ${depth}, the largest depth, for the values of the changed
+ * instructions, and one less than the largest reach of its sources for the
+ * other ALU values.
+ */
+static void
+${pass_name}_pre_block(nir_block *block, uint16_t *states, uint8_t *reach)
+% else:
+static void
+${pass_name}_pre_block(nir_block *block, uint16_t *states)
+% endif
+{
+   nir_foreach_instr(instr, block) {
+% if dirty_flag:
+      const bool dirty = instr->dirty & ${dirty_flag};
+      instr->dirty &= ~${dirty_flag};
+
+% endif
+      switch (instr->type) {
+      case nir_instr_type_alu: {
+         nir_alu_instr *alu = nir_instr_as_alu(instr);
+         const struct per_op_table *tbl = &${pass_name}_table[alu->op];
+
+         if (!alu->dest.dest.is_ssa)
+            break;
+
+% if dirty_flag:
+         unsigned src_reach = 0;
+         for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+            if (alu->src[i].src.is_ssa)
+               src_reach = MAX2(src_reach, reach[alu->src[i].src.ssa->index]);
+         }
+
+         reach[alu->dest.dest.ssa.index] = dirty ? ${depth} :
+                                           MAX2(src_reach, 1) - 1;
+
+% endif
+         if (tbl->num_filtered_states == 0)
+            break;
+
+         /* The index into the transition table must match the iteration
+          * order of itertools.product(), which was used to emit the table.
+          * Non-SSA sources are in the wildcard state.
+          */
+         unsigned index = 0;
+         for (unsigned i = 0; i < nir_op_infos[alu->op].num_inputs; i++) {
+            uint16_t src_state = alu->src[i].src.is_ssa ?
+                                 states[alu->src[i].src.ssa->index] : 0;
+
+            index = index * tbl->num_filtered_states + tbl->filter[src_state];
+         }
+
+         states[alu->dest.dest.ssa.index] = tbl->table[index];
+         break;
+      }
+
+      case nir_instr_type_load_const: {
+         nir_load_const_instr *load_const = nir_instr_as_load_const(instr);
+         states[load_const->def.index] = CONST_STATE;
+% if dirty_flag:
+         if (dirty)
+            reach[load_const->def.index] = ${depth};
+% endif
+         break;
+      }
+
+      default:
+% if dirty_flag:
+         if (dirty)
+            nir_foreach_ssa_def(instr, ${pass_name}_mark_reach, reach);
+% endif
+         break;
+      }
+   }
+}
 
 static bool
-${pass_name}_block(nir_block *block, const bool *condition_flags,
-                   void *mem_ctx)
+${pass_name}_block(nir_block *block, const uint16_t *states,
+% if dirty_flag:
+                   const uint8_t *reach,
+% endif
+                   const bool *condition_flags, void *mem_ctx)
 {
    bool progress = false;
 
+   /* The instructions inserted by the replacements are not visited, which is
+    * good as their state is unknown.
+    */
    nir_foreach_instr_reverse_safe(instr, block) {
       if (instr->type != nir_instr_type_alu)
          continue;
@@ -559,22 +910,22 @@ ${pass_name}_block(nir_block *block, const bool *condition_flags,
       if (!alu->dest.dest.is_ssa)
          continue;
 
-      switch (alu->op) {
-      % for opcode in xform_dict.keys():
-      case nir_op_${opcode}:
-         for (unsigned i = 0; i < ARRAY_SIZE(${pass_name}_${opcode}_xforms); i++) {
-            const struct transform *xform = &${pass_name}_${opcode}_xforms[i];
-            if (condition_flags[xform->condition_offset] &&
-                nir_replace_instr(alu, xform->search, xform->replace,
-                                  mem_ctx)) {
-               progress = true;
-               break;
-            }
+      const struct state_transforms *state_xforms =
+         &${pass_name}_state_xforms[states[alu->dest.dest.ssa.index]];
+
+% if dirty_flag:
+      if (reach[alu->dest.dest.ssa.index] + state_xforms->depth <= ${depth})
+         continue;
+
+% endif
+      for (unsigned i = 0; i < state_xforms->num_xforms; i++) {
+         const struct transform *xform = &state_xforms->xforms[i];
+         if (condition_flags[xform->condition_offset] &&
+             nir_replace_instr(alu, xform->search, xform->replace,
+                               mem_ctx)) {
+            progress = true;
+            break;
          }
-         break;
-      % endfor
-      default:
-         break;
       }
    }
 
@@ -587,13 +938,50 @@ ${pass_name}_impl(nir_function_impl *impl, const bool *condition_flags)
    void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
 
+   /* Zeroed, so that everything but ALU and load_const values is in the
+    * wildcard state.
+    */
+   uint16_t *states = calloc(impl->ssa_alloc, sizeof(*states));
+   if (!states)
+      return false;
+
+% if dirty_flag:
+   uint8_t *reach = calloc(impl->ssa_alloc, sizeof(*reach));
+   if (!reach) {
+      free(states);
+      return false;
+   }
+
+   nir_metadata_require(impl, nir_metadata_dirty_instrs);
+
+   nir_foreach_block(block, impl) {
+      ${pass_name}_pre_block(block, states, reach);
+   }
+
    nir_foreach_block_reverse(block, impl) {
-      progress |= ${pass_name}_block(block, condition_flags, mem_ctx);
+      progress |= ${pass_name}_block(block, states, reach, condition_flags,
+                                     mem_ctx);
    }
 
+   free(reach);
+% else:
+   nir_foreach_block(block, impl) {
+      ${pass_name}_pre_block(block, states);
+   }
+
+   nir_foreach_block_reverse(block, impl) {
+      progress |= ${pass_name}_block(block, states, condition_flags, mem_ctx);
+   }
+% endif
+   free(states);
+
+   /* The instructions are only changed by nir_replace_instr(), which keeps
+    * their dirty flags up to date.
+    */
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_dirty_instrs);
 
    return progress;
 }
@@ -620,10 +1008,22 @@ ${pass_name}(nir_shader *shader)
 }
 """)
 
+def _search_depth(value):
+   """Returns the number of levels of instructions matching the given search
+   value looks at, counting the ones defining the variables and constants."""
+   if isinstance(value, Expression):
+      return 1 + max(_search_depth(src) for src in value.sources)
+   else:
+      return 1
+
 class AlgebraicPass(object):
-   def __init__(self, pass_name, transforms):
-      self.xform_dict = OrderedDict()
+   def __init__(self, pass_name, transforms, dirty_flag=None):
+      """If dirty_flag is the nir_dirty_pass flag of the pass, it only tries
+      the transforms on the instructions near the ones which changed since
+      its last run."""
+      self.xforms = []
       self.pass_name = pass_name
+      self.dirty_flag = dirty_flag
 
       error = False
 
@@ -639,15 +1039,29 @@ class AlgebraicPass(object):
                error = True
                continue
 
-         if xform.search.opcode not in self.xform_dict:
-            self.xform_dict[xform.search.opcode] = []
-
-         self.xform_dict[xform.search.opcode].append(xform)
+         self.xforms.append(xform)
 
       if error:
          sys.exit(1)
 
+      self.automaton = TreeAutomaton(self.xforms)
+
    def render(self):
+      # States matching the same transforms share their list.
+      pattern_lists = []
+      for patterns in self.automaton.state_patterns:
+         if patterns and tuple(patterns) not in pattern_lists:
+            pattern_lists.append(tuple(patterns))
+
+      depths = [_search_depth(xform.search) for xform in self.xforms]
+
       return _algebraic_pass_template.render(pass_name=self.pass_name,
-                                             xform_dict=self.xform_dict,
+                                             xforms=self.xforms,
+                                             automaton=self.automaton,
+                                             pattern_lists=pattern_lists,
+                                             dirty_flag=self.dirty_flag,
+                                             depths=depths,
+                                             depth=max(depths),
+                                             opcodes=opcodes,
+                                             itertools=itertools,
                                              condition_list=condition_list)
@@ -561,32 +561,53 @@ nir_instr_set_destroy(struct set *instr_set)
    _mesa_set_destroy(instr_set, NULL);
 }
 
-bool
-nir_instr_set_add_or_rewrite(struct set *instr_set, nir_instr *instr)
+nir_ssa_def *
+nir_instr_set_add(struct set *instr_set, nir_instr *instr)
 {
    if (!instr_can_rewrite(instr))
-      return false;
+      return NULL;
 
-   struct set_entry *entry = _mesa_set_search(instr_set, instr);
-   if (entry) {
-      nir_ssa_def *def = nir_instr_get_dest_ssa_def(instr);
-      nir_instr *match = (nir_instr *) entry->key;
-      nir_ssa_def *new_def = nir_instr_get_dest_ssa_def(match);
-
-      /* It's safe to replace an exact instruction with an inexact one as
-       * long as we make it exact.  If we got here, the two instructions are
-       * exactly identical in every other way so, once we've set the exact
-       * bit, they are the same.
-       */
-      if (instr->type == nir_instr_type_alu && nir_instr_as_alu(instr)->exact)
-         nir_instr_as_alu(match)->exact = true;
+   uint32_t hash = instr_set->key_hash_function(instr);
+   struct set_entry *entry =
+      _mesa_set_search_pre_hashed(instr_set, hash, instr);
+   if (entry)
+      return nir_instr_get_dest_ssa_def((nir_instr *) entry->key);
 
-      nir_ssa_def_rewrite_uses(def, nir_src_for_ssa(new_def));
-      return true;
+   _mesa_set_add_pre_hashed(instr_set, hash, instr);
+   return NULL;
+}
+
+void
+nir_instr_set_rewrite(nir_instr *instr, nir_ssa_def *new_def)
+{
+   nir_ssa_def *def = nir_instr_get_dest_ssa_def(instr);
+   nir_instr *match = new_def->parent_instr;
+
+   /* It's safe to replace an exact instruction with an inexact one as
+    * long as we make it exact.  If we got here, the two instructions are
+    * exactly identical in every other way so, once we've set the exact
+    * bit, they are the same.
+    */
+   if (instr->type == nir_instr_type_alu &&
+       nir_instr_as_alu(instr)->exact &&
+       !nir_instr_as_alu(match)->exact) {
+      nir_instr_as_alu(match)->exact = true;
+      nir_instr_mark_dirty(match);
    }
 
-   _mesa_set_add(instr_set, instr);
-   return false;
+   nir_ssa_def_rewrite_uses(def, nir_src_for_ssa(new_def));
+}
+
+bool
+nir_instr_set_add_or_rewrite(struct set *instr_set, nir_instr *instr)
+{
+   nir_ssa_def *new_def = nir_instr_set_add(instr_set, instr);
+
+   if (new_def == NULL)
+      return false;
+
+   nir_instr_set_rewrite(instr, new_def);
+   return true;
 }
 
 void
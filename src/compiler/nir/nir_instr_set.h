@@ -53,6 +53,19 @@ void nir_instr_set_destroy(struct set *instr_set);
  */
 bool nir_instr_set_add_or_rewrite(struct set *instr_set, nir_instr *instr);
 
+/**
+ * Adds an instruction to an instruction set if it doesn't exist and returns
+ * NULL, or returns the value of the already-inserted instruction it's equal
+ * to without changing anything.
+ */
+nir_ssa_def *nir_instr_set_add(struct set *instr_set, nir_instr *instr);
+
+/**
+ * Rewrites all uses of an instruction to point to the value returned for it
+ * by nir_instr_set_add().
+ */
+void nir_instr_set_rewrite(nir_instr *instr, nir_ssa_def *new_def);
+
 /**
  * Removes an instruction from an instruction set, so that other instructions
  * won't be merged with it.
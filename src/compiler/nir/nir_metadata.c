@@ -41,6 +41,12 @@ nir_metadata_require(nir_function_impl *impl, nir_metadata required, ...)
       nir_calc_dominance_impl(impl);
    if (NEEDS_UPDATE(nir_metadata_live_ssa_defs))
       nir_live_ssa_defs_impl(impl);
+   if (NEEDS_UPDATE(nir_metadata_dirty_instrs)) {
+      nir_foreach_block(block, impl) {
+         nir_foreach_instr(instr, block)
+            nir_instr_mark_dirty(instr);
+      }
+   }
    if (NEEDS_UPDATE(nir_metadata_loop_analysis)) {
       va_list ap;
       va_start(ap, required);
@@ -59,6 +65,28 @@ nir_metadata_preserve(nir_function_impl *impl, nir_metadata preserved)
    impl->valid_metadata &= preserved;
 }
 
+/**
+ * Clears the given nir_dirty_pass flag of all the instructions and returns
+ * whether any of them had it, for the passes which can only skip the whole
+ * function when nothing changed since their last run.
+ */
+bool
+nir_clear_dirty_instrs(nir_function_impl *impl, nir_dirty_pass pass)
+{
+   bool dirty = false;
+
+   nir_metadata_require(impl, nir_metadata_dirty_instrs);
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         dirty |= (instr->dirty & pass) != 0;
+         instr->dirty &= ~pass;
+      }
+   }
+
+   return dirty;
+}
+
 #ifndef NDEBUG
 /**
  * Make sure passes properly invalidate metadata (part 1).
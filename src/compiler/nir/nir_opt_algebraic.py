@@ -899,8 +899,11 @@ late_optimizations = [
    (('b2f@32', a), ('iand', a, 1.0), 'options->lower_b2f'),
 ]
 
-print(nir_algebraic.AlgebraicPass("nir_opt_algebraic", optimizations).render())
+print(nir_algebraic.AlgebraicPass("nir_opt_algebraic", optimizations,
+                                  "nir_dirty_opt_algebraic").render())
 print(nir_algebraic.AlgebraicPass("nir_opt_algebraic_before_ffma",
-                                  before_ffma_optimizations).render())
+                                  before_ffma_optimizations,
+                                  "nir_dirty_opt_algebraic_before_ffma").render())
 print(nir_algebraic.AlgebraicPass("nir_opt_algebraic_late",
-                                  late_optimizations).render())
+                                  late_optimizations,
+                                  "nir_dirty_opt_algebraic_late").render())
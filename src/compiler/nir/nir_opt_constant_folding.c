@@ -161,6 +161,12 @@ constant_fold_block(nir_block *block, void *mem_ctx)
    bool progress = false;
 
    nir_foreach_instr_safe(instr, block) {
+      /* Whether an instruction can be folded only depends on its sources. */
+      if (!(instr->dirty & nir_dirty_constant_folding))
+         continue;
+
+      instr->dirty &= ~nir_dirty_constant_folding;
+
       switch (instr->type) {
       case nir_instr_type_alu:
          progress |= constant_fold_alu_instr(nir_instr_as_alu(instr), mem_ctx);
@@ -184,13 +190,16 @@ nir_opt_constant_folding_impl(nir_function_impl *impl)
    void *mem_ctx = ralloc_parent(impl);
    bool progress = false;
 
+   nir_metadata_require(impl, nir_metadata_dirty_instrs);
+
    nir_foreach_block(block, impl) {
       progress |= constant_fold_block(block, mem_ctx);
    }
 
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_dirty_instrs);
 
    return progress;
 }
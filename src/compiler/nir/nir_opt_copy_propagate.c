@@ -309,14 +309,38 @@ copy_prop_if(nir_if *if_stmt)
    return copy_prop_src(&if_stmt->condition, NULL, if_stmt, 1);
 }
 
+static bool
+src_parent_is_clean(nir_src *src, void *state)
+{
+   return !src->is_ssa || !src->ssa->parent_instr->pass_flags;
+}
+
+/* Whether copy propagation may have something new to do for an instruction
+ * since it last looked at it: it only looks at the instruction and at the
+ * ones defining its sources.  The pass_flags hold whether the instructions
+ * already walked through were dirty.  The sources of the other instructions
+ * are defined earlier, except for the ones of phis.
+ */
+static bool
+copy_prop_instr_is_dirty(nir_instr *instr)
+{
+   instr->pass_flags = (instr->dirty & nir_dirty_copy_prop) != 0;
+   instr->dirty &= ~nir_dirty_copy_prop;
+
+   return instr->pass_flags || instr->type == nir_instr_type_phi ||
+          !nir_foreach_src(instr, src_parent_is_clean, NULL);
+}
+
 static bool
 nir_copy_prop_impl(nir_function_impl *impl)
 {
    bool progress = false;
 
+   nir_metadata_require(impl, nir_metadata_dirty_instrs);
+
    nir_foreach_block(block, impl) {
       nir_foreach_instr(instr, block) {
-         if (copy_prop_instr(instr))
+         if (copy_prop_instr_is_dirty(instr) && copy_prop_instr(instr))
             progress = true;
       }
 
@@ -327,7 +351,8 @@ nir_copy_prop_impl(nir_function_impl *impl)
 
    if (progress) {
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_dirty_instrs);
    }
 
    return progress;
@@ -32,6 +32,141 @@
  * Implements common subexpression elimination
  */
 
+/*
+ * An instruction can only be eliminated if it or an equal instruction changed
+ * since the last run.  Equal instructions have the same sources, so the ones
+ * using an SSA value which a changed instruction also uses are the only ones
+ * with SSA sources that need to be looked at.
+ *
+ * Eliminating an instruction makes its users use the value of the equal one,
+ * so they may now be equal to its other users.  That value is then added to
+ * the ones used by the changed instructions, and its users which were
+ * already visited and skipped are added to the set, so that the same
+ * instructions are eliminated as when looking at all of them.
+ */
+
+/* Flags used in the instr->pass_flags field */
+enum {
+   /** Changed since the last run */
+   CSE_INSTR_DIRTY = (1 << 0),
+   CSE_INSTR_VISITED = (1 << 1),
+   CSE_INSTR_IN_SET = (1 << 2),
+   /** A source was rewritten after the visit */
+   CSE_INSTR_SRC_REWRITTEN = (1 << 3),
+};
+
+struct cse_state {
+   /** SSA values used by the changed instructions */
+   BITSET_WORD *used_by_dirty;
+   bool has_ssa_src;
+};
+
+static bool
+mark_used_by_dirty(nir_src *src, void *used_by_dirty)
+{
+   if (src->is_ssa)
+      BITSET_SET((BITSET_WORD *) used_by_dirty, src->ssa->index);
+
+   return true;
+}
+
+static bool
+src_not_used_by_dirty(nir_src *src, void *_state)
+{
+   struct cse_state *state = _state;
+
+   if (!src->is_ssa)
+      return true;
+
+   state->has_ssa_src = true;
+   return !BITSET_TEST(state->used_by_dirty, src->ssa->index);
+}
+
+/*
+ * Takes the nir_dirty_cse flags of the instructions, keeping whether they
+ * were dirty in pass_flags, and returns whether any of them was.
+ */
+static bool
+take_dirty_instrs(nir_function_impl *impl, BITSET_WORD *used_by_dirty)
+{
+   bool progress = false;
+
+   nir_metadata_require(impl, nir_metadata_dirty_instrs);
+
+   nir_foreach_block(block, impl) {
+      nir_foreach_instr(instr, block) {
+         const bool dirty = instr->dirty & nir_dirty_cse;
+
+         instr->pass_flags = dirty ? CSE_INSTR_DIRTY : 0;
+         instr->dirty &= ~nir_dirty_cse;
+
+         if (dirty) {
+            nir_foreach_src(instr, mark_used_by_dirty, used_by_dirty);
+            progress = true;
+         }
+      }
+   }
+
+   return progress;
+}
+
+static bool
+instr_needs_cse(nir_instr *instr, struct cse_state *state)
+{
+   if (instr->pass_flags & CSE_INSTR_DIRTY)
+      return true;
+
+   state->has_ssa_src = false;
+   if (!nir_foreach_src(instr, src_not_used_by_dirty, state))
+      return true;
+
+   return !state->has_ssa_src;
+}
+
+/*
+ * Called before the uses of an instruction in the given block are rewritten
+ * to def.  The users of def which were skipped but are still in the set when
+ * looking at all the instructions, i.e. the ones in a dominating block, are
+ * added to it.  If def was already used by a changed instruction, none of
+ * them was skipped.
+ */
+static void
+add_skipped_users(nir_ssa_def *def, nir_block *block, struct set *instr_set,
+                  struct cse_state *state)
+{
+   if (BITSET_TEST(state->used_by_dirty, def->index))
+      return;
+
+   BITSET_SET(state->used_by_dirty, def->index);
+
+   nir_foreach_use(src, def) {
+      nir_instr *user = src->parent_instr;
+
+      /* The ones with rewritten sources were hashed with other ones. */
+      if ((user->pass_flags & (CSE_INSTR_VISITED | CSE_INSTR_IN_SET |
+                               CSE_INSTR_SRC_REWRITTEN)) != CSE_INSTR_VISITED ||
+          !nir_block_dominates(user->block, block))
+         continue;
+
+      /* Unchanged instructions which are equal were eliminated by the last
+       * run, so this only adds the user.
+       */
+      if (nir_instr_set_add(instr_set, user) == NULL)
+         user->pass_flags |= CSE_INSTR_IN_SET;
+   }
+}
+
+static bool
+mark_visited_users(nir_ssa_def *def, void *state)
+{
+   nir_foreach_use(src, def) {
+      if (src->parent_instr->pass_flags & CSE_INSTR_VISITED)
+         src->parent_instr->pass_flags |= CSE_INSTR_SRC_REWRITTEN;
+   }
+
+   return true;
+}
+
 /*
  * Visits and CSEs the given block and all its descendants in the dominance
  * tree recursively. Note that the instr_set is guaranteed to only ever
@@ -39,24 +174,37 @@
  */
 
 static bool
-cse_block(nir_block *block, struct set *instr_set)
+cse_block(nir_block *block, struct set *instr_set, struct cse_state *state)
 {
    bool progress = false;
 
    nir_foreach_instr_safe(instr, block) {
-      if (nir_instr_set_add_or_rewrite(instr_set, instr)) {
-         progress = true;
+      instr->pass_flags |= CSE_INSTR_VISITED;
+      if (!instr_needs_cse(instr, state))
+         continue;
+
+      instr->pass_flags |= CSE_INSTR_IN_SET;
+
+      nir_ssa_def *new_def = nir_instr_set_add(instr_set, instr);
+      if (new_def) {
+         add_skipped_users(new_def, block, instr_set, state);
+         nir_foreach_ssa_def(instr, mark_visited_users, NULL);
+
+         nir_instr_set_rewrite(instr, new_def);
          nir_instr_remove(instr);
+         progress = true;
       }
    }
 
    for (unsigned i = 0; i < block->num_dom_children; i++) {
       nir_block *child = block->dom_children[i];
-      progress |= cse_block(child, instr_set);
+      progress |= cse_block(child, instr_set, state);
    }
 
-   nir_foreach_instr(instr, block)
-     nir_instr_set_remove(instr_set, instr);
+   nir_foreach_instr(instr, block) {
+      if (instr->pass_flags & CSE_INSTR_IN_SET)
+         nir_instr_set_remove(instr_set, instr);
+   }
 
    return progress;
 }
@@ -64,17 +212,29 @@ cse_block(nir_block *block, struct set *instr_set)
 static bool
 nir_opt_cse_impl(nir_function_impl *impl)
 {
+   struct cse_state state;
+   state.used_by_dirty = calloc(BITSET_WORDS(impl->ssa_alloc),
+                                sizeof(BITSET_WORD));
+
+   /* Nothing can be eliminated if nothing changed since the last run. */
+   if (!take_dirty_instrs(impl, state.used_by_dirty)) {
+      free(state.used_by_dirty);
+      return false;
+   }
+
    struct set *instr_set = nir_instr_set_create(NULL);
 
    nir_metadata_require(impl, nir_metadata_dominance);
 
-   bool progress = cse_block(nir_start_block(impl), instr_set);
+   bool progress = cse_block(nir_start_block(impl), instr_set, &state);
 
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_dirty_instrs);
 
    nir_instr_set_destroy(instr_set);
+   free(state.used_by_dirty);
    return progress;
 }
 
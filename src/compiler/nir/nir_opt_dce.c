@@ -123,6 +123,10 @@ init_block(nir_block *block, nir_instr_worklist *worklist)
 static bool
 nir_opt_dce_impl(nir_function_impl *impl)
 {
+   /* Nothing can become dead if nothing changed since the last run. */
+   if (!nir_clear_dirty_instrs(impl, nir_dirty_dce))
+      return false;
+
    nir_instr_worklist *worklist = nir_instr_worklist_create();
 
    nir_foreach_block(block, impl) {
@@ -147,7 +151,8 @@ nir_opt_dce_impl(nir_function_impl *impl)
 
    if (progress)
       nir_metadata_preserve(impl, nir_metadata_block_index |
-                                  nir_metadata_dominance);
+                                  nir_metadata_dominance |
+                                  nir_metadata_dirty_instrs);
 
    return progress;
 }
@@ -25,11 +25,16 @@
 #include "nir_control_flow.h"
 #include "util/u_dynarray.h"
 
-typedef struct {
-   size_t blob_offset;
-   nir_ssa_def *src;
-   nir_block *block;
-} write_phi_fixup;
+/* Bump this whenever the encoding below changes, blobs written with another
+ * version are rejected by nir_deserialize.
+ *
+ * Apart from shader_info and nir_variable_data, which are copied as they are,
+ * everything is written as varints (see blob_write_varint32), so that the
+ * frequent small values take a single byte.  Types and load_const values are
+ * only written the first time they are seen, and referenced by index after
+ * that.
+ */
+#define NIR_SERIALIZE_FORMAT_VERSION 1
 
 typedef struct {
    const nir_shader *nir;
@@ -42,10 +47,17 @@ typedef struct {
    /* the next index to assign to a NIR in-memory object */
    uintptr_t next_idx;
 
-   /* Array of write_phi_fixup structs representing phi sources that need to
-    * be resolved in the second pass.
+   /* Array of the phis of the current function_impl, whose sources are
+    * written after its body once all the SSA definitions and blocks have an
+    * index.
     */
-   struct util_dynarray phi_fixups;
+   struct util_dynarray phis;
+
+   /* maps glsl_type pointer to index */
+   struct hash_table *type_table;
+
+   /* maps nir_load_const_instr with a given value to index */
+   struct hash_table *const_table;
 } write_ctx;
 
 typedef struct {
@@ -62,9 +74,16 @@ typedef struct {
    /* map from index to deserialized pointer */
    void **idx_table;
 
-   /* List of phi sources. */
-   struct list_head phi_srcs;
+   /* Array of the phis of the current function_impl, whose sources are read
+    * after its body.
+    */
+   struct util_dynarray phis;
+
+   /* Array of the glsl_types read so far */
+   struct util_dynarray types;
 
+   /* Array of the nir_load_const_instrs with distinct values read so far */
+   struct util_dynarray consts;
 } read_ctx;
 
 static void
@@ -85,7 +104,7 @@ write_lookup_object(write_ctx *ctx, const void *obj)
 static void
 write_object(write_ctx *ctx, const void *obj)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, obj));
+   blob_write_varint32(ctx->blob, write_lookup_object(ctx, obj));
 }
 
 static void
@@ -105,14 +124,69 @@ read_lookup_object(read_ctx *ctx, uintptr_t idx)
 static void *
 read_object(read_ctx *ctx)
 {
-   return read_lookup_object(ctx, blob_read_intptr(ctx->blob));
+   return read_lookup_object(ctx, blob_read_varint32(ctx->blob));
+}
+
+static void
+write_type(write_ctx *ctx, const struct glsl_type *type)
+{
+   /* Shaders tend to use the same few types over and over, so only the first
+    * occurrence of a type is encoded, as a 0 followed by the type, and the
+    * following ones are written as the index of the type plus one.
+    */
+   struct hash_entry *entry = _mesa_hash_table_search(ctx->type_table, type);
+   if (entry) {
+      blob_write_varint32(ctx->blob, (uintptr_t) entry->data + 1);
+      return;
+   }
+
+   uintptr_t index = ctx->type_table->entries;
+   _mesa_hash_table_insert(ctx->type_table, type, (void *) index);
+   blob_write_varint32(ctx->blob, 0);
+   encode_type_to_blob(ctx->blob, type);
+}
+
+static const struct glsl_type *
+read_type(read_ctx *ctx)
+{
+   uint32_t val = blob_read_varint32(ctx->blob);
+   if (val == 0) {
+      const struct glsl_type *type = decode_type_from_blob(ctx->blob);
+      util_dynarray_append(&ctx->types, const struct glsl_type *, type);
+      return type;
+   }
+
+   assert(val - 1 < ctx->types.size / sizeof(const struct glsl_type *));
+   return *util_dynarray_element(&ctx->types, const struct glsl_type *,
+                                 val - 1);
+}
+
+/* Packs the size of an SSA value in 5 bits. */
+static uint32_t
+encode_def_size(unsigned num_components, unsigned bit_size)
+{
+   assert(num_components >= 1 && num_components <= NIR_MAX_VEC_COMPONENTS);
+   assert(util_is_power_of_two_nonzero(bit_size) && bit_size <= 64);
+   return (num_components - 1) | (ffs(bit_size) - 1) << 2;
+}
+
+static unsigned
+decode_def_num_components(uint32_t val)
+{
+   return (val & 0x3) + 1;
+}
+
+static unsigned
+decode_def_bit_size(uint32_t val)
+{
+   return 1 << ((val >> 2) & 0x7);
 }
 
 static void
 write_constant(write_ctx *ctx, const nir_constant *c)
 {
    blob_write_bytes(ctx->blob, c->values, sizeof(c->values));
-   blob_write_uint32(ctx->blob, c->num_elements);
+   blob_write_varint32(ctx->blob, c->num_elements);
    for (unsigned i = 0; i < c->num_elements; i++)
       write_constant(ctx, c->elements[i]);
 }
@@ -123,7 +197,7 @@ read_constant(read_ctx *ctx, nir_variable *nvar)
    nir_constant *c = ralloc(nvar, nir_constant);
 
    blob_copy_bytes(ctx->blob, (uint8_t *)c->values, sizeof(c->values));
-   c->num_elements = blob_read_uint32(ctx->blob);
+   c->num_elements = blob_read_varint32(ctx->blob);
    c->elements = ralloc_array(nvar, nir_constant *, c->num_elements);
    for (unsigned i = 0; i < c->num_elements; i++)
       c->elements[i] = read_constant(ctx, nvar);
@@ -135,21 +209,22 @@ static void
 write_variable(write_ctx *ctx, const nir_variable *var)
 {
    write_add_object(ctx, var);
-   encode_type_to_blob(ctx->blob, var->type);
-   blob_write_uint32(ctx->blob, !!(var->name));
+   write_type(ctx, var->type);
+   uint32_t flags = !!(var->name);
+   flags |= !!(var->constant_initializer) << 1;
+   flags |= !!(var->interface_type) << 2;
+   blob_write_varint32(ctx->blob, flags);
    if (var->name)
       blob_write_string(ctx->blob, var->name);
    blob_write_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   blob_write_uint32(ctx->blob, var->num_state_slots);
+   blob_write_varint32(ctx->blob, var->num_state_slots);
    blob_write_bytes(ctx->blob, (uint8_t *) var->state_slots,
                     var->num_state_slots * sizeof(nir_state_slot));
-   blob_write_uint32(ctx->blob, !!(var->constant_initializer));
    if (var->constant_initializer)
       write_constant(ctx, var->constant_initializer);
-   blob_write_uint32(ctx->blob, !!(var->interface_type));
    if (var->interface_type)
-      encode_type_to_blob(ctx->blob, var->interface_type);
-   blob_write_uint32(ctx->blob, var->num_members);
+      write_type(ctx, var->interface_type);
+   blob_write_varint32(ctx->blob, var->num_members);
    if (var->num_members > 0) {
       blob_write_bytes(ctx->blob, (uint8_t *) var->members,
                        var->num_members * sizeof(*var->members));
@@ -162,8 +237,11 @@ read_variable(read_ctx *ctx)
    nir_variable *var = rzalloc(ctx->nir, nir_variable);
    read_add_object(ctx, var);
 
-   var->type = decode_type_from_blob(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
+   var->type = read_type(ctx);
+   uint32_t flags = blob_read_varint32(ctx->blob);
+   bool has_name = flags & 0x1;
+   bool has_const_initializer = flags & 0x2;
+   bool has_interface_type = flags & 0x4;
    if (has_name) {
       const char *name = blob_read_string(ctx->blob);
       var->name = ralloc_strdup(var, name);
@@ -171,21 +249,19 @@ read_variable(read_ctx *ctx)
       var->name = NULL;
    }
    blob_copy_bytes(ctx->blob, (uint8_t *) &var->data, sizeof(var->data));
-   var->num_state_slots = blob_read_uint32(ctx->blob);
+   var->num_state_slots = blob_read_varint32(ctx->blob);
    var->state_slots = ralloc_array(var, nir_state_slot, var->num_state_slots);
    blob_copy_bytes(ctx->blob, (uint8_t *) var->state_slots,
                    var->num_state_slots * sizeof(nir_state_slot));
-   bool has_const_initializer = blob_read_uint32(ctx->blob);
    if (has_const_initializer)
       var->constant_initializer = read_constant(ctx, var);
    else
       var->constant_initializer = NULL;
-   bool has_interface_type = blob_read_uint32(ctx->blob);
    if (has_interface_type)
-      var->interface_type = decode_type_from_blob(ctx->blob);
+      var->interface_type = read_type(ctx);
    else
       var->interface_type = NULL;
-   var->num_members = blob_read_uint32(ctx->blob);
+   var->num_members = blob_read_varint32(ctx->blob);
    if (var->num_members > 0) {
       var->members = ralloc_array(var, struct nir_variable_data,
                                   var->num_members);
@@ -199,7 +275,7 @@ read_variable(read_ctx *ctx)
 static void
 write_var_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint32(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_variable, var, node, src) {
       write_variable(ctx, var);
    }
@@ -209,7 +285,7 @@ static void
 read_var_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_vars = blob_read_uint32(ctx->blob);
+   unsigned num_vars = blob_read_varint32(ctx->blob);
    for (unsigned i = 0; i < num_vars; i++) {
       nir_variable *var = read_variable(ctx);
       exec_list_push_tail(dst, &var->node);
@@ -220,14 +296,14 @@ static void
 write_register(write_ctx *ctx, const nir_register *reg)
 {
    write_add_object(ctx, reg);
-   blob_write_uint32(ctx->blob, reg->num_components);
-   blob_write_uint32(ctx->blob, reg->bit_size);
-   blob_write_uint32(ctx->blob, reg->num_array_elems);
-   blob_write_uint32(ctx->blob, reg->index);
-   blob_write_uint32(ctx->blob, !!(reg->name));
+   blob_write_varint32(ctx->blob, reg->num_components);
+   blob_write_varint32(ctx->blob, reg->bit_size);
+   blob_write_varint32(ctx->blob, reg->num_array_elems);
+   blob_write_varint32(ctx->blob, reg->index);
+   blob_write_varint32(ctx->blob, reg->is_global << 2 | reg->is_packed << 1 |
+                                  !!(reg->name));
    if (reg->name)
       blob_write_string(ctx->blob, reg->name);
-   blob_write_uint32(ctx->blob, reg->is_global << 1 | reg->is_packed);
 }
 
 static nir_register *
@@ -235,20 +311,19 @@ read_register(read_ctx *ctx)
 {
    nir_register *reg = ralloc(ctx->nir, nir_register);
    read_add_object(ctx, reg);
-   reg->num_components = blob_read_uint32(ctx->blob);
-   reg->bit_size = blob_read_uint32(ctx->blob);
-   reg->num_array_elems = blob_read_uint32(ctx->blob);
-   reg->index = blob_read_uint32(ctx->blob);
-   bool has_name = blob_read_uint32(ctx->blob);
-   if (has_name) {
+   reg->num_components = blob_read_varint32(ctx->blob);
+   reg->bit_size = blob_read_varint32(ctx->blob);
+   reg->num_array_elems = blob_read_varint32(ctx->blob);
+   reg->index = blob_read_varint32(ctx->blob);
+   unsigned flags = blob_read_varint32(ctx->blob);
+   reg->is_global = flags & 0x4;
+   reg->is_packed = flags & 0x2;
+   if (flags & 0x1) {
       const char *name = blob_read_string(ctx->blob);
       reg->name = ralloc_strdup(reg, name);
    } else {
       reg->name = NULL;
    }
-   unsigned flags = blob_read_uint32(ctx->blob);
-   reg->is_global = flags & 0x2;
-   reg->is_packed = flags & 0x1;
 
    list_inithead(&reg->uses);
    list_inithead(&reg->defs);
@@ -260,7 +335,7 @@ read_register(read_ctx *ctx)
 static void
 write_reg_list(write_ctx *ctx, const struct exec_list *src)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(src));
+   blob_write_varint32(ctx->blob, exec_list_length(src));
    foreach_list_typed(nir_register, reg, node, src)
       write_register(ctx, reg);
 }
@@ -269,7 +344,7 @@ static void
 read_reg_list(read_ctx *ctx, struct exec_list *dst)
 {
    exec_list_make_empty(dst);
-   unsigned num_regs = blob_read_uint32(ctx->blob);
+   unsigned num_regs = blob_read_varint32(ctx->blob);
    for (unsigned i = 0; i < num_regs; i++) {
       nir_register *reg = read_register(ctx);
       exec_list_push_tail(dst, &reg->node);
@@ -281,20 +356,21 @@ write_src(write_ctx *ctx, const nir_src *src)
 {
    /* Since sources are very frequent, we try to save some space when storing
     * them. In particular, we store whether the source is a register and
-    * whether the register has an indirect index in the low two bits. We can
-    * assume that the high two bits of the index are zero, since otherwise our
-    * address space would've been exhausted allocating the remap table!
+    * whether the register has an indirect index in the low two bits.  SSA
+    * values are mostly used shortly after being defined, so they are stored
+    * as the distance back from the next index, which is the same when
+    * reading, and usually fits in a single byte.
     */
    if (src->is_ssa) {
-      uintptr_t idx = write_lookup_object(ctx, src->ssa) << 2;
-      idx |= 1;
-      blob_write_intptr(ctx->blob, idx);
+      uintptr_t delta = ctx->next_idx - write_lookup_object(ctx, src->ssa);
+      assert(delta > 0);
+      blob_write_varint32(ctx->blob, delta << 2 | 1);
    } else {
       uintptr_t idx = write_lookup_object(ctx, src->reg.reg) << 2;
       if (src->reg.indirect)
          idx |= 2;
-      blob_write_intptr(ctx->blob, idx);
-      blob_write_uint32(ctx->blob, src->reg.base_offset);
+      blob_write_varint32(ctx->blob, idx);
+      blob_write_varint32(ctx->blob, src->reg.base_offset);
       if (src->reg.indirect) {
          write_src(ctx, src->reg.indirect);
       }
@@ -304,15 +380,16 @@ write_src(write_ctx *ctx, const nir_src *src)
 static void
 read_src(read_ctx *ctx, nir_src *src, void *mem_ctx)
 {
-   uintptr_t val = blob_read_intptr(ctx->blob);
+   uintptr_t val = blob_read_varint32(ctx->blob);
    uintptr_t idx = val >> 2;
    src->is_ssa = val & 0x1;
    if (src->is_ssa) {
-      src->ssa = read_lookup_object(ctx, idx);
+      assert(idx > 0 && idx <= ctx->next_idx);
+      src->ssa = read_lookup_object(ctx, ctx->next_idx - idx);
    } else {
       bool is_indirect = val & 0x2;
       src->reg.reg = read_lookup_object(ctx, idx);
-      src->reg.base_offset = blob_read_uint32(ctx->blob);
+      src->reg.base_offset = blob_read_varint32(ctx->blob);
       if (is_indirect) {
          src->reg.indirect = ralloc(mem_ctx, nir_src);
          read_src(ctx, src->reg.indirect, mem_ctx);
@@ -328,19 +405,18 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
    uint32_t val = dst->is_ssa;
    if (dst->is_ssa) {
       val |= !!(dst->ssa.name) << 1;
-      val |= dst->ssa.num_components << 2;
-      val |= dst->ssa.bit_size << 5;
+      val |= encode_def_size(dst->ssa.num_components, dst->ssa.bit_size) << 2;
    } else {
       val |= !!(dst->reg.indirect) << 1;
    }
-   blob_write_uint32(ctx->blob, val);
+   blob_write_varint32(ctx->blob, val);
    if (dst->is_ssa) {
       write_add_object(ctx, &dst->ssa);
       if (dst->ssa.name)
          blob_write_string(ctx->blob, dst->ssa.name);
    } else {
-      blob_write_intptr(ctx->blob, write_lookup_object(ctx, dst->reg.reg));
-      blob_write_uint32(ctx->blob, dst->reg.base_offset);
+      write_object(ctx, dst->reg.reg);
+      blob_write_varint32(ctx->blob, dst->reg.base_offset);
       if (dst->reg.indirect)
          write_src(ctx, dst->reg.indirect);
    }
@@ -349,19 +425,19 @@ write_dest(write_ctx *ctx, const nir_dest *dst)
 static void
 read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint32(ctx->blob);
    bool is_ssa = val & 0x1;
    if (is_ssa) {
       bool has_name = val & 0x2;
-      unsigned num_components = (val >> 2) & 0x7;
-      unsigned bit_size = val >> 5;
+      unsigned num_components = decode_def_num_components(val >> 2);
+      unsigned bit_size = decode_def_bit_size(val >> 2);
       char *name = has_name ? blob_read_string(ctx->blob) : NULL;
       nir_ssa_dest_init(instr, dst, num_components, bit_size, name);
       read_add_object(ctx, &dst->ssa);
    } else {
       bool is_indirect = val & 0x2;
       dst->reg.reg = read_object(ctx);
-      dst->reg.base_offset = blob_read_uint32(ctx->blob);
+      dst->reg.base_offset = blob_read_varint32(ctx->blob);
       if (is_indirect) {
          dst->reg.indirect = ralloc(instr, nir_src);
          read_src(ctx, dst->reg.indirect, instr);
@@ -369,14 +445,26 @@ read_dest(read_ctx *ctx, nir_dest *dst, nir_instr *instr)
    }
 }
 
+/* The number of components of an ALU source whose swizzle matters, which
+ * only depends on the opcode and the destination.
+ */
+static unsigned
+alu_src_num_components(const nir_alu_instr *alu, unsigned src)
+{
+   if (nir_op_infos[alu->op].input_sizes[src] > 0)
+      return nir_op_infos[alu->op].input_sizes[src];
+
+   return nir_dest_num_components(alu->dest.dest);
+}
+
 static void
 write_alu(write_ctx *ctx, const nir_alu_instr *alu)
 {
-   blob_write_uint32(ctx->blob, alu->op);
    uint32_t flags = alu->exact;
    flags |= alu->dest.saturate << 1;
    flags |= alu->dest.write_mask << 2;
-   blob_write_uint32(ctx->blob, flags);
+   flags |= alu->op << 6;
+   blob_write_varint32(ctx->blob, flags);
 
    write_dest(ctx, &alu->dest.dest);
 
@@ -384,31 +472,31 @@ write_alu(write_ctx *ctx, const nir_alu_instr *alu)
       write_src(ctx, &alu->src[i].src);
       flags = alu->src[i].negate;
       flags |= alu->src[i].abs << 1;
-      for (unsigned j = 0; j < 4; j++)
+      for (unsigned j = 0; j < alu_src_num_components(alu, i); j++)
          flags |= alu->src[i].swizzle[j] << (2 + 2 * j);
-      blob_write_uint32(ctx->blob, flags);
+      blob_write_varint32(ctx->blob, flags);
    }
 }
 
 static nir_alu_instr *
 read_alu(read_ctx *ctx)
 {
-   nir_op op = blob_read_uint32(ctx->blob);
+   uint32_t flags = blob_read_varint32(ctx->blob);
+   nir_op op = flags >> 6;
    nir_alu_instr *alu = nir_alu_instr_create(ctx->nir, op);
 
-   uint32_t flags = blob_read_uint32(ctx->blob);
    alu->exact = flags & 1;
    alu->dest.saturate = flags & 2;
-   alu->dest.write_mask = flags >> 2;
+   alu->dest.write_mask = (flags >> 2) & 0xf;
 
    read_dest(ctx, &alu->dest.dest, &alu->instr);
 
    for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++) {
       read_src(ctx, &alu->src[i].src, &alu->instr);
-      flags = blob_read_uint32(ctx->blob);
+      flags = blob_read_varint32(ctx->blob);
       alu->src[i].negate = flags & 1;
       alu->src[i].abs = flags & 2;
-      for (unsigned j = 0; j < 4; j++)
+      for (unsigned j = 0; j < alu_src_num_components(alu, i); j++)
          alu->src[i].swizzle[j] = (flags >> (2 * j + 2)) & 3;
    }
 
@@ -418,10 +506,8 @@ read_alu(read_ctx *ctx)
 static void
 write_deref(write_ctx *ctx, const nir_deref_instr *deref)
 {
-   blob_write_uint32(ctx->blob, deref->deref_type);
-
-   blob_write_uint32(ctx->blob, deref->mode);
-   encode_type_to_blob(ctx->blob, deref->type);
+   blob_write_varint32(ctx->blob, deref->mode << 3 | deref->deref_type);
+   write_type(ctx, deref->type);
 
    write_dest(ctx, &deref->dest);
 
@@ -434,7 +520,7 @@ write_deref(write_ctx *ctx, const nir_deref_instr *deref)
 
    switch (deref->deref_type) {
    case nir_deref_type_struct:
-      blob_write_uint32(ctx->blob, deref->strct.index);
+      blob_write_varint32(ctx->blob, deref->strct.index);
       break;
 
    case nir_deref_type_array:
@@ -454,11 +540,12 @@ write_deref(write_ctx *ctx, const nir_deref_instr *deref)
 static nir_deref_instr *
 read_deref(read_ctx *ctx)
 {
-   nir_deref_type deref_type = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint32(ctx->blob);
+   nir_deref_type deref_type = val & 0x7;
    nir_deref_instr *deref = nir_deref_instr_create(ctx->nir, deref_type);
 
-   deref->mode = blob_read_uint32(ctx->blob);
-   deref->type = decode_type_from_blob(ctx->blob);
+   deref->mode = val >> 3;
+   deref->type = read_type(ctx);
 
    read_dest(ctx, &deref->dest, &deref->instr);
 
@@ -471,7 +558,7 @@ read_deref(read_ctx *ctx)
 
    switch (deref->deref_type) {
    case nir_deref_type_struct:
-      deref->strct.index = blob_read_uint32(ctx->blob);
+      deref->strct.index = blob_read_varint32(ctx->blob);
       break;
 
    case nir_deref_type_array:
@@ -493,12 +580,12 @@ read_deref(read_ctx *ctx)
 static void
 write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
 {
-   blob_write_uint32(ctx->blob, intrin->intrinsic);
+   blob_write_varint32(ctx->blob, intrin->intrinsic);
 
    unsigned num_srcs = nir_intrinsic_infos[intrin->intrinsic].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[intrin->intrinsic].num_indices;
 
-   blob_write_uint32(ctx->blob, intrin->num_components);
+   blob_write_varint32(ctx->blob, intrin->num_components);
 
    if (nir_intrinsic_infos[intrin->intrinsic].has_dest)
       write_dest(ctx, &intrin->dest);
@@ -507,20 +594,20 @@ write_intrinsic(write_ctx *ctx, const nir_intrinsic_instr *intrin)
       write_src(ctx, &intrin->src[i]);
 
    for (unsigned i = 0; i < num_indices; i++)
-      blob_write_uint32(ctx->blob, intrin->const_index[i]);
+      blob_write_varint32(ctx->blob, intrin->const_index[i]);
 }
 
 static nir_intrinsic_instr *
 read_intrinsic(read_ctx *ctx)
 {
-   nir_intrinsic_op op = blob_read_uint32(ctx->blob);
+   nir_intrinsic_op op = blob_read_varint32(ctx->blob);
 
    nir_intrinsic_instr *intrin = nir_intrinsic_instr_create(ctx->nir, op);
 
    unsigned num_srcs = nir_intrinsic_infos[op].num_srcs;
    unsigned num_indices = nir_intrinsic_infos[op].num_indices;
 
-   intrin->num_components = blob_read_uint32(ctx->blob);
+   intrin->num_components = blob_read_varint32(ctx->blob);
 
    if (nir_intrinsic_infos[op].has_dest)
       read_dest(ctx, &intrin->dest, &intrin->instr);
@@ -529,30 +616,84 @@ read_intrinsic(read_ctx *ctx)
       read_src(ctx, &intrin->src[i], &intrin->instr);
 
    for (unsigned i = 0; i < num_indices; i++)
-      intrin->const_index[i] = blob_read_uint32(ctx->blob);
+      intrin->const_index[i] = blob_read_varint32(ctx->blob);
 
    return intrin;
 }
 
+/* The components of a nir_const_value are laid out one after the other
+ * whatever their bit size, so only this many bytes of it are meaningful.
+ */
+static size_t
+load_const_value_size(const nir_load_const_instr *lc)
+{
+   return lc->def.num_components * (lc->def.bit_size / 8);
+}
+
+static uint32_t
+load_const_hash(const void *data)
+{
+   const nir_load_const_instr *lc = data;
+   uint32_t hash = _mesa_hash_data(&lc->value, load_const_value_size(lc));
+   return hash ^ encode_def_size(lc->def.num_components, lc->def.bit_size);
+}
+
+static bool
+load_const_equal(const void *a, const void *b)
+{
+   const nir_load_const_instr *lc1 = a, *lc2 = b;
+   return lc1->def.num_components == lc2->def.num_components &&
+          lc1->def.bit_size == lc2->def.bit_size &&
+          memcmp(&lc1->value, &lc2->value, load_const_value_size(lc1)) == 0;
+}
+
 static void
 write_load_const(write_ctx *ctx, const nir_load_const_instr *lc)
 {
-   uint32_t val = lc->def.num_components;
-   val |= lc->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
-   blob_write_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
+   /* The same few constants tend to be loaded in many places, so only the
+    * first load of a value stores it, and the following ones refer to it by
+    * index.  The low bit tells which case this is.
+    */
+   struct hash_entry *entry = _mesa_hash_table_search(ctx->const_table, lc);
+   if (entry) {
+      blob_write_varint32(ctx->blob, (uintptr_t) entry->data << 1 | 1);
+   } else {
+      uintptr_t index = ctx->const_table->entries;
+      _mesa_hash_table_insert(ctx->const_table, lc, (void *) index);
+
+      uint32_t val = encode_def_size(lc->def.num_components,
+                                     lc->def.bit_size);
+      blob_write_varint32(ctx->blob, val << 1);
+      blob_write_bytes(ctx->blob, (uint8_t *) &lc->value,
+                       load_const_value_size(lc));
+   }
    write_add_object(ctx, &lc->def);
 }
 
 static nir_load_const_instr *
 read_load_const(read_ctx *ctx)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
-
-   nir_load_const_instr *lc =
-      nir_load_const_instr_create(ctx->nir, val & 0x7, val >> 3);
+   uint32_t val = blob_read_varint32(ctx->blob);
+   nir_load_const_instr *lc;
+
+   if (val & 1) {
+      uint32_t index = val >> 1;
+      assert(index < ctx->consts.size / sizeof(nir_load_const_instr *));
+      const nir_load_const_instr *orig =
+         *util_dynarray_element(&ctx->consts, nir_load_const_instr *, index);
+
+      lc = nir_load_const_instr_create(ctx->nir, orig->def.num_components,
+                                       orig->def.bit_size);
+      memcpy(&lc->value, &orig->value, load_const_value_size(lc));
+   } else {
+      lc = nir_load_const_instr_create(ctx->nir,
+                                       decode_def_num_components(val >> 1),
+                                       decode_def_bit_size(val >> 1));
+      blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value,
+                      load_const_value_size(lc));
+      util_dynarray_append(&ctx->consts, nir_load_const_instr *, lc);
+   }
 
-   blob_copy_bytes(ctx->blob, (uint8_t *) &lc->value, sizeof(lc->value));
    read_add_object(ctx, &lc->def);
    return lc;
 }
@@ -560,19 +701,19 @@ read_load_const(read_ctx *ctx)
 static void
 write_ssa_undef(write_ctx *ctx, const nir_ssa_undef_instr *undef)
 {
-   uint32_t val = undef->def.num_components;
-   val |= undef->def.bit_size << 3;
-   blob_write_uint32(ctx->blob, val);
+   blob_write_varint32(ctx->blob, encode_def_size(undef->def.num_components,
+                                                  undef->def.bit_size));
    write_add_object(ctx, &undef->def);
 }
 
 static nir_ssa_undef_instr *
 read_ssa_undef(read_ctx *ctx)
 {
-   uint32_t val = blob_read_uint32(ctx->blob);
+   uint32_t val = blob_read_varint32(ctx->blob);
 
    nir_ssa_undef_instr *undef =
-      nir_ssa_undef_instr_create(ctx->nir, val & 0x7, val >> 3);
+      nir_ssa_undef_instr_create(ctx->nir, decode_def_num_components(val),
+                                 decode_def_bit_size(val));
 
    read_add_object(ctx, &undef->def);
    return undef;
@@ -595,11 +736,11 @@ union packed_tex_data {
 static void
 write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 {
-   blob_write_uint32(ctx->blob, tex->num_srcs);
-   blob_write_uint32(ctx->blob, tex->op);
-   blob_write_uint32(ctx->blob, tex->texture_index);
-   blob_write_uint32(ctx->blob, tex->texture_array_size);
-   blob_write_uint32(ctx->blob, tex->sampler_index);
+   blob_write_varint32(ctx->blob, tex->num_srcs);
+   blob_write_varint32(ctx->blob, tex->op);
+   blob_write_varint32(ctx->blob, tex->texture_index);
+   blob_write_varint32(ctx->blob, tex->texture_array_size);
+   blob_write_varint32(ctx->blob, tex->sampler_index);
 
    STATIC_ASSERT(sizeof(union packed_tex_data) == sizeof(uint32_t));
    union packed_tex_data packed = {
@@ -611,11 +752,11 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
       .u.is_new_style_shadow = tex->is_new_style_shadow,
       .u.component = tex->component,
    };
-   blob_write_uint32(ctx->blob, packed.u32);
+   blob_write_varint32(ctx->blob, packed.u32);
 
    write_dest(ctx, &tex->dest);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      blob_write_uint32(ctx->blob, tex->src[i].src_type);
+      blob_write_varint32(ctx->blob, tex->src[i].src_type);
       write_src(ctx, &tex->src[i].src);
    }
 }
@@ -623,16 +764,16 @@ write_tex(write_ctx *ctx, const nir_tex_instr *tex)
 static nir_tex_instr *
 read_tex(read_ctx *ctx)
 {
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
+   unsigned num_srcs = blob_read_varint32(ctx->blob);
    nir_tex_instr *tex = nir_tex_instr_create(ctx->nir, num_srcs);
 
-   tex->op = blob_read_uint32(ctx->blob);
-   tex->texture_index = blob_read_uint32(ctx->blob);
-   tex->texture_array_size = blob_read_uint32(ctx->blob);
-   tex->sampler_index = blob_read_uint32(ctx->blob);
+   tex->op = blob_read_varint32(ctx->blob);
+   tex->texture_index = blob_read_varint32(ctx->blob);
+   tex->texture_array_size = blob_read_varint32(ctx->blob);
+   tex->sampler_index = blob_read_varint32(ctx->blob);
 
    union packed_tex_data packed;
-   packed.u32 = blob_read_uint32(ctx->blob);
+   packed.u32 = blob_read_varint32(ctx->blob);
    tex->sampler_dim = packed.u.sampler_dim;
    tex->dest_type = packed.u.dest_type;
    tex->coord_components = packed.u.coord_components;
@@ -643,7 +784,7 @@ read_tex(read_ctx *ctx)
 
    read_dest(ctx, &tex->dest, &tex->instr);
    for (unsigned i = 0; i < tex->num_srcs; i++) {
-      tex->src[i].src_type = blob_read_uint32(ctx->blob);
+      tex->src[i].src_type = blob_read_varint32(ctx->blob);
       read_src(ctx, &tex->src[i].src, &tex->instr);
    }
 
@@ -654,38 +795,29 @@ static void
 write_phi(write_ctx *ctx, const nir_phi_instr *phi)
 {
    /* Phi nodes are special, since they may reference SSA definitions and
-    * basic blocks that don't exist yet. We leave two empty uintptr_t's here,
-    * and then store enough information so that a later fixup pass can fill
-    * them in correctly.
+    * basic blocks that don't exist yet.  Only the destination is written
+    * here, the sources are written by write_fixup_phis once the whole
+    * function_impl has been written.
     */
    write_dest(ctx, &phi->dest);
 
-   blob_write_uint32(ctx->blob, exec_list_length(&phi->srcs));
-
-   nir_foreach_phi_src(src, phi) {
-      assert(src->src.is_ssa);
-      size_t blob_offset = blob_reserve_intptr(ctx->blob);
-      MAYBE_UNUSED size_t blob_offset2 = blob_reserve_intptr(ctx->blob);
-      assert(blob_offset + sizeof(uintptr_t) == blob_offset2);
-      write_phi_fixup fixup = {
-         .blob_offset = blob_offset,
-         .src = src->src.ssa,
-         .block = src->pred,
-      };
-      util_dynarray_append(&ctx->phi_fixups, write_phi_fixup, fixup);
-   }
+   util_dynarray_append(&ctx->phis, const nir_phi_instr *, phi);
 }
 
 static void
 write_fixup_phis(write_ctx *ctx)
 {
-   util_dynarray_foreach(&ctx->phi_fixups, write_phi_fixup, fixup) {
-      uintptr_t *blob_ptr = (uintptr_t *)(ctx->blob->data + fixup->blob_offset);
-      blob_ptr[0] = write_lookup_object(ctx, fixup->src);
-      blob_ptr[1] = write_lookup_object(ctx, fixup->block);
+   util_dynarray_foreach(&ctx->phis, const nir_phi_instr *, phi) {
+      blob_write_varint32(ctx->blob, exec_list_length(&(*phi)->srcs));
+
+      nir_foreach_phi_src(src, *phi) {
+         assert(src->src.is_ssa);
+         write_object(ctx, src->pred);
+         write_object(ctx, src->src.ssa);
+      }
    }
 
-   util_dynarray_clear(&ctx->phi_fixups);
+   util_dynarray_clear(&ctx->phis);
 }
 
 static nir_phi_instr *
@@ -695,38 +827,12 @@ read_phi(read_ctx *ctx, nir_block *blk)
 
    read_dest(ctx, &phi->dest, &phi->instr);
 
-   unsigned num_srcs = blob_read_uint32(ctx->blob);
-
-   /* For similar reasons as before, we just store the index directly into the
-    * pointer, and let a later pass resolve the phi sources.
-    *
-    * In order to ensure that the copied sources (which are just the indices
-    * from the blob for now) don't get inserted into the old shader's use-def
-    * lists, we have to add the phi instruction *before* we set up its
-    * sources.
+   /* The sources are only read by read_fixup_phis at the end of
+    * read_function_impl, so the phi has none when it's inserted.
     */
    nir_instr_insert_after_block(blk, &phi->instr);
 
-   for (unsigned i = 0; i < num_srcs; i++) {
-      nir_phi_src *src = ralloc(phi, nir_phi_src);
-
-      src->src.is_ssa = true;
-      src->src.ssa = (nir_ssa_def *) blob_read_intptr(ctx->blob);
-      src->pred = (nir_block *) blob_read_intptr(ctx->blob);
-
-      /* Since we're not letting nir_insert_instr handle use/def stuff for us,
-       * we have to set the parent_instr manually.  It doesn't really matter
-       * when we do it, so we might as well do it here.
-       */
-      src->src.parent_instr = &phi->instr;
-
-      /* Stash it in the list of phi sources.  We'll walk this list and fix up
-       * sources at the very end of read_function_impl.
-       */
-      list_add(&src->src.use_link, &ctx->phi_srcs);
-
-      exec_list_push_tail(&phi->srcs, &src->node);
-   }
+   util_dynarray_append(&ctx->phis, nir_phi_instr *, phi);
 
    return phi;
 }
@@ -734,28 +840,40 @@ read_phi(read_ctx *ctx, nir_block *blk)
 static void
 read_fixup_phis(read_ctx *ctx)
 {
-   list_for_each_entry_safe(nir_phi_src, src, &ctx->phi_srcs, src.use_link) {
-      src->pred = read_lookup_object(ctx, (uintptr_t)src->pred);
-      src->src.ssa = read_lookup_object(ctx, (uintptr_t)src->src.ssa);
+   util_dynarray_foreach(&ctx->phis, nir_phi_instr *, phi_ptr) {
+      nir_phi_instr *phi = *phi_ptr;
+      unsigned num_srcs = blob_read_varint32(ctx->blob);
+
+      for (unsigned i = 0; i < num_srcs; i++) {
+         nir_phi_src *src = ralloc(phi, nir_phi_src);
+
+         src->pred = read_object(ctx);
+         src->src.is_ssa = true;
+         src->src.ssa = read_object(ctx);
 
-      /* Remove from this list */
-      list_del(&src->src.use_link);
+         /* Since we're not letting nir_insert_instr handle use/def stuff for
+          * us, we have to set up the parent_instr and the uses manually.
+          */
+         src->src.parent_instr = &phi->instr;
+         list_addtail(&src->src.use_link, &src->src.ssa->uses);
 
-      list_addtail(&src->src.use_link, &src->src.ssa->uses);
+         exec_list_push_tail(&phi->srcs, &src->node);
+      }
    }
-   assert(list_empty(&ctx->phi_srcs));
+
+   util_dynarray_clear(&ctx->phis);
 }
 
 static void
 write_jump(write_ctx *ctx, const nir_jump_instr *jmp)
 {
-   blob_write_uint32(ctx->blob, jmp->type);
+   blob_write_varint32(ctx->blob, jmp->type);
 }
 
 static nir_jump_instr *
 read_jump(read_ctx *ctx)
 {
-   nir_jump_type type = blob_read_uint32(ctx->blob);
+   nir_jump_type type = blob_read_varint32(ctx->blob);
    nir_jump_instr *jmp = nir_jump_instr_create(ctx->nir, type);
    return jmp;
 }
@@ -763,7 +881,7 @@ read_jump(read_ctx *ctx)
 static void
 write_call(write_ctx *ctx, const nir_call_instr *call)
 {
-   blob_write_intptr(ctx->blob, write_lookup_object(ctx, call->callee));
+   write_object(ctx, call->callee);
 
    for (unsigned i = 0; i < call->num_params; i++)
       write_src(ctx, &call->params[i]);
@@ -784,7 +902,7 @@ read_call(read_ctx *ctx)
 static void
 write_instr(write_ctx *ctx, const nir_instr *instr)
 {
-   blob_write_uint32(ctx->blob, instr->type);
+   blob_write_varint32(ctx->blob, instr->type);
    switch (instr->type) {
    case nir_instr_type_alu:
       write_alu(ctx, nir_instr_as_alu(instr));
@@ -823,7 +941,7 @@ write_instr(write_ctx *ctx, const nir_instr *instr)
 static void
 read_instr(read_ctx *ctx, nir_block *block)
 {
-   nir_instr_type type = blob_read_uint32(ctx->blob);
+   nir_instr_type type = blob_read_varint32(ctx->blob);
    nir_instr *instr;
    switch (type) {
    case nir_instr_type_alu:
@@ -846,9 +964,8 @@ read_instr(read_ctx *ctx, nir_block *block)
       break;
    case nir_instr_type_phi:
       /* Phi instructions are a bit of a special case when reading because we
-       * don't want inserting the instruction to automatically handle use/defs
-       * for us.  Instead, we need to wait until all the blocks/instructions
-       * are read so that we can set their sources up.
+       * need to wait until all the blocks/instructions are read so that we
+       * can set their sources up.
        */
       read_phi(ctx, block);
       return;
@@ -871,7 +988,7 @@ static void
 write_block(write_ctx *ctx, const nir_block *block)
 {
    write_add_object(ctx, block);
-   blob_write_uint32(ctx->blob, exec_list_length(&block->instr_list));
+   blob_write_varint32(ctx->blob, exec_list_length(&block->instr_list));
    nir_foreach_instr(instr, block)
       write_instr(ctx, instr);
 }
@@ -887,7 +1004,7 @@ read_block(read_ctx *ctx, struct exec_list *cf_list)
       exec_node_data(nir_block, exec_list_get_tail(cf_list), cf_node.node);
 
    read_add_object(ctx, block);
-   unsigned num_instrs = blob_read_uint32(ctx->blob);
+   unsigned num_instrs = blob_read_varint32(ctx->blob);
    for (unsigned i = 0; i < num_instrs; i++) {
       read_instr(ctx, block);
    }
@@ -940,7 +1057,7 @@ read_loop(read_ctx *ctx, struct exec_list *cf_list)
 static void
 write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 {
-   blob_write_uint32(ctx->blob, cf->type);
+   blob_write_varint32(ctx->blob, cf->type);
 
    switch (cf->type) {
    case nir_cf_node_block:
@@ -960,7 +1077,7 @@ write_cf_node(write_ctx *ctx, nir_cf_node *cf)
 static void
 read_cf_node(read_ctx *ctx, struct exec_list *list)
 {
-   nir_cf_node_type type = blob_read_uint32(ctx->blob);
+   nir_cf_node_type type = blob_read_varint32(ctx->blob);
 
    switch (type) {
    case nir_cf_node_block:
@@ -980,7 +1097,7 @@ read_cf_node(read_ctx *ctx, struct exec_list *list)
 static void
 write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 {
-   blob_write_uint32(ctx->blob, exec_list_length(cf_list));
+   blob_write_varint32(ctx->blob, exec_list_length(cf_list));
    foreach_list_typed(nir_cf_node, cf, node, cf_list) {
       write_cf_node(ctx, cf);
    }
@@ -989,7 +1106,7 @@ write_cf_list(write_ctx *ctx, const struct exec_list *cf_list)
 static void
 read_cf_list(read_ctx *ctx, struct exec_list *cf_list)
 {
-   uint32_t num_cf_nodes = blob_read_uint32(ctx->blob);
+   uint32_t num_cf_nodes = blob_read_varint32(ctx->blob);
    for (unsigned i = 0; i < num_cf_nodes; i++)
       read_cf_node(ctx, cf_list);
 }
@@ -999,7 +1116,7 @@ write_function_impl(write_ctx *ctx, const nir_function_impl *fi)
 {
    write_var_list(ctx, &fi->locals);
    write_reg_list(ctx, &fi->registers);
-   blob_write_uint32(ctx->blob, fi->reg_alloc);
+   blob_write_varint32(ctx->blob, fi->reg_alloc);
 
    write_cf_list(ctx, &fi->body);
    write_fixup_phis(ctx);
@@ -1013,7 +1130,7 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 
    read_var_list(ctx, &fi->locals);
    read_reg_list(ctx, &fi->registers);
-   fi->reg_alloc = blob_read_uint32(ctx->blob);
+   fi->reg_alloc = blob_read_varint32(ctx->blob);
 
    read_cf_list(ctx, &fi->body);
    read_fixup_phis(ctx);
@@ -1026,18 +1143,18 @@ read_function_impl(read_ctx *ctx, nir_function *fxn)
 static void
 write_function(write_ctx *ctx, const nir_function *fxn)
 {
-   blob_write_uint32(ctx->blob, !!(fxn->name));
+   blob_write_varint32(ctx->blob, !!(fxn->name));
    if (fxn->name)
       blob_write_string(ctx->blob, fxn->name);
 
    write_add_object(ctx, fxn);
 
-   blob_write_uint32(ctx->blob, fxn->num_params);
+   blob_write_varint32(ctx->blob, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
       uint32_t val =
          ((uint32_t)fxn->params[i].num_components) |
          ((uint32_t)fxn->params[i].bit_size) << 8;
-      blob_write_uint32(ctx->blob, val);
+      blob_write_varint32(ctx->blob, val);
    }
 
    /* At first glance, it looks like we should write the function_impl here.
@@ -1050,17 +1167,17 @@ write_function(write_ctx *ctx, const nir_function *fxn)
 static void
 read_function(read_ctx *ctx)
 {
-   bool has_name = blob_read_uint32(ctx->blob);
+   bool has_name = blob_read_varint32(ctx->blob);
    char *name = has_name ? blob_read_string(ctx->blob) : NULL;
 
    nir_function *fxn = nir_function_create(ctx->nir, name);
 
    read_add_object(ctx, fxn);
 
-   fxn->num_params = blob_read_uint32(ctx->blob);
+   fxn->num_params = blob_read_varint32(ctx->blob);
    fxn->params = ralloc_array(fxn, nir_parameter, fxn->num_params);
    for (unsigned i = 0; i < fxn->num_params; i++) {
-      uint32_t val = blob_read_uint32(ctx->blob);
+      uint32_t val = blob_read_varint32(ctx->blob);
       fxn->params[i].num_components = val & 0xff;
       fxn->params[i].bit_size = (val >> 8) & 0xff;
    }
@@ -1075,9 +1192,14 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    ctx.next_idx = 0;
    ctx.blob = blob;
    ctx.nir = nir;
-   util_dynarray_init(&ctx.phi_fixups, NULL);
+   util_dynarray_init(&ctx.phis, NULL);
+   ctx.type_table = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
+                                            _mesa_key_pointer_equal);
+   ctx.const_table = _mesa_hash_table_create(NULL, load_const_hash,
+                                             load_const_equal);
 
-   size_t idx_size_offset = blob_reserve_intptr(blob);
+   blob_write_uint32(blob, NIR_SERIALIZE_FORMAT_VERSION);
+   size_t idx_size_offset = blob_reserve_uint32(blob);
 
    struct shader_info info = nir->info;
    uint32_t strings = 0;
@@ -1085,7 +1207,7 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
       strings |= 0x1;
    if (info.label)
       strings |= 0x2;
-   blob_write_uint32(blob, strings);
+   blob_write_varint32(blob, strings);
    if (info.name)
       blob_write_string(blob, info.name);
    if (info.label)
@@ -1101,13 +1223,13 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
    write_var_list(&ctx, &nir->system_values);
 
    write_reg_list(&ctx, &nir->registers);
-   blob_write_uint32(blob, nir->reg_alloc);
-   blob_write_uint32(blob, nir->num_inputs);
-   blob_write_uint32(blob, nir->num_uniforms);
-   blob_write_uint32(blob, nir->num_outputs);
-   blob_write_uint32(blob, nir->num_shared);
+   blob_write_varint32(blob, nir->reg_alloc);
+   blob_write_varint32(blob, nir->num_inputs);
+   blob_write_varint32(blob, nir->num_uniforms);
+   blob_write_varint32(blob, nir->num_outputs);
+   blob_write_varint32(blob, nir->num_shared);
 
-   blob_write_uint32(blob, exec_list_length(&nir->functions));
+   blob_write_varint32(blob, exec_list_length(&nir->functions));
    nir_foreach_function(fxn, nir) {
       write_function(&ctx, fxn);
    }
@@ -1116,14 +1238,49 @@ nir_serialize(struct blob *blob, const nir_shader *nir)
       write_function_impl(&ctx, fxn->impl);
    }
 
-   blob_write_uint32(blob, nir->constant_data_size);
+   blob_write_varint32(blob, nir->constant_data_size);
    if (nir->constant_data_size > 0)
       blob_write_bytes(blob, nir->constant_data, nir->constant_data_size);
 
-   *(uintptr_t *)(blob->data + idx_size_offset) = ctx.next_idx;
+   blob_overwrite_uint32(blob, idx_size_offset, ctx.next_idx);
 
    _mesa_hash_table_destroy(ctx.remap_table, NULL);
-   util_dynarray_fini(&ctx.phi_fixups);
+   _mesa_hash_table_destroy(ctx.type_table, NULL);
+   _mesa_hash_table_destroy(ctx.const_table, NULL);
+   util_dynarray_fini(&ctx.phis);
+}
+
+/* Reads the header of the blob, up to and including the shader_info.  The
+ * name and label of the shader point into the blob.
+ */
+static bool
+read_header(struct blob_reader *blob, uint32_t *idx_table_len,
+            struct shader_info *info)
+{
+   /* Flag a blob from another version as invalid, like a truncated one. */
+   if (blob_read_uint32(blob) != NIR_SERIALIZE_FORMAT_VERSION) {
+      blob->overrun = true;
+      return false;
+   }
+
+   *idx_table_len = blob_read_uint32(blob);
+
+   uint32_t strings = blob_read_varint32(blob);
+   char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
+   char *label = (strings & 0x2) ? blob_read_string(blob) : NULL;
+
+   blob_copy_bytes(blob, (uint8_t *) info, sizeof(*info));
+   info->name = name;
+   info->label = label;
+
+   return !blob->overrun;
+}
+
+bool
+nir_deserialize_shader_info(struct blob_reader *blob, struct shader_info *info)
+{
+   uint32_t idx_table_len;
+   return read_header(blob, &idx_table_len, info);
 }
 
 nir_shader *
@@ -1131,24 +1288,25 @@ nir_deserialize(void *mem_ctx,
                 const struct nir_shader_compiler_options *options,
                 struct blob_reader *blob)
 {
+   uint32_t idx_table_len;
+   struct shader_info info;
+
+   if (!read_header(blob, &idx_table_len, &info))
+      return NULL;
+
    read_ctx ctx;
    ctx.blob = blob;
-   list_inithead(&ctx.phi_srcs);
-   ctx.idx_table_len = blob_read_intptr(blob);
+   util_dynarray_init(&ctx.phis, NULL);
+   util_dynarray_init(&ctx.types, NULL);
+   util_dynarray_init(&ctx.consts, NULL);
+   ctx.idx_table_len = idx_table_len;
    ctx.idx_table = calloc(ctx.idx_table_len, sizeof(uintptr_t));
    ctx.next_idx = 0;
 
-   uint32_t strings = blob_read_uint32(blob);
-   char *name = (strings & 0x1) ? blob_read_string(blob) : NULL;
-   char *label = (strings & 0x2) ? blob_read_string(blob) : NULL;
-
-   struct shader_info info;
-   blob_copy_bytes(blob, (uint8_t *) &info, sizeof(info));
-
    ctx.nir = nir_shader_create(mem_ctx, info.stage, options, NULL);
 
-   info.name = name ? ralloc_strdup(ctx.nir, name) : NULL;
-   info.label = label ? ralloc_strdup(ctx.nir, label) : NULL;
+   info.name = info.name ? ralloc_strdup(ctx.nir, info.name) : NULL;
+   info.label = info.label ? ralloc_strdup(ctx.nir, info.label) : NULL;
 
    ctx.nir->info = info;
 
@@ -1160,20 +1318,20 @@ nir_deserialize(void *mem_ctx,
    read_var_list(&ctx, &ctx.nir->system_values);
 
    read_reg_list(&ctx, &ctx.nir->registers);
-   ctx.nir->reg_alloc = blob_read_uint32(blob);
-   ctx.nir->num_inputs = blob_read_uint32(blob);
-   ctx.nir->num_uniforms = blob_read_uint32(blob);
-   ctx.nir->num_outputs = blob_read_uint32(blob);
-   ctx.nir->num_shared = blob_read_uint32(blob);
+   ctx.nir->reg_alloc = blob_read_varint32(blob);
+   ctx.nir->num_inputs = blob_read_varint32(blob);
+   ctx.nir->num_uniforms = blob_read_varint32(blob);
+   ctx.nir->num_outputs = blob_read_varint32(blob);
+   ctx.nir->num_shared = blob_read_varint32(blob);
 
-   unsigned num_functions = blob_read_uint32(blob);
+   unsigned num_functions = blob_read_varint32(blob);
    for (unsigned i = 0; i < num_functions; i++)
       read_function(&ctx);
 
    nir_foreach_function(fxn, ctx.nir)
       fxn->impl = read_function_impl(&ctx, fxn);
 
-   ctx.nir->constant_data_size = blob_read_uint32(blob);
+   ctx.nir->constant_data_size = blob_read_varint32(blob);
    if (ctx.nir->constant_data_size > 0) {
       ctx.nir->constant_data =
          ralloc_size(ctx.nir, ctx.nir->constant_data_size);
@@ -1182,6 +1340,9 @@ nir_deserialize(void *mem_ctx,
    }
 
    free(ctx.idx_table);
+   util_dynarray_fini(&ctx.phis);
+   util_dynarray_fini(&ctx.types);
+   util_dynarray_fini(&ctx.consts);
 
    return ctx.nir;
 }
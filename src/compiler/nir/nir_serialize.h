@@ -32,10 +32,22 @@ extern "C" {
 #endif
 
 void nir_serialize(struct blob *blob, const nir_shader *nir);
+
+/* Returns NULL and sets the overrun flag of the blob reader if the blob was
+ * written by a different version of nir_serialize.
+ */
 nir_shader *nir_deserialize(void *mem_ctx,
                             const struct nir_shader_compiler_options *options,
                             struct blob_reader *blob);
 
+/* Only reads the shader_info at the start of a blob written by
+ * nir_serialize, without building the shader, for users which don't need
+ * the rest yet.  The name and label point into the blob.  Returns false, with
+ * the overrun flag set, if the blob is truncated or from a different version.
+ */
+bool nir_deserialize_shader_info(struct blob_reader *blob,
+                                 struct shader_info *info);
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -30,6 +30,9 @@
  * memory - anything still connected to the program will be kept, and any dead memory
  * we dropped on the floor will be freed.
  *
+ * The instructions live in a slab context of their own, so they are only marked
+ * as live rather than stolen back, and the dead ones are freed by the slab.
+ *
  * The expectation is that drivers should call this when finished compiling the shader
  * (after any optimization, lowering, and so on).  However, it's also fine to call it
  * earlier, and even many times, trading CPU cycles for memory savings.
@@ -64,7 +67,7 @@ sweep_block(nir_shader *nir, nir_block *block)
    ralloc_steal(nir, block);
 
    nir_foreach_instr(instr, block) {
-      ralloc_steal(nir, instr);
+      ralloc_slab_mark_live(instr);
 
       nir_foreach_src(instr, sweep_src_indirect, nir);
       nir_foreach_dest(instr, sweep_dest_indirect, nir);
@@ -168,7 +171,11 @@ nir_sweep(nir_shader *nir)
    }
 
    ralloc_steal(nir, nir->constant_data);
+   ralloc_steal(nir, nir->instr_slab);
 
-   /* Free everything we didn't steal back. */
+   /* Free everything we didn't steal back, and the instructions which weren't
+    * marked as live.
+    */
    ralloc_free(rubbish);
+   ralloc_slab_sweep(nir->instr_slab);
 }
@@ -0,0 +1,343 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Measures the compile time spent in the algebraic passes over a corpus of
+ * randomly generated, but reproducible, shaders.  The shaders are made of
+ * scalar ALU instructions nested in a few ifs, with a bias towards the
+ * opcodes which nir_opt_algebraic has the most rules for, and are optimized
+ * with the usual loop of algebraic, constant folding, copy propagation, DCE
+ * and CSE passes, followed by nir_sweep().
+ *
+ * Usage: nir_algebraic_bench [num_shaders] [first_seed] [-p]
+ *
+ * The instruction count printed at the end must not change when only the
+ * matching of the rules changed.  With -p, the optimized shaders are printed
+ * to stdout for a more thorough comparison.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "util/os_time.h"
+
+#define NUM_INPUTS 6
+#define NUM_INSTRS 300
+#define MAX_IF_DEPTH 2
+#define MAX_VALUES 4096
+
+/* Random shaders can make some rules undo each other forever. */
+#define MAX_ITERATIONS 50
+
+static const char *common_opcodes[] = {
+   "fadd", "fmul", "fneg", "fabs", "fsat", "fsub", "ffma", "flrp", "fmax",
+   "fmin", "frcp", "frsq", "fsqrt", "fexp2", "flog2", "fpow", "fdiv",
+   "fsign", "ffloor", "fceil", "ftrunc", "ffract", "fround_even", "fnot",
+   "flt", "fge", "feq", "fne", "slt", "sge", "seq", "sne",
+   "iadd", "isub", "imul", "ineg", "iabs", "imax", "imin", "umax", "umin",
+   "iand", "ior", "ixor", "inot", "ishl", "ishr", "ushr",
+   "ilt", "ige", "ieq", "ine", "ult", "uge",
+   "bcsel", "b2f", "b2i", "f2b", "i2b", "f2i32", "i2f32", "u2f32",
+   "extract_u8", "extract_i16",
+};
+
+static const float float_consts[] = { 0.0f, -0.0f, 1.0f, -1.0f, 2.0f, 0.5f, 3.0f };
+static const int int_consts[] = { 0, 1, -1, 2, 4, 8, 16, 24, 31, 32, 0xff, 0xffff };
+
+struct shader_gen {
+   nir_builder b;
+   uint32_t rand_state;
+
+   nir_op opcodes[nir_num_opcodes];
+   unsigned num_opcodes;
+   nir_op common[ARRAY_SIZE(common_opcodes)];
+   unsigned num_common;
+
+   nir_ssa_def *values[MAX_VALUES];
+   unsigned num_values;
+   unsigned num_outputs;
+};
+
+static uint32_t
+gen_rand(struct shader_gen *gen)
+{
+   gen->rand_state = gen->rand_state * 1103515245u + 12345u;
+   return gen->rand_state >> 8;
+}
+
+static bool
+is_32bit_type(nir_alu_type type)
+{
+   unsigned bit_size = nir_alu_type_get_type_size(type);
+   return bit_size == 0 || bit_size == 32;
+}
+
+/* Only scalar 32-bit opcodes which can't trap when constant folded. */
+static bool
+is_usable_opcode(nir_op op)
+{
+   const nir_op_info *info = &nir_op_infos[op];
+
+   if (info->num_inputs == 0 || info->output_size != 0 ||
+       !is_32bit_type(info->output_type))
+      return false;
+
+   for (unsigned i = 0; i < info->num_inputs; i++) {
+      if (info->input_sizes[i] != 0 || !is_32bit_type(info->input_types[i]))
+         return false;
+   }
+
+   return strncmp(info->name, "vec", 3) != 0 &&
+          strcmp(info->name, "imov") != 0 &&
+          strcmp(info->name, "fmov") != 0 &&
+          strstr(info->name, "div") == NULL &&
+          strstr(info->name, "mod") == NULL &&
+          strstr(info->name, "rem") == NULL;
+}
+
+static void
+init_opcodes(struct shader_gen *gen)
+{
+   for (unsigned op = 0; op < nir_num_opcodes; op++) {
+      if (is_usable_opcode(op))
+         gen->opcodes[gen->num_opcodes++] = op;
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(common_opcodes); i++) {
+      for (unsigned j = 0; j < gen->num_opcodes; j++) {
+         if (strcmp(nir_op_infos[gen->opcodes[j]].name,
+                    common_opcodes[i]) == 0)
+            gen->common[gen->num_common++] = gen->opcodes[j];
+      }
+   }
+}
+
+static nir_ssa_def *
+gen_input(struct shader_gen *gen, unsigned base)
+{
+   nir_builder *b = &gen->b;
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_load_uniform);
+
+   load->num_components = 1;
+   load->src[0] = nir_src_for_ssa(nir_imm_int(b, 0));
+   nir_intrinsic_set_base(load, base);
+   nir_ssa_dest_init(&load->instr, &load->dest, 1, 32, NULL);
+   nir_builder_instr_insert(b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+static void
+gen_output(struct shader_gen *gen, nir_ssa_def *value)
+{
+   nir_builder *b = &gen->b;
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_store_output);
+
+   store->num_components = 1;
+   store->src[0] = nir_src_for_ssa(value);
+   store->src[1] = nir_src_for_ssa(nir_imm_int(b, 0));
+   nir_intrinsic_set_base(store, gen->num_outputs++);
+   nir_intrinsic_set_write_mask(store, 0x1);
+   nir_builder_instr_insert(b, &store->instr);
+}
+
+/* Pick a source among the most recent values, so that expressions get deep,
+ * or a constant.
+ */
+static nir_ssa_def *
+gen_src(struct shader_gen *gen)
+{
+   switch (gen_rand(gen) % 10) {
+   case 0:
+      return nir_imm_float(&gen->b, float_consts[gen_rand(gen) %
+                                                 ARRAY_SIZE(float_consts)]);
+   case 1:
+      return nir_imm_int(&gen->b, int_consts[gen_rand(gen) %
+                                             ARRAY_SIZE(int_consts)]);
+   default: {
+      unsigned window = MIN2(gen->num_values, 8);
+      return gen->values[gen->num_values - 1 - gen_rand(gen) % window];
+   }
+   }
+}
+
+static void
+gen_instrs(struct shader_gen *gen, unsigned count, unsigned depth)
+{
+   for (unsigned i = 0; i < count && gen->num_values < MAX_VALUES; i++) {
+      if (depth < MAX_IF_DEPTH && gen_rand(gen) % 40 == 0) {
+         /* Values of the branches aren't visible after them. */
+         unsigned num_values = gen->num_values;
+
+         nir_if *nif = nir_push_if(&gen->b, gen_src(gen));
+         gen_instrs(gen, 10, depth + 1);
+         gen->num_values = num_values;
+         nir_push_else(&gen->b, nif);
+         gen_instrs(gen, 10, depth + 1);
+         gen->num_values = num_values;
+         nir_pop_if(&gen->b, nif);
+         continue;
+      }
+
+      nir_op op = gen_rand(gen) % 3 ?
+                  gen->common[gen_rand(gen) % gen->num_common] :
+                  gen->opcodes[gen_rand(gen) % gen->num_opcodes];
+
+      nir_ssa_def *srcs[4] = { NULL };
+      for (unsigned j = 0; j < nir_op_infos[op].num_inputs; j++)
+         srcs[j] = gen_src(gen);
+
+      nir_ssa_def *def = nir_build_alu(&gen->b, op, srcs[0], srcs[1],
+                                       srcs[2], srcs[3]);
+      gen->values[gen->num_values++] = def;
+
+      if (gen_rand(gen) % 8 == 0)
+         gen_output(gen, def);
+   }
+}
+
+static nir_shader *
+gen_shader(struct shader_gen *gen, uint32_t seed,
+           const nir_shader_compiler_options *options)
+{
+   gen->rand_state = seed;
+   gen->num_values = 0;
+   gen->num_outputs = 0;
+
+   nir_builder_init_simple_shader(&gen->b, NULL, MESA_SHADER_FRAGMENT,
+                                  options);
+
+   for (unsigned i = 0; i < NUM_INPUTS; i++)
+      gen->values[gen->num_values++] = gen_input(gen, i);
+
+   gen_instrs(gen, NUM_INSTRS, 0);
+
+   return gen->b.shader;
+}
+
+static unsigned
+count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function(function, shader) {
+      if (!function->impl)
+         continue;
+
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block)
+            count++;
+      }
+   }
+
+   return count;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const nir_shader_compiler_options float_options = {
+      .lower_fdiv = true,
+      .lower_fpow = true,
+      .lower_flrp32 = true,
+      .lower_sub = true,
+      .lower_scmp = true,
+      .lower_ldexp = true,
+      .lower_bitfield_extract = true,
+      .lower_extract_byte = true,
+      .lower_extract_word = true,
+   };
+   static const nir_shader_compiler_options int_options = {
+      .native_integers = true,
+   };
+   struct shader_gen gen = { 0 };
+   unsigned num_shaders = 1000, first_seed = 0;
+   unsigned instrs_before = 0, instrs_after = 0, num_passes = 0;
+   int64_t algebraic_time = 0, opt_time = 0;
+   bool print = false;
+   unsigned num_args = 0;
+
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-p") == 0)
+         print = true;
+      else if (num_args++ == 0)
+         num_shaders = strtoul(argv[i], NULL, 0);
+      else
+         first_seed = strtoul(argv[i], NULL, 0);
+   }
+
+   init_opcodes(&gen);
+
+   for (unsigned seed = first_seed; seed < first_seed + num_shaders; seed++) {
+      nir_shader *shader = gen_shader(&gen, seed, seed & 1 ? &float_options
+                                                            : &int_options);
+      unsigned iterations = 0;
+      bool progress;
+
+      instrs_before += count_instrs(shader);
+
+      int64_t opt_start = os_time_get_nano();
+
+      do {
+         progress = false;
+
+         int64_t start = os_time_get_nano();
+         progress |= nir_opt_algebraic(shader);
+         progress |= nir_opt_algebraic_before_ffma(shader);
+         algebraic_time += os_time_get_nano() - start;
+         num_passes++;
+
+         progress |= nir_opt_constant_folding(shader);
+         progress |= nir_copy_prop(shader);
+         progress |= nir_opt_dce(shader);
+         progress |= nir_opt_cse(shader);
+      } while (progress && ++iterations < MAX_ITERATIONS);
+
+      int64_t start = os_time_get_nano();
+      nir_opt_algebraic_late(shader);
+      algebraic_time += os_time_get_nano() - start;
+
+      nir_sweep(shader);
+      opt_time += os_time_get_nano() - opt_start;
+
+      instrs_after += count_instrs(shader);
+
+      if (print)
+         nir_print_shader(shader, stdout);
+
+      ralloc_free(shader);
+   }
+
+   fprintf(stderr, "%u shaders, %u instructions before, %u after\n",
+           num_shaders, instrs_before, instrs_after);
+   fprintf(stderr, "algebraic passes: %.3f ms for %u iterations\n",
+           algebraic_time / 1000000.0, num_passes);
+   fprintf(stderr, "all passes and nir_sweep: %.3f ms\n",
+           opt_time / 1000000.0);
+
+   return 0;
+}
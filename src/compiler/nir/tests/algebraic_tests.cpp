@@ -0,0 +1,253 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include <gtest/gtest.h>
+#include "nir.h"
+#include "nir_builder.h"
+
+/* nir_opt_algebraic only tries the rules that the tree automaton built by
+ * nir_algebraic.py lets through, these check that it still finds matches
+ * through nested expressions, commuted sources and constants.
+ */
+class nir_algebraic_test : public ::testing::Test {
+protected:
+   nir_algebraic_test();
+   ~nir_algebraic_test();
+
+   nir_ssa_def *input(unsigned base);
+   void output(nir_ssa_def *value);
+   nir_ssa_def *optimize();
+
+   nir_builder b;
+   unsigned num_outputs;
+};
+
+nir_algebraic_test::nir_algebraic_test()
+{
+   static const nir_shader_compiler_options options = {
+      .native_integers = true,
+   };
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_VERTEX, &options);
+   num_outputs = 0;
+}
+
+nir_algebraic_test::~nir_algebraic_test()
+{
+   ralloc_free(b.shader);
+}
+
+nir_ssa_def *
+nir_algebraic_test::input(unsigned base)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_load_uniform);
+
+   load->num_components = 1;
+   load->src[0] = nir_src_for_ssa(nir_imm_int(&b, 0));
+   nir_intrinsic_set_base(load, base);
+   nir_ssa_dest_init(&load->instr, &load->dest, 1, 32, NULL);
+   nir_builder_instr_insert(&b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+void
+nir_algebraic_test::output(nir_ssa_def *value)
+{
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_store_output);
+
+   store->num_components = 1;
+   store->src[0] = nir_src_for_ssa(value);
+   store->src[1] = nir_src_for_ssa(nir_imm_int(&b, 0));
+   nir_intrinsic_set_base(store, num_outputs++);
+   nir_intrinsic_set_write_mask(store, 0x1);
+   nir_builder_instr_insert(&b, &store->instr);
+}
+
+/* Runs the algebraic optimizations until they make no more progress, and
+ * returns the value stored by the last output.
+ */
+nir_ssa_def *
+nir_algebraic_test::optimize()
+{
+   bool progress;
+
+   do {
+      progress = nir_opt_algebraic(b.shader);
+      progress |= nir_copy_prop(b.shader);
+      progress |= nir_opt_dce(b.shader);
+   } while (progress);
+
+   nir_validate_shader(b.shader);
+
+   nir_block *block = nir_impl_last_block(b.impl);
+   nir_foreach_instr_reverse(instr, block) {
+      if (instr->type != nir_instr_type_intrinsic)
+         continue;
+
+      nir_intrinsic_instr *store = nir_instr_as_intrinsic(instr);
+      if (store->intrinsic == nir_intrinsic_store_output)
+         return store->src[0].ssa;
+   }
+
+   return NULL;
+}
+
+static bool
+is_alu(nir_ssa_def *def, nir_op op)
+{
+   return def->parent_instr->type == nir_instr_type_alu &&
+          nir_instr_as_alu(def->parent_instr)->op == op;
+}
+
+static nir_ssa_def *
+alu_src(nir_ssa_def *def, unsigned i)
+{
+   return nir_instr_as_alu(def->parent_instr)->src[i].src.ssa;
+}
+
+static bool
+is_const_int(nir_ssa_def *def, int value)
+{
+   return def->parent_instr->type == nir_instr_type_load_const &&
+          nir_instr_as_load_const(def->parent_instr)->value.i32[0] == value;
+}
+
+TEST_F(nir_algebraic_test, nested_unary)
+{
+   nir_ssa_def *a = input(0);
+
+   /* fneg(fneg(a)) -> a */
+   output(nir_fneg(&b, nir_fneg(&b, a)));
+   EXPECT_EQ(optimize(), a);
+}
+
+TEST_F(nir_algebraic_test, nested_unary_replacement)
+{
+   nir_ssa_def *a = input(0);
+
+   /* fabs(fneg(a)) -> fabs(a) */
+   output(nir_fabs(&b, nir_fneg(&b, a)));
+
+   nir_ssa_def *result = optimize();
+   ASSERT_TRUE(is_alu(result, nir_op_fabs));
+   EXPECT_EQ(alu_src(result, 0), a);
+}
+
+TEST_F(nir_algebraic_test, replacement_matched_again)
+{
+   nir_ssa_def *a = input(0);
+
+   /* Each ineg(ineg(x)) -> x exposes another pair. */
+   output(nir_ineg(&b, nir_ineg(&b, nir_ineg(&b, nir_ineg(&b,
+          nir_ineg(&b, a))))));
+
+   nir_ssa_def *result = optimize();
+   ASSERT_TRUE(is_alu(result, nir_op_ineg));
+   EXPECT_EQ(alu_src(result, 0), a);
+}
+
+TEST_F(nir_algebraic_test, constant_source)
+{
+   nir_ssa_def *a = input(0);
+
+   /* fmul(a, 1.0) -> a, with the constant on either side. */
+   output(nir_fmul(&b, a, nir_imm_float(&b, 1.0)));
+   EXPECT_EQ(optimize(), a);
+
+   output(nir_fmul(&b, nir_imm_float(&b, 1.0), a));
+   EXPECT_EQ(optimize(), a);
+}
+
+TEST_F(nir_algebraic_test, constant_value_checked)
+{
+   nir_ssa_def *a = input(0);
+
+   /* ishl(a, 0) -> a, but ishl(a, 1) has to stay. */
+   output(nir_ishl(&b, a, nir_imm_int(&b, 1)));
+
+   nir_ssa_def *result = optimize();
+   ASSERT_TRUE(is_alu(result, nir_op_ishl));
+   EXPECT_EQ(alu_src(result, 0), a);
+   EXPECT_TRUE(is_const_int(alu_src(result, 1), 1));
+
+   output(nir_ishl(&b, a, nir_imm_int(&b, 0)));
+   EXPECT_EQ(optimize(), a);
+}
+
+TEST_F(nir_algebraic_test, commuted_nested_source)
+{
+   nir_ssa_def *a = input(0);
+
+   /* iadd(ineg(a), a) -> 0, with the ineg on either side. */
+   output(nir_iadd(&b, nir_ineg(&b, a), a));
+   EXPECT_TRUE(is_const_int(optimize(), 0));
+
+   output(nir_iadd(&b, a, nir_ineg(&b, a)));
+   EXPECT_TRUE(is_const_int(optimize(), 0));
+}
+
+TEST_F(nir_algebraic_test, repeated_variable)
+{
+   nir_ssa_def *a = input(0);
+   nir_ssa_def *c = input(1);
+
+   /* iand(a, a) -> a, but iand(a, c) has to stay. */
+   output(nir_iand(&b, a, c));
+
+   nir_ssa_def *result = optimize();
+   ASSERT_TRUE(is_alu(result, nir_op_iand));
+
+   output(nir_iand(&b, a, a));
+   EXPECT_EQ(optimize(), a);
+}
+
+TEST_F(nir_algebraic_test, deep_expression)
+{
+   nir_ssa_def *a = nir_ilt(&b, input(0), input(1));
+   nir_ssa_def *c = nir_ilt(&b, input(2), input(3));
+
+   /* flt(fneg(fadd(b2f(a), b2f(c))), 0.0) -> ior(a, c) */
+   output(nir_flt(&b, nir_fneg(&b, nir_fadd(&b, nir_b2f(&b, a),
+                                                 nir_b2f(&b, c))),
+                  nir_imm_float(&b, 0.0)));
+
+   nir_ssa_def *result = optimize();
+   ASSERT_TRUE(is_alu(result, nir_op_ior));
+   EXPECT_TRUE((alu_src(result, 0) == a && alu_src(result, 1) == c) ||
+               (alu_src(result, 0) == c && alu_src(result, 1) == a));
+}
+
+TEST_F(nir_algebraic_test, deep_expression_mismatch)
+{
+   nir_ssa_def *a = nir_ilt(&b, input(0), input(1));
+   nir_ssa_def *c = nir_ilt(&b, input(2), input(3));
+
+   /* The same, with one b2f replaced by a b2i, must not match. */
+   output(nir_flt(&b, nir_fneg(&b, nir_fadd(&b, nir_b2f(&b, a),
+                                                 nir_b2i(&b, c))),
+                  nir_imm_float(&b, 0.0)));
+
+   nir_ssa_def *result = optimize();
+   EXPECT_FALSE(is_alu(result, nir_op_ior));
+}
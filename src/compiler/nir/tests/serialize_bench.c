@@ -0,0 +1,374 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Round-trips a corpus of randomly generated, but reproducible, shaders
+ * through nir_serialize and nir_deserialize, and reports the size of the
+ * blobs and the time spent writing and reading them.
+ *
+ * The shaders load vec4 inputs and uniforms through derefs, do swizzled
+ * vector ALU and texturing, and keep local variables across ifs and loops,
+ * which become phis once lowered to SSA.  Every other shader is also taken
+ * out of SSA, so that registers get written too.
+ *
+ * Usage: nir_serialize_bench [num_shaders] [first_seed]
+ *
+ * Fails if a shader doesn't print the same after the round-trip, doesn't
+ * serialize to the same blob again, or if its shader_info can't be read on its
+ * own.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+#include "nir_serialize.h"
+#include "util/os_time.h"
+
+#define NUM_INPUTS 4
+#define NUM_UNIFORMS 16
+#define NUM_LOCALS 4
+#define NUM_INSTRS 200
+#define MAX_CF_DEPTH 2
+#define MAX_VALUES 4096
+
+static const nir_op vec_opcodes[] = {
+   nir_op_fadd, nir_op_fadd, nir_op_fmul, nir_op_fmul, nir_op_ffma,
+   nir_op_fmax, nir_op_fmin, nir_op_fneg, nir_op_fabs, nir_op_fsat,
+   nir_op_ffract, nir_op_flt, nir_op_bcsel, nir_op_fdot3, nir_op_fdot4,
+};
+
+static const float float_consts[] = { 0.0f, 1.0f, -1.0f, 0.5f, 2.0f };
+
+struct shader_gen {
+   nir_builder b;
+   uint32_t rand_state;
+
+   nir_variable *inputs[NUM_INPUTS];
+   nir_variable *uniforms;
+   nir_variable *locals[NUM_LOCALS];
+   nir_variable *output;
+
+   nir_ssa_def *values[MAX_VALUES];
+   unsigned num_values;
+};
+
+static uint32_t
+gen_rand(struct shader_gen *gen)
+{
+   gen->rand_state = gen->rand_state * 1103515245u + 12345u;
+   return gen->rand_state >> 8;
+}
+
+static float
+gen_float_const(struct shader_gen *gen)
+{
+   return float_consts[gen_rand(gen) % ARRAY_SIZE(float_consts)];
+}
+
+/* Pick a recent vec4 value, with a random swizzle now and then. */
+static nir_ssa_def *
+gen_src(struct shader_gen *gen)
+{
+   nir_builder *b = &gen->b;
+
+   if (gen_rand(gen) % 8 == 0) {
+      float v[4];
+      for (unsigned i = 0; i < 4; i++)
+         v[i] = gen_float_const(gen);
+      return nir_imm_vec4(b, v[0], v[1], v[2], v[3]);
+   }
+
+   unsigned window = MIN2(gen->num_values, 8);
+   nir_ssa_def *def = gen->values[gen->num_values - 1 -
+                                  gen_rand(gen) % window];
+
+   if (gen_rand(gen) % 3 == 0) {
+      unsigned swiz[4];
+      for (unsigned i = 0; i < 4; i++)
+         swiz[i] = gen_rand(gen) % 4;
+      def = nir_swizzle(b, def, swiz, 4, false);
+   }
+
+   return def;
+}
+
+static nir_ssa_def *
+gen_vec4(nir_builder *b, nir_ssa_def *def)
+{
+   if (def->num_components == 4)
+      return def;
+
+   return nir_swizzle(b, def, (unsigned[]) { 0, 0, 0, 0 }, 4, false);
+}
+
+static nir_ssa_def *
+gen_tex(struct shader_gen *gen, nir_ssa_def *coord)
+{
+   nir_builder *b = &gen->b;
+   nir_tex_instr *tex = nir_tex_instr_create(b->shader, 1);
+
+   tex->op = nir_texop_tex;
+   tex->sampler_dim = GLSL_SAMPLER_DIM_2D;
+   tex->dest_type = nir_type_float;
+   tex->coord_components = 2;
+   tex->texture_index = gen_rand(gen) % 4;
+   tex->sampler_index = tex->texture_index;
+   tex->src[0].src_type = nir_tex_src_coord;
+   tex->src[0].src = nir_src_for_ssa(nir_channels(b, coord, 0x3));
+   nir_ssa_dest_init(&tex->instr, &tex->dest, 4, 32, NULL);
+   nir_builder_instr_insert(b, &tex->instr);
+
+   return &tex->dest.ssa;
+}
+
+static nir_ssa_def *
+gen_value(struct shader_gen *gen)
+{
+   nir_builder *b = &gen->b;
+
+   switch (gen_rand(gen) % 16) {
+   case 0:
+      return nir_load_var(b, gen->inputs[gen_rand(gen) % NUM_INPUTS]);
+   case 1: {
+      nir_deref_instr *deref = nir_build_deref_var(b, gen->uniforms);
+      deref = nir_build_deref_array(b, deref,
+                                    nir_imm_int(b, gen_rand(gen) %
+                                                   NUM_UNIFORMS));
+      return nir_load_deref(b, deref);
+   }
+   case 2:
+      return nir_load_var(b, gen->locals[gen_rand(gen) % NUM_LOCALS]);
+   case 3:
+      return gen_tex(gen, gen_src(gen));
+   default: {
+      nir_op op = vec_opcodes[gen_rand(gen) % ARRAY_SIZE(vec_opcodes)];
+      nir_ssa_def *srcs[3] = { NULL };
+      for (unsigned i = 0; i < nir_op_infos[op].num_inputs; i++) {
+         srcs[i] = gen_src(gen);
+         if (nir_op_infos[op].input_sizes[i] == 3)
+            srcs[i] = nir_channels(b, srcs[i], 0x7);
+      }
+
+      return gen_vec4(b, nir_build_alu(b, op, srcs[0], srcs[1], srcs[2],
+                                       NULL));
+   }
+   }
+}
+
+static void
+gen_instrs(struct shader_gen *gen, unsigned count, unsigned depth)
+{
+   nir_builder *b = &gen->b;
+
+   for (unsigned i = 0; i < count && gen->num_values < MAX_VALUES; i++) {
+      unsigned num_values = gen->num_values;
+
+      switch (gen_rand(gen) % 32) {
+      case 0:
+         if (depth < MAX_CF_DEPTH) {
+            /* Values of the branches aren't visible after them. */
+            nir_ssa_def *cond = nir_channel(b, gen_src(gen), 0);
+            nir_if *nif =
+               nir_push_if(b, nir_flt(b, cond, nir_imm_float(b, 0.5f)));
+            gen_instrs(gen, 8, depth + 1);
+            gen->num_values = num_values;
+            nir_push_else(b, nif);
+            gen_instrs(gen, 8, depth + 1);
+            gen->num_values = num_values;
+            nir_pop_if(b, nif);
+         }
+         continue;
+      case 1:
+         if (depth < MAX_CF_DEPTH) {
+            nir_loop *loop = nir_push_loop(b);
+            nir_ssa_def *cond = nir_channel(b, gen_src(gen), 1);
+            nir_if *nif =
+               nir_push_if(b, nir_fge(b, cond, nir_imm_float(b, 1.0f)));
+            nir_jump(b, nir_jump_break);
+            nir_pop_if(b, nif);
+            gen_instrs(gen, 8, depth + 1);
+            gen->num_values = num_values;
+            nir_pop_loop(b, loop);
+         }
+         continue;
+      case 2:
+      case 3:
+      case 4:
+      case 5: {
+         nir_variable *var = gen->locals[gen_rand(gen) % NUM_LOCALS];
+         nir_ssa_def *value = gen_src(gen);
+         nir_store_var(b, var, value, gen_rand(gen) % 2 ? 0xf : 0x3);
+         continue;
+      }
+      default: {
+         nir_ssa_def *def = gen_value(gen);
+         gen->values[gen->num_values++] = def;
+         continue;
+      }
+      }
+   }
+}
+
+static nir_shader *
+gen_shader(struct shader_gen *gen, uint32_t seed,
+           const nir_shader_compiler_options *options)
+{
+   nir_builder *b = &gen->b;
+   char name[16];
+
+   gen->rand_state = seed;
+   gen->num_values = 0;
+
+   nir_builder_init_simple_shader(b, NULL, MESA_SHADER_FRAGMENT, options);
+   b->shader->info.name = ralloc_asprintf(b->shader, "shader%u", seed);
+
+   for (unsigned i = 0; i < NUM_INPUTS; i++) {
+      snprintf(name, sizeof(name), "in%u", i);
+      gen->inputs[i] = nir_variable_create(b->shader, nir_var_shader_in,
+                                           glsl_vec4_type(), name);
+      gen->inputs[i]->data.location = VARYING_SLOT_VAR0 + i;
+   }
+
+   gen->uniforms =
+      nir_variable_create(b->shader, nir_var_uniform,
+                          glsl_array_type(glsl_vec4_type(), NUM_UNIFORMS),
+                          "uniforms");
+
+   for (unsigned i = 0; i < NUM_LOCALS; i++) {
+      snprintf(name, sizeof(name), "tmp%u", i);
+      gen->locals[i] = nir_local_variable_create(b->impl, glsl_vec4_type(),
+                                                 name);
+      nir_store_var(b, gen->locals[i], nir_imm_vec4(b, 0, 0, 0, 0), 0xf);
+   }
+
+   gen->output = nir_variable_create(b->shader, nir_var_shader_out,
+                                     glsl_vec4_type(), "color");
+   gen->output->data.location = FRAG_RESULT_DATA0;
+
+   gen->values[gen->num_values++] = nir_load_var(b, gen->inputs[0]);
+
+   gen_instrs(gen, NUM_INSTRS, 0);
+
+   nir_store_var(b, gen->output, gen_src(gen), 0xf);
+
+   nir_lower_vars_to_ssa(b->shader);
+   nir_copy_prop(b->shader);
+   nir_opt_dce(b->shader);
+
+   if (seed & 1)
+      nir_convert_from_ssa(b->shader, true);
+
+   return b->shader;
+}
+
+/* The deserialized shader gets new SSA and block indices, so both shaders
+ * are renumbered before being compared.
+ */
+static char *
+print_shader(nir_shader *shader)
+{
+   char *str;
+   size_t size;
+   FILE *f = open_memstream(&str, &size);
+
+   nir_foreach_function(function, shader) {
+      if (function->impl) {
+         nir_index_ssa_defs(function->impl);
+         nir_index_blocks(function->impl);
+      }
+   }
+
+   nir_print_shader(shader, f);
+   fclose(f);
+
+   return str;
+}
+
+int
+main(int argc, char **argv)
+{
+   static const nir_shader_compiler_options options = {
+      .native_integers = true,
+   };
+   struct shader_gen gen;
+   unsigned num_shaders = argc > 1 ? strtoul(argv[1], NULL, 0) : 200;
+   unsigned first_seed = argc > 2 ? strtoul(argv[2], NULL, 0) : 0;
+   size_t total_size = 0;
+   int64_t write_time = 0, read_time = 0;
+   unsigned failures = 0;
+
+   for (unsigned seed = first_seed; seed < first_seed + num_shaders; seed++) {
+      nir_shader *shader = gen_shader(&gen, seed, &options);
+      struct blob blob, blob2;
+
+      blob_init(&blob);
+      int64_t start = os_time_get_nano();
+      nir_serialize(&blob, shader);
+      write_time += os_time_get_nano() - start;
+      total_size += blob.size;
+
+      struct blob_reader reader;
+      blob_reader_init(&reader, blob.data, blob.size);
+      start = os_time_get_nano();
+      nir_shader *copy = nir_deserialize(NULL, &options, &reader);
+      read_time += os_time_get_nano() - start;
+
+      char *orig_str = print_shader(shader);
+      char *copy_str = print_shader(copy);
+
+      blob_init(&blob2);
+      nir_serialize(&blob2, copy);
+
+      if (reader.overrun || reader.current != reader.end ||
+          strcmp(orig_str, copy_str) != 0 || blob.size != blob2.size ||
+          memcmp(blob.data, blob2.data, blob.size) != 0) {
+         fprintf(stderr, "shader %u doesn't survive the round-trip\n", seed);
+         failures++;
+      }
+
+      struct shader_info info;
+      blob_reader_init(&reader, blob.data, blob.size);
+      if (!nir_deserialize_shader_info(&reader, &info) ||
+          info.stage != shader->info.stage ||
+          strcmp(info.name, shader->info.name) != 0) {
+         fprintf(stderr, "shader %u has a bad shader_info\n", seed);
+         failures++;
+      }
+
+      free(orig_str);
+      free(copy_str);
+      blob_finish(&blob);
+      blob_finish(&blob2);
+      ralloc_free(shader);
+      ralloc_free(copy);
+   }
+
+   printf("%u shaders, %zu bytes serialized (%.1f per shader)\n",
+          num_shaders, total_size, (double) total_size / num_shaders);
+   printf("serialize: %.3f ms, deserialize: %.3f ms\n",
+          write_time / 1000000.0, read_time / 1000000.0);
+
+   return failures ? 1 : 0;
+}
@@ -1005,6 +1005,25 @@ draw_set_samplers(struct draw_context *draw,
 #endif
 }
 
+/**
+ * Install driver callbacks to look up and store the object code of
+ * JIT-compiled vertex/geometry shader variants in an on-disk cache.
+ */
+void
+draw_set_disk_cache_callbacks(struct draw_context *draw,
+                              void *data_cookie,
+                              void (*find_shader)(void *cookie,
+                                                  struct lp_cached_code *cache,
+                                                  unsigned char ir_sha1_cache_key[20]),
+                              void (*insert_shader)(void *cookie,
+                                                    struct lp_cached_code *cache,
+                                                    unsigned char ir_sha1_cache_key[20]))
+{
+   draw->disk_cache_find_shader = find_shader;
+   draw->disk_cache_insert_shader = insert_shader;
+   draw->disk_cache_cookie = data_cookie;
+}
+
 void
 draw_set_mapped_texture(struct draw_context *draw,
                         enum pipe_shader_type shader_stage,
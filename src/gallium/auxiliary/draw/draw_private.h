@@ -71,6 +71,7 @@ struct tgsi_buffer;
 struct draw_pt_front_end;
 struct draw_assembler;
 struct draw_llvm;
+struct lp_cached_code;
 
 
 /**
@@ -341,6 +342,15 @@ struct draw_context
 
    struct draw_assembler *ia;
 
+   /** Optional driver callbacks for caching JIT-compiled code on disk */
+   void *disk_cache_cookie;
+   void (*disk_cache_find_shader)(void *cookie,
+                                  struct lp_cached_code *cache,
+                                  unsigned char ir_sha1_cache_key[20]);
+   void (*disk_cache_insert_shader)(void *cookie,
+                                    struct lp_cached_code *cache,
+                                    unsigned char ir_sha1_cache_key[20]);
+
    void *driver_private;
 };
 
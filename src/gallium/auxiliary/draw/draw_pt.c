@@ -146,8 +146,14 @@ draw_pt_arrays(struct draw_context *draw,
       draw->pt.rebind_parameters = FALSE;
    }
 
+   if (middle->begin_draw)
+      middle->begin_draw(middle, count);
+
    frontend->run( frontend, start, count );
 
+   if (middle->end_draw)
+      middle->end_draw(middle);
+
    return TRUE;
 }
 
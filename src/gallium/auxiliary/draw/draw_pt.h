@@ -124,6 +124,14 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)( struct draw_pt_middle_end * );
 
+   /**
+    * Optional, called around the run calls of each draw of "count"
+    * vertices.  The LLVM middle end shades the vertices of large draws on
+    * other threads and waits for them in end_draw.
+    */
+   void (*begin_draw)( struct draw_pt_middle_end *, unsigned count );
+   void (*end_draw)( struct draw_pt_middle_end * );
+
    void (*finish)( struct draw_pt_middle_end * );
    void (*destroy)( struct draw_pt_middle_end * );
 };
@@ -38,8 +38,31 @@
 #include "draw/draw_llvm.h"
 #include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_debug.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_queue.h"
 
 
+/* Draws of at least this many vertices have the chunks vsplit hands over
+ * shaded on the threads of the middle end.  Smaller ones wouldn't make up
+ * for the handoff.
+ */
+#define LLVM_PARALLEL_MIN_VERTICES 16384
+#define LLVM_MAX_THREADS 8
+/* At most two shaded chunks per thread wait to be drawn. */
+#define LLVM_MAX_JOBS (2 * LLVM_MAX_THREADS)
+
+/* Indexed draws of more vertices than vsplit hands over at once keep the
+ * shaded vertices in a cache across the run calls.  It holds up to
+ * DRAW_VERTEX_CACHE_SIZE vertices.
+ */
+#define LLVM_VCACHE_MIN_VERTICES 4096
+#define LLVM_VCACHE_DEFAULT_SIZE 1024
+#define LLVM_VCACHE_MAX_SIZE 4096
+/* The largest run call the cache handles */
+#define LLVM_VCACHE_MAX_FETCH 4096
+
+struct llvm_shade_job;
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -57,6 +80,43 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Vertex shading threads, created by the first large draw. */
+   struct util_queue queue;
+   unsigned num_threads;
+   boolean parallel;
+
+   /* Ring of the jobs queued by the current draw, oldest first. */
+   struct llvm_shade_job *jobs[LLVM_MAX_JOBS];
+   unsigned first_job;
+   unsigned num_jobs;
+
+   /* Post-transform vertex cache of the current draw, replaced in FIFO
+    * order.  The entries are chained in buckets by fetch element.
+    */
+   struct {
+      unsigned size;
+      boolean enabled;
+      unsigned count;
+      unsigned next;
+
+      unsigned *elts;
+      int *chain;
+      int *buckets;
+      unsigned bucket_mask;
+      boolean *clipped;
+
+      char *verts;
+      unsigned verts_size;
+
+      /* Vertices looked up and found by the current draw */
+      unsigned lookups;
+      unsigned hits;
+
+      int slots[LLVM_VCACHE_MAX_FETCH];
+      unsigned miss_elts[LLVM_VCACHE_MAX_FETCH];
+      ushort draw_elts[LLVM_VCACHE_MAX_FETCH];
+   } vcache;
 };
 
 
@@ -347,72 +407,130 @@ emit(struct pt_emit *emit,
 }
 
 
-static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+/**
+ * Fetch, vertex shade and cliptest a chunk of vertices.  The element arrays
+ * and the per-draw state the jit function reads are captured, as the
+ * shading may happen on another thread after the caller moved on.
+ */
+struct llvm_shade_job {
+   struct util_queue_fence fence;
+   struct llvm_middle_end *fpme;
+   struct draw_llvm_variant *variant;
+
+   struct draw_fetch_info fetch_info;
+   struct draw_prim_info prim_info;
+   struct draw_vertex_info vert_info;
+   unsigned prim_length;
+
+   unsigned start_or_maxelt;
+   unsigned vid_base;
+   unsigned instance_id;
+   unsigned start_instance;
+
+   boolean clipped;
+};
+
+
+static boolean
+llvm_shade_job_init(struct llvm_shade_job *job,
+                    struct llvm_middle_end *fpme,
+                    const struct draw_fetch_info *fetch_info,
+                    const struct draw_prim_info *prim_info)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
-   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
-   struct draw_prim_info gs_prim_info;
-   struct draw_vertex_info llvm_vert_info;
-   struct draw_vertex_info gs_vert_info;
-   struct draw_vertex_info *vert_info;
-   struct draw_prim_info ia_prim_info;
-   struct draw_vertex_info ia_vert_info;
-   const struct draw_prim_info *prim_info = in_prim_info;
-   boolean free_prim_info = FALSE;
-   unsigned opt = fpme->opt;
-   boolean clipped = 0;
-   unsigned start_or_maxelt, vid_base;
-   const unsigned *elts;
 
    assert(fetch_info->count > 0);
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
+   job->vert_info.count = fetch_info->count;
+   job->vert_info.vertex_size = fpme->vertex_size;
+   job->vert_info.stride = fpme->vertex_size;
+   job->vert_info.verts = (struct vertex_header *)
       MALLOC(fpme->vertex_size *
              align(fetch_info->count, lp_native_vector_width / 32));
-   if (!llvm_vert_info.verts) {
+   if (!job->vert_info.verts) {
       assert(0);
-      return;
+      return FALSE;
    }
 
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      draw->statistics.ia_primitives +=
-         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
+   job->fpme = fpme;
+   job->variant = fpme->current_variant;
+   job->fetch_info = *fetch_info;
+   job->prim_info = *prim_info;
+   assert(prim_info->primitive_count == 1);
+   job->prim_length = prim_info->primitive_lengths[0];
+   job->prim_info.primitive_lengths = &job->prim_length;
 
    if (fetch_info->linear) {
-      start_or_maxelt = fetch_info->start;
-      vid_base = draw->start_index;
-      elts = NULL;
+      job->start_or_maxelt = fetch_info->start;
+      job->vid_base = draw->start_index;
    }
    else {
-      start_or_maxelt = draw->pt.user.eltMax;
-      vid_base = draw->pt.user.eltBias;
-      elts = fetch_info->elts;
-   }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts);
-
-   /* Finished with fetch and vs:
+      job->start_or_maxelt = draw->pt.user.eltMax;
+      job->vid_base = draw->pt.user.eltBias;
+   }
+   job->instance_id = draw->instance_id;
+   job->start_instance = draw->start_instance;
+   job->clipped = FALSE;
+
+   return TRUE;
+}
+
+
+static void
+llvm_shade_job_run(void *data, int thread_index)
+{
+   struct llvm_shade_job *job = (struct llvm_shade_job *) data;
+   struct llvm_middle_end *fpme = job->fpme;
+   struct draw_context *draw = fpme->draw;
+
+   job->clipped = job->variant->jit_func(&fpme->llvm->jit_context,
+                                         job->vert_info.verts,
+                                         draw->pt.user.vbuffer,
+                                         job->fetch_info.count,
+                                         job->start_or_maxelt,
+                                         fpme->vertex_size,
+                                         draw->pt.vertex_buffer,
+                                         job->instance_id,
+                                         job->vid_base,
+                                         job->start_instance,
+                                         job->fetch_info.linear ?
+                                            NULL : job->fetch_info.elts);
+}
+
+
+static void
+llvm_shade_job_execute(void *data, int thread_index)
+{
+   /* Shade with the floating point environment draw_vbo() set up for the
+    * application thread.
     */
-   fetch_info = NULL;
-   vert_info = &llvm_vert_info;
+   unsigned fpstate = util_fpstate_get();
+
+   util_fpstate_set_denorms_to_zero(fpstate);
+   llvm_shade_job_run(data, thread_index);
+   util_fpstate_set(fpstate);
+}
+
+
+/**
+ * Run the rest of the pipeline on the shaded vertices of a job: geometry
+ * shader or primitive assembly, stream output, clipping and emit.  This
+ * happens on the application thread, in the order the chunks were drawn.
+ */
+static void
+llvm_pipeline_draw(struct llvm_middle_end *fpme,
+                   struct llvm_shade_job *job)
+{
+   struct draw_context *draw = fpme->draw;
+   struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
+   struct draw_prim_info gs_prim_info;
+   struct draw_vertex_info gs_vert_info;
+   struct draw_vertex_info *vert_info = &job->vert_info;
+   struct draw_prim_info ia_prim_info;
+   struct draw_vertex_info ia_vert_info;
+   const struct draw_prim_info *prim_info = &job->prim_info;
+   boolean free_prim_info = FALSE;
+   unsigned opt = fpme->opt;
+   boolean clipped = job->clipped;
 
    if ((opt & PT_SHADE) && gshader) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
@@ -495,6 +613,246 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+/**
+ * Wait for the oldest queued job to be shaded and draw it.
+ */
+static void
+llvm_middle_end_finish_job(struct llvm_middle_end *fpme)
+{
+   struct llvm_shade_job *job = fpme->jobs[fpme->first_job];
+
+   assert(fpme->num_jobs > 0);
+   fpme->first_job = (fpme->first_job + 1) % LLVM_MAX_JOBS;
+   fpme->num_jobs--;
+
+   util_queue_fence_wait(&job->fence);
+   util_queue_fence_destroy(&job->fence);
+   llvm_pipeline_draw(fpme, job);
+   FREE(job);
+}
+
+
+static void
+llvm_middle_end_finish_jobs(struct llvm_middle_end *fpme)
+{
+   while (fpme->num_jobs)
+      llvm_middle_end_finish_job(fpme);
+}
+
+
+/**
+ * Shade the chunk on the threads of the middle end.  The oldest chunks are
+ * drawn as soon as they are shaded, or when too many are in flight, so that
+ * the application thread keeps feeding the backend meanwhile.  Returns FALSE
+ * if the job couldn't be allocated.
+ */
+static boolean
+llvm_middle_end_queue_job(struct llvm_middle_end *fpme,
+                          const struct draw_fetch_info *fetch_info,
+                          const struct draw_prim_info *prim_info)
+{
+   const unsigned fetch_elts_size =
+      fetch_info->linear ? 0 : fetch_info->count * sizeof(unsigned);
+   const unsigned draw_elts_size =
+      prim_info->linear ? 0 : prim_info->count * sizeof(ushort);
+   struct llvm_shade_job *job;
+
+   job = MALLOC(sizeof(*job) + fetch_elts_size + draw_elts_size);
+   if (!job)
+      return FALSE;
+
+   if (!llvm_shade_job_init(job, fpme, fetch_info, prim_info)) {
+      FREE(job);
+      return TRUE;
+   }
+
+   if (fetch_elts_size) {
+      unsigned *fetch_elts = (unsigned *) (job + 1);
+      memcpy(fetch_elts, fetch_info->elts, fetch_elts_size);
+      job->fetch_info.elts = fetch_elts;
+   }
+   if (draw_elts_size) {
+      ushort *draw_elts = (ushort *) ((char *) (job + 1) + fetch_elts_size);
+      memcpy(draw_elts, prim_info->elts, draw_elts_size);
+      job->prim_info.elts = draw_elts;
+   }
+
+   if (fpme->num_jobs == 2 * fpme->num_threads)
+      llvm_middle_end_finish_job(fpme);
+
+   fpme->jobs[(fpme->first_job + fpme->num_jobs) % LLVM_MAX_JOBS] = job;
+   fpme->num_jobs++;
+   util_queue_fence_init(&job->fence);
+   util_queue_add_job(&fpme->queue, job, &job->fence,
+                      llvm_shade_job_execute, NULL);
+
+   while (fpme->num_jobs &&
+          util_queue_fence_is_signalled(&fpme->jobs[fpme->first_job]->fence))
+      llvm_middle_end_finish_job(fpme);
+
+   return TRUE;
+}
+
+
+static void
+llvm_collect_statistics(struct draw_context *draw,
+                        const struct draw_prim_info *prim_info,
+                        unsigned vs_invocations)
+{
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      draw->statistics.ia_primitives +=
+         u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      draw->statistics.vs_invocations += vs_invocations;
+   }
+}
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct llvm_shade_job job;
+
+   llvm_collect_statistics(draw, prim_info, fetch_info->count);
+
+   if (fpme->parallel) {
+      if (llvm_middle_end_queue_job(fpme, fetch_info, prim_info))
+         return;
+
+      /* Out of memory for the job, draw the chunk after the queued ones. */
+      llvm_middle_end_finish_jobs(fpme);
+   }
+
+   if (!llvm_shade_job_init(&job, fpme, fetch_info, prim_info))
+      return;
+
+   llvm_shade_job_run(&job, 0);
+   llvm_pipeline_draw(fpme, &job);
+}
+
+
+static int
+llvm_vcache_lookup(struct llvm_middle_end *fpme, unsigned elt)
+{
+   int slot = fpme->vcache.buckets[elt & fpme->vcache.bucket_mask];
+
+   while (slot >= 0 && fpme->vcache.elts[slot] != elt)
+      slot = fpme->vcache.chain[slot];
+
+   return slot;
+}
+
+
+/**
+ * Add a shaded vertex to the cache, in place of the oldest one if it is
+ * full.  "clipped" is the result of the cliptest of the chunk the vertex
+ * was shaded with.
+ */
+static void
+llvm_vcache_insert(struct llvm_middle_end *fpme, unsigned elt,
+                   const struct vertex_header *vert, boolean clipped)
+{
+   const unsigned slot = fpme->vcache.next;
+   int *link;
+
+   if (fpme->vcache.count == fpme->vcache.size) {
+      link = &fpme->vcache.buckets[fpme->vcache.elts[slot] &
+                                   fpme->vcache.bucket_mask];
+      while (*link != (int) slot)
+         link = &fpme->vcache.chain[*link];
+      *link = fpme->vcache.chain[slot];
+   }
+   else {
+      fpme->vcache.count++;
+   }
+
+   link = &fpme->vcache.buckets[elt & fpme->vcache.bucket_mask];
+   fpme->vcache.elts[slot] = elt;
+   fpme->vcache.chain[slot] = *link;
+   fpme->vcache.clipped[slot] = clipped;
+   *link = slot;
+   memcpy(fpme->vcache.verts + slot * fpme->vertex_size, vert,
+          fpme->vertex_size);
+
+   fpme->vcache.next = (slot + 1) % fpme->vcache.size;
+}
+
+
+/**
+ * Shade only the fetch elements which aren't in the cache, at the start of
+ * the vertex array, and copy the cached ones after them.  The draw elements
+ * are remapped to the new order.
+ */
+static void
+llvm_middle_end_run_cached(struct llvm_middle_end *fpme,
+                           const struct draw_fetch_info *fetch_info,
+                           const struct draw_prim_info *prim_info)
+{
+   struct draw_context *draw = fpme->draw;
+   const unsigned vertex_size = fpme->vertex_size;
+   int *slots = fpme->vcache.slots;
+   unsigned *miss_elts = fpme->vcache.miss_elts;
+   ushort *draw_elts = fpme->vcache.draw_elts;
+   struct draw_fetch_info miss_info = *fetch_info;
+   struct draw_prim_info cached_prim_info = *prim_info;
+   struct llvm_shade_job job;
+   unsigned num_misses = 0, num_hits = 0;
+   boolean clipped = FALSE;
+   char *verts;
+   unsigned i;
+
+   for (i = 0; i < fetch_info->count; i++) {
+      slots[i] = llvm_vcache_lookup(fpme, fetch_info->elts[i]);
+      if (slots[i] < 0)
+         miss_elts[num_misses++] = fetch_info->elts[i];
+   }
+
+   miss_info.elts = miss_elts;
+   cached_prim_info.elts = draw_elts;
+
+   llvm_collect_statistics(draw, prim_info, num_misses);
+   fpme->vcache.lookups += fetch_info->count;
+   fpme->vcache.hits += fetch_info->count - num_misses;
+
+   if (!llvm_shade_job_init(&job, fpme, &miss_info, &cached_prim_info))
+      return;
+
+   if (num_misses) {
+      job.fetch_info.count = num_misses;
+      llvm_shade_job_run(&job, 0);
+   }
+
+   /* The shader may write past the misses, copy the hits afterwards. */
+   verts = (char *) job.vert_info.verts;
+   for (i = 0; i < fetch_info->count; i++) {
+      if (slots[i] < 0) {
+         slots[i] = i - num_hits;
+      }
+      else {
+         memcpy(verts + (num_misses + num_hits) * vertex_size,
+                fpme->vcache.verts + slots[i] * vertex_size, vertex_size);
+         clipped |= fpme->vcache.clipped[slots[i]];
+         slots[i] = num_misses + num_hits++;
+      }
+   }
+
+   for (i = 0; i < num_misses; i++)
+      llvm_vcache_insert(fpme, miss_elts[i],
+                         (struct vertex_header *) (verts + i * vertex_size),
+                         job.clipped);
+
+   for (i = 0; i < prim_info->count; i++)
+      draw_elts[i] = slots[prim_info->elts[i]];
+
+   job.clipped |= clipped;
+   llvm_pipeline_draw(fpme, &job);
+}
+
+
 static inline unsigned
 prim_type(unsigned prim, unsigned flags)
 {
@@ -531,6 +889,13 @@ llvm_middle_end_run(struct draw_pt_middle_end *middle,
    prim_info.primitive_count = 1;
    prim_info.primitive_lengths = &draw_count;
 
+   if (fpme->vcache.enabled &&
+       fetch_count <= LLVM_VCACHE_MAX_FETCH &&
+       draw_count <= LLVM_VCACHE_MAX_FETCH) {
+      llvm_middle_end_run_cached(fpme, &fetch_info, &prim_info);
+      return;
+   }
+
    llvm_pipeline_generic( middle, &fetch_info, &prim_info );
 }
 
@@ -595,10 +960,88 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
 }
 
 
+/**
+ * Enable the vertex cache for a draw of "count" vertices, and empty it.
+ */
+static void
+llvm_middle_end_begin_vcache(struct llvm_middle_end *fpme, unsigned count)
+{
+   const unsigned verts_size = fpme->vcache.size * fpme->vertex_size;
+
+   fpme->vcache.enabled = FALSE;
+   if (count <= LLVM_VCACHE_MIN_VERTICES || !fpme->vcache.size)
+      return;
+
+   if (fpme->vcache.verts_size < verts_size) {
+      FREE(fpme->vcache.verts);
+      fpme->vcache.verts = MALLOC(verts_size);
+      if (!fpme->vcache.verts) {
+         fpme->vcache.verts_size = 0;
+         return;
+      }
+      fpme->vcache.verts_size = verts_size;
+   }
+
+   memset(fpme->vcache.buckets, 0xff,
+          (fpme->vcache.bucket_mask + 1) * sizeof(int));
+   fpme->vcache.count = 0;
+   fpme->vcache.next = 0;
+   fpme->vcache.lookups = 0;
+   fpme->vcache.hits = 0;
+   fpme->vcache.enabled = TRUE;
+}
+
+
+static void
+llvm_middle_end_begin_draw(struct draw_pt_middle_end *middle,
+                           unsigned count)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   fpme->parallel = FALSE;
+   fpme->vcache.enabled = FALSE;
+
+   /* The cache needs the shaded vertices of each chunk before the next one
+    * is handed over, the threads shade the chunks without it.
+    */
+   if (count < LLVM_PARALLEL_MIN_VERTICES || !fpme->num_threads) {
+      llvm_middle_end_begin_vcache(fpme, count);
+      return;
+   }
+
+   if (!util_queue_is_initialized(&fpme->queue) &&
+       !util_queue_init(&fpme->queue, "draw_vs", LLVM_MAX_JOBS,
+                        fpme->num_threads, 0)) {
+      fpme->num_threads = 0;
+      llvm_middle_end_begin_vcache(fpme, count);
+      return;
+   }
+
+   fpme->parallel = TRUE;
+}
+
+
+static void
+llvm_middle_end_end_draw(struct draw_pt_middle_end *middle)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+
+   /* The parameters bound to the jit context may change after the draw. */
+   llvm_middle_end_finish_jobs(fpme);
+   fpme->parallel = FALSE;
+
+   if (fpme->vcache.enabled && (gallivm_debug & GALLIVM_DEBUG_PERF)) {
+      debug_printf("draw: vertex cache hits %u of %u vertices\n",
+                   fpme->vcache.hits, fpme->vcache.lookups);
+   }
+   fpme->vcache.enabled = FALSE;
+}
+
+
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   llvm_middle_end_finish_jobs(llvm_middle_end(middle));
 }
 
 
@@ -607,6 +1050,11 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
 
+   if (util_queue_is_initialized(&fpme->queue)) {
+      llvm_middle_end_finish_jobs(fpme);
+      util_queue_destroy(&fpme->queue);
+   }
+
    if (fpme->fetch)
       draw_pt_fetch_destroy( fpme->fetch );
 
@@ -619,6 +1067,12 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
    if (fpme->post_vs)
       draw_pt_post_vs_destroy( fpme->post_vs );
 
+   FREE(fpme->vcache.elts);
+   FREE(fpme->vcache.chain);
+   FREE(fpme->vcache.buckets);
+   FREE(fpme->vcache.clipped);
+   FREE(fpme->vcache.verts);
+
    FREE(middle);
 }
 
@@ -640,6 +1094,8 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    fpme->base.run             = llvm_middle_end_run;
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
+   fpme->base.begin_draw      = llvm_middle_end_begin_draw;
+   fpme->base.end_draw        = llvm_middle_end_end_draw;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
@@ -667,6 +1123,30 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
 
    fpme->current_variant = NULL;
 
+   fpme->num_threads =
+      debug_get_num_option("DRAW_NUM_THREADS",
+                           MIN2(util_cpu_caps.nr_cpus, LLVM_MAX_THREADS));
+   fpme->num_threads = MIN2(fpme->num_threads, LLVM_MAX_THREADS);
+   if (util_cpu_caps.nr_cpus == 1)
+      fpme->num_threads = 0;
+
+   fpme->vcache.size = debug_get_num_option("DRAW_VERTEX_CACHE_SIZE",
+                                            LLVM_VCACHE_DEFAULT_SIZE);
+   fpme->vcache.size = MIN2(fpme->vcache.size, LLVM_VCACHE_MAX_SIZE);
+   if (fpme->vcache.size) {
+      const unsigned num_buckets =
+         util_next_power_of_two(2 * fpme->vcache.size);
+
+      fpme->vcache.elts = MALLOC(fpme->vcache.size * sizeof(unsigned));
+      fpme->vcache.chain = MALLOC(fpme->vcache.size * sizeof(int));
+      fpme->vcache.clipped = MALLOC(fpme->vcache.size * sizeof(boolean));
+      fpme->vcache.buckets = MALLOC(num_buckets * sizeof(int));
+      fpme->vcache.bucket_mask = num_buckets - 1;
+      if (!fpme->vcache.elts || !fpme->vcache.chain ||
+          !fpme->vcache.clipped || !fpme->vcache.buckets)
+         goto fail;
+   }
+
    return &fpme->base;
 
  fail:
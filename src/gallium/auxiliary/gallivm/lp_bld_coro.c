@@ -0,0 +1,260 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER(S) AND/OR ITS SUPPLIERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+#include "lp_bld_coro.h"
+
+#if GALLIVM_HAVE_CORO
+
+#include "lp_bld_const.h"
+#include "lp_bld_flow.h"
+#include "lp_bld_intr.h"
+
+
+/** Alignment of the coroutine frames, enough for any vector we spill */
+#define LP_CORO_FRAME_ALIGN 64
+
+
+static LLVMTypeRef
+coro_hdl_type(struct gallivm_state *gallivm)
+{
+   return LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+}
+
+
+/**
+ * Build llvm.coro.id, identifying the coroutine in its function.
+ *
+ * A null promise and null function table mark the coroutine as not yet
+ * split, so that the coroutine lowering passes will pick it up.
+ */
+LLVMValueRef
+lp_build_coro_id(struct gallivm_state *gallivm)
+{
+   LLVMValueRef args[4];
+
+   args[0] = lp_build_const_int32(gallivm, 0);
+   args[1] = LLVMConstPointerNull(coro_hdl_type(gallivm));
+   args[2] = args[1];
+   args[3] = args[1];
+
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.id",
+                             LLVMTokenTypeInContext(gallivm->context),
+                             args, 4, 0);
+}
+
+
+/**
+ * Size in bytes of the coroutine frame, only known after splitting.
+ */
+LLVMValueRef
+lp_build_coro_size(struct gallivm_state *gallivm)
+{
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.size.i32",
+                             LLVMInt32TypeInContext(gallivm->context),
+                             NULL, 0, 0);
+}
+
+
+LLVMValueRef
+lp_build_coro_begin(struct gallivm_state *gallivm,
+                    LLVMValueRef coro_id, LLVMValueRef mem_ptr)
+{
+   LLVMValueRef args[2];
+
+   args[0] = coro_id;
+   args[1] = mem_ptr;
+
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.begin",
+                             coro_hdl_type(gallivm), args, 2, 0);
+}
+
+
+LLVMValueRef
+lp_build_coro_free(struct gallivm_state *gallivm,
+                   LLVMValueRef coro_id, LLVMValueRef coro_hdl)
+{
+   LLVMValueRef args[2];
+
+   args[0] = coro_id;
+   args[1] = coro_hdl;
+
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.free",
+                             coro_hdl_type(gallivm), args, 2, 0);
+}
+
+
+void
+lp_build_coro_end(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   LLVMValueRef args[2];
+
+   args[0] = coro_hdl;
+   args[1] = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context), 0, 0);
+
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.end",
+                      LLVMInt1TypeInContext(gallivm->context),
+                      args, 2, 0);
+}
+
+
+void
+lp_build_coro_resume(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.resume",
+                      LLVMVoidTypeInContext(gallivm->context),
+                      &coro_hdl, 1, 0);
+}
+
+
+void
+lp_build_coro_destroy(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   lp_build_intrinsic(gallivm->builder, "llvm.coro.destroy",
+                      LLVMVoidTypeInContext(gallivm->context),
+                      &coro_hdl, 1, 0);
+}
+
+
+/**
+ * Whether the coroutine reached its final suspend point.
+ *
+ * Only valid for coroutines which have a final suspend point, see
+ * lp_build_coro_suspend_switch.
+ */
+LLVMValueRef
+lp_build_coro_done(struct gallivm_state *gallivm, LLVMValueRef coro_hdl)
+{
+   return lp_build_intrinsic(gallivm->builder, "llvm.coro.done",
+                             LLVMInt1TypeInContext(gallivm->context),
+                             &coro_hdl, 1, 0);
+}
+
+
+/**
+ * Suspend the coroutine.
+ *
+ * Control continues in resume_block when the coroutine is resumed, or in
+ * sus_info->cleanup when it is destroyed. The final suspend point has no
+ * resume block, as resuming a finished coroutine is undefined.
+ */
+void
+lp_build_coro_suspend_switch(struct gallivm_state *gallivm,
+                             const struct lp_build_coro_suspend_info *sus_info,
+                             LLVMBasicBlockRef resume_block,
+                             boolean final_suspend)
+{
+   LLVMTypeRef i8_type = LLVMInt8TypeInContext(gallivm->context);
+   LLVMValueRef args[2];
+   LLVMValueRef suspend_val, sw;
+
+   args[0] = LLVMConstNull(LLVMTokenTypeInContext(gallivm->context));
+   args[1] = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context),
+                          final_suspend, 0);
+   suspend_val = lp_build_intrinsic(gallivm->builder, "llvm.coro.suspend",
+                                    i8_type, args, 2, 0);
+
+   /* -1 (default): suspended, 0: resumed, 1: destroyed */
+   sw = LLVMBuildSwitch(gallivm->builder, suspend_val, sus_info->suspend,
+                        resume_block ? 2 : 1);
+   LLVMAddCase(sw, LLVMConstInt(i8_type, 1, 0), sus_info->cleanup);
+   if (resume_block)
+      LLVMAddCase(sw, LLVMConstInt(i8_type, 0, 0), resume_block);
+}
+
+
+/**
+ * Allocate the coroutine frame and return the coroutine handle.
+ *
+ * The frame holds spilled vectors, which need more alignment than malloc
+ * guarantees, so over-allocate and keep the pointer malloc returned right
+ * before the aligned frame.  Unlike calling an aligned allocator through a
+ * function pointer this keeps the code cacheable.
+ */
+LLVMValueRef
+lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm,
+                              LLVMValueRef coro_id)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef i8_type = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef mem_ptr_type = LLVMPointerType(i8_type, 0);
+   LLVMTypeRef int_ptr_type =
+      LLVMIntTypeInContext(gallivm->context, 8 * sizeof(void *));
+   LLVMValueRef minus_one = lp_build_const_int32(gallivm, -1);
+   LLVMValueRef coro_size, alloc_mem, frame, slot;
+
+   coro_size = lp_build_coro_size(gallivm);
+   coro_size = LLVMBuildAdd(builder, coro_size,
+                            lp_build_const_int32(gallivm, LP_CORO_FRAME_ALIGN +
+                                                 sizeof(void *)), "");
+   alloc_mem = LLVMBuildArrayMalloc(builder, i8_type, coro_size, "coro_mem");
+
+   frame = LLVMBuildPtrToInt(builder, alloc_mem, int_ptr_type, "");
+   frame = LLVMBuildAdd(builder, frame,
+                        LLVMConstInt(int_ptr_type, sizeof(void *) +
+                                     LP_CORO_FRAME_ALIGN - 1, 0), "");
+   frame = LLVMBuildAnd(builder, frame,
+                        LLVMConstInt(int_ptr_type,
+                                     ~(uint64_t)(LP_CORO_FRAME_ALIGN - 1), 0),
+                        "");
+   frame = LLVMBuildIntToPtr(builder, frame, mem_ptr_type, "coro_frame");
+
+   slot = LLVMBuildBitCast(builder, frame,
+                           LLVMPointerType(mem_ptr_type, 0), "");
+   slot = LLVMBuildGEP(builder, slot, &minus_one, 1, "");
+   LLVMBuildStore(builder, alloc_mem, slot);
+
+   return lp_build_coro_begin(gallivm, coro_id, frame);
+}
+
+
+/**
+ * Free the frame allocated by lp_build_coro_begin_alloc_mem.
+ */
+void
+lp_build_coro_free_mem(struct gallivm_state *gallivm,
+                       LLVMValueRef coro_id, LLVMValueRef coro_hdl)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef mem_ptr_type =
+      LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   LLVMValueRef minus_one = lp_build_const_int32(gallivm, -1);
+   LLVMValueRef frame, slot, alloc_mem;
+   struct lp_build_if_state ifthen;
+
+   /* null when the frame allocation got elided */
+   frame = lp_build_coro_free(gallivm, coro_id, coro_hdl);
+
+   lp_build_if(&ifthen, gallivm,
+               LLVMBuildIsNotNull(builder, frame, ""));
+   slot = LLVMBuildBitCast(builder, frame,
+                           LLVMPointerType(mem_ptr_type, 0), "");
+   slot = LLVMBuildGEP(builder, slot, &minus_one, 1, "");
+   alloc_mem = LLVMBuildLoad(builder, slot, "coro_mem");
+   LLVMBuildFree(builder, alloc_mem);
+   lp_build_endif(&ifthen);
+}
+
+#endif /* GALLIVM_HAVE_CORO */
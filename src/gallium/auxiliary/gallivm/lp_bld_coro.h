@@ -0,0 +1,102 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER(S) AND/OR ITS SUPPLIERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Helpers for building LLVM switched-resume coroutines.
+ *
+ * Coroutines let a shader invocation suspend in the middle of its body
+ * (e.g. at a compute shader barrier) and be resumed later, so that all
+ * the invocations of a work group can be stepped in lockstep on a single
+ * thread. They require the coroutine lowering passes, which are only
+ * available through the C API since LLVM 8, see GALLIVM_HAVE_CORO.
+ */
+
+#ifndef LP_BLD_CORO_H
+#define LP_BLD_CORO_H
+
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
+
+
+/**
+ * The blocks every suspend point of a coroutine branches to.
+ */
+struct lp_build_coro_suspend_info
+{
+   /** Returns the coroutine handle to the caller (coro.end). */
+   LLVMBasicBlockRef suspend;
+   /** Frees the coroutine frame when destroyed (coro.free). */
+   LLVMBasicBlockRef cleanup;
+};
+
+
+LLVMValueRef
+lp_build_coro_id(struct gallivm_state *gallivm);
+
+LLVMValueRef
+lp_build_coro_size(struct gallivm_state *gallivm);
+
+LLVMValueRef
+lp_build_coro_begin(struct gallivm_state *gallivm,
+                    LLVMValueRef coro_id, LLVMValueRef mem_ptr);
+
+LLVMValueRef
+lp_build_coro_free(struct gallivm_state *gallivm,
+                   LLVMValueRef coro_id, LLVMValueRef coro_hdl);
+
+void
+lp_build_coro_end(struct gallivm_state *gallivm,
+                  LLVMValueRef coro_hdl);
+
+void
+lp_build_coro_resume(struct gallivm_state *gallivm,
+                     LLVMValueRef coro_hdl);
+
+void
+lp_build_coro_destroy(struct gallivm_state *gallivm,
+                      LLVMValueRef coro_hdl);
+
+LLVMValueRef
+lp_build_coro_done(struct gallivm_state *gallivm,
+                   LLVMValueRef coro_hdl);
+
+void
+lp_build_coro_suspend_switch(struct gallivm_state *gallivm,
+                             const struct lp_build_coro_suspend_info *sus_info,
+                             LLVMBasicBlockRef resume_block,
+                             boolean final_suspend);
+
+LLVMValueRef
+lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm,
+                              LLVMValueRef coro_id);
+
+void
+lp_build_coro_free_mem(struct gallivm_state *gallivm,
+                       LLVMValueRef coro_id, LLVMValueRef coro_hdl);
+
+
+#endif /* LP_BLD_CORO_H */
@@ -858,3 +858,174 @@ lp_build_fetch_rgba_soa(struct gallivm_state *gallivm,
       convert_to_soa(gallivm, aos_fetch, rgba_out, type);
    }
 }
+
+
+/**
+ * Pack a channel value into the bits of the given format channel, the
+ * inverse of lp_build_extract_soa_chan().
+ *
+ * Returns the value in the low bits of a 32 bit integer vector.
+ */
+static LLVMValueRef
+lp_build_pack_soa_chan(struct lp_build_context *bld,
+                       struct util_format_channel_description chan_desc,
+                       LLVMValueRef rgba)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type type = bld->type;
+   struct lp_type int_type = lp_int_type(type);
+   LLVMTypeRef int_vec_type = lp_build_vec_type(gallivm, int_type);
+   const unsigned width = chan_desc.size;
+   LLVMValueRef output;
+
+   switch(chan_desc.type) {
+   case UTIL_FORMAT_TYPE_UNSIGNED:
+      if (chan_desc.pure_integer) {
+         struct lp_build_context uint_bld;
+         lp_build_context_init(&uint_bld, gallivm, lp_uint_type(type));
+         output = LLVMBuildBitCast(builder, rgba, uint_bld.vec_type, "");
+         if (width < 32) {
+            output = lp_build_min(&uint_bld, output,
+                                  lp_build_const_int_vec(gallivm, uint_bld.type,
+                                                         (1u << width) - 1));
+         }
+      }
+      else {
+         assert(type.floating);
+         assert(chan_desc.normalized);
+         output = lp_build_clamp_zero_one_nanzero(bld, rgba);
+         output = lp_build_clamped_float_to_unsigned_norm(gallivm, type,
+                                                          width, output);
+      }
+      break;
+
+   case UTIL_FORMAT_TYPE_SIGNED:
+      if (chan_desc.pure_integer) {
+         struct lp_build_context int_bld;
+         lp_build_context_init(&int_bld, gallivm, int_type);
+         output = LLVMBuildBitCast(builder, rgba, int_vec_type, "");
+         if (width < 32) {
+            int max = (1 << (width - 1)) - 1;
+            output = lp_build_clamp(&int_bld, output,
+                                    lp_build_const_int_vec(gallivm, int_type,
+                                                           -max - 1),
+                                    lp_build_const_int_vec(gallivm, int_type,
+                                                           max));
+         }
+      }
+      else {
+         double scale = (1 << (width - 1)) - 1;
+         assert(type.floating);
+         assert(chan_desc.normalized);
+         output = lp_build_clamp(bld, rgba,
+                                 lp_build_const_vec(gallivm, type, -1.0),
+                                 bld->one);
+         output = lp_build_mul(bld, output,
+                               lp_build_const_vec(gallivm, type, scale));
+         output = lp_build_iround(bld, output);
+      }
+      break;
+
+   case UTIL_FORMAT_TYPE_FLOAT:
+      assert(type.floating);
+      if (width == 16) {
+         output = lp_build_float_to_half(gallivm, rgba);
+         output = LLVMBuildZExt(builder, output, int_vec_type, "");
+      }
+      else {
+         assert(width == 32);
+         output = LLVMBuildBitCast(builder, rgba, int_vec_type, "");
+      }
+      break;
+
+   default:
+      assert(0);
+      output = lp_build_zero(gallivm, int_type);
+      break;
+   }
+
+   /* drop the sign bits of negative values */
+   if (width < 32) {
+      output = LLVMBuildAnd(builder, output,
+                            lp_build_const_int_vec(gallivm, int_type,
+                                                   (1u << width) - 1), "");
+   }
+
+   return LLVMBuildBitCast(builder, output, int_vec_type, "");
+}
+
+
+/**
+ * Pack SoA rgba values into pixels of the given format, the inverse of
+ * lp_build_unpack_rgba_soa().
+ *
+ * It handles plain formats whose channels each fit in a 32 bit word, plus
+ * R11G11B10_FLOAT.
+ *
+ * \param type     the type of rgba_in: float for normalized and float
+ *                 formats, 32 bit (u)int for pure integer formats
+ * \param packed   returns the pixels as 32 bit integer vectors, one for
+ *                 every dword of the pixel (pixels smaller than a dword
+ *                 are returned in the low bits of packed[0])
+ */
+void
+lp_build_pack_rgba_soa(struct gallivm_state *gallivm,
+                       const struct util_format_description *format_desc,
+                       struct lp_type type,
+                       const LLVMValueRef rgba_in[4],
+                       LLVMValueRef packed[4])
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type int_type = lp_int_type(type);
+   struct lp_build_context bld;
+   unsigned num_dwords = MAX2(format_desc->block.bits / 32, 1);
+   unsigned chan, i;
+
+   assert(type.width == 32);
+
+   if (format_desc->format == PIPE_FORMAT_R11G11B10_FLOAT) {
+      LLVMValueRef rgb[3] = { rgba_in[0], rgba_in[1], rgba_in[2] };
+      packed[0] = lp_build_float_to_r11g11b10(gallivm, rgb);
+      return;
+   }
+
+   assert(format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN);
+   assert(format_desc->block.width == 1);
+   assert(format_desc->block.height == 1);
+   assert(format_desc->block.bits <= 128);
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   for (i = 0; i < num_dwords; i++)
+      packed[i] = lp_build_zero(gallivm, int_type);
+
+   for (chan = 0; chan < format_desc->nr_channels; ++chan) {
+      struct util_format_channel_description chan_desc =
+         format_desc->channel[chan];
+      unsigned dword = chan_desc.shift / 32;
+      unsigned shift = chan_desc.shift % 32;
+      LLVMValueRef output;
+
+      if (chan_desc.type == UTIL_FORMAT_TYPE_VOID)
+         continue;
+
+      /* find the rgba component this channel is read back as */
+      for (i = 0; i < 4; i++) {
+         if (format_desc->swizzle[i] == chan)
+            break;
+      }
+      if (i == 4)
+         continue;
+
+      assert(shift + chan_desc.size <= 32);
+
+      output = lp_build_pack_soa_chan(&bld, chan_desc, rgba_in[i]);
+      if (shift) {
+         output = LLVMBuildShl(builder, output,
+                               lp_build_const_int_vec(gallivm, int_type, shift),
+                               "");
+      }
+      packed[dword] = LLVMBuildOr(builder, packed[dword], output, "");
+   }
+}
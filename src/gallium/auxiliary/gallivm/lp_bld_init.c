@@ -43,6 +43,10 @@
 #if HAVE_LLVM >= 0x0700
 #include <llvm-c/Transforms/Utils.h>
 #endif
+#if GALLIVM_HAVE_CORO
+#include <llvm-c/Transforms/Coroutines.h>
+#include <llvm-c/Transforms/IPO.h>
+#endif
 #include <llvm-c/BitWriter.h>
 
 
@@ -117,6 +121,17 @@ create_pass_manager(struct gallivm_state *gallivm)
    gallivm->passmgr = LLVMCreateFunctionPassManagerForModule(gallivm->module);
    if (!gallivm->passmgr)
       return FALSE;
+
+#if GALLIVM_HAVE_CORO
+   /*
+    * Coroutine lowering is not optional, so the lowering passes run even
+    * with GALLIVM_DEBUG_NO_OPT. CoroSplit is a call graph pass and needs to be
+    * scheduled together with other call graph passes to be iterated.
+    */
+   gallivm->cgpassmgr = LLVMCreatePassManager();
+   if (!gallivm->cgpassmgr)
+      return FALSE;
+#endif
    /*
     * TODO: some per module pass manager with IPO passes might be helpful -
     * the generated texture functions may benefit from inlining if they are
@@ -170,6 +185,21 @@ create_pass_manager(struct gallivm_state *gallivm)
       LLVMAddPromoteMemoryToRegisterPass(gallivm->passmgr);
    }
 
+#if GALLIVM_HAVE_CORO
+   if (!(gallivm_debug & GALLIVM_DEBUG_NO_OPT)) {
+      LLVMAddArgumentPromotionPass(gallivm->cgpassmgr);
+      LLVMAddFunctionAttrsPass(gallivm->cgpassmgr);
+   }
+   LLVMAddCoroEarlyPass(gallivm->cgpassmgr);
+   LLVMAddCoroSplitPass(gallivm->cgpassmgr);
+   /* CoroElide also devirtualizes the restart trigger CoroSplit leaves
+    * behind, which is what makes the call graph pass manager revisit the
+    * coroutine and split it for real, so it can't be skipped either.
+    */
+   LLVMAddCoroElidePass(gallivm->cgpassmgr);
+   LLVMAddCoroCleanupPass(gallivm->passmgr);
+#endif
+
    return TRUE;
 }
 
@@ -185,6 +215,10 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposePassManager(gallivm->passmgr);
    }
 
+   if (gallivm->cgpassmgr) {
+      LLVMDisposePassManager(gallivm->cgpassmgr);
+   }
+
    if (gallivm->engine) {
       /* This will already destroy any associated module */
       LLVMDisposeExecutionEngine(gallivm->engine);
@@ -192,6 +226,15 @@ gallivm_free_ir(struct gallivm_state *gallivm)
       LLVMDisposeModule(gallivm->module);
    }
 
+   /* No more code gets generated, so the object cache and the caller's
+    * lp_cached_code it refers to are not needed anymore.
+    */
+   if (gallivm->objcache) {
+      lp_free_objcache(gallivm->objcache);
+      gallivm->objcache = NULL;
+   }
+   gallivm->cache = NULL;
+
    FREE(gallivm->module_name);
 
    if (!use_mcjit) {
@@ -212,6 +255,7 @@ gallivm_free_ir(struct gallivm_state *gallivm)
    gallivm->module = NULL;
    gallivm->module_name = NULL;
    gallivm->passmgr = NULL;
+   gallivm->cgpassmgr = NULL;
    gallivm->context = NULL;
    gallivm->builder = NULL;
 }
@@ -249,6 +293,8 @@ init_gallivm_engine(struct gallivm_state *gallivm)
 
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
+                                                    gallivm->cache,
+                                                    &gallivm->objcache,
                                                     gallivm->module,
                                                     gallivm->memorymgr,
                                                     (unsigned) optlevel,
@@ -301,7 +347,7 @@ fail:
  */
 static boolean
 init_gallivm_state(struct gallivm_state *gallivm, const char *name,
-                   LLVMContextRef context)
+                   LLVMContextRef context, struct lp_cached_code *cache)
 {
    assert(!gallivm->context);
    assert(!gallivm->module);
@@ -310,6 +356,7 @@ init_gallivm_state(struct gallivm_state *gallivm, const char *name,
       return FALSE;
 
    gallivm->context = context;
+   gallivm->cache = cache;
 
    if (!gallivm->context)
       goto fail;
@@ -509,15 +556,18 @@ lp_build_init(void)
 
 /**
  * Create a new gallivm_state object.
+ * \param cache  optional cached object code, see struct lp_cached_code;
+ *               it is referenced until gallivm_free_ir() is called
  */
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context)
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache)
 {
    struct gallivm_state *gallivm;
 
    gallivm = CALLOC_STRUCT(gallivm_state);
    if (gallivm) {
-      if (!init_gallivm_state(gallivm, name, context)) {
+      if (!init_gallivm_state(gallivm, name, context, cache)) {
          FREE(gallivm);
          gallivm = NULL;
       }
@@ -597,9 +647,19 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    "[-mattr=<-mattr option(s)>]");
    }
 
+   /* The object code is going to come from the cache, no point in
+    * optimizing the IR.
+    */
+   if (gallivm->cache && gallivm->cache->data_size)
+      goto skip_cached;
+
    if (gallivm_debug & GALLIVM_DEBUG_PERF)
       time_begin = os_time_get();
 
+   /* Lower coroutines, which also creates their resume/destroy functions */
+   if (gallivm->cgpassmgr)
+      LLVMRunPassManager(gallivm->cgpassmgr, gallivm->module);
+
    /* Run optimization passes */
    LLVMInitializeFunctionPassManager(gallivm->passmgr);
    func = LLVMGetFirstFunction(gallivm->module);
@@ -630,6 +690,8 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    gallivm->module_name, time_msec);
    }
 
+skip_cached:
+
    if (use_mcjit) {
       /* Setting the module's DataLayout to an empty string will cause the
        * ExecutionEngine to copy to the DataLayout string from its target
@@ -39,6 +39,27 @@
 extern "C" {
 #endif
 
+/**
+ * Coroutines (used for compute shader barriers) need the coroutine lowering
+ * passes, which the C API only exposes since LLVM 8.
+ */
+#define GALLIVM_HAVE_CORO (HAVE_LLVM >= 0x0800)
+
+/**
+ * Object code of a compiled module, used for caching shaders on disk.
+ *
+ * If data_size is non-zero when the module is compiled, the object code in
+ * data is loaded instead of generating code from the IR.  Otherwise the
+ * generated object code is returned in data, unless dont_cache got set
+ * while building the IR (e.g. because it embeds process-local pointers).
+ */
+struct lp_cached_code {
+   void *data;
+   size_t data_size;
+   boolean dont_cache;
+};
+
+
 struct gallivm_state
 {
    char *module_name;
@@ -46,10 +67,13 @@ struct gallivm_state
    LLVMExecutionEngineRef engine;
    LLVMTargetDataRef target;
    LLVMPassManagerRef passmgr;
+   LLVMPassManagerRef cgpassmgr;
    LLVMContextRef context;
    LLVMBuilderRef builder;
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
+   struct lp_cached_code *cache;
+   void *objcache;
    unsigned compiled;
 };
 
@@ -59,7 +83,8 @@ lp_build_init(void);
 
 
 struct gallivm_state *
-gallivm_create(const char *name, LLVMContextRef context);
+gallivm_create(const char *name, LLVMContextRef context,
+               struct lp_cached_code *cache);
 
 void
 gallivm_destroy(struct gallivm_state *gallivm);
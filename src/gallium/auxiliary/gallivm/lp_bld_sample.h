@@ -49,6 +49,7 @@ extern "C" {
 struct pipe_resource;
 struct pipe_sampler_view;
 struct pipe_sampler_state;
+struct pipe_image_view;
 struct util_format_description;
 struct lp_type;
 struct lp_build_context;
@@ -122,6 +123,31 @@ struct lp_sampler_size_query_params
    LLVMValueRef explicit_lod;
    LLVMValueRef *sizes_out;
 };
+
+/**
+ * Shader image operations.
+ */
+enum lp_img_op {
+   LP_IMG_LOAD,
+   LP_IMG_STORE,
+   LP_IMG_ATOMIC,
+   LP_IMG_ATOMIC_CAS
+};
+
+struct lp_img_params
+{
+   struct lp_type type;
+   unsigned image_index;
+   enum lp_img_op img_op;
+   unsigned target;             /**< PIPE_TEXTURE_x, from the instruction */
+   LLVMAtomicRMWBinOp op;       /**< for LP_IMG_ATOMIC */
+   LLVMValueRef exec_mask;
+   LLVMValueRef context_ptr;
+   const LLVMValueRef *coords;  /**< integer x, y, z/layer */
+   LLVMValueRef indata[4];      /**< values to store, atomic operand in x */
+   LLVMValueRef indata2[4];     /**< value to compare to in x, for CAS */
+   LLVMValueRef *outdata;       /**< loaded values, or values before atomics */
+};
 /**
  * Texture static state.
  *
@@ -226,7 +252,12 @@ struct lp_sampler_dynamic_state
                  LLVMValueRef context_ptr,
                  unsigned texture_unit);
 
-   /** Obtain stride in bytes between image rows/blocks (returns int32) */
+   /**
+    * Obtain stride in bytes between image rows/blocks (returns int32)
+    *
+    * For textures these two return the address of the per level stride
+    * arrays, for shader images the strides of the bound level themselves.
+    */
    LLVMValueRef
    (*row_stride)(const struct lp_sampler_dynamic_state *state,
                  struct gallivm_state *gallivm,
@@ -489,6 +520,10 @@ void
 lp_sampler_static_texture_state(struct lp_static_texture_state *state,
                                 const struct pipe_sampler_view *view);
 
+void
+lp_sampler_static_texture_state_image(struct lp_static_texture_state *state,
+                                      const struct pipe_image_view *view);
+
 
 void
 lp_build_lod_selector(struct lp_build_sample_context *bld,
@@ -626,6 +661,12 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                         struct lp_sampler_dynamic_state *dynamic_state,
                         const struct lp_sampler_size_query_params *params);
 
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params);
+
 void
 lp_build_sample_nop(struct gallivm_state *gallivm, 
                     struct lp_type type,
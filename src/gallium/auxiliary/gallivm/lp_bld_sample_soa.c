@@ -3946,3 +3946,247 @@ lp_build_size_query_soa(struct gallivm_state *gallivm,
                                         num_levels);
    }
 }
+
+
+/**
+ * Emit a load, store or atomic operation on a shader image.
+ *
+ * The image is addressed per lane with integer coordinates, which are
+ * bounds checked: out of bounds and inactive lanes load zero, and don't
+ * store anything.  Atomics are only supported on single channel 32 bit
+ * formats.
+ */
+void
+lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
+                    struct lp_sampler_dynamic_state *dynamic_state,
+                    struct gallivm_state *gallivm,
+                    const struct lp_img_params *params)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   const struct util_format_description *format_desc;
+   LLVMValueRef context_ptr = params->context_ptr;
+   unsigned image_unit = params->image_index;
+   unsigned target = params->target;
+   struct lp_type texel_type = params->type;
+   struct lp_type int_type = lp_int_type(params->type);
+   struct lp_build_context int_bld;
+   LLVMValueRef x, y = NULL, z = NULL;
+   LLVMValueRef width, height, depth;
+   LLVMValueRef row_stride = NULL, img_stride = NULL;
+   LLVMValueRef base_ptr, offset, i, j, in_bounds, mask;
+   LLVMValueRef zero_vec = lp_build_zero(gallivm, params->type);
+   unsigned chan;
+
+   lp_build_context_init(&int_bld, gallivm, int_type);
+
+   if (static_texture_state->format == PIPE_FORMAT_NONE) {
+      /* nothing bound */
+      if (params->outdata) {
+         for (chan = 0; chan < 4; chan++)
+            params->outdata[chan] = zero_vec;
+      }
+      return;
+   }
+
+   format_desc = util_format_description(static_texture_state->format);
+
+   if (format_desc->channel[0].pure_integer) {
+      if (format_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED)
+         texel_type = lp_type_int_vec(32, 32 * params->type.length);
+      else
+         texel_type = lp_type_uint_vec(32, 32 * params->type.length);
+   }
+
+   /*
+    * Work out the coordinates.  Layers of arrays and cube faces are
+    * addressed as the slices of a 3D image.
+    */
+   x = params->coords[0];
+   if (target == PIPE_TEXTURE_1D_ARRAY) {
+      z = params->coords[1];
+   }
+   else {
+      if (texture_dims(target) >= 2)
+         y = params->coords[1];
+      if (target == PIPE_TEXTURE_3D || has_layer_coord(target))
+         z = params->coords[2];
+   }
+
+   width = dynamic_state->width(dynamic_state, gallivm,
+                                context_ptr, image_unit);
+   width = lp_build_broadcast_scalar(&int_bld, width);
+   in_bounds = lp_build_compare(gallivm, lp_uint_type(int_type),
+                                PIPE_FUNC_LESS, x, width);
+
+   if (y) {
+      height = dynamic_state->height(dynamic_state, gallivm,
+                                     context_ptr, image_unit);
+      height = lp_build_broadcast_scalar(&int_bld, height);
+      in_bounds = LLVMBuildAnd(builder, in_bounds,
+                               lp_build_compare(gallivm, lp_uint_type(int_type),
+                                                PIPE_FUNC_LESS, y, height),
+                               "");
+      row_stride = dynamic_state->row_stride(dynamic_state, gallivm,
+                                             context_ptr, image_unit);
+      row_stride = lp_build_broadcast_scalar(&int_bld, row_stride);
+   }
+
+   if (z) {
+      depth = dynamic_state->depth(dynamic_state, gallivm,
+                                   context_ptr, image_unit);
+      depth = lp_build_broadcast_scalar(&int_bld, depth);
+      in_bounds = LLVMBuildAnd(builder, in_bounds,
+                               lp_build_compare(gallivm, lp_uint_type(int_type),
+                                                PIPE_FUNC_LESS, z, depth),
+                               "");
+      img_stride = dynamic_state->img_stride(dynamic_state, gallivm,
+                                             context_ptr, image_unit);
+      img_stride = lp_build_broadcast_scalar(&int_bld, img_stride);
+   }
+
+   mask = LLVMBuildAnd(builder, in_bounds,
+                       LLVMBuildBitCast(builder, params->exec_mask,
+                                        int_bld.vec_type, ""), "");
+
+   lp_build_sample_offset(&int_bld, format_desc, x, y, z,
+                          row_stride, img_stride, &offset, &i, &j);
+
+   /* point the out of bounds lanes to the first texel */
+   offset = LLVMBuildAnd(builder, offset, in_bounds, "");
+
+   base_ptr = dynamic_state->base_ptr(dynamic_state, gallivm,
+                                      context_ptr, image_unit);
+
+   if (params->img_op == LP_IMG_LOAD) {
+      LLVMValueRef texel[4];
+
+      lp_build_fetch_rgba_soa(gallivm, format_desc, texel_type, TRUE,
+                              base_ptr, offset, i, j, NULL, texel);
+
+      for (chan = 0; chan < 4; chan++) {
+         LLVMValueRef val = LLVMBuildBitCast(builder, texel[chan],
+                                             int_bld.vec_type, "");
+         val = LLVMBuildAnd(builder, val, mask, "");
+         params->outdata[chan] = LLVMBuildBitCast(builder, val,
+                                                  LLVMTypeOf(zero_vec), "");
+      }
+   }
+   else if (params->img_op == LP_IMG_STORE) {
+      LLVMTypeRef texel_vec_type = lp_build_vec_type(gallivm, texel_type);
+      LLVMValueRef data[4], packed[4];
+      unsigned num_dwords = MAX2(format_desc->block.bits / 32, 1);
+      struct lp_build_loop_state loop_state;
+      struct lp_build_if_state ifthen;
+      LLVMValueRef lane, cond, lane_offset;
+      unsigned dword;
+
+      for (chan = 0; chan < 4; chan++)
+         data[chan] = LLVMBuildBitCast(builder, params->indata[chan],
+                                       texel_vec_type, "");
+
+      lp_build_pack_rgba_soa(gallivm, format_desc, texel_type, data, packed);
+
+      lp_build_loop_begin(&loop_state, gallivm,
+                          lp_build_const_int32(gallivm, 0));
+      lane = loop_state.counter;
+
+      cond = LLVMBuildExtractElement(builder, mask, lane, "");
+      cond = LLVMBuildICmp(builder, LLVMIntNE, cond,
+                           lp_build_const_int32(gallivm, 0), "");
+      lp_build_if(&ifthen, gallivm, cond);
+
+      lane_offset = LLVMBuildExtractElement(builder, offset, lane, "");
+
+      for (dword = 0; dword < num_dwords; dword++) {
+         LLVMValueRef val, ptr;
+         LLVMTypeRef val_type;
+
+         val = LLVMBuildExtractElement(builder, packed[dword], lane, "");
+         if (format_desc->block.bits < 32) {
+            val_type = LLVMIntTypeInContext(gallivm->context,
+                                            format_desc->block.bits);
+            val = LLVMBuildTrunc(builder, val, val_type, "");
+         }
+         else {
+            val_type = LLVMInt32TypeInContext(gallivm->context);
+         }
+
+         ptr = LLVMBuildGEP(builder, base_ptr, &lane_offset, 1, "");
+         ptr = LLVMBuildBitCast(builder, ptr,
+                                LLVMPointerType(val_type, 0), "");
+         if (dword) {
+            LLVMValueRef index = lp_build_const_int32(gallivm, dword);
+            ptr = LLVMBuildGEP(builder, ptr, &index, 1, "");
+         }
+         LLVMBuildStore(builder, val, ptr);
+      }
+
+      lp_build_endif(&ifthen);
+
+      lp_build_loop_end_cond(&loop_state,
+                             lp_build_const_int32(gallivm, int_type.length),
+                             NULL, LLVMIntUGE);
+   }
+   else {
+      LLVMTypeRef i32_type = LLVMInt32TypeInContext(gallivm->context);
+      struct lp_build_loop_state loop_state;
+      struct lp_build_if_state ifthen;
+      LLVMValueRef lane, cond, lane_offset, ptr, val, res, res_ptr;
+
+      if (format_desc->block.bits != 32 || format_desc->nr_channels != 1) {
+         /* not allowed by the APIs */
+         params->outdata[0] = zero_vec;
+         return;
+      }
+
+      res_ptr = lp_build_alloca(gallivm, int_bld.vec_type, "");
+
+      lp_build_loop_begin(&loop_state, gallivm,
+                          lp_build_const_int32(gallivm, 0));
+      lane = loop_state.counter;
+
+      cond = LLVMBuildExtractElement(builder, mask, lane, "");
+      cond = LLVMBuildICmp(builder, LLVMIntNE, cond,
+                           lp_build_const_int32(gallivm, 0), "");
+      lp_build_if(&ifthen, gallivm, cond);
+
+      lane_offset = LLVMBuildExtractElement(builder, offset, lane, "");
+      ptr = LLVMBuildGEP(builder, base_ptr, &lane_offset, 1, "");
+      ptr = LLVMBuildBitCast(builder, ptr, LLVMPointerType(i32_type, 0), "");
+
+      val = LLVMBuildBitCast(builder, params->indata[0], int_bld.vec_type, "");
+      val = LLVMBuildExtractElement(builder, val, lane, "");
+
+      if (params->img_op == LP_IMG_ATOMIC_CAS) {
+         LLVMValueRef cmp;
+
+         cmp = LLVMBuildBitCast(builder, params->indata2[0],
+                                int_bld.vec_type, "");
+         cmp = LLVMBuildExtractElement(builder, cmp, lane, "");
+         val = LLVMBuildAtomicCmpXchg(builder, ptr, cmp, val,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      FALSE);
+         val = LLVMBuildExtractValue(builder, val, 0, "");
+      }
+      else {
+         val = LLVMBuildAtomicRMW(builder, params->op, ptr, val,
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+      }
+
+      res = LLVMBuildLoad(builder, res_ptr, "");
+      res = LLVMBuildInsertElement(builder, res, val, lane, "");
+      LLVMBuildStore(builder, res, res_ptr);
+
+      lp_build_endif(&ifthen);
+
+      lp_build_loop_end_cond(&loop_state,
+                             lp_build_const_int32(gallivm, int_type.length),
+                             NULL, LLVMIntUGE);
+
+      res = LLVMBuildLoad(builder, res_ptr, "");
+      params->outdata[0] = LLVMBuildBitCast(builder, res,
+                                            LLVMTypeOf(zero_vec), "");
+   }
+}
@@ -67,6 +67,7 @@ struct lp_build_mask_context;
 struct gallivm_state;
 struct lp_derivatives;
 struct lp_build_tgsi_gs_iface;
+struct lp_build_tgsi_cs_iface;
 
 
 enum lp_build_tex_modifier {
@@ -170,6 +171,11 @@ struct lp_bld_tgsi_system_values {
    LLVMValueRef prim_id;
    LLVMValueRef basevertex;
    LLVMValueRef invocation_id;
+   /* compute shaders: thread_id is a vector per component, the rest scalars */
+   LLVMValueRef thread_id[3];
+   LLVMValueRef block_id[3];
+   LLVMValueRef block_size[3];
+   LLVMValueRef grid_size[3];
 };
 
 
@@ -198,6 +204,27 @@ struct lp_build_sampler_soa
 };
 
 
+/**
+ * Image code generator, the counterpart of lp_build_sampler_soa for
+ * shader images.
+ */
+struct lp_build_image_soa
+{
+   void
+   (*destroy)( struct lp_build_image_soa *image );
+
+   void
+   (*emit_op)( const struct lp_build_image_soa *image,
+               struct gallivm_state *gallivm,
+               const struct lp_img_params *params );
+
+   void
+   (*emit_size_query)( const struct lp_build_image_soa *image,
+                       struct gallivm_state *gallivm,
+                       const struct lp_sampler_size_query_params *params );
+};
+
+
 struct lp_build_sampler_aos
 {
    LLVMValueRef
@@ -230,7 +257,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface);
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface);
 
 
 void
@@ -430,6 +458,30 @@ struct lp_build_tgsi_gs_iface
                        LLVMValueRef emitted_prims_vec);
 };
 
+/**
+ * Compute shader interface.
+ *
+ * Besides compute shaders proper, nothing here is compute specific:
+ * fragment shaders use it for their shader buffers too, without shared
+ * memory, images nor barriers.
+ */
+struct lp_build_tgsi_cs_iface
+{
+   /** Pointer to the array of shader buffer pointers */
+   LLVMValueRef ssbo_ptr;
+   /** Pointer to the array of shader buffer sizes, in bytes */
+   LLVMValueRef ssbo_sizes_ptr;
+   /** Pointer to the work group's shared memory and its size in bytes */
+   LLVMValueRef shared_ptr;
+   LLVMValueRef shared_size;
+
+   /** Image code generator, optional */
+   const struct lp_build_image_soa *image;
+
+   void (*emit_barrier)(const struct lp_build_tgsi_cs_iface *cs_iface,
+                        struct lp_build_tgsi_context *bld_base);
+};
+
 struct lp_build_tgsi_soa_context
 {
    struct lp_build_tgsi_context bld_base;
@@ -443,6 +495,10 @@ struct lp_build_tgsi_soa_context
    LLVMValueRef emitted_vertices_vec_ptr;
    LLVMValueRef max_output_vertices_vec;
 
+   const struct lp_build_tgsi_cs_iface *cs_iface;
+   LLVMValueRef ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   LLVMValueRef ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
+
    LLVMValueRef consts_ptr;
    LLVMValueRef const_sizes_ptr;
    LLVMValueRef consts[LP_MAX_TGSI_CONST_BUFFERS];
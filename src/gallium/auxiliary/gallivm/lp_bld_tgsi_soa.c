@@ -1650,6 +1650,7 @@ emit_fetch_system_value(
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef res;
    enum tgsi_opcode_type atype; // Actual type of the value
+   unsigned swizzle = swizzle_in & 0xffff;
 
    assert(!reg->Register.Indirect);
 
@@ -1684,6 +1685,39 @@ emit_fetch_system_value(
       atype = TGSI_TYPE_UNSIGNED;
       break;
 
+   case TGSI_SEMANTIC_THREAD_ID:
+      if (swizzle < 3)
+         res = bld->system_values.thread_id[swizzle];
+      else
+         res = bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+
+   case TGSI_SEMANTIC_BLOCK_ID:
+   case TGSI_SEMANTIC_BLOCK_SIZE:
+   case TGSI_SEMANTIC_GRID_SIZE:
+   {
+      const LLVMValueRef *vals;
+
+      switch (info->system_value_semantic_name[reg->Register.Index]) {
+      case TGSI_SEMANTIC_BLOCK_ID:
+         vals = bld->system_values.block_id;
+         break;
+      case TGSI_SEMANTIC_BLOCK_SIZE:
+         vals = bld->system_values.block_size;
+         break;
+      default:
+         vals = bld->system_values.grid_size;
+         break;
+      }
+      if (swizzle < 3)
+         res = lp_build_broadcast_scalar(&bld_base->uint_bld, vals[swizzle]);
+      else
+         res = bld_base->uint_bld.zero;
+      atype = TGSI_TYPE_UNSIGNED;
+      break;
+   }
+
    default:
       assert(!"unexpected semantic in emit_fetch_system_value");
       res = bld_base->base.zero;
@@ -2173,6 +2207,15 @@ emit_tex( struct lp_build_tgsi_soa_context *bld,
       }
       lod_property = lp_build_lod_property(&bld->bld_base, inst, 0);
    }
+   else if (bld->bld_base.info->processor == PIPE_SHADER_COMPUTE &&
+            modifier != LP_BLD_TEX_MODIFIER_EXPLICIT_DERIV) {
+      /*
+       * There are no implicit derivatives in compute shaders, as the
+       * invocations of a vector aren't laid out in quads: use the base level.
+       */
+      lod = bld->bld_base.base.zero;
+      sample_key |= LP_SAMPLER_LOD_EXPLICIT << LP_SAMPLER_LOD_CONTROL_SHIFT;
+   }
 
    if (modifier == LP_BLD_TEX_MODIFIER_PROJECTED) {
       oow = lp_build_emit_fetch(&bld->bld_base, inst, 0, 3);
@@ -2941,6 +2984,21 @@ lp_emit_declaration_soa(
    }
       break;
 
+   case TGSI_FILE_BUFFER:
+      /* Same as for constants, fetch the pointers once upfront. */
+      if (bld->cs_iface) {
+         assert(last < LP_MAX_TGSI_SHADER_BUFFERS);
+         for (idx = first; idx <= last; ++idx) {
+            LLVMValueRef index = lp_build_const_int32(gallivm, idx);
+            bld->ssbos[idx] =
+               lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr, index);
+            bld->ssbo_sizes[idx] =
+               lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr,
+                                  index);
+         }
+      }
+      break;
+
    default:
       /* don't need to declare other vars */
       break;
@@ -3494,6 +3552,601 @@ end_primitive(
    }
 }
 
+/**
+ * Shader buffer or shared memory referenced by a memory instruction.
+ *
+ * Indirectly addressed shader buffers are looked up per lane, in which case
+ * index holds the (clamped) buffer index vector and ptr/size are NULL.
+ */
+struct soa_mem_ref
+{
+   LLVMValueRef ptr;
+   LLVMValueRef size;
+   LLVMValueRef index;
+};
+
+static void
+get_mem_ref(struct lp_build_tgsi_soa_context *bld,
+            unsigned file, unsigned index, boolean indirect,
+            const struct tgsi_ind_register *indirect_reg,
+            struct soa_mem_ref *ref)
+{
+   const struct lp_build_tgsi_cs_iface *cs_iface = bld->cs_iface;
+
+   memset(ref, 0, sizeof *ref);
+
+   if (file == TGSI_FILE_MEMORY) {
+      ref->ptr = cs_iface->shared_ptr;
+      ref->size = cs_iface->shared_size;
+   }
+   else if (indirect) {
+      assert(file == TGSI_FILE_BUFFER);
+      ref->index = get_indirect_index(bld, file, index, indirect_reg);
+   }
+   else {
+      assert(file == TGSI_FILE_BUFFER);
+      assert(index < LP_MAX_TGSI_SHADER_BUFFERS);
+      ref->ptr = bld->ssbos[index];
+      ref->size = bld->ssbo_sizes[index];
+   }
+}
+
+static LLVMValueRef
+emit_fetch_uint(struct lp_build_tgsi_context *bld_base,
+                const struct tgsi_full_instruction *inst,
+                unsigned src_op, unsigned chan)
+{
+   LLVMValueRef val = lp_build_emit_fetch(bld_base, inst, src_op, chan);
+
+   return LLVMBuildBitCast(bld_base->base.gallivm->builder, val,
+                           bld_base->uint_bld.vec_type, "");
+}
+
+static LLVMAtomicRMWBinOp
+atomic_rmw_op(unsigned opcode)
+{
+   switch (opcode) {
+   case TGSI_OPCODE_ATOMUADD:
+      return LLVMAtomicRMWBinOpAdd;
+   case TGSI_OPCODE_ATOMXCHG:
+      return LLVMAtomicRMWBinOpXchg;
+   case TGSI_OPCODE_ATOMAND:
+      return LLVMAtomicRMWBinOpAnd;
+   case TGSI_OPCODE_ATOMOR:
+      return LLVMAtomicRMWBinOpOr;
+   case TGSI_OPCODE_ATOMXOR:
+      return LLVMAtomicRMWBinOpXor;
+   case TGSI_OPCODE_ATOMUMIN:
+      return LLVMAtomicRMWBinOpUMin;
+   case TGSI_OPCODE_ATOMUMAX:
+      return LLVMAtomicRMWBinOpUMax;
+   case TGSI_OPCODE_ATOMIMIN:
+      return LLVMAtomicRMWBinOpMin;
+   case TGSI_OPCODE_ATOMIMAX:
+      return LLVMAtomicRMWBinOpMax;
+   default:
+      assert(0);
+      return LLVMAtomicRMWBinOpAdd;
+   }
+}
+
+/**
+ * Emit a LOAD, STORE or atomic operation on a shader buffer or on shared
+ * memory.
+ *
+ * The lanes can access arbitrary addresses, so this loops over them and
+ * accesses one dword at a time, skipping inactive lanes and out of bounds
+ * accesses (loads then return zero, stores are dropped).
+ *
+ * \param offset     byte offset vector
+ * \param chan_mask  channels to access, at consecutive dwords
+ * \param data       values to store, or the atomic operands (x only)
+ * \param cmp        compare value for ATOMCAS
+ * \param result     loaded values, or the values before the atomic op
+ */
+static void
+emit_mem_access(struct lp_build_tgsi_soa_context *bld,
+                unsigned opcode,
+                const struct soa_mem_ref *ref,
+                LLVMValueRef offset,
+                unsigned chan_mask,
+                const LLVMValueRef *data,
+                LLVMValueRef cmp,
+                LLVMValueRef *result)
+{
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld->bld_base.uint_bld;
+   LLVMValueRef exec_mask = mask_vec(&bld->bld_base);
+   LLVMValueRef res_ptrs[TGSI_NUM_CHANNELS];
+   struct lp_build_loop_state loop_state;
+   LLVMValueRef lane, active, base_ptr, size, num_dwords, first_dword;
+   unsigned chan;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      res_ptrs[chan] = NULL;
+      if (result && (chan_mask & (1 << chan)))
+         res_ptrs[chan] = lp_build_alloca(gallivm, uint_bld->vec_type, "");
+   }
+
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+
+   lane = loop_state.counter;
+   active = LLVMBuildExtractElement(builder, exec_mask, lane, "");
+   active = LLVMBuildICmp(builder, LLVMIntNE, active,
+                          lp_build_const_int32(gallivm, 0), "");
+
+   if (ref->index) {
+      LLVMValueRef buf = LLVMBuildExtractElement(builder, ref->index, lane, "");
+      base_ptr = lp_build_array_get(gallivm, bld->cs_iface->ssbo_ptr, buf);
+      size = lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr, buf);
+   }
+   else {
+      base_ptr = ref->ptr;
+      size = ref->size;
+   }
+
+   num_dwords = LLVMBuildLShr(builder, size,
+                              lp_build_const_int32(gallivm, 2), "");
+   first_dword = LLVMBuildExtractElement(builder, offset, lane, "");
+   first_dword = LLVMBuildLShr(builder, first_dword,
+                               lp_build_const_int32(gallivm, 2), "");
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      struct lp_build_if_state ifthen;
+      LLVMValueRef dword, cond, ptr, val = NULL;
+
+      if (!(chan_mask & (1 << chan)))
+         continue;
+
+      /* first_dword is at most 2^30 - 1, so this cannot wrap around */
+      dword = LLVMBuildAdd(builder, first_dword,
+                           lp_build_const_int32(gallivm, chan), "");
+      cond = LLVMBuildICmp(builder, LLVMIntULT, dword, num_dwords, "");
+      cond = LLVMBuildAnd(builder, cond, active, "");
+
+      lp_build_if(&ifthen, gallivm, cond);
+
+      ptr = LLVMBuildGEP(builder, base_ptr, &dword, 1, "");
+
+      switch (opcode) {
+      case TGSI_OPCODE_LOAD:
+         val = LLVMBuildLoad(builder, ptr, "");
+         break;
+      case TGSI_OPCODE_STORE:
+         LLVMBuildStore(builder,
+                        LLVMBuildExtractElement(builder, data[chan], lane, ""),
+                        ptr);
+         break;
+      case TGSI_OPCODE_ATOMCAS:
+         val = LLVMBuildAtomicCmpXchg(builder, ptr,
+                                      LLVMBuildExtractElement(builder, cmp,
+                                                              lane, ""),
+                                      LLVMBuildExtractElement(builder, data[0],
+                                                              lane, ""),
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      LLVMAtomicOrderingSequentiallyConsistent,
+                                      FALSE);
+         val = LLVMBuildExtractValue(builder, val, 0, "");
+         break;
+      default:
+         val = LLVMBuildAtomicRMW(builder, atomic_rmw_op(opcode), ptr,
+                                  LLVMBuildExtractElement(builder, data[0],
+                                                          lane, ""),
+                                  LLVMAtomicOrderingSequentiallyConsistent,
+                                  FALSE);
+         break;
+      }
+
+      if (res_ptrs[chan]) {
+         LLVMValueRef res = LLVMBuildLoad(builder, res_ptrs[chan], "");
+         res = LLVMBuildInsertElement(builder, res, val, lane, "");
+         LLVMBuildStore(builder, res, res_ptrs[chan]);
+      }
+
+      lp_build_endif(&ifthen);
+   }
+
+   lp_build_loop_end_cond(&loop_state,
+                          lp_build_const_int32(gallivm, uint_bld->type.length),
+                          NULL, LLVMIntUGE);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (res_ptrs[chan])
+         result[chan] = LLVMBuildLoad(builder, res_ptrs[chan], "");
+   }
+}
+
+/**
+ * Get a dynamically uniform resource index, from the active lanes.
+ */
+static LLVMValueRef
+get_uniform_index(struct lp_build_tgsi_soa_context *bld,
+                  unsigned file, unsigned index,
+                  const struct tgsi_ind_register *indirect_reg)
+{
+   struct lp_build_tgsi_context *bld_base = &bld->bld_base;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_build_context *uint_bld = &bld_base->uint_bld;
+   LLVMValueRef index_vec, res;
+   unsigned i;
+
+   /*
+    * The index is dynamically uniform, so with the inactive lanes zeroed,
+    * or'ing all lanes together yields it.
+    */
+   index_vec = get_indirect_index(bld, file, index, indirect_reg);
+   index_vec = LLVMBuildAnd(builder, index_vec, mask_vec(bld_base), "");
+   res = lp_build_const_int32(gallivm, 0);
+   for (i = 0; i < uint_bld->type.length; i++) {
+      LLVMValueRef elem = LLVMBuildExtractElement(
+         builder, index_vec, lp_build_const_int32(gallivm, i), "");
+      res = LLVMBuildOr(builder, res, elem, "");
+   }
+   return res;
+}
+
+/**
+ * Emit an image operation.
+ *
+ * Indirectly addressed images are dispatched to through a chain of ifs
+ * over the declared images, as the image format is part of the code.
+ */
+static void
+emit_image_op(struct lp_build_tgsi_soa_context *bld,
+              unsigned index, boolean indirect,
+              const struct tgsi_ind_register *indirect_reg,
+              struct lp_img_params *params)
+{
+   const struct lp_build_image_soa *image = bld->cs_iface->image;
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   unsigned num_out = params->img_op == LP_IMG_LOAD ? 4 : 1;
+   LLVMValueRef *outdata = params->outdata;
+   LLVMValueRef res_ptrs[4] = { NULL };
+   LLVMValueRef tmp[4];
+   LLVMValueRef image_index;
+   int max_index, i;
+   unsigned chan;
+
+   if (!image) {
+      if (outdata) {
+         for (chan = 0; chan < num_out; chan++)
+            outdata[chan] = bld->bld_base.base.zero;
+      }
+      return;
+   }
+
+   params->exec_mask = mask_vec(&bld->bld_base);
+   params->context_ptr = bld->context_ptr;
+
+   if (!indirect) {
+      params->image_index = index;
+      image->emit_op(image, gallivm, params);
+      return;
+   }
+
+   image_index = get_uniform_index(bld, TGSI_FILE_IMAGE, index, indirect_reg);
+   max_index = bld->bld_base.info->file_max[TGSI_FILE_IMAGE];
+
+   if (outdata) {
+      for (chan = 0; chan < num_out; chan++) {
+         res_ptrs[chan] = lp_build_alloca(gallivm,
+                                          bld->bld_base.base.vec_type, "");
+      }
+      params->outdata = tmp;
+   }
+
+   for (i = 0; i <= max_index; i++) {
+      struct lp_build_if_state ifthen;
+      LLVMValueRef cond;
+
+      cond = LLVMBuildICmp(builder, LLVMIntEQ, image_index,
+                           lp_build_const_int32(gallivm, i), "");
+      lp_build_if(&ifthen, gallivm, cond);
+
+      params->image_index = i;
+      image->emit_op(image, gallivm, params);
+
+      if (outdata) {
+         for (chan = 0; chan < num_out; chan++)
+            LLVMBuildStore(builder, tmp[chan], res_ptrs[chan]);
+      }
+
+      lp_build_endif(&ifthen);
+   }
+
+   if (outdata) {
+      for (chan = 0; chan < num_out; chan++)
+         outdata[chan] = LLVMBuildLoad(builder, res_ptrs[chan], "");
+      params->outdata = outdata;
+   }
+}
+
+/**
+ * Set up the parameters common to all the image operations.
+ */
+static void
+init_image_params(struct lp_build_tgsi_context *bld_base,
+                  const struct tgsi_full_instruction *inst,
+                  unsigned coord_src,
+                  enum lp_img_op img_op,
+                  LLVMValueRef *coords,
+                  struct lp_img_params *params)
+{
+   unsigned num_coords, i;
+
+   memset(params, 0, sizeof *params);
+
+   params->type = bld_base->base.type;
+   params->img_op = img_op;
+   params->target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+   params->coords = coords;
+
+   num_coords = tgsi_util_get_texture_coord_dim(inst->Memory.Texture);
+   for (i = 0; i < 3; i++) {
+      coords[i] = i < num_coords ?
+         emit_fetch_uint(bld_base, inst, coord_src, i) : NULL;
+   }
+}
+
+static void
+load_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   struct soa_mem_ref ref;
+   LLVMValueRef offset;
+
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      struct lp_img_params params;
+      LLVMValueRef coords[3];
+
+      init_image_params(bld_base, inst, 1, LP_IMG_LOAD, coords, &params);
+      params.outdata = emit_data->output;
+      emit_image_op(bld, res->Register.Index, res->Register.Indirect,
+                    &res->Indirect, &params);
+      return;
+   }
+
+   get_mem_ref(bld, res->Register.File, res->Register.Index,
+               res->Register.Indirect, &res->Indirect, &ref);
+   offset = emit_fetch_uint(bld_base, inst, 1, TGSI_CHAN_X);
+
+   emit_mem_access(bld, TGSI_OPCODE_LOAD, &ref, offset,
+                   inst->Dst[0].Register.WriteMask, NULL, NULL,
+                   emit_data->output);
+}
+
+static void
+store_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_dst_register *res = &inst->Dst[0];
+   LLVMValueRef data[TGSI_NUM_CHANNELS];
+   struct soa_mem_ref ref;
+   LLVMValueRef offset;
+   unsigned chan;
+
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      struct lp_img_params params;
+      LLVMValueRef coords[3];
+
+      init_image_params(bld_base, inst, 0, LP_IMG_STORE, coords, &params);
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++)
+         params.indata[chan] = lp_build_emit_fetch(bld_base, inst, 1, chan);
+      emit_image_op(bld, res->Register.Index, res->Register.Indirect,
+                    &res->Indirect, &params);
+      return;
+   }
+
+   get_mem_ref(bld, res->Register.File, res->Register.Index,
+               res->Register.Indirect, &res->Indirect, &ref);
+   offset = emit_fetch_uint(bld_base, inst, 0, TGSI_CHAN_X);
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      data[chan] = NULL;
+      if (res->Register.WriteMask & (1 << chan))
+         data[chan] = emit_fetch_uint(bld_base, inst, 1, chan);
+   }
+
+   emit_mem_access(bld, TGSI_OPCODE_STORE, &ref, offset,
+                   res->Register.WriteMask, data, NULL, NULL);
+}
+
+static void
+atomic_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   const struct tgsi_full_instruction *inst = emit_data->inst;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   unsigned opcode = inst->Instruction.Opcode;
+   LLVMValueRef data[TGSI_NUM_CHANNELS] = { NULL };
+   LLVMValueRef cmp = NULL;
+   struct soa_mem_ref ref;
+   LLVMValueRef offset;
+   unsigned chan;
+
+   if (opcode == TGSI_OPCODE_ATOMCAS) {
+      cmp = emit_fetch_uint(bld_base, inst, 2, TGSI_CHAN_X);
+      data[0] = emit_fetch_uint(bld_base, inst, 3, TGSI_CHAN_X);
+   }
+   else {
+      data[0] = emit_fetch_uint(bld_base, inst, 2, TGSI_CHAN_X);
+   }
+
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      struct lp_img_params params;
+      LLVMValueRef coords[3];
+
+      init_image_params(bld_base, inst, 1,
+                        opcode == TGSI_OPCODE_ATOMCAS ?
+                        LP_IMG_ATOMIC_CAS : LP_IMG_ATOMIC,
+                        coords, &params);
+      if (opcode != TGSI_OPCODE_ATOMCAS)
+         params.op = atomic_rmw_op(opcode);
+      params.indata[0] = data[0];
+      params.indata2[0] = cmp;
+      params.outdata = emit_data->output;
+      emit_image_op(bld, res->Register.Index, res->Register.Indirect,
+                    &res->Indirect, &params);
+   }
+   else {
+      get_mem_ref(bld, res->Register.File, res->Register.Index,
+                  res->Register.Indirect, &res->Indirect, &ref);
+      offset = emit_fetch_uint(bld_base, inst, 1, TGSI_CHAN_X);
+
+      emit_mem_access(bld, opcode, &ref, offset, TGSI_WRITEMASK_X,
+                      data, cmp, emit_data->output);
+   }
+
+   for (chan = 1; chan < TGSI_NUM_CHANNELS; chan++)
+      emit_data->output[chan] = emit_data->output[0];
+}
+
+/**
+ * Emit the size query of an image, in the same way as emit_image_op().
+ */
+static void
+emit_image_size(struct lp_build_tgsi_soa_context *bld,
+                const struct tgsi_full_instruction *inst,
+                LLVMValueRef *sizes_out)
+{
+   const struct lp_build_image_soa *image = bld->cs_iface->image;
+   const struct tgsi_full_src_register *res = &inst->Src[0];
+   struct gallivm_state *gallivm = bld->bld_base.base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_sampler_size_query_params params;
+   LLVMValueRef res_ptrs[4], tmp[4];
+   LLVMValueRef image_index;
+   int max_index, i;
+   unsigned chan;
+
+   for (chan = 0; chan < 4; chan++)
+      sizes_out[chan] = bld->bld_base.int_bld.zero;
+
+   if (!image)
+      return;
+
+   memset(&params, 0, sizeof params);
+   params.int_type = bld->bld_base.int_bld.type;
+   params.target = tgsi_to_pipe_tex_target(inst->Memory.Texture);
+   params.context_ptr = bld->context_ptr;
+   params.sizes_out = sizes_out;
+
+   if (!res->Register.Indirect) {
+      params.texture_unit = res->Register.Index;
+      image->emit_size_query(image, gallivm, &params);
+      return;
+   }
+
+   image_index = get_uniform_index(bld, TGSI_FILE_IMAGE, res->Register.Index,
+                                   &res->Indirect);
+   max_index = bld->bld_base.info->file_max[TGSI_FILE_IMAGE];
+
+   for (chan = 0; chan < 4; chan++) {
+      res_ptrs[chan] = lp_build_alloca(gallivm,
+                                       bld->bld_base.int_bld.vec_type, "");
+   }
+   params.sizes_out = tmp;
+
+   for (i = 0; i <= max_index; i++) {
+      struct lp_build_if_state ifthen;
+      LLVMValueRef cond;
+
+      cond = LLVMBuildICmp(builder, LLVMIntEQ, image_index,
+                           lp_build_const_int32(gallivm, i), "");
+      lp_build_if(&ifthen, gallivm, cond);
+
+      for (chan = 0; chan < 4; chan++)
+         tmp[chan] = bld->bld_base.int_bld.zero;
+      params.texture_unit = i;
+      image->emit_size_query(image, gallivm, &params);
+      for (chan = 0; chan < 4; chan++)
+         LLVMBuildStore(builder, tmp[chan], res_ptrs[chan]);
+
+      lp_build_endif(&ifthen);
+   }
+
+   for (chan = 0; chan < 4; chan++)
+      sizes_out[chan] = LLVMBuildLoad(builder, res_ptrs[chan], "");
+}
+
+static void
+resq_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   const struct tgsi_full_src_register *res = &emit_data->inst->Src[0];
+   LLVMValueRef size = NULL;
+   unsigned chan;
+
+   if (res->Register.File == TGSI_FILE_IMAGE) {
+      emit_image_size(bld, emit_data->inst, emit_data->output);
+      return;
+   }
+
+   if (res->Register.File == TGSI_FILE_BUFFER) {
+      if (res->Register.Indirect) {
+         LLVMValueRef index = get_uniform_index(bld, res->Register.File,
+                                                res->Register.Index,
+                                                &res->Indirect);
+         size = lp_build_array_get(gallivm, bld->cs_iface->ssbo_sizes_ptr,
+                                   index);
+      }
+      else {
+         size = bld->ssbo_sizes[res->Register.Index];
+      }
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      emit_data->output[chan] = bld_base->uint_bld.zero;
+   }
+   if (size) {
+      emit_data->output[TGSI_CHAN_X] =
+         lp_build_broadcast_scalar(&bld_base->uint_bld, size);
+   }
+}
+
+static void
+membar_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+
+   LLVMBuildFence(builder, LLVMAtomicOrderingSequentiallyConsistent,
+                  FALSE, "");
+}
+
+static void
+barrier_emit(
+   const struct lp_build_tgsi_action * action,
+   struct lp_build_tgsi_context * bld_base,
+   struct lp_build_emit_data * emit_data)
+{
+   struct lp_build_tgsi_soa_context * bld = lp_soa_context(bld_base);
+
+   if (bld->cs_iface->emit_barrier)
+      bld->cs_iface->emit_barrier(bld->cs_iface, bld_base);
+}
+
 static void
 cal_emit(
    const struct lp_build_tgsi_action * action,
@@ -3817,7 +4470,8 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                   LLVMValueRef thread_data_ptr,
                   const struct lp_build_sampler_soa *sampler,
                   const struct tgsi_shader_info *info,
-                  const struct lp_build_tgsi_gs_iface *gs_iface)
+                  const struct lp_build_tgsi_gs_iface *gs_iface,
+                  const struct lp_build_tgsi_cs_iface *cs_iface)
 {
    struct lp_build_tgsi_soa_context bld;
 
@@ -3973,6 +4627,25 @@ lp_build_tgsi_soa(struct gallivm_state *gallivm,
                                 max_output_vertices);
    }
 
+   if (cs_iface) {
+      bld.cs_iface = cs_iface;
+      bld.bld_base.op_actions[TGSI_OPCODE_LOAD].emit = load_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_STORE].emit = store_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_RESQ].emit = resq_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_MEMBAR].emit = membar_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_BARRIER].emit = barrier_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUADD].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXCHG].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMCAS].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMAND].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMXOR].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMUMAX].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMIN].emit = atomic_emit;
+      bld.bld_base.op_actions[TGSI_OPCODE_ATOMIMAX].emit = atomic_emit;
+   }
+
    lp_exec_mask_init(&bld.exec_mask, &bld.bld_base.int_bld);
 
    bld.system_values = *system_values;
@@ -41,6 +41,7 @@
 #include "hud/hud_private.h"
 
 #include "cso_cache/cso_context.h"
+#include "state_tracker/st_api.h"
 #include "util/u_draw_quad.h"
 #include "util/u_format.h"
 #include "util/u_inlines.h"
@@ -1273,6 +1274,20 @@ hud_parse_env_var(struct hud_context *hud, struct pipe_screen *screen,
       else if (strcmp(name, "main-thread-busy") == 0) {
          hud_thread_busy_install(pane, name, true);
       }
+      else if (strcmp(name, "st-validate-time") == 0) {
+         hud_atom_stats_install(pane, name, NULL, true);
+         pane->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+      }
+      else if (strcmp(name, "st-validate-updates") == 0) {
+         hud_atom_stats_install(pane, name, NULL, false);
+      }
+      else if (util_strncmp(name, "st-atom-time-", 13) == 0) {
+         hud_atom_stats_install(pane, name, name + 13, true);
+         pane->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+      }
+      else if (util_strncmp(name, "st-atom-updates-", 16) == 0) {
+         hud_atom_stats_install(pane, name, name + 16, false);
+      }
 #ifdef HAVE_GALLIUM_EXTRA_HUD
       else if (sscanf(name, "nic-rx-%s", arg_name) == 1) {
          hud_nic_graph_install(pane, arg_name, NIC_DIRECTION_RX);
@@ -1569,6 +1584,11 @@ print_help(struct pipe_screen *screen)
    for (i = 0; i < num_cpus; i++)
       printf("    cpu%i\n", i);
 
+   puts("    st-validate-time (state validation of st/mesa)");
+   puts("    st-validate-updates");
+   puts("    st-atom-time-<update function>, e.g. st-atom-time-st_update_fp");
+   puts("    st-atom-updates-<update function>");
+
    if (has_occlusion_query(screen))
       puts("    samples-passed");
    if (has_streamout(screen))
@@ -1761,12 +1781,38 @@ hud_unset_record_context(struct hud_context *hud)
 
    hud_batch_query_cleanup(&hud->batch_query, pipe);
    hud->record_pipe = NULL;
+   hud->atom_stats = NULL;
+}
+
+struct hud_atom_stats_entry {
+   struct list_head head;
+   struct pipe_context *pipe;
+   struct st_atom_stats *stats;
+};
+
+static void
+hud_attach_atom_stats(struct hud_context *hud, struct st_atom_stats *stats)
+{
+   hud->atom_stats = stats;
+   if (stats && hud->shows_atom_stats)
+      stats->enabled = TRUE;
 }
 
 static void
 hud_set_record_context(struct hud_context *hud, struct pipe_context *pipe)
 {
+   struct hud_atom_stats_entry *entry;
+
    hud->record_pipe = pipe;
+
+   mtx_lock(&hud->atom_stats_mutex);
+   LIST_FOR_EACH_ENTRY(entry, &hud->atom_stats_list, head) {
+      if (entry->pipe == pipe) {
+         hud_attach_atom_stats(hud, entry->stats);
+         break;
+      }
+   }
+   mtx_unlock(&hud->atom_stats_mutex);
 }
 
 /**
@@ -1886,6 +1932,8 @@ hud_create(struct cso_context *cso, struct hud_context *share)
    hud->constbuf.user_buffer = &hud->constants;
 
    LIST_INITHEAD(&hud->pane_list);
+   LIST_INITHEAD(&hud->atom_stats_list);
+   (void) mtx_init(&hud->atom_stats_mutex, mtx_plain);
 
    /* setup sig handler once for all hud contexts */
 #ifdef PIPE_OS_UNIX
@@ -1919,14 +1967,26 @@ hud_create(struct cso_context *cso, struct hud_context *share)
 void
 hud_destroy(struct hud_context *hud, struct cso_context *cso)
 {
+   struct hud_atom_stats_entry *entry, *tmp;
+
    if (!cso || hud->record_pipe == cso_get_pipe_context(cso))
       hud_unset_record_context(hud);
 
    if (!cso || hud->cso == cso)
       hud_unset_draw_context(hud);
 
+   mtx_lock(&hud->atom_stats_mutex);
+   LIST_FOR_EACH_ENTRY_SAFE(entry, tmp, &hud->atom_stats_list, head) {
+      if (!cso || entry->pipe == cso_get_pipe_context(cso)) {
+         LIST_DEL(&entry->head);
+         FREE(entry);
+      }
+   }
+   mtx_unlock(&hud->atom_stats_mutex);
+
    if (p_atomic_dec_zero(&hud->refcount)) {
       pipe_resource_reference(&hud->font.texture, NULL);
+      mtx_destroy(&hud->atom_stats_mutex);
       FREE(hud);
    }
 }
@@ -1938,3 +1998,39 @@ hud_add_queue_for_monitoring(struct hud_context *hud,
    assert(!hud->monitored_queue);
    hud->monitored_queue = queue_info;
 }
+
+/**
+ * Set the state validation statistics of the context using "pipe".
+ *
+ * Only the statistics of the context recording the queries are shown, and
+ * the context only starts collecting them once the HUD shows some. The
+ * statistics of the other contexts are kept until they are destroyed, in
+ * case one of them becomes the recording context.
+ */
+void
+hud_add_atom_stats(struct hud_context *hud, struct pipe_context *pipe,
+                   struct st_atom_stats *stats)
+{
+   struct hud_atom_stats_entry *entry;
+
+   mtx_lock(&hud->atom_stats_mutex);
+   LIST_FOR_EACH_ENTRY(entry, &hud->atom_stats_list, head) {
+      if (entry->pipe == pipe)
+         break;
+   }
+
+   if (&entry->head == &hud->atom_stats_list) {
+      entry = CALLOC_STRUCT(hud_atom_stats_entry);
+      if (!entry) {
+         mtx_unlock(&hud->atom_stats_mutex);
+         return;
+      }
+      entry->pipe = pipe;
+      LIST_ADDTAIL(&entry->head, &hud->atom_stats_list);
+   }
+   entry->stats = stats;
+   mtx_unlock(&hud->atom_stats_mutex);
+
+   if (hud->record_pipe == pipe)
+      hud_attach_atom_stats(hud, stats);
+}
@@ -33,6 +33,7 @@ struct cso_context;
 struct pipe_context;
 struct pipe_resource;
 struct util_queue_monitoring;
+struct st_atom_stats;
 
 struct hud_context *
 hud_create(struct cso_context *cso, struct hud_context *share);
@@ -51,4 +52,8 @@ void
 hud_add_queue_for_monitoring(struct hud_context *hud,
                              struct util_queue_monitoring *queue_info);
 
+void
+hud_add_atom_stats(struct hud_context *hud, struct pipe_context *pipe,
+                   struct st_atom_stats *stats);
+
 #endif
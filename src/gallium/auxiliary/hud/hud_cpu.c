@@ -33,6 +33,8 @@
 #include "os/os_thread.h"
 #include "util/u_memory.h"
 #include "util/u_queue.h"
+#include "util/u_string.h"
+#include "state_tracker/st_api.h"
 #include <stdio.h>
 #include <inttypes.h>
 #ifdef PIPE_OS_WINDOWS
@@ -382,3 +384,106 @@ void hud_thread_counter_install(struct hud_pane *pane, const char *name,
    hud_pane_add_graph(pane, gr);
    hud_pane_set_max_value(pane, 100);
 }
+
+struct atom_stats_info {
+   char atom[64];       /* update function of the atom, or "" for all */
+   int index;           /* index of the atom, or -1 if not found yet */
+   bool time;           /* time instead of number of updates */
+   uint64_t last_value;
+   int64_t last_time;
+};
+
+static uint64_t
+get_atom_stats_value(struct hud_graph *gr, struct atom_stats_info *info)
+{
+   struct st_atom_stats *stats = gr->pane->hud->atom_stats;
+   const uint64_t *values;
+   uint64_t value = 0;
+   unsigned i;
+
+   if (!stats)
+      return 0;
+
+   values = info->time ? stats->time_ns : stats->calls;
+
+   if (!info->atom[0]) {
+      for (i = 0; i < stats->num_atoms; i++)
+         value += values[i];
+      return value;
+   }
+
+   /* The statistics are only available once the context has been set up,
+    * after the HUD was created, so look the atom up the first time.
+    */
+   if (info->index < 0) {
+      for (i = 0; i < stats->num_atoms; i++) {
+         if (strcmp(stats->names[i], info->atom) == 0)
+            info->index = i;
+      }
+      if (info->index < 0)
+         return 0;
+   }
+
+   return values[info->index];
+}
+
+static void
+query_atom_stats(struct hud_graph *gr, struct pipe_context *pipe)
+{
+   struct atom_stats_info *info = gr->query_data;
+   int64_t now = os_time_get_nano();
+
+   if (info->last_time) {
+      if (info->last_time + gr->pane->period*1000 <= now) {
+         uint64_t current_value = get_atom_stats_value(gr, info);
+         uint64_t delta = current_value - info->last_value;
+
+         hud_graph_add_value(gr, info->time ? delta / 1000.0 : delta);
+         info->last_value = current_value;
+         info->last_time = now;
+      }
+   } else {
+      /* initialize */
+      info->last_value = get_atom_stats_value(gr, info);
+      info->last_time = now;
+   }
+}
+
+/**
+ * Show the number of updates or the time in microseconds spent in the
+ * state validation of st/mesa, for the atom with the update function "atom",
+ * or for all of them if "atom" is NULL.
+ */
+void
+hud_atom_stats_install(struct hud_pane *pane, const char *name,
+                       const char *atom, bool time)
+{
+   struct hud_graph *gr;
+   struct atom_stats_info *info;
+
+   gr = CALLOC_STRUCT(hud_graph);
+   if (!gr)
+      return;
+
+   strcpy(gr->name, name);
+
+   gr->query_data = info = CALLOC_STRUCT(atom_stats_info);
+   if (!gr->query_data) {
+      FREE(gr);
+      return;
+   }
+
+   if (atom)
+      util_snprintf(info->atom, sizeof(info->atom), "%s", atom);
+   info->index = -1;
+   info->time = time;
+   gr->query_new_value = query_atom_stats;
+
+   /* Don't use free() as our callback as that messes up Gallium's
+    * memory debugger.  Use simple free_query_data() wrapper.
+    */
+   gr->free_query_data = free_query_data;
+
+   hud_pane_add_graph(pane, gr);
+   pane->hud->shows_atom_stats = true;
+}
@@ -31,8 +31,11 @@
 #include "pipe/p_context.h"
 #include "pipe/p_state.h"
 #include "util/list.h"
+#include "c11/threads.h"
 #include "hud/font.h"
 
+struct st_atom_stats;
+
 enum hud_counter {
    HUD_COUNTER_OFFLOADED,
    HUD_COUNTER_DIRECT,
@@ -55,6 +58,16 @@ struct hud_context {
 
    struct util_queue_monitoring *monitored_queue;
 
+   /* State validation statistics of the recording context. */
+   struct st_atom_stats *atom_stats;
+   bool shows_atom_stats;
+
+   /* The statistics of all contexts sharing the HUD, so that they can be
+    * attached again when another context starts recording.
+    */
+   struct list_head atom_stats_list;
+   mtx_t atom_stats_mutex;
+
    /* states */
    struct pipe_blend_state no_blend, alpha_blend;
    struct pipe_depth_stencil_alpha_state dsa;
@@ -162,6 +175,8 @@ void hud_cpu_graph_install(struct hud_pane *pane, unsigned cpu_index);
 void hud_thread_busy_install(struct hud_pane *pane, const char *name, bool main);
 void hud_thread_counter_install(struct hud_pane *pane, const char *name,
                                 enum hud_counter counter);
+void hud_atom_stats_install(struct hud_pane *pane, const char *name,
+                            const char *atom, bool time);
 void hud_pipe_query_install(struct hud_batch_query_context **pbq,
                             struct hud_pane *pane,
                             const char *name,
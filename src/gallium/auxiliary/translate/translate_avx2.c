@@ -0,0 +1,355 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER(S) AND/OR ITS SUPPLIERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * AVX2 vertex fetch for translate_generic.
+ *
+ * Eight vertices are fetched at a time: their offsets are computed from
+ * the (clamped) indices, each dword of the attribute is gathered for all of
+ * them, the channels are converted to float side by side and the result is
+ * transposed into one float[4] per vertex.
+ *
+ * Only the plain formats whose channels are all alike are handled, with
+ * 8-bit channels when there are four of them, 16-bit channels when there
+ * are at least two, so that no gather reads past the end of the vertex,
+ * and 32-bit floats.  The arithmetic is the same as in the generated
+ * fetch_rgba_float functions, so the results are identical.
+ */
+
+#include <immintrin.h>
+
+#include "translate_avx2.h"
+
+
+enum fetch_type {
+   FETCH_UNORM,
+   FETCH_SNORM,
+   FETCH_USCALED,
+   FETCH_SSCALED,
+   FETCH_FLOAT,
+};
+
+
+/**
+ * Return the offsets of the vertices i to i + 7 in the buffer.  The lanes
+ * past 'n' repeat the last vertex.
+ */
+static inline __m256i
+fetch_offsets(const unsigned *elts, unsigned start, unsigned i, unsigned n,
+              unsigned stride, unsigned max_index)
+{
+   __m256i index;
+
+   if (elts) {
+      if (n == 8) {
+         index = _mm256_loadu_si256((const __m256i *)(elts + i));
+      }
+      else {
+         unsigned tmp[8];
+         unsigned j;
+
+         for (j = 0; j < 8; j++)
+            tmp[j] = elts[i + MIN2(j, n - 1)];
+         index = _mm256_loadu_si256((const __m256i *)tmp);
+      }
+   }
+   else {
+      index = _mm256_min_epu32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                               _mm256_set1_epi32(n - 1));
+      index = _mm256_add_epi32(index, _mm256_set1_epi32(start + i));
+   }
+
+   /* clamp to avoid going out of bounds */
+   index = _mm256_min_epu32(index, _mm256_set1_epi32(max_index));
+
+   return _mm256_mullo_epi32(index, _mm256_set1_epi32(stride));
+}
+
+
+static inline __m256i
+gather(const uint8_t *src, unsigned offset, __m256i offsets)
+{
+   return _mm256_i32gather_epi32((const int *)(src + offset), offsets, 1);
+}
+
+
+/**
+ * Extract the 'size' bits wide channel at bit 'shift' of the dwords in 'v'.
+ */
+static inline __m256i
+extract(__m256i v, unsigned shift, unsigned size, enum fetch_type type)
+{
+   if (type == FETCH_SNORM || type == FETCH_SSCALED) {
+      if (shift + size < 32)
+         v = _mm256_slli_epi32(v, 32 - shift - size);
+      return _mm256_srai_epi32(v, 32 - size);
+   }
+   else {
+      if (shift)
+         v = _mm256_srli_epi32(v, shift);
+      if (shift + size < 32)
+         v = _mm256_and_si256(v, _mm256_set1_epi32((1 << size) - 1));
+      return v;
+   }
+}
+
+
+static inline __m256
+convert(__m256i v, unsigned size, enum fetch_type type)
+{
+   __m256 f;
+
+   if (type == FETCH_FLOAT)
+      return _mm256_castsi256_ps(v);
+
+   f = _mm256_cvtepi32_ps(v);
+
+   if (type == FETCH_UNORM)
+      f = _mm256_mul_ps(f, _mm256_set1_ps(1.0f / ((1 << size) - 1)));
+   else if (type == FETCH_SNORM)
+      f = _mm256_mul_ps(f, _mm256_set1_ps(1.0f / ((1 << (size - 1)) - 1)));
+
+   return f;
+}
+
+
+/**
+ * Fetch and convert the 'nr' channels of 'size' bits of eight vertices.
+ */
+static ALWAYS_INLINE void
+fetch_channels(__m256 chan[4], const uint8_t *src, __m256i offsets,
+               unsigned nr, unsigned size, enum fetch_type type)
+{
+   __m256i lo, hi;
+   unsigned i;
+
+   switch (size) {
+   case 8:
+      lo = gather(src, 0, offsets);
+      for (i = 0; i < 4; i++)
+         chan[i] = convert(extract(lo, i * 8, 8, type), 8, type);
+      break;
+   case 16:
+      lo = gather(src, 0, offsets);
+      chan[0] = convert(extract(lo, 0, 16, type), 16, type);
+      chan[1] = convert(extract(lo, 16, 16, type), 16, type);
+      if (nr == 3) {
+         /* Bytes 2 to 5, so as not to read past the vertex. */
+         hi = gather(src, 2, offsets);
+         chan[2] = convert(extract(hi, 16, 16, type), 16, type);
+      }
+      else if (nr == 4) {
+         hi = gather(src, 4, offsets);
+         chan[2] = convert(extract(hi, 0, 16, type), 16, type);
+         chan[3] = convert(extract(hi, 16, 16, type), 16, type);
+      }
+      break;
+   case 32:
+      for (i = 0; i < nr; i++)
+         chan[i] = convert(gather(src, i * 4, offsets), 32, type);
+      break;
+   default:
+      unreachable("unexpected channel size");
+   }
+}
+
+
+/**
+ * Transpose the r, g, b and a values of eight vertices and store the first
+ * 'n' of them.
+ */
+static inline void
+store_vertices(float (*dst)[4], __m256 r, __m256 g, __m256 b, __m256 a,
+               unsigned n)
+{
+   __m256 rg_lo = _mm256_unpacklo_ps(r, g);
+   __m256 rg_hi = _mm256_unpackhi_ps(r, g);
+   __m256 ba_lo = _mm256_unpacklo_ps(b, a);
+   __m256 ba_hi = _mm256_unpackhi_ps(b, a);
+   __m256 v04 = _mm256_shuffle_ps(rg_lo, ba_lo, 0x44);
+   __m256 v15 = _mm256_shuffle_ps(rg_lo, ba_lo, 0xee);
+   __m256 v26 = _mm256_shuffle_ps(rg_hi, ba_hi, 0x44);
+   __m256 v37 = _mm256_shuffle_ps(rg_hi, ba_hi, 0xee);
+   float tmp[8][4];
+   float (*out)[4] = n == 8 ? dst : tmp;
+
+   _mm256_storeu_ps(out[0], _mm256_permute2f128_ps(v04, v15, 0x20));
+   _mm256_storeu_ps(out[2], _mm256_permute2f128_ps(v26, v37, 0x20));
+   _mm256_storeu_ps(out[4], _mm256_permute2f128_ps(v04, v15, 0x31));
+   _mm256_storeu_ps(out[6], _mm256_permute2f128_ps(v26, v37, 0x31));
+
+   if (n != 8)
+      memcpy(dst, tmp, n * sizeof tmp[0]);
+}
+
+
+static ALWAYS_INLINE void
+fetch_vertices(float (*dst)[4], const unsigned char swizzle[4],
+               const uint8_t *src, unsigned stride, const unsigned *elts,
+               unsigned start, unsigned max_index, unsigned count,
+               unsigned nr, unsigned size, enum fetch_type type)
+{
+   unsigned i;
+
+   for (i = 0; i < count; i += 8) {
+      unsigned n = MIN2(count - i, 8);
+      __m256i offsets = fetch_offsets(elts, start, i, n, stride, max_index);
+      /* indexed by PIPE_SWIZZLE_* */
+      __m256 chan[6];
+
+      chan[1] = chan[2] = chan[3] = _mm256_setzero_ps();
+      fetch_channels(chan, src, offsets, nr, size, type);
+      chan[PIPE_SWIZZLE_0] = _mm256_setzero_ps();
+      chan[PIPE_SWIZZLE_1] = _mm256_set1_ps(1.0f);
+
+      store_vertices(dst + i, chan[swizzle[0]], chan[swizzle[1]],
+                     chan[swizzle[2]], chan[swizzle[3]], n);
+   }
+}
+
+
+#define FETCH(NAME, NR, SIZE, TYPE)					\
+static void								\
+fetch_##NAME(float (*dst)[4], const unsigned char swizzle[4],		\
+             const uint8_t *src, unsigned stride, const unsigned *elts,	\
+             unsigned start, unsigned max_index, unsigned count)	\
+{									\
+   fetch_vertices(dst, swizzle, src, stride, elts, start, max_index,	\
+                  count, NR, SIZE, TYPE);				\
+}
+
+FETCH(4x8_unorm,    4, 8, FETCH_UNORM)
+FETCH(4x8_snorm,    4, 8, FETCH_SNORM)
+FETCH(4x8_uscaled,  4, 8, FETCH_USCALED)
+FETCH(4x8_sscaled,  4, 8, FETCH_SSCALED)
+
+FETCH(2x16_unorm,   2, 16, FETCH_UNORM)
+FETCH(2x16_snorm,   2, 16, FETCH_SNORM)
+FETCH(2x16_uscaled, 2, 16, FETCH_USCALED)
+FETCH(2x16_sscaled, 2, 16, FETCH_SSCALED)
+FETCH(3x16_unorm,   3, 16, FETCH_UNORM)
+FETCH(3x16_snorm,   3, 16, FETCH_SNORM)
+FETCH(3x16_uscaled, 3, 16, FETCH_USCALED)
+FETCH(3x16_sscaled, 3, 16, FETCH_SSCALED)
+FETCH(4x16_unorm,   4, 16, FETCH_UNORM)
+FETCH(4x16_snorm,   4, 16, FETCH_SNORM)
+FETCH(4x16_uscaled, 4, 16, FETCH_USCALED)
+FETCH(4x16_sscaled, 4, 16, FETCH_SSCALED)
+
+FETCH(1x32_float,   1, 32, FETCH_FLOAT)
+FETCH(2x32_float,   2, 32, FETCH_FLOAT)
+FETCH(3x32_float,   3, 32, FETCH_FLOAT)
+FETCH(4x32_float,   4, 32, FETCH_FLOAT)
+
+
+static const translate_avx2_fetch_func fetch_8[5][4] = {
+   [4] = {
+      fetch_4x8_unorm, fetch_4x8_snorm, fetch_4x8_uscaled, fetch_4x8_sscaled
+   },
+};
+
+static const translate_avx2_fetch_func fetch_16[5][4] = {
+   [2] = {
+      fetch_2x16_unorm, fetch_2x16_snorm,
+      fetch_2x16_uscaled, fetch_2x16_sscaled
+   },
+   [3] = {
+      fetch_3x16_unorm, fetch_3x16_snorm,
+      fetch_3x16_uscaled, fetch_3x16_sscaled
+   },
+   [4] = {
+      fetch_4x16_unorm, fetch_4x16_snorm,
+      fetch_4x16_uscaled, fetch_4x16_sscaled
+   },
+};
+
+static const translate_avx2_fetch_func fetch_32_float[5] = {
+   NULL, fetch_1x32_float, fetch_2x32_float, fetch_3x32_float,
+   fetch_4x32_float
+};
+
+
+translate_avx2_fetch_func
+translate_avx2_get_fetch_func(const struct util_format_description *desc)
+{
+   const struct util_format_channel_description *channel = NULL;
+   unsigned nr = desc->nr_channels;
+   enum fetch_type type;
+   unsigned i;
+
+   if (desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+       desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+       desc->block.width != 1 || desc->block.height != 1)
+      return NULL;
+
+   /* All the channels must be alike, but for the padding ones. */
+   for (i = 0; i < nr; i++) {
+      if (desc->channel[i].type == UTIL_FORMAT_TYPE_VOID)
+         continue;
+
+      if (!channel)
+         channel = &desc->channel[i];
+      else if (desc->channel[i].type != channel->type ||
+               desc->channel[i].normalized != channel->normalized ||
+               desc->channel[i].pure_integer != channel->pure_integer)
+         return NULL;
+   }
+
+   if (!channel || channel->pure_integer ||
+       desc->block.bits != nr * channel->size)
+      return NULL;
+
+   for (i = 0; i < nr; i++) {
+      if (desc->channel[i].size != channel->size)
+         return NULL;
+   }
+
+   switch (channel->type) {
+   case UTIL_FORMAT_TYPE_UNSIGNED:
+      type = channel->normalized ? FETCH_UNORM : FETCH_USCALED;
+      break;
+   case UTIL_FORMAT_TYPE_SIGNED:
+      type = channel->normalized ? FETCH_SNORM : FETCH_SSCALED;
+      break;
+   case UTIL_FORMAT_TYPE_FLOAT:
+      type = FETCH_FLOAT;
+      break;
+   default:
+      return NULL;
+   }
+
+   switch (channel->size) {
+   case 8:
+      return type != FETCH_FLOAT ? fetch_8[nr][type] : NULL;
+   case 16:
+      return type != FETCH_FLOAT ? fetch_16[nr][type] : NULL;
+   case 32:
+      return type == FETCH_FLOAT ? fetch_32_float[nr] : NULL;
+   default:
+      return NULL;
+   }
+}
@@ -0,0 +1,71 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER(S) AND/OR ITS SUPPLIERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * AVX2 vertex fetch for translate_generic.
+ *
+ * This is built separately with the AVX2 compiler flags, when USE_AVX2 is
+ * defined, and must only be called when util_cpu_caps.has_avx2 is set.
+ */
+
+#ifndef TRANSLATE_AVX2_H
+#define TRANSLATE_AVX2_H
+
+
+#include "pipe/p_compiler.h"
+#include "util/u_format.h"
+
+
+/**
+ * Fetch one attribute of 'count' vertices into an array of float[4], with
+ * the same results as the fetch_rgba_float function of its format, whose
+ * swizzle must be passed.
+ *
+ * The vertices are either the consecutive ones starting at 'start'
+ * (elts == NULL) or the ones listed in 'elts', and their index is clamped
+ * to 'max_index'.  The offset of the last vertex that can be read, 'stride'
+ * times its index, must fit in an int32_t, as the vertices are read with
+ * gathers.
+ */
+typedef void (*translate_avx2_fetch_func)(float (*dst)[4],
+                                          const unsigned char swizzle[4],
+                                          const uint8_t *src,
+                                          unsigned stride,
+                                          const unsigned *elts,
+                                          unsigned start,
+                                          unsigned max_index,
+                                          unsigned count);
+
+
+/**
+ * Return the AVX2 fetch function of a format, or NULL if there is none.
+ */
+translate_avx2_fetch_func
+translate_avx2_get_fetch_func(const struct util_format_description *desc);
+
+
+#endif /* TRANSLATE_AVX2_H */
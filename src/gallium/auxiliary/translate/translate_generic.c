@@ -34,8 +34,10 @@
 #include "util/u_format.h"
 #include "util/u_half.h"
 #include "util/u_math.h"
+#include "util/u_cpu_detect.h"
 #include "pipe/p_state.h"
 #include "translate.h"
+#include "translate_avx2.h"
 
 
 #define DRAW_DBG 0
@@ -43,7 +45,18 @@
 typedef void (*fetch_func)(void *dst,
                            const uint8_t *src,
                            unsigned i, unsigned j);
-typedef void (*emit_func)(const void *attrib, void *ptr);
+typedef void (*emit_func)(const void *attrib, void *ptr,
+                          unsigned stride, unsigned count);
+typedef void (*unpack_func)(void *dst, unsigned dst_stride,
+                            const uint8_t *src, unsigned src_stride,
+                            unsigned width, unsigned height);
+
+/**
+ * Number of vertices converted at once: each attribute is fetched for the
+ * whole batch into a dword[4] array before being emitted, so that the
+ * per-vertex function pointer calls are replaced by per-batch ones.
+ */
+#define BATCH_SIZE 64
 
 
 
@@ -54,8 +67,12 @@ struct translate_generic {
       enum translate_element_type type;
 
       fetch_func fetch;
+      unpack_func unpack;
+      translate_avx2_fetch_func fetch_avx2;
+      const unsigned char *swizzle;
       unsigned buffer;
       unsigned input_offset;
+      unsigned input_size;
       unsigned instance_divisor;
 
       emit_func emit;
@@ -88,6 +105,27 @@ translate_generic(struct translate *translate)
 }
 
 
+/**
+ * Emit 'count' vertices 'stride' bytes apart from an array of dword[4]
+ * attributes, one vertex at a time with emit_one_NAME.
+ */
+#define EMIT(NAME)					\
+static void						\
+emit_##NAME(const void *attrib, void *ptr,		\
+            unsigned stride, unsigned count)		\
+{							\
+   const uint32_t *in = (const uint32_t *)attrib;	\
+   uint8_t *out = (uint8_t *)ptr;			\
+   unsigned j;						\
+							\
+   for (j = 0; j < count; j++) {			\
+      emit_one_##NAME(in, out);				\
+      in += 4;						\
+      out += stride;					\
+   }							\
+}
+
+
 /**
  * Fetch a dword[4] vertex attribute from memory, doing format/type
  * conversion as needed.
@@ -96,8 +134,8 @@ translate_generic(struct translate *translate)
  * conversion, texture sampling etc.
  */
 #define ATTRIB(NAME, SZ, SRCTYPE, DSTTYPE, TO)  	\
-static void						\
-emit_##NAME(const void *attrib, void *ptr)		\
+static inline void					\
+emit_one_##NAME(const void *attrib, void *ptr)		\
 {  \
    unsigned i;						\
    SRCTYPE *in = (SRCTYPE *)attrib;                     \
@@ -106,7 +144,8 @@ emit_##NAME(const void *attrib, void *ptr)		\
    for (i = 0; i < SZ; i++) {				\
       out[i] = TO(in[i]);				\
    }							\
-}
+}							\
+EMIT(NAME)
 
 
 #define TO_64_FLOAT(x)   ((double) x)
@@ -239,8 +278,8 @@ ATTRIB(R8G8B8_SINT,     3, int32_t, char, TO_INT)
 ATTRIB(R8G8_SINT,       2, int32_t, char, TO_INT)
 ATTRIB(R8_SINT,         1, int32_t, char, TO_INT)
 
-static void
-emit_A8R8G8B8_UNORM(const void *attrib, void *ptr)
+static inline void
+emit_one_A8R8G8B8_UNORM(const void *attrib, void *ptr)
 {
    float *in = (float *)attrib;
    ubyte *out = (ubyte *)ptr;
@@ -249,9 +288,10 @@ emit_A8R8G8B8_UNORM(const void *attrib, void *ptr)
    out[2] = TO_8_UNORM(in[1]);
    out[3] = TO_8_UNORM(in[2]);
 }
+EMIT(A8R8G8B8_UNORM)
 
-static void
-emit_B8G8R8A8_UNORM(const void *attrib, void *ptr)
+static inline void
+emit_one_B8G8R8A8_UNORM(const void *attrib, void *ptr)
 {
    float *in = (float *)attrib;
    ubyte *out = (ubyte *)ptr;
@@ -260,105 +300,114 @@ emit_B8G8R8A8_UNORM(const void *attrib, void *ptr)
    out[0] = TO_8_UNORM(in[2]);
    out[3] = TO_8_UNORM(in[3]);
 }
+EMIT(B8G8R8A8_UNORM)
 
-static void
-emit_B10G10R10A2_UNORM(const void *attrib, void *ptr)
+static inline void
+emit_one_B10G10R10A2_UNORM(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
-   value |= ((uint32_t)(CLAMP(src[2], 0, 1) * 0x3ff)) & 0x3ff;
-   value |= (((uint32_t)(CLAMP(src[1], 0, 1) * 0x3ff)) & 0x3ff) << 10;
-   value |= (((uint32_t)(CLAMP(src[0], 0, 1) * 0x3ff)) & 0x3ff) << 20;
-   value |= ((uint32_t)(CLAMP(src[3], 0, 1) * 0x3)) << 30;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   value |= ((uint32_t)util_iround(CLAMP(src[2], 0, 1) * 0x3ff)) & 0x3ff;
+   value |= (((uint32_t)util_iround(CLAMP(src[1], 0, 1) * 0x3ff)) & 0x3ff) << 10;
+   value |= (((uint32_t)util_iround(CLAMP(src[0], 0, 1) * 0x3ff)) & 0x3ff) << 20;
+   value |= ((uint32_t)util_iround(CLAMP(src[3], 0, 1) * 0x3)) << 30;
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(B10G10R10A2_UNORM)
 
-static void
-emit_B10G10R10A2_USCALED(const void *attrib, void *ptr)
+static inline void
+emit_one_B10G10R10A2_USCALED(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
    value |= ((uint32_t)CLAMP(src[2], 0, 1023)) & 0x3ff;
    value |= (((uint32_t)CLAMP(src[1], 0, 1023)) & 0x3ff) << 10;
    value |= (((uint32_t)CLAMP(src[0], 0, 1023)) & 0x3ff) << 20;
    value |= ((uint32_t)CLAMP(src[3], 0, 3)) << 30;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(B10G10R10A2_USCALED)
 
-static void
-emit_B10G10R10A2_SNORM(const void *attrib, void *ptr)
+static inline void
+emit_one_B10G10R10A2_SNORM(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
-   value |= (uint32_t)(((uint32_t)(CLAMP(src[2], -1, 1) * 0x1ff)) & 0x3ff) ;
-   value |= (uint32_t)((((uint32_t)(CLAMP(src[1], -1, 1) * 0x1ff)) & 0x3ff) << 10) ;
-   value |= (uint32_t)((((uint32_t)(CLAMP(src[0], -1, 1) * 0x1ff)) & 0x3ff) << 20) ;
-   value |= (uint32_t)(((uint32_t)(CLAMP(src[3], -1, 1) * 0x1)) << 30) ;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   value |= (uint32_t)(((uint32_t)util_iround(CLAMP(src[2], -1, 1) * 0x1ff)) & 0x3ff) ;
+   value |= (uint32_t)((((uint32_t)util_iround(CLAMP(src[1], -1, 1) * 0x1ff)) & 0x3ff) << 10) ;
+   value |= (uint32_t)((((uint32_t)util_iround(CLAMP(src[0], -1, 1) * 0x1ff)) & 0x3ff) << 20) ;
+   value |= (uint32_t)(((uint32_t)util_iround(CLAMP(src[3], -1, 1) * 0x1)) << 30) ;
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(B10G10R10A2_SNORM)
 
-static void
-emit_B10G10R10A2_SSCALED(const void *attrib, void *ptr)
+static inline void
+emit_one_B10G10R10A2_SSCALED(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
    value |= (uint32_t)(((uint32_t)CLAMP(src[2], -512, 511)) & 0x3ff) ;
    value |= (uint32_t)((((uint32_t)CLAMP(src[1], -512, 511)) & 0x3ff) << 10) ;
    value |= (uint32_t)((((uint32_t)CLAMP(src[0], -512, 511)) & 0x3ff) << 20) ;
    value |= (uint32_t)(((uint32_t)CLAMP(src[3], -2, 1)) << 30) ;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(B10G10R10A2_SSCALED)
 
-static void
-emit_R10G10B10A2_UNORM(const void *attrib, void *ptr)
+static inline void
+emit_one_R10G10B10A2_UNORM(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
-   value |= ((uint32_t)(CLAMP(src[0], 0, 1) * 0x3ff)) & 0x3ff;
-   value |= (((uint32_t)(CLAMP(src[1], 0, 1) * 0x3ff)) & 0x3ff) << 10;
-   value |= (((uint32_t)(CLAMP(src[2], 0, 1) * 0x3ff)) & 0x3ff) << 20;
-   value |= ((uint32_t)(CLAMP(src[3], 0, 1) * 0x3)) << 30;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   value |= ((uint32_t)util_iround(CLAMP(src[0], 0, 1) * 0x3ff)) & 0x3ff;
+   value |= (((uint32_t)util_iround(CLAMP(src[1], 0, 1) * 0x3ff)) & 0x3ff) << 10;
+   value |= (((uint32_t)util_iround(CLAMP(src[2], 0, 1) * 0x3ff)) & 0x3ff) << 20;
+   value |= ((uint32_t)util_iround(CLAMP(src[3], 0, 1) * 0x3)) << 30;
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(R10G10B10A2_UNORM)
 
-static void
-emit_R10G10B10A2_USCALED(const void *attrib, void *ptr)
+static inline void
+emit_one_R10G10B10A2_USCALED(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
    value |= ((uint32_t)CLAMP(src[0], 0, 1023)) & 0x3ff;
    value |= (((uint32_t)CLAMP(src[1], 0, 1023)) & 0x3ff) << 10;
    value |= (((uint32_t)CLAMP(src[2], 0, 1023)) & 0x3ff) << 20;
    value |= ((uint32_t)CLAMP(src[3], 0, 3)) << 30;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(R10G10B10A2_USCALED)
 
-static void
-emit_R10G10B10A2_SNORM(const void *attrib, void *ptr)
+static inline void
+emit_one_R10G10B10A2_SNORM(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
-   value |= (uint32_t)(((uint32_t)(CLAMP(src[0], -1, 1) * 0x1ff)) & 0x3ff) ;
-   value |= (uint32_t)((((uint32_t)(CLAMP(src[1], -1, 1) * 0x1ff)) & 0x3ff) << 10) ;
-   value |= (uint32_t)((((uint32_t)(CLAMP(src[2], -1, 1) * 0x1ff)) & 0x3ff) << 20) ;
-   value |= (uint32_t)(((uint32_t)(CLAMP(src[3], -1, 1) * 0x1)) << 30) ;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   value |= (uint32_t)(((uint32_t)util_iround(CLAMP(src[0], -1, 1) * 0x1ff)) & 0x3ff) ;
+   value |= (uint32_t)((((uint32_t)util_iround(CLAMP(src[1], -1, 1) * 0x1ff)) & 0x3ff) << 10) ;
+   value |= (uint32_t)((((uint32_t)util_iround(CLAMP(src[2], -1, 1) * 0x1ff)) & 0x3ff) << 20) ;
+   value |= (uint32_t)(((uint32_t)util_iround(CLAMP(src[3], -1, 1) * 0x1)) << 30) ;
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(R10G10B10A2_SNORM)
 
-static void
-emit_R10G10B10A2_SSCALED(const void *attrib, void *ptr)
+static inline void
+emit_one_R10G10B10A2_SSCALED(const void *attrib, void *ptr)
 {
-   float *src = (float *)ptr;
+   float *src = (float *)attrib;
    uint32_t value = 0;
    value |= (uint32_t)(((uint32_t)CLAMP(src[0], -512, 511)) & 0x3ff) ;
    value |= (uint32_t)((((uint32_t)CLAMP(src[1], -512, 511)) & 0x3ff) << 10) ;
    value |= (uint32_t)((((uint32_t)CLAMP(src[2], -512, 511)) & 0x3ff) << 20) ;
    value |= (uint32_t)(((uint32_t)CLAMP(src[3], -2, 1)) << 30) ;
-   *(uint32_t *)attrib = util_le32_to_cpu(value);
+   *(uint32_t *)ptr = util_le32_to_cpu(value);
 }
+EMIT(R10G10B10A2_SSCALED)
 
 static void
-emit_NULL(const void *attrib, void *ptr)
+emit_NULL(const void *attrib, void *ptr, unsigned stride, unsigned count)
 {
    /* do nothing is the only sensible option */
 }
@@ -586,65 +635,159 @@ get_emit_func(enum pipe_format format)
    }
 }
 
-static ALWAYS_INLINE void PIPE_CDECL
-generic_run_one(struct translate_generic *tg,
-                unsigned elt,
-                unsigned start_instance,
-                unsigned instance_id,
-                void *vert)
+/**
+ * Fetch the attribute 'attr' of 'count' vertices into 'data', either from
+ * the consecutive vertices starting at 'start' (elts == NULL) or from the
+ * vertices listed in 'elts'.
+ */
+static void
+generic_fetch_batch(struct translate_generic *tg,
+                    unsigned attr,
+                    const unsigned *elts,
+                    unsigned start,
+                    unsigned count,
+                    float (*data)[4])
+{
+   const uint8_t *input_ptr = tg->attrib[attr].input_ptr;
+   unsigned input_stride = tg->attrib[attr].input_stride;
+   unsigned max_index = tg->attrib[attr].max_index;
+   unsigned i;
+
+   if (!elts && tg->attrib[attr].unpack &&
+       start <= max_index && count - 1 <= max_index - start) {
+      /* No clamping needed: convert the whole run as a single row of
+       * tightly packed vertices, or as a column of one vertex per row.
+       */
+      const uint8_t *src = input_ptr + (ptrdiff_t)input_stride * start;
+
+      if (input_stride == tg->attrib[attr].input_size) {
+         tg->attrib[attr].unpack(data, 0, src, 0, count, 1);
+         return;
+      }
+
+#ifdef USE_AVX2
+      /* The AVX2 fetch below is faster than converting a column. */
+      if (!tg->attrib[attr].fetch_avx2)
+#endif
+      {
+         tg->attrib[attr].unpack(data, sizeof data[0], src, input_stride,
+                                 1, count);
+         return;
+      }
+   }
+
+#ifdef USE_AVX2
+   if (tg->attrib[attr].fetch_avx2) {
+      /* The AVX2 code reads the vertices with 32-bit offsets. */
+      uint64_t last = elts ? max_index :
+                      MIN2((uint64_t)start + count - 1, max_index);
+
+      if (last * input_stride <= INT32_MAX) {
+         tg->attrib[attr].fetch_avx2(data, tg->attrib[attr].swizzle,
+                                     input_ptr, input_stride, elts, start,
+                                     max_index, count);
+         return;
+      }
+   }
+#endif
+
+   for (i = 0; i < count; i++) {
+      unsigned index = elts ? elts[i] : start + i;
+
+      /* clamp to avoid going out of bounds */
+      index = MIN2(index, max_index);
+
+      tg->attrib[attr].fetch(data[i],
+                             input_ptr + (ptrdiff_t)input_stride * index,
+                             0, 0);
+   }
+}
+
+/**
+ * Translate 'count' (at most BATCH_SIZE) vertices, attribute by attribute.
+ */
+static void
+generic_run_batch(struct translate_generic *tg,
+                  const unsigned *elts,
+                  unsigned start,
+                  unsigned count,
+                  unsigned start_instance,
+                  unsigned instance_id,
+                  uint8_t *vert)
 {
+   const unsigned stride = tg->translate.key.output_stride;
    unsigned nr_attrs = tg->nr_attrib;
-   unsigned attr;
+   unsigned attr, i;
+   float data[BATCH_SIZE][4];
+
+   assert(count <= BATCH_SIZE);
 
    for (attr = 0; attr < nr_attrs; attr++) {
-      float data[4];
-      uint8_t *dst = (uint8_t *)vert + tg->attrib[attr].output_offset;
+      uint8_t *dst = vert + tg->attrib[attr].output_offset;
+      int copy_size = tg->attrib[attr].copy_size;
 
       if (tg->attrib[attr].type == TRANSLATE_ELEMENT_NORMAL) {
-         const uint8_t *src;
-         unsigned index;
-         int copy_size;
-
          if (tg->attrib[attr].instance_divisor) {
-            index = start_instance;
+            /* The same value for all the vertices of the batch. */
+            unsigned index = start_instance;
+            const uint8_t *src;
+
             index += (instance_id  / tg->attrib[attr].instance_divisor);
             /* XXX we need to clamp the index here too, but to a
              * per-array max value, not the draw->pt.max_index value
              * that's being given to us via translate->set_buffer().
              */
+            src = tg->attrib[attr].input_ptr +
+                  (ptrdiff_t)tg->attrib[attr].input_stride * index;
+
+            if (likely(copy_size >= 0)) {
+               for (i = 0; i < count; i++)
+                  memcpy(dst + i * stride, src, copy_size);
+            } else {
+               tg->attrib[attr].fetch(data[0], src, 0, 0);
+               for (i = 1; i < count; i++)
+                  memcpy(data[i], data[0], sizeof data[0]);
+               tg->attrib[attr].emit(data, dst, stride, count);
+            }
          }
-         else {
-            index = elt;
-            /* clamp to avoid going out of bounds */
-            index = MIN2(index, tg->attrib[attr].max_index);
-         }
+         else if (likely(copy_size >= 0)) {
+            const uint8_t *input_ptr = tg->attrib[attr].input_ptr;
+            unsigned input_stride = tg->attrib[attr].input_stride;
+            unsigned max_index = tg->attrib[attr].max_index;
 
-         src = tg->attrib[attr].input_ptr +
-               (ptrdiff_t)tg->attrib[attr].input_stride * index;
+            for (i = 0; i < count; i++) {
+               unsigned index = elts ? elts[i] : start + i;
 
-         copy_size = tg->attrib[attr].copy_size;
-         if (likely(copy_size >= 0)) {
-            memcpy(dst, src, copy_size);
-         } else {
-            tg->attrib[attr].fetch(data, src, 0, 0);
+               /* clamp to avoid going out of bounds */
+               index = MIN2(index, max_index);
+
+               memcpy(dst + i * stride,
+                      input_ptr + (ptrdiff_t)input_stride * index,
+                      copy_size);
+            }
+         }
+         else {
+            generic_fetch_batch(tg, attr, elts, start, count, data);
 
             if (0)
-               debug_printf("Fetch linear attr %d  from %p  stride %d  index %d: "
-                         " %f, %f, %f, %f \n",
-                         attr,
-                         tg->attrib[attr].input_ptr,
-                         tg->attrib[attr].input_stride,
-                         index,
-                         data[0], data[1],data[2], data[3]);
-
-            tg->attrib[attr].emit(data, dst);
+               debug_printf("Fetch attr %d  from %p  stride %d  start %d: "
+                            " %f, %f, %f, %f \n",
+                            attr,
+                            tg->attrib[attr].input_ptr,
+                            tg->attrib[attr].input_stride,
+                            elts ? elts[0] : start,
+                            data[0][0], data[0][1], data[0][2], data[0][3]);
+
+            tg->attrib[attr].emit(data, dst, stride, count);
          }
       } else {
-         if (likely(tg->attrib[attr].copy_size >= 0)) {
-            memcpy(data, &instance_id, 4);
+         if (likely(copy_size >= 0)) {
+            for (i = 0; i < count; i++)
+               memcpy(dst + i * stride, &instance_id, 4);
          } else {
-            data[0] = (float)instance_id;
-            tg->attrib[attr].emit(data, dst);
+            for (i = 0; i < count; i++)
+               data[i][0] = (float)instance_id;
+            tg->attrib[attr].emit(data, dst, stride, count);
          }
       }
    }
@@ -662,12 +805,14 @@ generic_run_elts(struct translate *translate,
                  void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
+   uint8_t *vert = output_buffer;
    unsigned i;
 
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   for (i = 0; i < count; i += BATCH_SIZE) {
+      unsigned n = MIN2(count - i, BATCH_SIZE);
+
+      generic_run_batch(tg, elts + i, 0, n, start_instance, instance_id, vert);
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
@@ -680,12 +825,19 @@ generic_run_elts16(struct translate *translate,
                    void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
+   uint8_t *vert = output_buffer;
+   unsigned batch_elts[BATCH_SIZE];
+   unsigned i, j;
 
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   for (i = 0; i < count; i += BATCH_SIZE) {
+      unsigned n = MIN2(count - i, BATCH_SIZE);
+
+      for (j = 0; j < n; j++)
+         batch_elts[j] = *elts++;
+
+      generic_run_batch(tg, batch_elts, 0, n, start_instance, instance_id,
+                        vert);
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
@@ -698,12 +850,19 @@ generic_run_elts8(struct translate *translate,
                   void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
-   unsigned i;
+   uint8_t *vert = output_buffer;
+   unsigned batch_elts[BATCH_SIZE];
+   unsigned i, j;
 
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, *elts++, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   for (i = 0; i < count; i += BATCH_SIZE) {
+      unsigned n = MIN2(count - i, BATCH_SIZE);
+
+      for (j = 0; j < n; j++)
+         batch_elts[j] = *elts++;
+
+      generic_run_batch(tg, batch_elts, 0, n, start_instance, instance_id,
+                        vert);
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
@@ -716,17 +875,19 @@ generic_run(struct translate *translate,
             void *output_buffer)
 {
    struct translate_generic *tg = translate_generic(translate);
-   char *vert = output_buffer;
+   uint8_t *vert = output_buffer;
    unsigned i;
 
-   for (i = 0; i < count; i++) {
-      generic_run_one(tg, start + i, start_instance, instance_id, vert);
-      vert += tg->translate.key.output_stride;
+   for (i = 0; i < count; i += BATCH_SIZE) {
+      unsigned n = MIN2(count - i, BATCH_SIZE);
+
+      generic_run_batch(tg, NULL, start + i, n, start_instance, instance_id,
+                        vert);
+      vert += n * tg->translate.key.output_stride;
    }
 }
 
 
-
 static void
 generic_set_buffer(struct translate *translate,
                    unsigned buf,
@@ -816,15 +977,32 @@ translate_generic_create(const struct translate_key *key)
          if (format_desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED) {
             assert(format_desc->fetch_rgba_sint);
             tg->attrib[i].fetch = (fetch_func)format_desc->fetch_rgba_sint;
+            tg->attrib[i].unpack = (unpack_func)format_desc->unpack_rgba_sint;
          } else {
             assert(format_desc->fetch_rgba_uint);
             tg->attrib[i].fetch = (fetch_func)format_desc->fetch_rgba_uint;
+            tg->attrib[i].unpack = (unpack_func)format_desc->unpack_rgba_uint;
          }
       } else {
          assert(format_desc->fetch_rgba_float);
          tg->attrib[i].fetch = (fetch_func)format_desc->fetch_rgba_float;
+         tg->attrib[i].unpack = (unpack_func)format_desc->unpack_rgba_float;
+
+#ifdef USE_AVX2
+         if (util_cpu_caps.has_avx2) {
+            tg->attrib[i].fetch_avx2 =
+               translate_avx2_get_fetch_func(format_desc);
+            tg->attrib[i].swizzle = format_desc->swizzle;
+         }
+#endif
       }
 
+      /* The row functions are only used for whole bytes per vertex. */
+      if (format_desc->block.width != 1 || format_desc->block.height != 1 ||
+          (format_desc->block.bits & 7))
+         tg->attrib[i].unpack = NULL;
+      tg->attrib[i].input_size = format_desc->block.bits >> 3;
+
       tg->attrib[i].buffer = key->element[i].input_buffer;
       tg->attrib[i].input_offset = key->element[i].input_offset;
       tg->attrib[i].instance_divisor = key->element[i].instance_divisor;
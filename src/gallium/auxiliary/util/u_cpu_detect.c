@@ -538,6 +538,11 @@ util_cpu_detect_once(void)
    check_os_arm_support();
 #endif
 
+#if defined(PIPE_ARCH_AARCH64)
+   /* Advanced SIMD is mandatory on AArch64. */
+   util_cpu_caps.has_neon = 1;
+#endif
+
 #if defined(PIPE_ARCH_PPC)
    check_os_altivec_support();
 #endif /* PIPE_ARCH_PPC */
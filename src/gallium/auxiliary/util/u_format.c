@@ -598,6 +598,7 @@ util_format_translate(enum pipe_format dst_format,
 {
    const struct util_format_description *dst_format_desc;
    const struct util_format_description *src_format_desc;
+   util_format_convert_func convert;
    uint8_t *dst_row;
    const uint8_t *src_row;
    unsigned x_step, y_step;
@@ -626,6 +627,16 @@ util_format_translate(enum pipe_format dst_format,
    dst_row = (uint8_t *)dst + dst_y*dst_stride + dst_x*(dst_format_desc->block.bits/8);
    src_row = (const uint8_t *)src + src_y*src_stride + src_x*(src_format_desc->block.bits/8);
 
+   convert = util_format_get_convert_func(dst_format, src_format);
+   if (convert) {
+      /*
+       * Common pair of formats, converted without intermediate buffer.
+       */
+
+      convert(dst_row, dst_stride, src_row, src_stride, width, height);
+      return TRUE;
+   }
+
    /*
     * This works because all pixel formats have pixel blocks with power of two
     * sizes.
@@ -641,7 +652,6 @@ util_format_translate(enum pipe_format dst_format,
 
    /*
     * TODO: double formats will loose precision
-    * TODO: Add a special case for formats that are mere swizzles of each other
     */
 
    if (src_format_desc->colorspace == UTIL_FORMAT_COLORSPACE_ZS ||
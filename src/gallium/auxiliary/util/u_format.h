@@ -1280,6 +1280,23 @@ util_format_write_4i(enum pipe_format format,
 boolean
 util_format_fits_8unorm(const struct util_format_description *format_desc);
 
+/**
+ * Function converting rows of pixels straight from one format to another.
+ */
+typedef void
+(*util_format_convert_func)(uint8_t *dst_row, unsigned dst_stride,
+                            const uint8_t *src_row, unsigned src_stride,
+                            unsigned width, unsigned height);
+
+/**
+ * Return the generated function converting src_format pixels to dst_format
+ * ones without going through rgba_float or rgba_8unorm, or NULL if there is
+ * none for this pair of formats.
+ */
+util_format_convert_func
+util_format_get_convert_func(enum pipe_format dst_format,
+                             enum pipe_format src_format);
+
 boolean
 util_format_translate(enum pipe_format dst_format,
                       void *dst, unsigned dst_stride,
@@ -444,6 +444,50 @@ def conversion_expr(src_channel,
     return value
 
 
+def unpack_bitmask_channel_expr(channel, depth, value):
+    '''Generate the expression extracting a channel from the integer holding
+    a pixel of a bitmask format.'''
+
+    shift = channel.shift
+    if channel.type == UNSIGNED:
+        if shift:
+            value = '%s >> %u' % (value, shift)
+        if shift + channel.size < depth:
+            value = '(%s) & 0x%x' % (value, (1 << channel.size) - 1)
+    elif channel.type == SIGNED:
+        if shift + channel.size < depth:
+            # Align the sign bit
+            lshift = depth - (shift + channel.size)
+            value = '%s << %u' % (value, lshift)
+        # Cast to signed
+        value = '(int%u_t)(%s) ' % (depth, value)
+        if channel.size < depth:
+            # Align the LSB bit
+            rshift = depth - channel.size
+            value = '(%s) >> %u' % (value, rshift)
+    else:
+        value = None
+    return value
+
+
+def pack_bitmask_channel_expr(channel, depth, value):
+    '''Generate the expression placing a channel value in the integer holding
+    a pixel of a bitmask format.'''
+
+    shift = channel.shift
+    if channel.type in (UNSIGNED, SIGNED):
+        if shift + channel.size < depth:
+            value = '(%s) & 0x%x' % (value, (1 << channel.size) - 1)
+        if shift:
+            value = '(%s) << %u' % (value, shift)
+        if channel.type == SIGNED:
+            # Cast to unsigned
+            value = '(uint%u_t)(%s) ' % (depth, value)
+    else:
+        value = None
+    return value
+
+
 def generate_unpack_kernel(format, dst_channel, dst_native_type):
 
     if not is_format_supported(format):
@@ -468,27 +512,7 @@ def generate_unpack_kernel(format, dst_channel, dst_native_type):
         # Compute the intermediate unshifted values 
         for i in range(format.nr_channels()):
             src_channel = channels[i]
-            value = 'value'
-            shift = src_channel.shift
-            if src_channel.type == UNSIGNED:
-                if shift:
-                    value = '%s >> %u' % (value, shift)
-                if shift + src_channel.size < depth:
-                    value = '(%s) & 0x%x' % (value, (1 << src_channel.size) - 1)
-            elif src_channel.type == SIGNED:
-                if shift + src_channel.size < depth:
-                    # Align the sign bit
-                    lshift = depth - (shift + src_channel.size)
-                    value = '%s << %u' % (value, lshift)
-                # Cast to signed
-                value = '(int%u_t)(%s) ' % (depth, value)
-                if src_channel.size < depth:
-                    # Align the LSB bit
-                    rshift = depth - src_channel.size
-                    value = '(%s) >> %u' % (value, rshift)
-            else:
-                value = None
-                
+            value = unpack_bitmask_channel_expr(src_channel, depth, 'value')
             if value is not None:
                 print('         %s = %s;' % (src_channel.name, value))
                 
@@ -566,7 +590,6 @@ def generate_pack_kernel(format, src_channel, src_native_type):
 
         for i in range(4):
             dst_channel = channels[i]
-            shift = dst_channel.shift
             if inv_swizzle[i] is not None:
                 value ='src[%u]' % inv_swizzle[i]
                 dst_colorspace = format.colorspace
@@ -577,16 +600,7 @@ def generate_pack_kernel(format, src_channel, src_native_type):
                                         dst_channel, dst_native_type, 
                                         value,
                                         dst_colorspace = dst_colorspace)
-                if dst_channel.type in (UNSIGNED, SIGNED):
-                    if shift + dst_channel.size < depth:
-                        value = '(%s) & 0x%x' % (value, (1 << dst_channel.size) - 1)
-                    if shift:
-                        value = '(%s) << %u' % (value, shift)
-                    if dst_channel.type == SIGNED:
-                        # Cast to unsigned
-                        value = '(uint%u_t)(%s) ' % (depth, value)
-                else:
-                    value = None
+                value = pack_bitmask_channel_expr(dst_channel, depth, value)
                 if value is not None:
                     print('         value |= %s;' % (value))
                 
@@ -621,11 +635,864 @@ def generate_pack_kernel(format, src_channel, src_native_type):
         print_channels(format, pack_into_union)
 
 
+def simd_format_kind(format):
+    '''Return the kind of SSE2 row kernels the format gets, if any: four
+    channels of unorm8, unorm16 or float32 in a 1x1 block.'''
+
+    if format.colorspace != RGB:
+        return None
+    return simd_channel_kind(format)
+
+
+def simd_channel_kind(format):
+    '''Like simd_format_kind(), regardless of the colorspace.'''
+
+    if format.layout != PLAIN:
+        return None
+    if format.block_width != 1 or format.block_height != 1:
+        return None
+
+    channels = format.le_channels
+    swizzles = format.le_swizzles
+    inv_swizzle = inv_swizzles(swizzles)
+
+    first = None
+    for i in range(4):
+        channel = channels[i]
+        if channel.type == VOID:
+            continue
+        if first is None:
+            first = channel
+        if channel.type != first.type or channel.norm != first.norm or \
+           channel.pure or channel.size != first.size:
+            return None
+        if inv_swizzle[i] is None:
+            return None
+    if first is None:
+        return None
+    for channel in channels:
+        if channel.size != first.size:
+            return None
+    for swizzle in swizzles:
+        if swizzle == SWIZZLE_NONE:
+            return None
+        if swizzle < 4 and channels[swizzle].type == VOID:
+            return None
+
+    if first.type == UNSIGNED and first.norm and first.size == 8:
+        return 'unorm8'
+    if first.type == UNSIGNED and first.norm and first.size == 16:
+        return 'unorm16'
+    if first.type == FLOAT and first.size == 32:
+        return 'float32'
+    return None
+
+
+def sse2_byte_remap(value, moves, ones, avx2 = False):
+    '''Expression moving bytes within the 32-bit lanes of value.  moves is a
+    list of (src bit, dst bit) pairs of bytes, ones a mask of the bytes
+    set to 0xff.  With avx2, value is a 256-bit vector.'''
+
+    mm, si = avx2 and ('_mm256', 'si256') or ('_mm', 'si128')
+    groups = {}
+    for src, dst in moves:
+        groups[dst - src] = groups.get(dst - src, 0) | (0xff << dst)
+
+    terms = []
+    for delta in sorted(groups):
+        mask = groups[delta]
+        term = value
+        if delta > 0:
+            term = '%s_slli_epi32(%s, %u)' % (mm, term, delta)
+        elif delta < 0:
+            term = '%s_srli_epi32(%s, %u)' % (mm, term, -delta)
+        if mask != 0xffffffff:
+            term = '%s_and_%s(%s, %s_set1_epi32((int)0x%08x))' % (mm, si, term, mm, mask)
+        terms.append(term)
+    if ones:
+        terms.append('%s_set1_epi32((int)0x%08x)' % (mm, ones))
+    if not terms:
+        return '%s_setzero_%s()' % (mm, si)
+
+    expr = terms[0]
+    for term in terms[1:]:
+        expr = '%s_or_%s(%s, %s)' % (mm, si, expr, term)
+    return expr
+
+
+def sse2_unpack_moves(format):
+    '''Byte moves from the channels of a pixel, at the position of their
+    element, to rgba order.'''
+
+    channels = format.le_channels
+    moves = []
+    ones = 0
+    for i in range(4):
+        swizzle = format.le_swizzles[i]
+        if swizzle < 4:
+            channel = channels[swizzle]
+            moves.append((channel.shift // channel.size * 8, i * 8))
+        elif swizzle == SWIZZLE_1:
+            ones |= 0xff << (i * 8)
+    return moves, ones
+
+
+def sse2_pack_moves(format):
+    '''Byte moves from rgba order to the elements of the channels.'''
+
+    channels = format.le_channels
+    inv_swizzle = inv_swizzles(format.le_swizzles)
+    moves = []
+    for i in range(4):
+        channel = channels[i]
+        if channel.type != VOID:
+            moves.append((inv_swizzle[i] * 8, channel.shift // channel.size * 8))
+    return moves
+
+
+def sse2_float_swizzle(value, swizzles, elements, avx2 = False):
+    '''Expression selecting the elements of a float vector.  swizzles[i]
+    is the element of lane i, SWIZZLE_0 or SWIZZLE_1.  With avx2, value
+    holds two pixels, swizzled alike.'''
+
+    mm, si, pixels = avx2 and ('_mm256', 'si256', 2) or ('_mm', 'si128', 1)
+    lanes = []
+    keep = []
+    consts = []
+    for i in range(4):
+        swizzle = swizzles[i]
+        if swizzle < 4:
+            lanes.append(elements[swizzle])
+            keep.append('-1')
+            consts.append('0.0f')
+        else:
+            lanes.append(i)
+            keep.append('0')
+            consts.append(swizzle == SWIZZLE_1 and '1.0f' or '0.0f')
+
+    if lanes != [0, 1, 2, 3]:
+        value = '%s_shuffle_ps(%s, %s, _MM_SHUFFLE(%u, %u, %u, %u))' % \
+                (mm, value, value, lanes[3], lanes[2], lanes[1], lanes[0])
+    if '0' in keep:
+        value = '%s_and_ps(%s, %s_castsi%s_ps(%s_setr_epi32(%s)))' % \
+                (mm, value, mm, si[2:], mm, ', '.join(keep * pixels))
+    if '1.0f' in consts:
+        value = '%s_or_ps(%s, %s_setr_ps(%s))' % \
+                (mm, value, mm, ', '.join(consts * pixels))
+    return value
+
+
+def sse2_elements(format):
+    '''Element of the pixel holding each channel.'''
+
+    return [channel.shift // channel.size for channel in format.le_channels]
+
+
+def sse2_pack_swizzles(format):
+    '''Source lane of each element when packing rgba.'''
+
+    inv_swizzle = inv_swizzles(format.le_swizzles)
+    swizzles = [SWIZZLE_0] * 4
+    for i in range(4):
+        channel = format.le_channels[i]
+        if channel.type != VOID:
+            swizzles[channel.shift // channel.size] = inv_swizzle[i]
+    return swizzles
+
+
+def generate_sse2_float_to_8unorm(values, indent):
+    '''Convert four vectors of rgba floats to a vector of four rgba8 pixels
+    named rgba, rounding like float_to_ubyte().'''
+
+    print(indent + 'const __m128 zero = _mm_setzero_ps();')
+    print(indent + 'const __m128 one = _mm_set1_ps(1.0f);')
+    print(indent + 'const __m128 scale = _mm_set1_ps(255.0f/256.0f);')
+    print(indent + 'const __m128 magic = _mm_set1_ps(32768.0f);')
+    print(indent + 'const __m128i mask = _mm_set1_epi32(0xff);')
+    print(indent + '__m128i p[4], rgba;')
+    for k in range(4):
+        print(indent + 'p[%u] = _mm_castps_si128(_mm_min_ps(_mm_max_ps(%s, zero), one));' % (k, values[k]))
+        print(indent + 'p[%u] = _mm_castps_si128(_mm_add_ps(_mm_mul_ps(_mm_castsi128_ps(p[%u]), scale), magic));' % (k, k))
+        print(indent + 'p[%u] = _mm_and_si128(p[%u], mask);' % (k, k))
+    print(indent + 'rgba = _mm_packus_epi16(_mm_packs_epi32(p[0], p[1]), _mm_packs_epi32(p[2], p[3]));')
+
+
+def generate_sse2_8unorm_to_float(value, dst, indent):
+    '''Convert a vector of four pixels of 8-bit channels to floats, like
+    ubyte_to_float().'''
+
+    print(indent + 'const __m128i zero = _mm_setzero_si128();')
+    print(indent + 'const __m128 scale = _mm_set1_ps(1.0f/255.0f);')
+    print(indent + 'const __m128i lo = _mm_unpacklo_epi8(%s, zero);' % value)
+    print(indent + 'const __m128i hi = _mm_unpackhi_epi8(%s, zero);' % value)
+    print(indent + '_mm_storeu_ps(%s + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));' % dst)
+    print(indent + '_mm_storeu_ps(%s + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));' % dst)
+    print(indent + '_mm_storeu_ps(%s + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));' % dst)
+    print(indent + '_mm_storeu_ps(%s + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));' % dst)
+
+
+def generate_sse2_kernel(format, kind, suffix, unpack):
+    '''Generate the body of a loop converting four pixels at once, with the
+    same results as the scalar kernels.'''
+
+    indent = '            '
+    elements = sse2_elements(format)
+
+    if kind == 'unorm8':
+        if unpack:
+            moves, ones = sse2_unpack_moves(format)
+            print(indent + 'const __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+            print(indent + 'const __m128i rgba = %s;' % sse2_byte_remap('pixels', moves, ones))
+            if suffix == 'rgba_8unorm':
+                print(indent + '_mm_storeu_si128((__m128i *)dst, rgba);')
+            else:
+                generate_sse2_8unorm_to_float('rgba', 'dst', indent)
+        else:
+            if suffix == 'rgba_8unorm':
+                print(indent + 'const __m128i rgba = _mm_loadu_si128((const __m128i *)src);')
+            else:
+                generate_sse2_float_to_8unorm(['_mm_loadu_ps(src + %u)' % (4 * k) for k in range(4)], indent)
+            value = sse2_byte_remap('rgba', sse2_pack_moves(format), 0)
+            print(indent + '_mm_storeu_si128((__m128i *)dst, %s);' % value)
+
+    elif kind == 'unorm16':
+        if unpack:
+            print(indent + 'const __m128i pixels[2] = {')
+            print(indent + '   _mm_loadu_si128((const __m128i *)src),')
+            print(indent + '   _mm_loadu_si128((const __m128i *)src + 1)')
+            print(indent + '};')
+            if suffix == 'rgba_8unorm':
+                # Elements of the four pixels, in the high bytes of the channels
+                moves, ones = sse2_unpack_moves(format)
+                print(indent + 'const __m128i elements = _mm_packus_epi16(_mm_srli_epi16(pixels[0], 8), _mm_srli_epi16(pixels[1], 8));')
+                print(indent + '_mm_storeu_si128((__m128i *)dst, %s);' % sse2_byte_remap('elements', moves, ones))
+            else:
+                print(indent + 'const __m128i zero = _mm_setzero_si128();')
+                print(indent + 'const __m128 scale = _mm_set1_ps(1.0f/0xffff);')
+                print(indent + 'unsigned k;')
+                print(indent + 'for (k = 0; k < 2; k++) {')
+                for half, unpack_func in ((0, '_mm_unpacklo_epi16'), (1, '_mm_unpackhi_epi16')):
+                    value = '_mm_mul_ps(_mm_cvtepi32_ps(%s(pixels[k], zero)), scale)' % unpack_func
+                    value = sse2_float_swizzle(value, format.le_swizzles, elements)
+                    print(indent + '   _mm_storeu_ps(dst + 8*k + %u, %s);' % (4 * half, value))
+                print(indent + '}')
+        else:
+            if suffix == 'rgba_8unorm':
+                moves = sse2_pack_moves(format)
+                print(indent + 'const __m128i rgba = _mm_loadu_si128((const __m128i *)src);')
+                print(indent + 'const __m128i elements = %s;' % sse2_byte_remap('rgba', moves, 0))
+                # x * 0xffff / 0xff == x * 0x101
+                print(indent + '_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(elements, elements));')
+                print(indent + '_mm_storeu_si128((__m128i *)dst + 1, _mm_unpackhi_epi8(elements, elements));')
+            else:
+                # Like util_iround(CLAMP(x, 0.0f, 1.0f) * 0xffff) for x86-64
+                print(indent + 'const __m128 zero = _mm_setzero_ps();')
+                print(indent + 'const __m128 one = _mm_set1_ps(1.0f);')
+                print(indent + 'const __m128 scale = _mm_set1_ps((float)0xffff);')
+                print(indent + 'const __m128 half = _mm_set1_ps(0.5f);')
+                print(indent + 'const __m128i bias = _mm_set1_epi32(0x8000);')
+                print(indent + '__m128i p[4];')
+                print(indent + 'unsigned k;')
+                print(indent + 'for (k = 0; k < 4; k++) {')
+                value = sse2_float_swizzle('_mm_loadu_ps(src + 4*k)', sse2_pack_swizzles(format), [0, 1, 2, 3])
+                print(indent + '   __m128 v = %s;' % value)
+                print(indent + '   v = _mm_min_ps(_mm_max_ps(v, zero), one);')
+                print(indent + '   v = _mm_add_ps(_mm_mul_ps(v, scale), half);')
+                print(indent + '   p[k] = _mm_sub_epi32(_mm_cvttps_epi32(v), bias);')
+                print(indent + '}')
+                print(indent + '_mm_storeu_si128((__m128i *)dst, _mm_xor_si128(_mm_packs_epi32(p[0], p[1]), _mm_set1_epi16((short)0x8000)));')
+                print(indent + '_mm_storeu_si128((__m128i *)dst + 1, _mm_xor_si128(_mm_packs_epi32(p[2], p[3]), _mm_set1_epi16((short)0x8000)));')
+
+    elif kind == 'float32':
+        if unpack:
+            values = [sse2_float_swizzle('_mm_loadu_ps((const float *)src + %u)' % (4 * k),
+                                         format.le_swizzles, elements)
+                      for k in range(4)]
+            if suffix == 'rgba_float':
+                for k in range(4):
+                    print(indent + '_mm_storeu_ps(dst + %u, %s);' % (4 * k, values[k]))
+            else:
+                generate_sse2_float_to_8unorm(values, indent)
+                print(indent + '_mm_storeu_si128((__m128i *)dst, rgba);')
+        else:
+            swizzles = sse2_pack_swizzles(format)
+            if suffix == 'rgba_float':
+                for k in range(4):
+                    value = sse2_float_swizzle('_mm_loadu_ps(src + %u)' % (4 * k), swizzles, [0, 1, 2, 3])
+                    print(indent + '_mm_storeu_ps((float *)dst + %u, %s);' % (4 * k, value))
+            else:
+                moves = sse2_pack_moves(format)
+                print(indent + 'const __m128i rgba = _mm_loadu_si128((const __m128i *)src);')
+                print(indent + 'const __m128i elements = %s;' % sse2_byte_remap('rgba', moves, 0))
+                generate_sse2_8unorm_to_float('elements', '(float *)dst', indent)
+    else:
+        assert False
+
+
+def simd_kernels(format, suffix, unpack):
+    '''The (isa, kernel) pairs of the row kernels of a function.'''
+
+    if simd_format_kind(format) is None or \
+       suffix not in ('rgba_float', 'rgba_8unorm'):
+        return []
+    return [(isa, simd_kernel(format.short_name(), suffix, isa, unpack))
+            for isa in simd_isas]
+
+
+def generate_sse2_loop(format, suffix, unpack):
+    '''Generate the loop converting four pixels at once, after the call to
+    the kernels of the other ISAs and before the loop converting the
+    remaining pixels.'''
+
+    kind = simd_format_kind(format)
+    if kind is None or suffix not in ('rgba_float', 'rgba_8unorm'):
+        print('      for(x = 0; x < width; x += %u) {' % (format.block_width,))
+        return
+
+    print('      x = 0;')
+    if unpack:
+        generate_simd_calls(simd_kernels(format, suffix, unpack),
+                            format.block_size() // 8, 4)
+    else:
+        generate_simd_calls(simd_kernels(format, suffix, unpack),
+                            4, format.block_size() // 8)
+    print('#ifdef UTIL_FORMAT_SSE2')
+    print('      if (util_cpu_caps.has_sse2) {')
+    print('         for(; x + 4 <= width; x += 4) {')
+    generate_sse2_kernel(format, kind, suffix, unpack)
+    if unpack:
+        print('            src += %u;' % (4 * format.block_size() // 8,))
+        print('            dst += 16;')
+    else:
+        print('            src += 16;')
+        print('            dst += %u;' % (4 * format.block_size() // 8,))
+    print('         }')
+    print('      }')
+    print('#endif')
+    print('      for(; x < width; x += 1) {')
+
+
+# The ISAs whose row kernels are generated in separate files, compiled with
+# their own flags, by u_format_table.py --simd=<isa>.
+simd_isas = ('avx2', 'neon')
+
+simd_pixels = {
+    'avx2': 8,
+    'neon': 8,
+}
+
+
+def simd_kernel(name, suffix, isa, unpack):
+    '''Return the name and the parameters of a row kernel.  The kernels
+    convert as many pixels as they can at once and return their number.'''
+
+    native_type = suffix == 'rgba_float' and 'float' or 'uint8_t'
+    if unpack:
+        return ('util_format_%s_unpack_%s_%s' % (name, suffix, isa),
+                '%s *dst, const uint8_t *src, unsigned width' % native_type)
+    else:
+        return ('util_format_%s_pack_%s_%s' % (name, suffix, isa),
+                'uint8_t *dst, const %s *src, unsigned width' % native_type)
+
+
+def simd_convert_kernel(src_format, dst_format, isa):
+    return ('util_format_%s_from_%s_%s' % (dst_format.short_name(), src_format.short_name(), isa),
+            'uint8_t *dst, const uint8_t *src, unsigned width')
+
+
+def generate_simd_prototypes(kernels, guard = True):
+    '''Declare the kernels of each ISA, as (isa, (name, params)) pairs, if
+    the build has them unless guard is False.'''
+
+    for isa, kernel in kernels:
+        if guard:
+            print('#ifdef UTIL_FORMAT_%s' % isa.upper())
+        print('unsigned')
+        print('%s(%s);' % kernel)
+        if guard:
+            print('#endif')
+
+
+def generate_simd_calls(kernels, src_step, dst_step):
+    '''Call the kernels of each ISA before the other loops, and skip the
+    pixels they converted.'''
+
+    for isa, kernel in kernels:
+        print('#ifdef UTIL_FORMAT_%s' % isa.upper())
+        print('      if (util_cpu_caps.has_%s) {' % isa)
+        print('         x = %s(dst, src, width);' % kernel[0])
+        print('         src += x * %u;' % src_step)
+        print('         dst += x * %u;' % dst_step)
+        print('      }')
+        print('#endif')
+
+
+def generate_avx2_kernel(format, kind, suffix, unpack):
+    '''Generate the body of a loop converting eight pixels at once, like
+    generate_sse2_kernel() does with four.'''
+
+    indent = '      '
+    elements = sse2_elements(format)
+
+    def remap(value, moves, ones):
+        return sse2_byte_remap(value, moves, ones, avx2 = True)
+
+    def swizzle(value, swizzles, elements):
+        return sse2_float_swizzle(value, swizzles, elements, avx2 = True)
+
+    if kind == 'unorm8':
+        if unpack:
+            moves, ones = sse2_unpack_moves(format)
+            print(indent + 'const __m256i pixels = _mm256_loadu_si256((const __m256i *)src);')
+            print(indent + 'const __m256i rgba = %s;' % remap('pixels', moves, ones))
+            if suffix == 'rgba_8unorm':
+                print(indent + '_mm256_storeu_si256((__m256i *)dst, rgba);')
+            else:
+                print(indent + 'avx2_8unorm_to_float(dst, rgba);')
+        else:
+            if suffix == 'rgba_8unorm':
+                print(indent + 'const __m256i rgba = _mm256_loadu_si256((const __m256i *)src);')
+            else:
+                print(indent + 'const __m256 values[4] = {')
+                print(indent + '   _mm256_loadu_ps(src), _mm256_loadu_ps(src + 8),')
+                print(indent + '   _mm256_loadu_ps(src + 16), _mm256_loadu_ps(src + 24)')
+                print(indent + '};')
+                print(indent + 'const __m256i rgba = avx2_float_to_8unorm(values);')
+            value = remap('rgba', sse2_pack_moves(format), 0)
+            print(indent + '_mm256_storeu_si256((__m256i *)dst, %s);' % value)
+
+    elif kind == 'unorm16':
+        if unpack:
+            print(indent + 'const __m256i pixels[2] = {')
+            print(indent + '   _mm256_loadu_si256((const __m256i *)src),')
+            print(indent + '   _mm256_loadu_si256((const __m256i *)src + 1)')
+            print(indent + '};')
+            if suffix == 'rgba_8unorm':
+                # The high bytes of the channels; packus works within 128-bit
+                # lanes, so the pixels come out as 0-1, 4-5, 2-3, 6-7.
+                moves, ones = sse2_unpack_moves(format)
+                print(indent + 'const __m256i elements = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(pixels[0], 8), _mm256_srli_epi16(pixels[1], 8)), _MM_SHUFFLE(3, 1, 2, 0));')
+                print(indent + '_mm256_storeu_si256((__m256i *)dst, %s);' % remap('elements', moves, ones))
+            else:
+                print(indent + 'const __m256 scale = _mm256_set1_ps(1.0f/0xffff);')
+                print(indent + 'unsigned k;')
+                print(indent + 'for (k = 0; k < 2; k++) {')
+                for half, extract in ((0, '_mm256_castsi256_si128(pixels[k])'),
+                                      (1, '_mm256_extracti128_si256(pixels[k], 1)')):
+                    value = '_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(%s)), scale)' % extract
+                    value = swizzle(value, format.le_swizzles, elements)
+                    print(indent + '   _mm256_storeu_ps(dst + 16*k + %u, %s);' % (8 * half, value))
+                print(indent + '}')
+        else:
+            if suffix == 'rgba_8unorm':
+                moves = sse2_pack_moves(format)
+                print(indent + 'const __m256i rgba = _mm256_loadu_si256((const __m256i *)src);')
+                print(indent + 'const __m256i elements = %s;' % remap('rgba', moves, 0))
+                # x * 0xffff / 0xff == x * 0x101
+                print(indent + 'const __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(elements));')
+                print(indent + 'const __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(elements, 1));')
+                print(indent + '_mm256_storeu_si256((__m256i *)dst, _mm256_or_si256(lo, _mm256_slli_epi16(lo, 8)));')
+                print(indent + '_mm256_storeu_si256((__m256i *)dst + 1, _mm256_or_si256(hi, _mm256_slli_epi16(hi, 8)));')
+            else:
+                # Like util_iround(CLAMP(x, 0.0f, 1.0f) * 0xffff) for x86-64;
+                # packus works within 128-bit lanes, so the pixels come out
+                # as 0, 2, 1, 3.
+                print(indent + 'const __m256 zero = _mm256_setzero_ps();')
+                print(indent + 'const __m256 one = _mm256_set1_ps(1.0f);')
+                print(indent + 'const __m256 scale = _mm256_set1_ps((float)0xffff);')
+                print(indent + 'const __m256 half = _mm256_set1_ps(0.5f);')
+                print(indent + '__m256i p[4];')
+                print(indent + 'unsigned k;')
+                print(indent + 'for (k = 0; k < 4; k++) {')
+                value = swizzle('_mm256_loadu_ps(src + 8*k)', sse2_pack_swizzles(format), [0, 1, 2, 3])
+                print(indent + '   __m256 v = %s;' % value)
+                print(indent + '   v = _mm256_min_ps(_mm256_max_ps(v, zero), one);')
+                print(indent + '   v = _mm256_add_ps(_mm256_mul_ps(v, scale), half);')
+                print(indent + '   p[k] = _mm256_cvttps_epi32(v);')
+                print(indent + '}')
+                print(indent + '_mm256_storeu_si256((__m256i *)dst, _mm256_permute4x64_epi64(_mm256_packus_epi32(p[0], p[1]), _MM_SHUFFLE(3, 1, 2, 0)));')
+                print(indent + '_mm256_storeu_si256((__m256i *)dst + 1, _mm256_permute4x64_epi64(_mm256_packus_epi32(p[2], p[3]), _MM_SHUFFLE(3, 1, 2, 0)));')
+
+    elif kind == 'float32':
+        if unpack:
+            values = [swizzle('_mm256_loadu_ps((const float *)src + %u)' % (8 * k),
+                              format.le_swizzles, elements)
+                      for k in range(4)]
+            if suffix == 'rgba_float':
+                for k in range(4):
+                    print(indent + '_mm256_storeu_ps(dst + %u, %s);' % (8 * k, values[k]))
+            else:
+                print(indent + 'const __m256 values[4] = {')
+                for k in range(4):
+                    print(indent + '   %s%s' % (values[k], k < 3 and ',' or ''))
+                print(indent + '};')
+                print(indent + '_mm256_storeu_si256((__m256i *)dst, avx2_float_to_8unorm(values));')
+        else:
+            swizzles = sse2_pack_swizzles(format)
+            if suffix == 'rgba_float':
+                for k in range(4):
+                    value = swizzle('_mm256_loadu_ps(src + %u)' % (8 * k), swizzles, [0, 1, 2, 3])
+                    print(indent + '_mm256_storeu_ps((float *)dst + %u, %s);' % (8 * k, value))
+            else:
+                moves = sse2_pack_moves(format)
+                print(indent + 'const __m256i rgba = _mm256_loadu_si256((const __m256i *)src);')
+                print(indent + 'const __m256i elements = %s;' % remap('rgba', moves, 0))
+                print(indent + 'avx2_8unorm_to_float((float *)dst, elements);')
+    else:
+        assert False
+
+
+# NEON kernels load the pixels with the channels split in planes of eight
+# values, convert the planes and store them interleaved again.  A plane is
+# an uint8x8_t, an uint16x8_t or a pair of float32x4_t.
+
+def neon_plane_type(kind):
+    return {'unorm8': 'u8', 'unorm16': 'u16', 'float32': 'f32'}[kind]
+
+
+def neon_load(type, src, indent):
+    '''Load eight pixels, returning the expressions of their four planes.'''
+
+    if type == 'u8':
+        print(indent + 'const uint8x8x4_t in = vld4_u8((const uint8_t *)%s);' % src)
+        return ['in.val[%u]' % i for i in range(4)]
+    if type == 'u16':
+        print(indent + 'const uint16x8x4_t in = vld4q_u16((const uint16_t *)%s);' % src)
+        return ['in.val[%u]' % i for i in range(4)]
+    if type == 'f32':
+        print(indent + 'const float32x4x4_t in[2] = {')
+        print(indent + '   vld4q_f32((const float *)%s),' % src)
+        print(indent + '   vld4q_f32((const float *)%s + 16)' % src)
+        print(indent + '};')
+        return [('in[0].val[%u]' % i, 'in[1].val[%u]' % i) for i in range(4)]
+    assert False
+
+
+def neon_constant(type, swizzle):
+    one = swizzle == SWIZZLE_1
+    if type == 'u8':
+        return 'vdup_n_u8(%s)' % (one and '0xff' or '0')
+    if type == 'u16':
+        return 'vdupq_n_u16(%s)' % (one and '0xffff' or '0')
+    if type == 'f32':
+        value = 'vdupq_n_f32(%s)' % (one and '1.0f' or '0.0f')
+        return (value, value)
+    assert False
+
+
+def neon_convert(src_type, dst_type, plane):
+    '''Expression converting a plane, with the same results as the scalar
+    code.'''
+
+    if src_type == dst_type:
+        return plane
+    if src_type == 'u8' and dst_type == 'u16':
+        # x * 0xffff / 0xff == x * 0x101
+        return 'vmulq_n_u16(vmovl_u8(%s), 0x101)' % plane
+    if src_type == 'u16' and dst_type == 'u8':
+        return 'vshrn_n_u16(%s, 8)' % plane
+    if src_type == 'u8' and dst_type == 'f32':
+        wide = 'vmovl_u8(%s)' % plane
+        return ('neon_unorm_to_float(vget_low_u16(%s), 1.0f/0xff)' % wide,
+                'neon_unorm_to_float(vget_high_u16(%s), 1.0f/0xff)' % wide)
+    if src_type == 'u16' and dst_type == 'f32':
+        return ('neon_unorm_to_float(vget_low_u16(%s), 1.0f/0xffff)' % plane,
+                'neon_unorm_to_float(vget_high_u16(%s), 1.0f/0xffff)' % plane)
+    if src_type == 'f32' and dst_type == 'u8':
+        return 'neon_float_to_8unorm(%s, %s)' % plane
+    if src_type == 'f32' and dst_type == 'u16':
+        return 'neon_float_to_16unorm(%s, %s)' % plane
+    assert False
+
+
+def neon_store(type, dst, planes, indent):
+    if type == 'u8':
+        print(indent + 'uint8x8x4_t out;')
+        for i in range(4):
+            print(indent + 'out.val[%u] = %s;' % (i, planes[i]))
+        print(indent + 'vst4_u8((uint8_t *)%s, out);' % dst)
+    elif type == 'u16':
+        print(indent + 'uint16x8x4_t out;')
+        for i in range(4):
+            print(indent + 'out.val[%u] = %s;' % (i, planes[i]))
+        print(indent + 'vst4q_u16((uint16_t *)%s, out);' % dst)
+    elif type == 'f32':
+        print(indent + 'float32x4x4_t out[2];')
+        for i in range(4):
+            print(indent + 'out[0].val[%u] = %s;' % (i, planes[i][0]))
+            print(indent + 'out[1].val[%u] = %s;' % (i, planes[i][1]))
+        print(indent + 'vst4q_f32((float *)%s, out[0]);' % dst)
+        print(indent + 'vst4q_f32((float *)%s + 16, out[1]);' % dst)
+    else:
+        assert False
+
+
+def generate_neon_kernel(format, kind, suffix, unpack):
+    '''Generate the body of a loop converting eight pixels at once.'''
+
+    indent = '      '
+    elements = sse2_elements(format)
+    format_type = neon_plane_type(kind)
+    rgba_type = suffix == 'rgba_float' and 'f32' or 'u8'
+
+    if unpack:
+        planes = neon_load(format_type, 'src', indent)
+        out = []
+        for swizzle in format.le_swizzles:
+            if swizzle < 4:
+                out.append(neon_convert(format_type, rgba_type, planes[elements[swizzle]]))
+            else:
+                out.append(neon_constant(rgba_type, swizzle))
+        neon_store(rgba_type, 'dst', out, indent)
+    else:
+        planes = neon_load(rgba_type, 'src', indent)
+        swizzles = sse2_pack_swizzles(format)
+        out = []
+        for swizzle in swizzles:
+            if swizzle < 4:
+                out.append(neon_convert(rgba_type, format_type, planes[swizzle]))
+            else:
+                out.append(neon_constant(format_type, swizzle))
+        neon_store(format_type, 'dst', out, indent)
+
+
+def generate_simd_preamble(isa):
+    '''Generate the includes and the helpers of the kernels of an ISA.'''
+
+    print('#include "pipe/p_compiler.h"')
+    print()
+    if isa == 'avx2':
+        print('#include <immintrin.h>')
+        print('''
+
+/**
+ * Convert the 32 bytes of v to floats, like ubyte_to_float().
+ */
+static inline void
+avx2_8unorm_to_float(float *dst, __m256i v)
+{
+   const __m256 scale = _mm256_set1_ps(1.0f/255.0f);
+   const __m128i lo = _mm256_castsi256_si128(v);
+   const __m128i hi = _mm256_extracti128_si256(v, 1);
+   _mm256_storeu_ps(dst + 0, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(lo)), scale));
+   _mm256_storeu_ps(dst + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8))), scale));
+   _mm256_storeu_ps(dst + 16, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(hi)), scale));
+   _mm256_storeu_ps(dst + 24, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8))), scale));
+}
+
+
+/**
+ * Convert the 32 floats of v to bytes, rounding like float_to_ubyte().
+ */
+static inline __m256i
+avx2_float_to_8unorm(const __m256 v[4])
+{
+   const __m256 zero = _mm256_setzero_ps();
+   const __m256 one = _mm256_set1_ps(1.0f);
+   const __m256 scale = _mm256_set1_ps(255.0f/256.0f);
+   const __m256 magic = _mm256_set1_ps(32768.0f);
+   const __m256i mask = _mm256_set1_epi32(0xff);
+   __m256i p[4], bytes;
+   unsigned k;
+
+   for (k = 0; k < 4; k++) {
+      /* max_ps returns zero for NaN too */
+      __m256 f = _mm256_min_ps(_mm256_max_ps(v[k], zero), one);
+      f = _mm256_add_ps(_mm256_mul_ps(f, scale), magic);
+      p[k] = _mm256_and_si256(_mm256_castps_si256(f), mask);
+   }
+
+   /* The packs work within 128-bit lanes, so the dwords come out as
+    * 0, 2, 4, 6, 1, 3, 5, 7.
+    */
+   bytes = _mm256_packus_epi16(_mm256_packs_epi32(p[0], p[1]),
+                               _mm256_packs_epi32(p[2], p[3]));
+   return _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}''')
+    elif isa == 'neon':
+        print('#include <arm_neon.h>')
+        print('''
+
+/**
+ * Convert unorm values to floats, like the scalar code: (float)x * scale.
+ */
+static inline float32x4_t
+neon_unorm_to_float(uint16x4_t v, float scale)
+{
+   return vmulq_n_f32(vcvtq_f32_u32(vmovl_u16(v)), scale);
+}
+
+
+/**
+ * Convert floats to bytes, rounding like float_to_ubyte().
+ */
+static inline uint8x8_t
+neon_float_to_8unorm(float32x4_t lo, float32x4_t hi)
+{
+   const float32x4_t zero = vdupq_n_f32(0.0f);
+   const float32x4_t one = vdupq_n_f32(1.0f);
+   const float32x4_t scale = vdupq_n_f32(255.0f/256.0f);
+   const float32x4_t magic = vdupq_n_f32(32768.0f);
+   float32x4_t v[2] = { lo, hi };
+   uint16x4_t p[2];
+   unsigned k;
+
+   for (k = 0; k < 2; k++) {
+      /* vmaxq_f32 would keep NaNs, but they must become zero */
+      float32x4_t f = vbslq_f32(vcgtq_f32(v[k], zero), v[k], zero);
+      f = vminq_f32(f, one);
+      f = vaddq_f32(vmulq_f32(f, scale), magic);
+      p[k] = vmovn_u32(vreinterpretq_u32_f32(f));
+   }
+
+   return vmovn_u16(vcombine_u16(p[0], p[1]));
+}
+
+
+/**
+ * Convert floats to 16-bit unorm values, like
+ * util_iround(CLAMP(x, 0.0f, 1.0f) * 0xffff).
+ */
+static inline uint16x8_t
+neon_float_to_16unorm(float32x4_t lo, float32x4_t hi)
+{
+   const float32x4_t zero = vdupq_n_f32(0.0f);
+   const float32x4_t one = vdupq_n_f32(1.0f);
+   const float32x4_t scale = vdupq_n_f32((float)0xffff);
+   const float32x4_t half = vdupq_n_f32(0.5f);
+   float32x4_t v[2] = { lo, hi };
+   uint16x4_t p[2];
+   unsigned k;
+
+   for (k = 0; k < 2; k++) {
+      float32x4_t f = vbslq_f32(vcgtq_f32(v[k], zero), v[k], zero);
+      f = vminq_f32(f, one);
+      f = vaddq_f32(vmulq_f32(f, scale), half);
+      p[k] = vmovn_u32(vcvtq_u32_f32(f));
+   }
+
+   return vcombine_u16(p[0], p[1]);
+}''')
+    else:
+        assert False
+    print()
+
+
+def generate_simd_kernel(format, kind, suffix, unpack, isa):
+    name, params = simd_kernel(format.short_name(), suffix, isa, unpack)
+    pixels = simd_pixels[isa]
+    bytes = format.block_size() // 8
+
+    generate_simd_prototypes([(isa, (name, params))], guard = False)
+    print()
+    print('unsigned')
+    print('%s(%s)' % (name, params))
+    print('{')
+    print('   unsigned x;')
+    print('   for(x = 0; x + %u <= width; x += %u) {' % (pixels, pixels))
+    if isa == 'avx2':
+        generate_avx2_kernel(format, kind, suffix, unpack)
+    else:
+        generate_neon_kernel(format, kind, suffix, unpack)
+    if unpack:
+        print('      src += %u;' % (pixels * bytes,))
+        print('      dst += %u;' % (pixels * 4,))
+    else:
+        print('      src += %u;' % (pixels * 4,))
+        print('      dst += %u;' % (pixels * bytes,))
+    print('   }')
+    print('   return x;')
+    print('}')
+    print()
+
+
+def simd_convert_moves(src_format, dst_format):
+    '''The byte moves and the bytes set to 0xff when converting between two
+    formats of four unorm8 channels, or None.'''
+
+    if src_format.colorspace != dst_format.colorspace or \
+       simd_channel_kind(src_format) != 'unorm8' or \
+       simd_channel_kind(dst_format) != 'unorm8':
+        return None
+
+    src_channels = src_format.le_channels
+    dst_channels = dst_format.le_channels
+    inv_swizzle = inv_swizzles(dst_format.le_swizzles)
+    moves = []
+    ones = 0
+    for i in range(4):
+        if dst_channels[i].type == VOID:
+            continue
+        swizzle = src_format.le_swizzles[inv_swizzle[i]]
+        if swizzle < 4:
+            moves.append((src_channels[swizzle].shift, dst_channels[i].shift))
+        elif swizzle == SWIZZLE_1:
+            ones |= 0xff << dst_channels[i].shift
+    return moves, ones
+
+
+def generate_simd_convert_kernel(src_format, dst_format, isa):
+    moves, ones = simd_convert_moves(src_format, dst_format)
+    name, params = simd_convert_kernel(src_format, dst_format, isa)
+    pixels = simd_pixels[isa]
+    indent = '      '
+
+    generate_simd_prototypes([(isa, (name, params))], guard = False)
+    print()
+    print('unsigned')
+    print('%s(%s)' % (name, params))
+    print('{')
+    print('   unsigned x;')
+    print('   for(x = 0; x + %u <= width; x += %u) {' % (pixels, pixels))
+    if isa == 'avx2':
+        print(indent + 'const __m256i pixels = _mm256_loadu_si256((const __m256i *)src);')
+        print(indent + '_mm256_storeu_si256((__m256i *)dst, %s);' % sse2_byte_remap('pixels', moves, ones, avx2 = True))
+    else:
+        planes = neon_load('u8', 'src', indent)
+        out = [neon_constant('u8', SWIZZLE_0)] * 4
+        for src, dst in moves:
+            out[dst // 8] = planes[src // 8]
+        for i in range(4):
+            if ones & (0xff << (8 * i)):
+                out[i] = neon_constant('u8', SWIZZLE_1)
+        neon_store('u8', 'dst', out, indent)
+    print('      src += %u;' % (pixels * 4,))
+    print('      dst += %u;' % (pixels * 4,))
+    print('   }')
+    print('   return x;')
+    print('}')
+    print()
+
+
+def generate_simd(formats, isa):
+    '''Generate the row kernels of an ISA, called by the functions of
+    generate().'''
+
+    generate_simd_preamble(isa)
+
+    for format in formats:
+        if is_format_hand_written(format) or not is_format_supported(format):
+            continue
+        if format.is_pure_unsigned() or format.is_pure_signed():
+            continue
+        kind = simd_format_kind(format)
+        if kind is None:
+            continue
+        for suffix in ('rgba_float', 'rgba_8unorm'):
+            generate_simd_kernel(format, kind, suffix, True, isa)
+            generate_simd_kernel(format, kind, suffix, False, isa)
+
+    for src_format, dst_format in convert_format_pairs(formats):
+        if simd_convert_moves(src_format, dst_format) is not None:
+            generate_simd_convert_kernel(src_format, dst_format, isa)
+
+
 def generate_format_unpack(format, dst_channel, dst_native_type, dst_suffix):
     '''Generate the function to unpack pixels from a particular format'''
 
     name = format.short_name()
 
+    generate_simd_prototypes(simd_kernels(format, dst_suffix, True))
     print('static inline void')
     print('util_format_%s_unpack_%s(%s *dst_row, unsigned dst_stride, const uint8_t *src_row, unsigned src_stride, unsigned width, unsigned height)' % (name, dst_suffix, dst_native_type))
     print('{')
@@ -635,7 +1502,7 @@ def generate_format_unpack(format, dst_channel, dst_native_type, dst_suffix):
         print('   for(y = 0; y < height; y += %u) {' % (format.block_height,))
         print('      %s *dst = dst_row;' % (dst_native_type))
         print('      const uint8_t *src = src_row;')
-        print('      for(x = 0; x < width; x += %u) {' % (format.block_width,))
+        generate_sse2_loop(format, dst_suffix, True)
         
         generate_unpack_kernel(format, dst_channel, dst_native_type)
     
@@ -655,6 +1522,7 @@ def generate_format_pack(format, src_channel, src_native_type, src_suffix):
 
     name = format.short_name()
 
+    generate_simd_prototypes(simd_kernels(format, src_suffix, False))
     print('static inline void')
     print('util_format_%s_pack_%s(uint8_t *dst_row, unsigned dst_stride, const %s *src_row, unsigned src_stride, unsigned width, unsigned height)' % (name, src_suffix, src_native_type))
     print('{')
@@ -664,7 +1532,7 @@ def generate_format_pack(format, src_channel, src_native_type, src_suffix):
         print('   for(y = 0; y < height; y += %u) {' % (format.block_height,))
         print('      const %s *src = src_row;' % (src_native_type))
         print('      uint8_t *dst = dst_row;')
-        print('      for(x = 0; x < width; x += %u) {' % (format.block_width,))
+        generate_sse2_loop(format, src_suffix, False)
     
         generate_pack_kernel(format, src_channel, src_native_type)
             
@@ -695,6 +1563,267 @@ def generate_format_fetch(format, dst_channel, dst_native_type, dst_suffix):
     print()
 
 
+# Groups of formats for which functions converting pixels directly between
+# any two of them are generated, without going through rgba_float or
+# rgba_8unorm.  These are the conversions which only need integer operations:
+# reordering channels, converting between sRGB and linear 8 bit values with
+# the lookup tables, and rescaling unorm values.  Conversions involving float
+# channels are not any faster than the rgba_float and rgba_8unorm paths.
+convert_format_groups = [
+    [
+        'PIPE_FORMAT_R8G8B8A8_UNORM',
+        'PIPE_FORMAT_R8G8B8X8_UNORM',
+        'PIPE_FORMAT_B8G8R8A8_UNORM',
+        'PIPE_FORMAT_B8G8R8X8_UNORM',
+        'PIPE_FORMAT_A8R8G8B8_UNORM',
+        'PIPE_FORMAT_X8R8G8B8_UNORM',
+        'PIPE_FORMAT_A8B8G8R8_UNORM',
+        'PIPE_FORMAT_X8B8G8R8_UNORM',
+    ],
+    [
+        'PIPE_FORMAT_R8G8B8A8_SRGB',
+        'PIPE_FORMAT_R8G8B8X8_SRGB',
+        'PIPE_FORMAT_B8G8R8A8_SRGB',
+        'PIPE_FORMAT_B8G8R8X8_SRGB',
+        'PIPE_FORMAT_A8R8G8B8_SRGB',
+        'PIPE_FORMAT_A8B8G8R8_SRGB',
+        'PIPE_FORMAT_R8G8B8A8_UNORM',
+        'PIPE_FORMAT_B8G8R8A8_UNORM',
+    ],
+    [
+        'PIPE_FORMAT_R10G10B10A2_UNORM',
+        'PIPE_FORMAT_B10G10R10A2_UNORM',
+        'PIPE_FORMAT_R8G8B8A8_UNORM',
+        'PIPE_FORMAT_B8G8R8A8_UNORM',
+    ],
+]
+
+
+def convert_format_pairs(formats):
+    '''Return the (src, dst) pairs of formats to generate conversion
+    functions for.'''
+
+    formats_by_name = dict((format.name, format) for format in formats)
+    pairs = []
+    for group in convert_format_groups:
+        for src_name in group:
+            for dst_name in group:
+                if src_name == dst_name:
+                    continue
+                pair = (formats_by_name[src_name], formats_by_name[dst_name])
+                if pair not in pairs:
+                    pairs.append(pair)
+    return pairs
+
+
+def constant_expr(channel, native_type, swizzle):
+    '''Generate the expression of a constant channel value.'''
+
+    if swizzle != SWIZZLE_1:
+        return '0'
+    if channel.type == FLOAT and channel.size == 16:
+        return '0x3c00'
+    if channel.type == FLOAT:
+        return native_to_constant(channel, 1)
+    return '(%s)%s' % (native_type, get_one(channel))
+
+
+def convert_channel_expr(src_channel, dst_channel, dst_native_type, value,
+                         src_colorspace, dst_colorspace):
+    '''Generate the expression converting a channel of a direct conversion.
+
+    Unlike conversion_expr, which shifts the bits out, this rounds to the
+    nearest value when narrowing or widening a linear normalized channel, so
+    that the result matches the conversion through rgba_float.'''
+
+    if src_colorspace == RGB and dst_colorspace == RGB and \
+       src_channel.type == UNSIGNED and src_channel.norm and \
+       dst_channel.type == UNSIGNED and dst_channel.norm and \
+       src_channel.size != dst_channel.size:
+        src_one = get_one(src_channel)
+        dst_one = get_one(dst_channel)
+        tmp_native_type = intermediate_native_type(src_channel.size + dst_channel.size, False)
+        # The numerators are never half way between two multiples of the odd
+        # src_one, so there is no tie to break.
+        return '(%s)(((%s)%s * 0x%x + 0x%x) / 0x%x)' % (dst_native_type, tmp_native_type, value,
+                                                      dst_one, src_one // 2, src_one)
+
+    return conversion_expr(src_channel, dst_channel, dst_native_type, value,
+                           src_colorspace = src_colorspace,
+                           dst_colorspace = dst_colorspace)
+
+
+def generate_convert_kernel(src_format, dst_format):
+    '''Generate the code converting a pixel from src_format to dst_format.'''
+
+    dst_native_type = native_type(dst_format)
+
+    def convert(src_channels, src_swizzles, dst_channels, dst_swizzles):
+        # Read the source pixel
+        if src_format.is_bitmask():
+            depth = src_format.block_size()
+            print('         uint%u_t src_value = *(const uint%u_t *)src;' % (depth, depth))
+            src_values = []
+            for channel in src_channels:
+                value = unpack_bitmask_channel_expr(channel, depth, 'src_value')
+                if value is not None:
+                    value = '(%s)' % value
+                src_values.append(value)
+        else:
+            print('         union util_format_%s src_pixel;' % src_format.short_name())
+            print('         memcpy(&src_pixel, src, sizeof src_pixel);')
+            src_values = ['src_pixel.chan.%s' % channel.name
+                          for channel in src_channels]
+
+        # Convert every destination channel straight from the source one
+        dst_values = [None]*4
+        inv_swizzle = inv_swizzles(dst_swizzles)
+        for i in range(4):
+            dst_channel = dst_channels[i]
+            if inv_swizzle[i] is None:
+                continue
+            swizzle = src_swizzles[inv_swizzle[i]]
+            if swizzle < 4:
+                src_colorspace = src_format.colorspace
+                dst_colorspace = dst_format.colorspace
+                if inv_swizzle[i] == 3:
+                    # Alpha channel is linear
+                    src_colorspace = RGB
+                    dst_colorspace = RGB
+                dst_values[i] = convert_channel_expr(src_channels[swizzle],
+                                                     dst_channel, dst_native_type,
+                                                     src_values[swizzle],
+                                                     src_colorspace, dst_colorspace)
+            else:
+                dst_values[i] = constant_expr(dst_channel, dst_native_type, swizzle)
+
+        # Write the destination pixel
+        if dst_format.is_bitmask():
+            depth = dst_format.block_size()
+            print('         uint%u_t dst_value = 0;' % depth)
+            for i in range(4):
+                if dst_values[i] is None:
+                    continue
+                value = pack_bitmask_channel_expr(dst_channels[i], depth, dst_values[i])
+                if value is not None:
+                    print('         dst_value |= %s;' % value)
+            print('         *(uint%u_t *)dst = dst_value;' % depth)
+        else:
+            print('         union util_format_%s dst_pixel;' % dst_format.short_name())
+            for i in range(4):
+                if dst_values[i] is not None:
+                    print('         dst_pixel.chan.%s = %s;' % (dst_channels[i].name, dst_values[i]))
+            print('         memcpy(dst, &dst_pixel, sizeof dst_pixel);')
+
+    if src_format.nr_channels() <= 1 and dst_format.nr_channels() <= 1:
+        convert(src_format.le_channels, src_format.le_swizzles,
+                dst_format.le_channels, dst_format.le_swizzles)
+    else:
+        print('#ifdef PIPE_ARCH_BIG_ENDIAN')
+        convert(src_format.be_channels, src_format.be_swizzles,
+                dst_format.be_channels, dst_format.be_swizzles)
+        print('#else')
+        convert(src_format.le_channels, src_format.le_swizzles,
+                dst_format.le_channels, dst_format.le_swizzles)
+        print('#endif')
+
+
+def simd_convert_kernels(src_format, dst_format):
+    '''The (isa, kernel) pairs of the row kernels of a conversion.'''
+
+    if simd_convert_moves(src_format, dst_format) is None:
+        return []
+    return [(isa, simd_convert_kernel(src_format, dst_format, isa))
+            for isa in simd_isas]
+
+
+def generate_sse2_convert_loop(src_format, dst_format):
+    '''Generate the loop reordering the bytes of four pixels at once when
+    both formats have four unorm8 channels, after the call to the kernels of
+    the other ISAs and before the loop converting the remaining pixels.'''
+
+    remap = simd_convert_moves(src_format, dst_format)
+    if remap is None:
+        print('      for(x = 0; x < width; x += 1) {')
+        return
+
+    moves, ones = remap
+
+    print('      x = 0;')
+    generate_simd_calls(simd_convert_kernels(src_format, dst_format), 4, 4)
+    print('#ifdef UTIL_FORMAT_SSE2')
+    print('      if (util_cpu_caps.has_sse2) {')
+    print('         for(; x + 4 <= width; x += 4) {')
+    print('            const __m128i pixels = _mm_loadu_si128((const __m128i *)src);')
+    print('            _mm_storeu_si128((__m128i *)dst, %s);' % sse2_byte_remap('pixels', moves, ones))
+    print('            src += 16;')
+    print('            dst += 16;')
+    print('         }')
+    print('      }')
+    print('#endif')
+    print('      for(; x < width; x += 1) {')
+
+
+def generate_format_convert(src_format, dst_format):
+    '''Generate the function to convert pixels from a format to another'''
+
+    assert src_format.layout == PLAIN and dst_format.layout == PLAIN
+    assert src_format.block_width == 1 and src_format.block_height == 1
+    assert dst_format.block_width == 1 and dst_format.block_height == 1
+
+    generate_simd_prototypes(simd_convert_kernels(src_format, dst_format))
+    print('static void')
+    print('util_format_%s_from_%s(uint8_t *dst_row, unsigned dst_stride, const uint8_t *src_row, unsigned src_stride, unsigned width, unsigned height)' % (dst_format.short_name(), src_format.short_name()))
+    print('{')
+    print('   unsigned x, y;')
+    print('   for(y = 0; y < height; y += 1) {')
+    print('      const uint8_t *src = src_row;')
+    print('      uint8_t *dst = dst_row;')
+    generate_sse2_convert_loop(src_format, dst_format)
+
+    generate_convert_kernel(src_format, dst_format)
+
+    print('         src += %u;' % (src_format.block_size() // 8,))
+    print('         dst += %u;' % (dst_format.block_size() // 8,))
+    print('      }')
+    print('      dst_row += dst_stride;')
+    print('      src_row += src_stride;')
+    print('   }')
+    print('}')
+    print()
+
+
+def generate_convert_funcs(formats):
+    '''Generate the direct conversion functions and the function looking
+    them up.'''
+
+    pairs = convert_format_pairs(formats)
+    for src_format, dst_format in pairs:
+        generate_format_convert(src_format, dst_format)
+
+    print('util_format_convert_func')
+    print('util_format_get_convert_func(enum pipe_format dst_format, enum pipe_format src_format)')
+    print('{')
+    print('   switch (src_format) {')
+    for src_format in formats:
+        dst_formats = [dst for src, dst in pairs if src is src_format]
+        if not dst_formats:
+            continue
+        print('   case %s:' % src_format.name)
+        print('      switch (dst_format) {')
+        for dst_format in dst_formats:
+            print('      case %s:' % dst_format.name)
+            print('         return &util_format_%s_from_%s;' % (dst_format.short_name(), src_format.short_name()))
+        print('      default:')
+        print('         return NULL;')
+        print('      }')
+    print('   default:')
+    print('      return NULL;')
+    print('   }')
+    print('}')
+    print()
+
+
 def is_format_hand_written(format):
     return format.layout in ('s3tc', 'rgtc', 'etc', 'bptc', 'astc', 'subsampled', 'other') or format.colorspace == ZS
 
@@ -709,6 +1838,19 @@ def generate(formats):
     print('#include "util/format_srgb.h"')
     print('#include "u_format_yuv.h"')
     print('#include "u_format_zs.h"')
+    print('#include "util/u_cpu_detect.h"')
+    print()
+    # The kernels round like the scalar code does with SSE math, not x87.
+    print('#if defined(PIPE_ARCH_SSE) && defined(PIPE_ARCH_X86_64)')
+    print('#define UTIL_FORMAT_SSE2')
+    print('#include <emmintrin.h>')
+    print('#endif')
+    # The AVX2 and NEON kernels are generated by generate_simd() into
+    # separate files, compiled with their own flags when USE_AVX2 and
+    # UTIL_FORMAT_NEON are defined by the build.
+    print('#if defined(USE_AVX2)')
+    print('#define UTIL_FORMAT_AVX2')
+    print('#endif')
     print()
 
     for format in formats:
@@ -761,3 +1903,5 @@ def generate(formats):
                 generate_format_unpack(format, channel, native_type, suffix)
                 generate_format_pack(format, channel, native_type, suffix)
 
+
+    generate_convert_funcs(formats)
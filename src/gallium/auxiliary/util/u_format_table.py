@@ -219,12 +219,32 @@ def write_format_table(formats):
     print()
 
 
+def write_format_simd(formats, isa):
+    print('/* This file is autogenerated by u_format_table.py from u_format.csv. Do not edit directly. */')
+    print()
+    print(CopyRight.strip())
+    print()
+    print('/* Row kernels of the functions of u_format_table.c, compiled with the')
+    print(' * %s flags of the build. */' % isa.upper())
+    print()
+
+    u_format_pack.generate_simd(formats, isa)
+
+
 def main():
 
     formats = []
+    isa = None
     for arg in sys.argv[1:]:
-        formats.extend(parse(arg))
-    write_format_table(formats)
+        if arg.startswith('--simd='):
+            isa = arg[len('--simd='):]
+            assert isa in u_format_pack.simd_isas
+        else:
+            formats.extend(parse(arg))
+    if isa:
+        write_format_simd(formats, isa)
+    else:
+        write_format_table(formats)
 
 
 if __name__ == '__main__':
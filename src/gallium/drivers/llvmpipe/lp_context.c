@@ -43,8 +43,10 @@
 #include "lp_flush.h"
 #include "lp_perf.h"
 #include "lp_state.h"
+#include "lp_state_cs.h"
 #include "lp_surface.h"
 #include "lp_query.h"
+#include "lp_screen.h"
 #include "lp_setup.h"
 
 /* This is only safe if there's just one concurrent context */
@@ -57,6 +59,8 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    uint i, j;
 
+   llvmpipe_finish_fs_compiles(llvmpipe);
+
    lp_print_counters();
 
    if (llvmpipe->blitter) {
@@ -95,6 +99,8 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
       }
    }
 
+   llvmpipe_cleanup_compute(llvmpipe);
+
    for (i = 0; i < llvmpipe->num_vertex_buffers; i++) {
       pipe_vertex_buffer_unreference(&llvmpipe->vertex_buffer[i]);
    }
@@ -131,6 +137,24 @@ llvmpipe_render_condition(struct pipe_context *pipe,
    llvmpipe->render_cond_cond = condition;
 }
 
+static void
+lp_draw_disk_cache_find_shader(void *cookie,
+                               struct lp_cached_code *cache,
+                               unsigned char ir_sha1_cache_key[20])
+{
+   struct llvmpipe_screen *screen = cookie;
+   lp_disk_cache_find_shader(screen, cache, ir_sha1_cache_key);
+}
+
+static void
+lp_draw_disk_cache_insert_shader(void *cookie,
+                                 struct lp_cached_code *cache,
+                                 unsigned char ir_sha1_cache_key[20])
+{
+   struct llvmpipe_screen *screen = cookie;
+   lp_disk_cache_insert_shader(screen, cache, ir_sha1_cache_key);
+}
+
 struct pipe_context *
 llvmpipe_create_context(struct pipe_screen *screen, void *priv,
                         unsigned flags)
@@ -171,6 +195,8 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe_init_fs_funcs(llvmpipe);
    llvmpipe_init_vs_funcs(llvmpipe);
    llvmpipe_init_gs_funcs(llvmpipe);
+   if (llvmpipe_screen(screen)->allow_compute)
+      llvmpipe_init_compute_funcs(llvmpipe);
    llvmpipe_init_rasterizer_funcs(llvmpipe);
    llvmpipe_init_context_resource_funcs( &llvmpipe->pipe );
    llvmpipe_init_surface_functions(llvmpipe);
@@ -192,6 +218,12 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    if (!llvmpipe->draw)
       goto fail;
 
+   if (llvmpipe_screen(screen)->disk_shader_cache)
+      draw_set_disk_cache_callbacks(llvmpipe->draw,
+                                    llvmpipe_screen(screen),
+                                    lp_draw_disk_cache_find_shader,
+                                    lp_draw_disk_cache_insert_shader);
+
    /* FIXME: devise alternative to draw_texture_samplers */
 
    llvmpipe->setup = lp_setup_create( &llvmpipe->pipe,
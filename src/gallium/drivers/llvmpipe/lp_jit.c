@@ -33,14 +33,156 @@
  */
 
 
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_format.h"
+#include "state_tracker/sw_winsys.h"
 #include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_memory.h"
+#include "lp_screen.h"
+#include "lp_texture.h"
+#include "lp_state_cs.h"
 #include "lp_jit.h"
 
 
+static LLVMTypeRef
+create_jit_texture_type(struct gallivm_state *gallivm)
+{
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef texture_type;
+   LLVMTypeRef elem_types[LP_JIT_TEXTURE_NUM_FIELDS];
+
+   /* struct lp_jit_texture */
+   elem_types[LP_JIT_TEXTURE_WIDTH]  =
+   elem_types[LP_JIT_TEXTURE_HEIGHT] =
+   elem_types[LP_JIT_TEXTURE_DEPTH] =
+   elem_types[LP_JIT_TEXTURE_FIRST_LEVEL] =
+   elem_types[LP_JIT_TEXTURE_LAST_LEVEL] = LLVMInt32TypeInContext(lc);
+   elem_types[LP_JIT_TEXTURE_BASE] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   elem_types[LP_JIT_TEXTURE_ROW_STRIDE] =
+   elem_types[LP_JIT_TEXTURE_IMG_STRIDE] =
+   elem_types[LP_JIT_TEXTURE_MIP_OFFSETS] =
+      LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TEXTURE_LEVELS);
+
+   texture_type = LLVMStructTypeInContext(lc, elem_types,
+                                          ARRAY_SIZE(elem_types), 0);
+
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, width,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_WIDTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, height,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_HEIGHT);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, depth,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_DEPTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, first_level,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_FIRST_LEVEL);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, last_level,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_LAST_LEVEL);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, base,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_BASE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, row_stride,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_ROW_STRIDE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, img_stride,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_IMG_STRIDE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, mip_offsets,
+                          gallivm->target, texture_type,
+                          LP_JIT_TEXTURE_MIP_OFFSETS);
+   LP_CHECK_STRUCT_SIZE(struct lp_jit_texture,
+                        gallivm->target, texture_type);
+
+   return texture_type;
+}
+
+
+static LLVMTypeRef
+create_jit_sampler_type(struct gallivm_state *gallivm)
+{
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef sampler_type;
+   LLVMTypeRef elem_types[LP_JIT_SAMPLER_NUM_FIELDS];
+
+   /* struct lp_jit_sampler */
+   elem_types[LP_JIT_SAMPLER_MIN_LOD] =
+   elem_types[LP_JIT_SAMPLER_MAX_LOD] =
+   elem_types[LP_JIT_SAMPLER_LOD_BIAS] = LLVMFloatTypeInContext(lc);
+   elem_types[LP_JIT_SAMPLER_BORDER_COLOR] =
+      LLVMArrayType(LLVMFloatTypeInContext(lc), 4);
+
+   sampler_type = LLVMStructTypeInContext(lc, elem_types,
+                                          ARRAY_SIZE(elem_types), 0);
+
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, min_lod,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_MIN_LOD);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, max_lod,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_MAX_LOD);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, lod_bias,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_LOD_BIAS);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, border_color,
+                          gallivm->target, sampler_type,
+                          LP_JIT_SAMPLER_BORDER_COLOR);
+   LP_CHECK_STRUCT_SIZE(struct lp_jit_sampler,
+                        gallivm->target, sampler_type);
+
+   return sampler_type;
+}
+
+
+static LLVMTypeRef
+create_jit_image_type(struct gallivm_state *gallivm)
+{
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef image_type;
+   LLVMTypeRef elem_types[LP_JIT_IMAGE_NUM_FIELDS];
+
+   /* struct lp_jit_image */
+   elem_types[LP_JIT_IMAGE_WIDTH] =
+   elem_types[LP_JIT_IMAGE_HEIGHT] =
+   elem_types[LP_JIT_IMAGE_DEPTH] = LLVMInt32TypeInContext(lc);
+   elem_types[LP_JIT_IMAGE_BASE] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
+   elem_types[LP_JIT_IMAGE_ROW_STRIDE] =
+   elem_types[LP_JIT_IMAGE_IMG_STRIDE] = LLVMInt32TypeInContext(lc);
+
+   image_type = LLVMStructTypeInContext(lc, elem_types,
+                                        ARRAY_SIZE(elem_types), 0);
+
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, width,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_WIDTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, height,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_HEIGHT);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, depth,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_DEPTH);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, base,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_BASE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, row_stride,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_ROW_STRIDE);
+   LP_CHECK_MEMBER_OFFSET(struct lp_jit_image, img_stride,
+                          gallivm->target, image_type,
+                          LP_JIT_IMAGE_IMG_STRIDE);
+   LP_CHECK_STRUCT_SIZE(struct lp_jit_image,
+                        gallivm->target, image_type);
+
+   return image_type;
+}
+
+
 static void
 lp_jit_create_types(struct lp_fragment_shader_variant *lp)
 {
@@ -68,82 +210,8 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
                            gallivm->target, viewport_type);
    }
 
-   /* struct lp_jit_texture */
-   {
-      LLVMTypeRef elem_types[LP_JIT_TEXTURE_NUM_FIELDS];
-
-      elem_types[LP_JIT_TEXTURE_WIDTH]  =
-      elem_types[LP_JIT_TEXTURE_HEIGHT] =
-      elem_types[LP_JIT_TEXTURE_DEPTH] =
-      elem_types[LP_JIT_TEXTURE_FIRST_LEVEL] =
-      elem_types[LP_JIT_TEXTURE_LAST_LEVEL] = LLVMInt32TypeInContext(lc);
-      elem_types[LP_JIT_TEXTURE_BASE] = LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
-      elem_types[LP_JIT_TEXTURE_ROW_STRIDE] =
-      elem_types[LP_JIT_TEXTURE_IMG_STRIDE] =
-      elem_types[LP_JIT_TEXTURE_MIP_OFFSETS] =
-         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TEXTURE_LEVELS);
-
-      texture_type = LLVMStructTypeInContext(lc, elem_types,
-                                             ARRAY_SIZE(elem_types), 0);
-
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, width,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_WIDTH);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, height,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_HEIGHT);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, depth,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_DEPTH);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, first_level,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_FIRST_LEVEL);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, last_level,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_LAST_LEVEL);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, base,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_BASE);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, row_stride,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_ROW_STRIDE);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, img_stride,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_IMG_STRIDE);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_texture, mip_offsets,
-                             gallivm->target, texture_type,
-                             LP_JIT_TEXTURE_MIP_OFFSETS);
-      LP_CHECK_STRUCT_SIZE(struct lp_jit_texture,
-                           gallivm->target, texture_type);
-   }
-
-   /* struct lp_jit_sampler */
-   {
-      LLVMTypeRef elem_types[LP_JIT_SAMPLER_NUM_FIELDS];
-      elem_types[LP_JIT_SAMPLER_MIN_LOD] =
-      elem_types[LP_JIT_SAMPLER_MAX_LOD] =
-      elem_types[LP_JIT_SAMPLER_LOD_BIAS] = LLVMFloatTypeInContext(lc);
-      elem_types[LP_JIT_SAMPLER_BORDER_COLOR] =
-         LLVMArrayType(LLVMFloatTypeInContext(lc), 4);
-
-      sampler_type = LLVMStructTypeInContext(lc, elem_types,
-                                             ARRAY_SIZE(elem_types), 0);
-
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, min_lod,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_MIN_LOD);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, max_lod,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_MAX_LOD);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, lod_bias,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_LOD_BIAS);
-      LP_CHECK_MEMBER_OFFSET(struct lp_jit_sampler, border_color,
-                             gallivm->target, sampler_type,
-                             LP_JIT_SAMPLER_BORDER_COLOR);
-      LP_CHECK_STRUCT_SIZE(struct lp_jit_sampler,
-                           gallivm->target, sampler_type);
-   }
+   texture_type = create_jit_texture_type(gallivm);
+   sampler_type = create_jit_sampler_type(gallivm);
 
    /* struct lp_jit_context */
    {
@@ -164,6 +232,10 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
                                                       PIPE_MAX_SHADER_SAMPLER_VIEWS);
       elem_types[LP_JIT_CTX_SAMPLERS] = LLVMArrayType(sampler_type,
                                                       PIPE_MAX_SAMPLERS);
+      elem_types[LP_JIT_CTX_SSBOS] =
+         LLVMArrayType(LLVMPointerType(LLVMInt32TypeInContext(lc), 0), LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CTX_SSBO_SIZES] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_SHADER_BUFFERS);
 
       context_type = LLVMStructTypeInContext(lc, elem_types,
                                              ARRAY_SIZE(elem_types), 0);
@@ -198,6 +270,12 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
       LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, samplers,
                              gallivm->target, context_type,
                              LP_JIT_CTX_SAMPLERS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, ssbos,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, ssbo_sizes,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_SSBO_SIZES);
       LP_CHECK_STRUCT_SIZE(struct lp_jit_context,
                            gallivm->target, context_type);
 
@@ -254,3 +332,291 @@ lp_jit_init_types(struct lp_fragment_shader_variant *lp)
    if (!lp->jit_context_ptr_type)
       lp_jit_create_types(lp);
 }
+
+
+static void
+lp_jit_create_cs_types(struct lp_compute_shader_variant *lp)
+{
+   struct gallivm_state *gallivm = lp->gallivm;
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef texture_type, sampler_type, image_type;
+
+   texture_type = create_jit_texture_type(gallivm);
+   sampler_type = create_jit_sampler_type(gallivm);
+   image_type = create_jit_image_type(gallivm);
+
+   /* struct lp_jit_cs_context */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_CTX_COUNT];
+      LLVMTypeRef cs_context_type;
+
+      elem_types[LP_JIT_CS_CTX_CONSTANTS] =
+         LLVMArrayType(LLVMPointerType(LLVMFloatTypeInContext(lc), 0), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_NUM_CONSTANTS] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_SSBOS] =
+         LLVMArrayType(LLVMPointerType(LLVMInt32TypeInContext(lc), 0), LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_SSBO_SIZES] =
+         LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_SHADER_BUFFERS);
+      elem_types[LP_JIT_CS_CTX_TEXTURES] = LLVMArrayType(texture_type,
+                                                         PIPE_MAX_SHADER_SAMPLER_VIEWS);
+      elem_types[LP_JIT_CS_CTX_SAMPLERS] = LLVMArrayType(sampler_type,
+                                                         PIPE_MAX_SAMPLERS);
+      elem_types[LP_JIT_CS_CTX_IMAGES] = LLVMArrayType(image_type,
+                                                       PIPE_MAX_SHADER_IMAGES);
+
+      cs_context_type = LLVMStructTypeInContext(lc, elem_types,
+                                                ARRAY_SIZE(elem_types), 0);
+
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, constants,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_CONSTANTS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, num_constants,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_NUM_CONSTANTS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, ssbos,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_SSBOS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, ssbo_sizes,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_SSBO_SIZES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, textures,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_TEXTURES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, samplers,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_SAMPLERS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, images,
+                             gallivm->target, cs_context_type,
+                             LP_JIT_CS_CTX_IMAGES);
+      LP_CHECK_STRUCT_SIZE(struct lp_jit_cs_context,
+                           gallivm->target, cs_context_type);
+
+      lp->jit_cs_context_ptr_type = LLVMPointerType(cs_context_type, 0);
+   }
+
+   /* struct lp_jit_cs_thread_data */
+   {
+      LLVMTypeRef elem_types[LP_JIT_CS_THREAD_DATA_COUNT];
+      LLVMTypeRef thread_data_type;
+
+      elem_types[LP_JIT_CS_THREAD_DATA_SHARED] =
+            LLVMPointerType(LLVMInt32TypeInContext(lc), 0);
+
+      thread_data_type = LLVMStructTypeInContext(lc, elem_types,
+                                                 ARRAY_SIZE(elem_types), 0);
+
+      lp->jit_cs_thread_data_ptr_type = LLVMPointerType(thread_data_type, 0);
+   }
+
+   if (gallivm_debug & GALLIVM_DEBUG_IR) {
+#if HAVE_LLVM >= 0x304
+      char *str = LLVMPrintModuleToString(gallivm->module);
+      fprintf(stderr, "%s", str);
+      LLVMDisposeMessage(str);
+#else
+      LLVMDumpModule(gallivm->module);
+#endif
+   }
+}
+
+
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp)
+{
+   if (!lp->jit_cs_context_ptr_type)
+      lp_jit_create_cs_types(lp);
+}
+
+/**
+ * Fill in the jit texture state from a sampler view.
+ */
+void
+lp_jit_texture_from_pipe(struct lp_jit_texture *jit_tex,
+                         const struct pipe_sampler_view *view)
+{
+   struct pipe_resource *res = view->texture;
+   struct llvmpipe_resource *lp_tex = llvmpipe_resource(res);
+
+   if (!lp_tex->dt) {
+      /* regular texture - setup array of mipmap level offsets */
+      int j;
+      unsigned first_level = 0;
+      unsigned last_level = 0;
+
+      if (llvmpipe_resource_is_texture(res)) {
+         first_level = view->u.tex.first_level;
+         last_level = view->u.tex.last_level;
+         assert(first_level <= last_level);
+         assert(last_level <= res->last_level);
+         jit_tex->base = lp_tex->tex_data;
+      }
+      else {
+        jit_tex->base = lp_tex->data;
+      }
+
+      if (LP_PERF & PERF_TEX_MEM) {
+         /* use dummy tile memory */
+         jit_tex->base = lp_dummy_tile;
+         jit_tex->width = TILE_SIZE/8;
+         jit_tex->height = TILE_SIZE/8;
+         jit_tex->depth = 1;
+         jit_tex->first_level = 0;
+         jit_tex->last_level = 0;
+         jit_tex->mip_offsets[0] = 0;
+         jit_tex->row_stride[0] = 0;
+         jit_tex->img_stride[0] = 0;
+      }
+      else {
+         jit_tex->width = res->width0;
+         jit_tex->height = res->height0;
+         jit_tex->depth = res->depth0;
+         jit_tex->first_level = first_level;
+         jit_tex->last_level = last_level;
+
+         if (llvmpipe_resource_is_texture(res)) {
+            for (j = first_level; j <= last_level; j++) {
+               jit_tex->mip_offsets[j] = lp_tex->mip_offsets[j];
+               jit_tex->row_stride[j] = lp_tex->row_stride[j];
+               jit_tex->img_stride[j] = lp_tex->img_stride[j];
+            }
+
+            if (res->target == PIPE_TEXTURE_1D_ARRAY ||
+                res->target == PIPE_TEXTURE_2D_ARRAY ||
+                res->target == PIPE_TEXTURE_CUBE ||
+                res->target == PIPE_TEXTURE_CUBE_ARRAY) {
+               /*
+                * For array textures, we don't have first_layer, instead
+                * adjust last_layer (stored as depth) plus the mip level offsets
+                * (as we have mip-first layout can't just adjust base ptr).
+                * XXX For mip levels, could do something similar.
+                */
+               jit_tex->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+               for (j = first_level; j <= last_level; j++) {
+                  jit_tex->mip_offsets[j] += view->u.tex.first_layer *
+                                             lp_tex->img_stride[j];
+               }
+               if (view->target == PIPE_TEXTURE_CUBE ||
+                   view->target == PIPE_TEXTURE_CUBE_ARRAY) {
+                  assert(jit_tex->depth % 6 == 0);
+               }
+               assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+               assert(view->u.tex.last_layer < res->array_size);
+            }
+         }
+         else {
+            /*
+             * For buffers, we don't have "offset", instead adjust
+             * the size (stored as width) plus the base pointer.
+             */
+            unsigned view_blocksize = util_format_get_blocksize(view->format);
+            /* probably don't really need to fill that out */
+            jit_tex->mip_offsets[0] = 0;
+            jit_tex->row_stride[0] = 0;
+            jit_tex->img_stride[0] = 0;
+
+            /* everything specified in number of elements here. */
+            jit_tex->width = view->u.buf.size / view_blocksize;
+            jit_tex->base = (uint8_t *)jit_tex->base + view->u.buf.offset;
+            /* XXX Unsure if we need to sanitize parameters? */
+            assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+         }
+      }
+   }
+   else {
+      /* display target texture/surface */
+      /*
+       * XXX: Where should this be unmapped?
+       */
+      struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
+      struct sw_winsys *winsys = screen->winsys;
+      jit_tex->base = winsys->displaytarget_map(winsys, lp_tex->dt,
+                                                   PIPE_TRANSFER_READ);
+      jit_tex->row_stride[0] = lp_tex->row_stride[0];
+      jit_tex->img_stride[0] = lp_tex->img_stride[0];
+      jit_tex->mip_offsets[0] = 0;
+      jit_tex->width = res->width0;
+      jit_tex->height = res->height0;
+      jit_tex->depth = res->depth0;
+      jit_tex->first_level = jit_tex->last_level = 0;
+      assert(jit_tex->base);
+   }
+}
+
+
+/**
+ * Fill in the jit sampler state from a sampler state.
+ */
+void
+lp_jit_sampler_from_pipe(struct lp_jit_sampler *jit_sam,
+                         const struct pipe_sampler_state *sampler)
+{
+   jit_sam->min_lod = sampler->min_lod;
+   jit_sam->max_lod = sampler->max_lod;
+   jit_sam->lod_bias = sampler->lod_bias;
+   COPY_4V(jit_sam->border_color, sampler->border_color.f);
+}
+
+
+/**
+ * Fill in the jit image state from an image view.
+ */
+void
+lp_jit_image_from_pipe(struct lp_jit_image *jit_img,
+                       const struct pipe_image_view *view)
+{
+   struct pipe_resource *res = view->resource;
+   struct llvmpipe_resource *lp_res = llvmpipe_resource(res);
+
+   if (!llvmpipe_resource_is_texture(res)) {
+      /*
+       * For buffers, the offset is applied to the base pointer, and the
+       * size is stored as width, in number of elements.
+       */
+      unsigned view_blocksize = util_format_get_blocksize(view->format);
+
+      jit_img->base = (uint8_t *)lp_res->data + view->u.buf.offset;
+      jit_img->width = view->u.buf.size / view_blocksize;
+      jit_img->height = 1;
+      jit_img->depth = 1;
+      jit_img->row_stride = 0;
+      jit_img->img_stride = 0;
+      assert(view->u.buf.offset + view->u.buf.size <= res->width0);
+   }
+   else {
+      unsigned level = view->u.tex.level;
+      uint8_t *data;
+
+      if (lp_res->dt) {
+         /* display target texture/surface */
+         struct llvmpipe_screen *screen = llvmpipe_screen(res->screen);
+         struct sw_winsys *winsys = screen->winsys;
+         data = winsys->displaytarget_map(winsys, lp_res->dt,
+                                          PIPE_TRANSFER_READ_WRITE);
+         assert(level == 0);
+      }
+      else {
+         data = (uint8_t *)lp_res->tex_data + lp_res->mip_offsets[level];
+      }
+
+      jit_img->width = u_minify(res->width0, level);
+      jit_img->height = u_minify(res->height0, level);
+      jit_img->row_stride = lp_res->row_stride[level];
+      jit_img->img_stride = lp_res->img_stride[level];
+
+      if (res->target == PIPE_TEXTURE_3D) {
+         jit_img->depth = u_minify(res->depth0, level);
+         jit_img->base = data;
+      }
+      else {
+         /*
+          * Arrays and cube maps are addressed from the first layer of the
+          * view, with the number of layers as depth.
+          */
+         jit_img->depth = view->u.tex.last_layer - view->u.tex.first_layer + 1;
+         jit_img->base = data + view->u.tex.first_layer * jit_img->img_stride;
+         assert(view->u.tex.first_layer <= view->u.tex.last_layer);
+         assert(view->u.tex.last_layer < res->array_size);
+      }
+   }
+}
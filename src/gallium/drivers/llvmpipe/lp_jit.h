@@ -45,6 +45,7 @@
 
 struct lp_build_format_cache;
 struct lp_fragment_shader_variant;
+struct lp_compute_shader_variant;
 struct llvmpipe_screen;
 
 
@@ -71,6 +72,17 @@ struct lp_jit_sampler
 };
 
 
+struct lp_jit_image
+{
+   uint32_t width;        /* same as number of elements */
+   uint32_t height;
+   uint32_t depth;        /* doubles as array size */
+   const void *base;
+   uint32_t row_stride;
+   uint32_t img_stride;
+};
+
+
 struct lp_jit_viewport
 {
    float min_depth;
@@ -101,6 +113,17 @@ enum {
 };
 
 
+enum {
+   LP_JIT_IMAGE_WIDTH = 0,
+   LP_JIT_IMAGE_HEIGHT,
+   LP_JIT_IMAGE_DEPTH,
+   LP_JIT_IMAGE_BASE,
+   LP_JIT_IMAGE_ROW_STRIDE,
+   LP_JIT_IMAGE_IMG_STRIDE,
+   LP_JIT_IMAGE_NUM_FIELDS  /* number of fields above */
+};
+
+
 enum {
    LP_JIT_VIEWPORT_MIN_DEPTH,
    LP_JIT_VIEWPORT_MAX_DEPTH,
@@ -135,6 +158,9 @@ struct lp_jit_context
 
    struct lp_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
    struct lp_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+
+   uint32_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   uint32_t ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
 };
 
 
@@ -153,6 +179,8 @@ enum {
    LP_JIT_CTX_VIEWPORTS,
    LP_JIT_CTX_TEXTURES,
    LP_JIT_CTX_SAMPLERS,
+   LP_JIT_CTX_SSBOS,
+   LP_JIT_CTX_SSBO_SIZES,
    LP_JIT_CTX_COUNT
 };
 
@@ -187,6 +215,12 @@ enum {
 #define lp_jit_context_samplers(_gallivm, _ptr) \
    lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SAMPLERS, "samplers")
 
+#define lp_jit_context_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SSBOS, "ssbos")
+
+#define lp_jit_context_ssbo_sizes(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CTX_SSBO_SIZES, "ssbo_sizes")
+
 
 struct lp_jit_thread_data
 {
@@ -259,6 +293,114 @@ typedef void
                     unsigned depth_stride);
 
 
+
+/**
+ * This structure is passed directly to the generated compute shader.
+ *
+ * Changes here must be reflected in the lp_jit_cs_context_* macros and
+ * lp_jit_init_cs_types function.
+ */
+struct lp_jit_cs_context
+{
+   const float *constants[LP_MAX_TGSI_CONST_BUFFERS];
+   int num_constants[LP_MAX_TGSI_CONST_BUFFERS];
+
+   uint32_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+   uint32_t ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS];
+
+   struct lp_jit_texture textures[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+   struct lp_jit_sampler samplers[PIPE_MAX_SAMPLERS];
+   struct lp_jit_image images[PIPE_MAX_SHADER_IMAGES];
+};
+
+
+/**
+ * These enum values must match the position of the fields in the
+ * lp_jit_cs_context struct above.
+ */
+enum {
+   LP_JIT_CS_CTX_CONSTANTS = 0,
+   LP_JIT_CS_CTX_NUM_CONSTANTS,
+   LP_JIT_CS_CTX_SSBOS,
+   LP_JIT_CS_CTX_SSBO_SIZES,
+   LP_JIT_CS_CTX_TEXTURES,
+   LP_JIT_CS_CTX_SAMPLERS,
+   LP_JIT_CS_CTX_IMAGES,
+   LP_JIT_CS_CTX_COUNT
+};
+
+
+#define lp_jit_cs_context_constants(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_CONSTANTS, "constants")
+
+#define lp_jit_cs_context_num_constants(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_NUM_CONSTANTS, "num_constants")
+
+#define lp_jit_cs_context_ssbos(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_SSBOS, "ssbos")
+
+#define lp_jit_cs_context_ssbo_sizes(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_SSBO_SIZES, "ssbo_sizes")
+
+#define lp_jit_cs_context_textures(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_TEXTURES, "textures")
+
+#define lp_jit_cs_context_samplers(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_SAMPLERS, "samplers")
+
+#define lp_jit_cs_context_images(_gallivm, _ptr) \
+   lp_build_struct_get_ptr(_gallivm, _ptr, LP_JIT_CS_CTX_IMAGES, "images")
+
+
+/**
+ * Per rasterizer thread data of compute shaders.
+ */
+struct lp_jit_cs_thread_data
+{
+   /** Shared memory of the work group being run on the thread */
+   uint32_t *shared;
+};
+
+
+enum {
+   LP_JIT_CS_THREAD_DATA_SHARED = 0,
+   LP_JIT_CS_THREAD_DATA_COUNT
+};
+
+
+#define lp_jit_cs_thread_data_shared(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_THREAD_DATA_SHARED, "shared")
+
+
+/**
+ * typedef for compute shader function, which runs a whole work group
+ *
+ * @param context       jit context
+ * @param block_x_size  work group size
+ * @param block_y_size
+ * @param block_z_size
+ * @param grid_x        work group id
+ * @param grid_y
+ * @param grid_z
+ * @param grid_size_x   number of work groups
+ * @param grid_size_y
+ * @param grid_size_z
+ * @param thread_data   rasterizer thread data
+ */
+typedef void
+(*lp_jit_cs_func)(const struct lp_jit_cs_context *context,
+                  uint32_t block_x_size,
+                  uint32_t block_y_size,
+                  uint32_t block_z_size,
+                  uint32_t grid_x,
+                  uint32_t grid_y,
+                  uint32_t grid_z,
+                  uint32_t grid_size_x,
+                  uint32_t grid_size_y,
+                  uint32_t grid_size_z,
+                  struct lp_jit_cs_thread_data *thread_data);
+
+
 void
 lp_jit_screen_cleanup(struct llvmpipe_screen *screen);
 
@@ -271,4 +413,23 @@ void
 lp_jit_init_types(struct lp_fragment_shader_variant *lp);
 
 
+void
+lp_jit_init_cs_types(struct lp_compute_shader_variant *lp);
+
+
+void
+lp_jit_texture_from_pipe(struct lp_jit_texture *jit_tex,
+                         const struct pipe_sampler_view *view);
+
+
+void
+lp_jit_sampler_from_pipe(struct lp_jit_sampler *jit_sam,
+                         const struct pipe_sampler_state *sampler);
+
+
+void
+lp_jit_image_from_pipe(struct lp_jit_image *jit_img,
+                       const struct pipe_image_view *view);
+
+
 #endif /* LP_JIT_H */
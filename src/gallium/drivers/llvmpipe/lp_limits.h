@@ -61,7 +61,34 @@
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
 
-#define LP_MAX_THREADS 16
+/**
+ * Max number of rasterizer threads.  Per-thread state is allocated for the
+ * number of threads actually used, so this is only an upper bound.
+ */
+#define LP_MAX_THREADS 128
+
+
+/**
+ * Max number of scenes per context.  While the rasterizer threads work on
+ * one scene the setup code can bin the next one(s).  The number actually
+ * used is chosen at runtime with LP_NUM_SCENES.
+ */
+#define LP_MAX_SCENES 4
+#define LP_DEFAULT_SCENES 2
+
+
+/**
+ * Max number of background shader compile threads, see
+ * LP_NUM_COMPILE_THREADS.
+ */
+#define LP_MAX_COMPILE_THREADS 8
+#define LP_DEFAULT_COMPILE_THREADS 2
+
+/**
+ * Max number of fragment shader variants per context which may be
+ * compiling in the background at once.
+ */
+#define LP_MAX_PENDING_COMPILES 64
 
 
 /**
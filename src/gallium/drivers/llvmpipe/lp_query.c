@@ -55,7 +55,9 @@ llvmpipe_create_query(struct pipe_context *pipe,
 {
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          type == LP_QUERY_DISK_SHADER_CACHE_HITS ||
+          type == LP_QUERY_DISK_SHADER_CACHE_MISSES);
 
    pq = CALLOC_STRUCT( llvmpipe_query );
 
@@ -177,6 +179,10 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       *stats = pq->stats;
    }
       break;
+   case LP_QUERY_DISK_SHADER_CACHE_HITS:
+   case LP_QUERY_DISK_SHADER_CACHE_MISSES:
+      *result = pq->driver_value;
+      break;
    default:
       assert(0);
       break;
@@ -190,6 +196,7 @@ static boolean
 llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
    /* Check if the query is already in the scene.  If so, we need to
@@ -200,6 +207,17 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe_finish(pipe, __FUNCTION__);
    }
 
+   /* Driver specific queries are plain CPU-side counters. */
+   switch (pq->type) {
+   case LP_QUERY_DISK_SHADER_CACHE_HITS:
+      pq->driver_value = screen->num_disk_shader_cache_hits;
+      return true;
+   case LP_QUERY_DISK_SHADER_CACHE_MISSES:
+      pq->driver_value = screen->num_disk_shader_cache_misses;
+      return true;
+   default:
+      break;
+   }
 
    memset(pq->start, 0, sizeof(pq->start));
    memset(pq->end, 0, sizeof(pq->end));
@@ -247,8 +265,20 @@ static bool
 llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   switch (pq->type) {
+   case LP_QUERY_DISK_SHADER_CACHE_HITS:
+      pq->driver_value = screen->num_disk_shader_cache_hits - pq->driver_value;
+      return true;
+   case LP_QUERY_DISK_SHADER_CACHE_MISSES:
+      pq->driver_value = screen->num_disk_shader_cache_misses - pq->driver_value;
+      return true;
+   default:
+      break;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -291,6 +321,8 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
          llvmpipe->pipeline_statistics.c_primitives - pq->stats.c_primitives;
       pq->stats.ps_invocations =
          llvmpipe->pipeline_statistics.ps_invocations - pq->stats.ps_invocations;
+      pq->stats.cs_invocations =
+         llvmpipe->pipeline_statistics.cs_invocations - pq->stats.cs_invocations;
 
       llvmpipe->active_statistics_queries--;
       break;
@@ -328,6 +360,29 @@ llvmpipe_check_render_cond(struct llvmpipe_context *lp)
       return TRUE;
 }
 
+
+static const struct pipe_driver_query_info lp_driver_query_list[] = {
+   {"shader-cache-hits", LP_QUERY_DISK_SHADER_CACHE_HITS, {0}},
+   {"shader-cache-misses", LP_QUERY_DISK_SHADER_CACHE_MISSES, {0}},
+};
+
+
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   if (!info)
+      return ARRAY_SIZE(lp_driver_query_list);
+
+   if (index >= ARRAY_SIZE(lp_driver_query_list))
+      return 0;
+
+   *info = lp_driver_query_list[index];
+   return 1;
+}
+
+
 static void
 llvmpipe_set_active_query_state(struct pipe_context *pipe, boolean enable)
 {
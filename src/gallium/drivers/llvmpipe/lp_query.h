@@ -39,6 +39,13 @@
 
 
 struct llvmpipe_context;
+struct pipe_screen;
+struct pipe_driver_query_info;
+
+
+/** Driver specific queries, see llvmpipe_get_driver_query_info() */
+#define LP_QUERY_DISK_SHADER_CACHE_HITS   (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_DISK_SHADER_CACHE_MISSES (PIPE_QUERY_DRIVER_SPECIFIC + 1)
 
 
 struct llvmpipe_query {
@@ -48,6 +55,7 @@ struct llvmpipe_query {
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned num_primitives_generated;
    unsigned num_primitives_written;
+   uint64_t driver_value;           /* LP_QUERY_x counter value */
 
    struct pipe_query_data_pipeline_statistics stats;
 };
@@ -57,4 +65,9 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info);
+
 #endif /* LP_QUERY_H */
@@ -26,6 +26,8 @@
  **************************************************************************/
 
 #include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
@@ -70,16 +72,34 @@ lp_rast_begin( struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_scene_bin_iter_begin( scene, MAX2(1, rast->num_threads) );
 }
 
 
+/**
+ * Finish rasterizing a scene.
+ * Called once per scene by one thread, after all threads are done with it.
+ *
+ * The scene's memory and resource references are not released here but by
+ * the setup code when it recycles the scene, so that binning of the next
+ * scene can proceed while this one is still being rasterized.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_fence *fence = NULL;
+
+   /* Hold a reference as the scene may be recycled as soon as the fence
+    * is signalled.
+    */
+   lp_fence_reference(&fence, rast->curr_scene->fence);
 
    rast->curr_scene = NULL;
+
+   if (fence) {
+      lp_fence_signal(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 }
 
 
@@ -680,9 +700,15 @@ rasterize_scene(struct lp_rasterizer_task *task,
       {
          struct cmd_bin *bin;
          int i, j;
+         boolean stolen;
 
          assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+         while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                              &i, &j, &stolen))) {
+            LP_COUNT(nr_bins[task->thread_index]);
+            if (stolen)
+               LP_COUNT(nr_stolen_bins[task->thread_index]);
+
             if (!is_empty_bin( bin ))
                rasterize_bin(task, bin, i, j);
          }
@@ -704,10 +730,6 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
-
    task->scene = NULL;
 }
 
@@ -721,6 +743,8 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 {
    LP_DBG(DEBUG_SETUP, "%s\n", __FUNCTION__);
 
+   lp_fence_reference(&rast->last_fence, scene->fence);
+
    if (rast->num_threads == 0) {
       /* no threading */
       unsigned fpstate = util_fpstate_get();
@@ -756,20 +780,58 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 }
 
 
+/**
+ * Wait for all the scenes queued so far to be rasterized.
+ * Scenes are rasterized in order, so it is enough to wait on the last one.
+ */
 void
 lp_rast_finish( struct lp_rasterizer *rast )
 {
+   if (rast->last_fence) {
+      lp_fence_wait(rast->last_fence);
+   }
+}
+
+
+/**
+ * Run a job on all the rasterizer threads and wait for it to complete.
+ *
+ * Any queued scene is finished first, so the job has the threads to
+ * itself.  The caller must hold the screen's rast_mutex, so that no other
+ * context queues a scene meanwhile.
+ */
+void
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 lp_rast_job_func func,
+                 void *data )
+{
+   unsigned i;
+
+   lp_rast_finish(rast);
+
    if (rast->num_threads == 0) {
-      /* nothing to do */
+      /* no threading */
+      unsigned fpstate = util_fpstate_get();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+
+      func(data, 0);
+
+      util_fpstate_set(fpstate);
+      return;
    }
-   else {
-      int i;
 
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
-      }
+   rast->job_func = func;
+   rast->job_data = data;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_signal(&rast->tasks[i].work_ready);
    }
+
+   pipe_semaphore_wait(&rast->job_done);
+
+   rast->job_func = NULL;
+   rast->job_data = NULL;
 }
 
 
@@ -792,6 +854,21 @@ thread_function(void *init_data)
    util_snprintf(thread_name, sizeof thread_name, "llvmpipe-%u", task->thread_index);
    u_thread_setname(thread_name);
 
+   if (task->cpu >= 0) {
+      struct lp_build_format_cache *cache;
+
+      util_pin_thread_to_cpu(thrd_current(), task->cpu);
+
+      /* Now that we run on our own node, reallocate the per-thread data so
+       * that it ends up in node-local memory.
+       */
+      cache = align_malloc(sizeof(struct lp_build_format_cache), 16);
+      if (cache) {
+         align_free(task->thread_data.cache);
+         task->thread_data.cache = cache;
+      }
+   }
+
    /* Make sure that denorms are treated like zeros. This is 
     * the behavior required by D3D10. OpenGL doesn't care.
     */
@@ -807,6 +884,17 @@ thread_function(void *init_data)
       if (rast->exit_flag)
          break;
 
+      if (rast->job_func) {
+         rast->job_func(rast->job_data, task->thread_index);
+
+         /* wait for all threads to finish with this job */
+         util_barrier_wait( &rast->barrier );
+
+         if (task->thread_index == 0)
+            pipe_semaphore_signal(&rast->job_done);
+         continue;
+      }
+
       if (task->thread_index == 0) {
          /* thread[0]:
           *  - get next scene to rasterize
@@ -837,11 +925,8 @@ thread_function(void *init_data)
          lp_rast_end( rast );
       }
 
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -852,6 +937,131 @@ thread_function(void *init_data)
 }
 
 
+#if defined(PIPE_OS_LINUX) && defined(HAVE_PTHREAD_SETAFFINITY)
+
+#define LP_MAX_NUMA_NODES 64
+
+/**
+ * Read a sysfs CPU list such as "0-7,16-23" into a CPU set.
+ */
+static boolean
+read_cpulist(const char *path, cpu_set_t *set)
+{
+   char buf[1024];
+   char *p;
+   FILE *f;
+
+   f = fopen(path, "r");
+   if (!f)
+      return FALSE;
+
+   p = fgets(buf, sizeof buf, f);
+   fclose(f);
+   if (!p)
+      return FALSE;
+
+   CPU_ZERO(set);
+
+   while (*p >= '0' && *p <= '9') {
+      unsigned long first, last;
+
+      first = last = strtoul(p, &p, 10);
+      if (*p == '-')
+         last = strtoul(p + 1, &p, 10);
+
+      for (; first <= last && first < CPU_SETSIZE; first++)
+         CPU_SET(first, set);
+
+      if (*p == ',')
+         p++;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Pick a CPU for each rasterizer thread.
+ *
+ * The threads are spread evenly over the NUMA nodes, and consecutive
+ * threads, which are handed neighbouring bins, are kept on the same node.
+ * Only CPUs in the process' affinity mask are used.
+ */
+static void
+assign_thread_cpus(struct lp_rasterizer *rast)
+{
+   unsigned node_first[LP_MAX_NUMA_NODES + 1];
+   unsigned node_count[LP_MAX_NUMA_NODES + 1];
+   unsigned cpus[CPU_SETSIZE];
+   unsigned num_cpus = 0, num_nodes = 0;
+   unsigned node, cpu, i;
+   cpu_set_t allowed, node_cpus;
+
+   if (sched_getaffinity(0, sizeof allowed, &allowed) != 0)
+      return;
+
+   for (node = 0; node < LP_MAX_NUMA_NODES; node++) {
+      char path[64];
+
+      util_snprintf(path, sizeof path,
+                    "/sys/devices/system/node/node%u/cpulist", node);
+      if (!read_cpulist(path, &node_cpus))
+         continue;
+
+      node_first[num_nodes] = num_cpus;
+      for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+         if (CPU_ISSET(cpu, &node_cpus) && CPU_ISSET(cpu, &allowed)) {
+            CPU_CLR(cpu, &allowed);
+            cpus[num_cpus++] = cpu;
+         }
+      }
+      node_count[num_nodes] = num_cpus - node_first[num_nodes];
+      if (node_count[num_nodes])
+         num_nodes++;
+   }
+
+   /* No NUMA information (or CPUs missing from it): treat whatever is left
+    * as one more node.
+    */
+   node_first[num_nodes] = num_cpus;
+   for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed))
+         cpus[num_cpus++] = cpu;
+   }
+   node_count[num_nodes] = num_cpus - node_first[num_nodes];
+   if (node_count[num_nodes])
+      num_nodes++;
+
+   if (num_nodes == 0)
+      return;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      unsigned first_thread;
+
+      node = i * num_nodes / rast->num_threads;
+      first_thread = (node * rast->num_threads + num_nodes - 1) / num_nodes;
+
+      rast->tasks[i].cpu =
+         cpus[node_first[node] + (i - first_thread) % node_count[node]];
+   }
+
+   if (LP_DEBUG & DEBUG_SETUP) {
+      for (i = 0; i < rast->num_threads; i++)
+         debug_printf("llvmpipe: rasterizer thread %u on cpu %d\n",
+                      i, rast->tasks[i].cpu);
+   }
+}
+
+#else
+
+static void
+assign_thread_cpus(struct lp_rasterizer *rast)
+{
+}
+
+#endif
+
+
 /**
  * Initialize semaphores and spawn the threads.
  */
@@ -892,10 +1102,17 @@ lp_rast_create( unsigned num_threads )
       goto no_full_scenes;
    }
 
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof *rast->tasks);
+   rast->threads = CALLOC(MAX2(1, num_threads), sizeof *rast->threads);
+   if (!rast->tasks || !rast->threads) {
+      goto no_tasks;
+   }
+
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
+      task->cpu = -1;
       task->thread_data.cache = align_malloc(sizeof(struct lp_build_format_cache),
                                              16);
       if (!task->thread_data.cache) {
@@ -907,11 +1124,17 @@ lp_rast_create( unsigned num_threads )
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
 
+   if (rast->num_threads > 0 &&
+       debug_get_bool_option("LP_PIN_THREADS", FALSE)) {
+      assign_thread_cpus(rast);
+   }
+
    create_rast_threads(rast);
 
    /* for synchronizing rasterization threads */
    if (rast->num_threads > 0) {
       util_barrier_init( &rast->barrier, rast->num_threads );
+      pipe_semaphore_init(&rast->job_done, 0);
    }
 
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
@@ -919,11 +1142,14 @@ lp_rast_create( unsigned num_threads )
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
    }
+no_tasks:
+   FREE(rast->tasks);
+   FREE(rast->threads);
 
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
@@ -971,10 +1197,16 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
    /* for synchronizing rasterization threads */
    if (rast->num_threads > 0) {
       util_barrier_destroy( &rast->barrier );
+      pipe_semaphore_destroy(&rast->job_done);
    }
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   lp_fence_reference(&rast->last_fence, NULL);
+
+   FREE(rast->tasks);
+   FREE(rast->threads);
+
    FREE(rast);
 }
 
@@ -169,6 +169,17 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
 void
 lp_rast_finish( struct lp_rasterizer *rast );
 
+/**
+ * A job run on every rasterizer thread, e.g. a compute grid launch.
+ * It's up to the job to split its work between the threads.
+ */
+typedef void (*lp_rast_job_func)(void *data, unsigned thread_index);
+
+void
+lp_rast_run_job( struct lp_rasterizer *rast,
+                 lp_rast_job_func func,
+                 void *data );
+
 
 union lp_rast_cmd_arg {
    const struct lp_rast_shader_inputs *shade_tile;
@@ -97,6 +97,9 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** CPU this thread is pinned to, or -1 */
+   int cpu;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
@@ -121,14 +124,22 @@ struct lp_rasterizer
    /** The scene currently being rasterized by the threads */
    struct lp_scene *curr_scene;
 
+   /** Fence of the most recently queued scene */
+   struct lp_fence *last_fence;
+
    /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
 
    /** For synchronizing the rasterization threads */
    util_barrier barrier;
+
+   /** Job to run instead of a scene, see lp_rast_run_job() */
+   lp_rast_job_func job_func;
+   void *job_data;
+   pipe_semaphore job_done;
 };
 
 
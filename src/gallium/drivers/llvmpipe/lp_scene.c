@@ -31,9 +31,11 @@
 #include "util/u_inlines.h"
 #include "util/simple_list.h"
 #include "util/u_format.h"
+#include "util/u_atomic.h"
 #include "lp_scene.h"
 #include "lp_fence.h"
 #include "lp_debug.h"
+#include "lp_texture.h"
 
 
 #define RESOURCE_REF_SZ 32
@@ -42,6 +44,7 @@
 struct resource_ref {
    struct pipe_resource *resource[RESOURCE_REF_SZ];
    int count;
+   unsigned writeable_mask;  /**< resources the shaders may write to */
    struct resource_ref *next;
 };
 
@@ -62,8 +65,6 @@ lp_scene_create( struct pipe_context *pipe )
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   (void) mtx_init(&scene->mutex, mtx_plain);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,7 +91,6 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
    FREE(scene);
@@ -374,7 +374,8 @@ lp_scene_data_size( const struct lp_scene *scene )
 boolean
 lp_scene_add_resource_reference(struct lp_scene *scene,
                                 struct pipe_resource *resource,
-                                boolean initializing_scene)
+                                boolean initializing_scene,
+                                boolean writeable)
 {
    struct resource_ref *ref, **last = &scene->resources;
    int i;
@@ -386,9 +387,13 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
       /* Search for this resource:
        */
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            if (writeable)
+               ref->writeable_mask |= 1u << i;
             return TRUE;
+         }
+      }
 
       if (ref->count < RESOURCE_REF_SZ) {
          /* If the block is half-empty, then append the reference here.
@@ -411,6 +416,8 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
    /* Append the reference to the reference block.
     */
+   if (writeable)
+      ref->writeable_mask |= 1u << ref->count;
    pipe_resource_reference(&ref->resource[ref->count++], resource);
    scene->resource_reference_size += llvmpipe_resource_size(resource);
 
@@ -429,8 +436,9 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 
 /**
  * Does this scene have a reference to the given resource?
+ * \return bitmask of LP_REFERENCED_FOR_READ/WRITE bits
  */
-boolean
+unsigned
 lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                 const struct pipe_resource *resource)
 {
@@ -438,72 +446,128 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
    int i;
 
    for (ref = scene->resources; ref; ref = ref->next) {
-      for (i = 0; i < ref->count; i++)
-         if (ref->resource[i] == resource)
-            return TRUE;
+      for (i = 0; i < ref->count; i++) {
+         if (ref->resource[i] == resource) {
+            if (ref->writeable_mask & (1u << i))
+               return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+            return LP_REFERENCED_FOR_READ;
+         }
+      }
    }
 
-   return FALSE;
+   return 0;
 }
 
 
 
 
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
+/** Gather the even bits of v into the low half (Morton decode) */
+static inline unsigned
+compact_bits(unsigned v)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
+   v &= 0x55555555;
+   v = (v | (v >> 1)) & 0x33333333;
+   v = (v | (v >> 2)) & 0x0f0f0f0f;
+   v = (v | (v >> 4)) & 0x00ff00ff;
+   v = (v | (v >> 8)) & 0x0000ffff;
+   return v;
+}
+
+
+/**
+ * Lay the bins out along a Morton (Z-order) curve, so that any contiguous
+ * run of bins covers a compact area of the framebuffer rather than a thin
+ * strip.  Only recomputed when the framebuffer size changes.
+ */
+static void
+update_bin_order(struct lp_scene *scene)
+{
+   unsigned size, i, n = 0;
+
+   if (scene->bin_order_tiles_x == scene->tiles_x &&
+       scene->bin_order_tiles_y == scene->tiles_y)
+      return;
+
+   size = util_next_power_of_two(MAX2(scene->tiles_x, scene->tiles_y));
+
+   for (i = 0; i < size * size; i++) {
+      unsigned x = compact_bits(i);
+      unsigned y = compact_bits(i >> 1);
+
+      if (x < scene->tiles_x && y < scene->tiles_y) {
+         scene->bin_order[n][0] = x;
+         scene->bin_order[n][1] = y;
+         n++;
+      }
    }
-   return TRUE;
+
+   assert(n == lp_scene_get_num_bins(scene));
+
+   scene->bin_order_tiles_x = scene->tiles_x;
+   scene->bin_order_tiles_y = scene->tiles_y;
 }
 
 
+/**
+ * Prepare for iterating over the bins.
+ * Called by one thread before any of the threads call
+ * lp_scene_bin_iter_next().
+ *
+ * Each thread is given an equal, contiguous range of the Morton-ordered
+ * bins, i.e. a compact region of the framebuffer.
+ */
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads )
 {
-   scene->curr_x = scene->curr_y = -1;
+   unsigned num_bins = lp_scene_get_num_bins(scene);
+   unsigned i;
+
+   assert(num_threads >= 1 && num_threads <= LP_MAX_THREADS);
+
+   update_bin_order(scene);
+
+   for (i = 0; i < num_threads; i++) {
+      scene->bin_queues[i].next = i * num_bins / num_threads;
+      scene->bin_queues[i].end = (i + 1) * num_bins / num_threads;
+   }
+
+   scene->num_bin_queues = num_threads;
 }
 
 
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
- * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * Return pointer to next bin to be rendered by the given thread.
+ * Multiple rendering threads will call this function concurrently, without
+ * locking.  A thread first works through its own range of bins and then
+ * steals bins from the other threads' ranges.
+ * \param stolen  returns whether the bin came from another thread's range
  */
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y, boolean *stolen )
 {
-   struct cmd_bin *bin = NULL;
+   unsigned num_queues = scene->num_bin_queues;
+   unsigned i;
 
-   mtx_lock(&scene->mutex);
+   for (i = 0; i < num_queues; i++) {
+      struct lp_bin_queue *queue =
+         &scene->bin_queues[(thread_index + i) % num_queues];
+      unsigned idx;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
-   }
+      if (p_atomic_read(&queue->next) >= queue->end)
+         continue;
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+      idx = p_atomic_inc_return(&queue->next) - 1;
+      if (idx < queue->end) {
+         *x = scene->bin_order[idx][0];
+         *y = scene->bin_order[idx][1];
+         *stolen = i != 0;
+         return lp_scene_get_bin(scene, *x, *y);
+      }
+   }
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   /* no more bins left */
+   return NULL;
 }
 
 
@@ -117,6 +117,17 @@ struct data_block_list {
 
 struct resource_ref;
 
+/**
+ * A range of bins, in lp_scene::bin_order, assigned to one rasterizer
+ * thread.  Bins are taken from the front by atomically incrementing 'next',
+ * both by the owning thread and by any other thread which ran out of work
+ * and steals from it.  Padded to avoid false sharing between threads.
+ */
+struct lp_bin_queue {
+   PIPE_ALIGN_VAR(64) unsigned next;
+   unsigned end;
+};
+
 /**
  * All bins and bin data are contained here.
  * Per-bin data goes into the 'tile' bins.
@@ -172,8 +183,13 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
+   /** Bin coordinates in the order they're handed to the threads */
+   uint8_t bin_order[TILES_X * TILES_Y][2];
+   unsigned bin_order_tiles_x, bin_order_tiles_y;
+
+   /** Per-thread work queues, for iterating over bins */
+   struct lp_bin_queue bin_queues[LP_MAX_THREADS];
+   unsigned num_bin_queues;
 
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
@@ -196,9 +212,10 @@ struct cmd_block *lp_scene_new_cmd_block( struct lp_scene *scene,
 
 boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
-                                        boolean initializing_scene);
+                                        boolean initializing_scene,
+                                        boolean writeable);
 
-boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
+unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
                                         const struct pipe_resource *resource );
 
 
@@ -378,10 +395,11 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 
 
 void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
+lp_scene_bin_iter_begin( struct lp_scene *scene, unsigned num_threads );
 
 struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
+lp_scene_bin_iter_next( struct lp_scene *scene, unsigned thread_index,
+                        int *x, int *y, boolean *stolen );
 
 
 
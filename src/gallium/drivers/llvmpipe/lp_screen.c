@@ -33,9 +33,14 @@
 #include "util/u_screen.h"
 #include "util/u_string.h"
 #include "util/u_format_s3tc.h"
+#include "util/u_atomic.h"
+#include "util/disk_cache.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_defines.h"
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_type.h"
 
 #include "os/os_misc.h"
@@ -49,9 +54,12 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_query.h"
 
 #include "state_tracker/sw_winsys.h"
 
+#include <llvm-c/ExecutionEngine.h>
+
 #ifdef DEBUG
 int LP_DEBUG = 0;
 
@@ -214,7 +222,7 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_QUADS_FOLLOW_PROVOKING_VERTEX_CONVENTION:
       return 0;
    case PIPE_CAP_COMPUTE:
-      return 0;
+      return llvmpipe_screen(screen)->allow_compute;
    case PIPE_CAP_USER_VERTEX_BUFFERS:
       return 1;
    case PIPE_CAP_VERTEX_BUFFER_OFFSET_4BYTE_ALIGNED_ONLY:
@@ -324,7 +332,6 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
    case PIPE_CAP_MULTI_DRAW_INDIRECT_PARAMS:
    case PIPE_CAP_TGSI_FS_POSITION_IS_SYSVAL:
    case PIPE_CAP_TGSI_FS_FACE_IS_INTEGER_SYSVAL:
-   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
    case PIPE_CAP_INVALIDATE_BUFFER:
    case PIPE_CAP_GENERATE_MIPMAP:
    case PIPE_CAP_STRING_MARKER:
@@ -381,6 +388,8 @@ llvmpipe_get_param(struct pipe_screen *screen, enum pipe_cap param)
       return 32;
    case PIPE_CAP_MAX_SHADER_BUFFER_SIZE:
       return 1 << 27;
+   case PIPE_CAP_SHADER_BUFFER_OFFSET_ALIGNMENT:
+      return 16;
 
    default:
       return u_pipe_screen_get_param_defaults(screen, param);
@@ -396,6 +405,8 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
    {
    case PIPE_SHADER_FRAGMENT:
       switch (param) {
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
       default:
          return gallivm_get_shader_param(param);
       }
@@ -419,11 +430,83 @@ llvmpipe_get_shader_param(struct pipe_screen *screen,
       default:
          return draw_get_shader_param(shader, param);
       }
+   case PIPE_SHADER_COMPUTE:
+      if (!llvmpipe_screen(screen)->allow_compute)
+         return 0;
+      switch (param) {
+      case PIPE_SHADER_CAP_MAX_SHADER_BUFFERS:
+         return LP_MAX_TGSI_SHADER_BUFFERS;
+      case PIPE_SHADER_CAP_MAX_SHADER_IMAGES:
+         return PIPE_MAX_SHADER_IMAGES;
+      case PIPE_SHADER_CAP_MAX_INPUTS:
+      case PIPE_SHADER_CAP_MAX_OUTPUTS:
+         return 0;
+      default:
+         return gallivm_get_shader_param(param);
+      }
    default:
       return 0;
    }
 }
 
+static int
+llvmpipe_get_compute_param(struct pipe_screen *_screen,
+                           enum pipe_shader_ir ir_type,
+                           enum pipe_compute_cap param,
+                           void *ret)
+{
+   switch (param) {
+   case PIPE_COMPUTE_CAP_IR_TARGET:
+      return 0;
+   case PIPE_COMPUTE_CAP_GRID_DIMENSION:
+      if (ret) {
+         uint64_t *grid_dimension = ret;
+         *grid_dimension = 3;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_GRID_SIZE:
+      if (ret) {
+         uint64_t *grid_size = ret;
+         grid_size[0] = 65535;
+         grid_size[1] = 65535;
+         grid_size[2] = 65535;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_BLOCK_SIZE:
+      if (ret) {
+         uint64_t *block_size = ret;
+         block_size[0] = 1024;
+         block_size[1] = 1024;
+         block_size[2] = 1024;
+      }
+      return 3 * sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_THREADS_PER_BLOCK:
+      if (ret) {
+         uint64_t *max_threads_per_block = ret;
+         *max_threads_per_block = 1024;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_LOCAL_SIZE:
+      if (ret) {
+         uint64_t *max_local_size = ret;
+         *max_local_size = 32768;
+      }
+      return sizeof(uint64_t);
+   case PIPE_COMPUTE_CAP_MAX_GLOBAL_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_PRIVATE_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_INPUT_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_MEM_ALLOC_SIZE:
+   case PIPE_COMPUTE_CAP_MAX_CLOCK_FREQUENCY:
+   case PIPE_COMPUTE_CAP_MAX_COMPUTE_UNITS:
+   case PIPE_COMPUTE_CAP_IMAGES_SUPPORTED:
+   case PIPE_COMPUTE_CAP_SUBGROUP_SIZE:
+   case PIPE_COMPUTE_CAP_ADDRESS_BITS:
+   case PIPE_COMPUTE_CAP_MAX_VARIABLE_THREADS_PER_BLOCK:
+      break;
+   }
+   return 0;
+}
+
 static float
 llvmpipe_get_paramf(struct pipe_screen *screen, enum pipe_capf param)
 {
@@ -529,6 +612,44 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
       }
    }
 
+   if (bind & PIPE_BIND_SHADER_IMAGE) {
+      /* Only what lp_build_pack_rgba_soa() can store */
+      if (format != PIPE_FORMAT_R11G11B10_FLOAT) {
+         unsigned chan;
+
+         if (format_desc->layout != UTIL_FORMAT_LAYOUT_PLAIN ||
+             format_desc->colorspace != UTIL_FORMAT_COLORSPACE_RGB ||
+             format_desc->block.bits < 8 ||
+             format_desc->block.bits > 128 ||
+             !util_is_power_of_two_or_zero(format_desc->block.bits))
+            return FALSE;
+
+         for (chan = 0; chan < format_desc->nr_channels; ++chan) {
+            const struct util_format_channel_description *chan_desc =
+               &format_desc->channel[chan];
+
+            if (chan_desc->type == UTIL_FORMAT_TYPE_VOID)
+               continue;
+
+            if (chan_desc->type == UTIL_FORMAT_TYPE_FLOAT) {
+               if (chan_desc->size != 16 && chan_desc->size != 32)
+                  return FALSE;
+            }
+            else if (chan_desc->type != UTIL_FORMAT_TYPE_UNSIGNED &&
+                     chan_desc->type != UTIL_FORMAT_TYPE_SIGNED)
+               return FALSE;
+
+            if (!chan_desc->pure_integer &&
+                chan_desc->type != UTIL_FORMAT_TYPE_FLOAT &&
+                !chan_desc->normalized)
+               return FALSE;
+
+            if (chan_desc->shift % 32 + chan_desc->size > 32)
+               return FALSE;
+         }
+      }
+   }
+
    if (bind & PIPE_BIND_DISPLAY_TARGET) {
       if(!winsys->is_displaytarget_format_supported(winsys, bind, format))
          return FALSE;
@@ -579,8 +700,16 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
 
    assert(texture->dt);
-   if (texture->dt)
+   if (texture->dt) {
+      /* Scenes are no longer rasterized synchronously on flush, so make sure
+       * whatever was queued so far has landed in the display target.
+       */
+      mtx_lock(&screen->rast_mutex);
+      lp_rast_finish(screen->rast);
+      mtx_unlock(&screen->rast_mutex);
+
       winsys->displaytarget_display(winsys, texture->dt, context_private, sub_box);
+   }
 }
 
 static void
@@ -592,8 +721,20 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   if (screen->num_compile_threads) {
+      unsigned i;
+
+      util_queue_destroy(&screen->compile_queue);
+      for (i = 0; i < ARRAY_SIZE(screen->compile_contexts); i++) {
+         if (screen->compile_contexts[i])
+            LLVMContextDispose(screen->compile_contexts[i]);
+      }
+   }
+
    lp_jit_screen_cleanup(screen);
 
+   disk_cache_destroy(screen->disk_shader_cache);
+
    if(winsys->destroy)
       winsys->destroy(winsys);
 
@@ -644,6 +785,97 @@ llvmpipe_get_timestamp(struct pipe_screen *_screen)
    return os_time_get_nano();
 }
 
+
+/**
+ * Create the on-disk cache for JIT-compiled code.
+ *
+ * The generated code depends on the Mesa and LLVM builds, on the CPU
+ * features code is generated for and on the gallivm debug flags, so all of
+ * these go into the cache id.
+ */
+static void
+lp_disk_cache_create(struct llvmpipe_screen *screen)
+{
+#ifdef HAVE_DLFCN_H
+   struct mesa_sha1 ctx;
+   unsigned char sha1[20];
+   char cache_id[20 * 2 + 1];
+   uint32_t mesa_timestamp, llvm_timestamp;
+
+   if (!disk_cache_get_function_timestamp(lp_disk_cache_create,
+                                          &mesa_timestamp) ||
+       !disk_cache_get_function_timestamp(LLVMLinkInMCJIT,
+                                          &llvm_timestamp))
+      return;
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, &mesa_timestamp, sizeof(mesa_timestamp));
+   _mesa_sha1_update(&ctx, &llvm_timestamp, sizeof(llvm_timestamp));
+   _mesa_sha1_update(&ctx, &util_cpu_caps, sizeof(util_cpu_caps));
+   _mesa_sha1_update(&ctx, &lp_native_vector_width,
+                     sizeof(lp_native_vector_width));
+#ifdef DEBUG
+   _mesa_sha1_update(&ctx, &gallivm_debug, sizeof(gallivm_debug));
+#endif
+   _mesa_sha1_final(&ctx, sha1);
+   disk_cache_format_hex_id(cache_id, sha1, 20 * 2);
+
+   screen->disk_shader_cache = disk_cache_create("llvmpipe", cache_id, 0);
+#endif
+}
+
+
+/**
+ * Look up the object code for the given variant key in the disk cache.
+ * On a hit, cache->data is malloc'ed and must be freed by the caller.
+ */
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+   size_t binary_size;
+   void *buffer;
+
+   if (!screen->disk_shader_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20,
+                          sha1);
+
+   buffer = disk_cache_get(screen->disk_shader_cache, sha1, &binary_size);
+   if (!buffer) {
+      cache->data_size = 0;
+      p_atomic_inc(&screen->num_disk_shader_cache_misses);
+      return;
+   }
+
+   cache->data_size = binary_size;
+   cache->data = buffer;
+   p_atomic_inc(&screen->num_disk_shader_cache_hits);
+}
+
+
+/**
+ * Store freshly generated object code for the given variant key.
+ */
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20])
+{
+   unsigned char sha1[CACHE_KEY_SIZE];
+
+   if (!screen->disk_shader_cache || !cache->data_size || cache->dont_cache)
+      return;
+
+   disk_cache_compute_key(screen->disk_shader_cache, ir_sha1_cache_key, 20,
+                          sha1);
+   disk_cache_put(screen->disk_shader_cache, sha1, cache->data,
+                  cache->data_size, NULL);
+}
+
 /**
  * Create a new pipe_screen object
  * Note: we're not presently subclassing pipe_screen (no llvmpipe_screen).
@@ -680,6 +912,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.get_param = llvmpipe_get_param;
    screen->base.get_shader_param = llvmpipe_get_shader_param;
    screen->base.get_paramf = llvmpipe_get_paramf;
+   screen->base.get_compute_param = llvmpipe_get_compute_param;
    screen->base.is_format_supported = llvmpipe_is_format_supported;
 
    screen->base.context_create = llvmpipe_create_context;
@@ -688,6 +921,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.fence_finish = llvmpipe_fence_finish;
 
    screen->base.get_timestamp = llvmpipe_get_timestamp;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
 
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
@@ -698,6 +932,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   screen->num_scenes = debug_get_num_option("LP_NUM_SCENES", LP_DEFAULT_SCENES);
+   screen->num_scenes = CLAMP(screen->num_scenes, 1, LP_MAX_SCENES);
+
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
       lp_jit_screen_cleanup(screen);
@@ -706,5 +943,23 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
+   screen->num_compile_threads =
+      util_cpu_caps.nr_cpus > 1 ? LP_DEFAULT_COMPILE_THREADS : 0;
+   screen->num_compile_threads = debug_get_num_option("LP_NUM_COMPILE_THREADS",
+                                                      screen->num_compile_threads);
+   screen->num_compile_threads = MIN2(screen->num_compile_threads,
+                                      LP_MAX_COMPILE_THREADS);
+   if (screen->num_compile_threads &&
+       !util_queue_init(&screen->compile_queue, "lpcomp",
+                        LP_MAX_PENDING_COMPILES,
+                        screen->num_compile_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL))
+      screen->num_compile_threads = 0;
+
+   /* Barriers need coroutines */
+   screen->allow_compute = GALLIVM_HAVE_CORO;
+
+   lp_disk_cache_create(screen);
+
    return &screen->base;
 }
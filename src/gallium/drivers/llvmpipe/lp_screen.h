@@ -37,10 +37,14 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_queue.h"
 #include "gallivm/lp_bld.h"
+#include "lp_limits.h"
 
 
 struct sw_winsys;
+struct disk_cache;
+struct lp_cached_code;
 
 
 struct llvmpipe_screen
@@ -50,6 +54,7 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_scenes;
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
@@ -57,6 +62,19 @@ struct llvmpipe_screen
 
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
+
+   /** Background compilation of fragment shader variants */
+   unsigned num_compile_threads;
+   struct util_queue compile_queue;
+   LLVMContextRef compile_contexts[LP_MAX_COMPILE_THREADS];
+
+   /** Whether PIPE_CAP_COMPUTE is advertised */
+   boolean allow_compute;
+
+   /** On-disk cache of JIT-compiled shader variants */
+   struct disk_cache *disk_shader_cache;
+   unsigned num_disk_shader_cache_hits;
+   unsigned num_disk_shader_cache_misses;
 };
 
 
@@ -69,5 +87,16 @@ llvmpipe_screen( struct pipe_screen *pipe )
 }
 
 
+void
+lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
+                          struct lp_cached_code *cache,
+                          unsigned char ir_sha1_cache_key[20]);
+
+void
+lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
+                            struct lp_cached_code *cache,
+                            unsigned char ir_sha1_cache_key[20]);
+
+
 
 #endif /* LP_SCREEN_H */
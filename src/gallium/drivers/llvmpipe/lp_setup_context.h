@@ -49,16 +49,12 @@
 #define LP_SETUP_NEW_BLEND_COLOR 0x04
 #define LP_SETUP_NEW_SCISSOR     0x08
 #define LP_SETUP_NEW_VIEWPORTS   0x10
+#define LP_SETUP_NEW_SSBOS       0x20
 
 
 struct lp_setup_variant;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
-
-
 
 /**
  * Point/line/triangle setup context.
@@ -87,8 +83,9 @@ struct lp_setup_context
     */
    struct draw_stage *vbuf;
    unsigned num_threads;
+   unsigned num_scenes;
    unsigned scene_idx;
-   struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
+   struct lp_scene *scenes[LP_MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
    struct lp_fence *last_fence;
@@ -143,6 +140,11 @@ struct lp_setup_context
       const void *stored_data;
    } constants[LP_MAX_TGSI_CONST_BUFFERS];
 
+   /** fragment shader buffers, written to in place */
+   struct {
+      struct pipe_shader_buffer current;
+   } ssbos[LP_MAX_TGSI_SHADER_BUFFERS];
+
    struct {
       struct pipe_blend_color current;
       uint8_t *stored;
@@ -0,0 +1,1010 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER(S) AND/OR ITS SUPPLIERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute shaders.
+ *
+ * A grid launch is run on the rasterizer threads, each thread claiming
+ * whole work groups in turn.  A work group is executed as a sequence of
+ * SoA vectors of invocations.  When the shader has barriers, each vector
+ * is a coroutine, which suspends at every barrier until all the vectors of
+ * the group have reached it.
+ */
+
+#include "pipe/p_defines.h"
+#include "pipe/p_shader_tokens.h"
+#include "util/u_atomic.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "util/os_time.h"
+#include "util/mesa-sha1.h"
+#include "util/u_format.h"
+#include "tgsi/tgsi_dump.h"
+#include "tgsi/tgsi_parse.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_coro.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_intr.h"
+#include "gallivm/lp_bld_logic.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_swizzle.h"
+#include "gallivm/lp_bld_tgsi.h"
+#include "gallivm/lp_bld_type.h"
+#include "lp_context.h"
+#include "lp_debug.h"
+#include "lp_flush.h"
+#include "lp_perf.h"
+#include "lp_rast.h"
+#include "lp_screen.h"
+#include "lp_state.h"
+#include "lp_state_cs.h"
+#include "lp_tex_sample.h"
+#include "lp_texture.h"
+
+
+/** shader number (for debugging) */
+static unsigned cs_no = 0;
+
+/**
+ * Compute state hardly ever changes between launches of a given shader,
+ * so only keep a handful of variants of each.
+ */
+#define LP_MAX_CS_VARIANTS 16
+
+
+/**
+ * Code generation state the TGSI translation calls back into.
+ */
+struct lp_cs_iface
+{
+   struct lp_build_tgsi_cs_iface base;
+
+   struct lp_build_coro_suspend_info sus_info;
+};
+
+
+#if GALLIVM_HAVE_CORO
+/**
+ * Suspend the current vector of invocations, to be resumed once all the
+ * other vectors of the work group have reached the barrier too.
+ */
+static void
+cs_emit_barrier(const struct lp_build_tgsi_cs_iface *cs_iface,
+                struct lp_build_tgsi_context *bld_base)
+{
+   const struct lp_cs_iface *iface = (const struct lp_cs_iface *)cs_iface;
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBasicBlockRef resume;
+
+   resume = lp_build_insert_new_block(gallivm, "resume");
+
+   lp_build_coro_suspend_switch(gallivm, &iface->sus_info, resume, FALSE);
+
+   LLVMPositionBuilderAtEnd(gallivm->builder, resume);
+}
+#endif
+
+
+/**
+ * Whether the work group can't be run as a single vector, and contains
+ * barriers to synchronize its vectors at.
+ */
+static boolean
+cs_needs_coroutines(const struct lp_compute_shader *shader,
+                    unsigned vector_length)
+{
+   const unsigned *properties = shader->info.base.properties;
+
+   if (!GALLIVM_HAVE_CORO)
+      return FALSE;
+
+   if (!shader->info.base.opcode_count[TGSI_OPCODE_BARRIER])
+      return FALSE;
+
+   if (properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH] &&
+       properties[TGSI_PROPERTY_CS_FIXED_BLOCK_WIDTH] *
+       properties[TGSI_PROPERTY_CS_FIXED_BLOCK_HEIGHT] *
+       properties[TGSI_PROPERTY_CS_FIXED_BLOCK_DEPTH] <= vector_length)
+      return FALSE;
+
+   return TRUE;
+}
+
+
+/**
+ * Generate the function running a vector of invocations of a work group.
+ *
+ * It takes the same arguments as the main function, plus the index of the
+ * vector within the group.  When using coroutines it returns the coroutine
+ * handle at the first suspend point.
+ */
+static LLVMValueRef
+generate_compute_body(struct lp_compute_shader *shader,
+                      struct lp_compute_shader_variant *variant,
+                      struct lp_type cs_type,
+                      const LLVMTypeRef *arg_types,
+                      unsigned num_args,
+                      boolean use_coro)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef ret_type;
+   LLVMTypeRef func_type;
+   LLVMValueRef function;
+   LLVMValueRef context_ptr;
+   LLVMValueRef thread_data_ptr;
+   LLVMValueRef vec_index;
+   LLVMValueRef consts_ptr, num_consts_ptr;
+   MAYBE_UNUSED LLVMValueRef coro_id = NULL, coro_hdl = NULL;
+   LLVMValueRef lanes[LP_MAX_VECTOR_LENGTH];
+   LLVMValueRef block_size[3];
+   LLVMValueRef idx, tmp, total, mask_val;
+   LLVMBasicBlockRef block;
+   struct lp_build_context uint_bld;
+   struct lp_build_mask_context mask;
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_sampler_soa *sampler;
+   struct lp_build_image_soa *image;
+   struct lp_cs_iface iface;
+   unsigned i;
+
+   if (use_coro)
+      ret_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   else
+      ret_type = LLVMVoidTypeInContext(gallivm->context);
+
+   func_type = LLVMFunctionType(ret_type, (LLVMTypeRef *)arg_types,
+                                num_args, 0);
+
+   function = LLVMAddFunction(gallivm->module, "cs_variant_body", func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+   LLVMSetLinkage(function, LLVMInternalLinkage);
+
+   for (i = 0; i < num_args; ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   context_ptr = LLVMGetParam(function, 0);
+   for (i = 0; i < 3; i++)
+      block_size[i] = LLVMGetParam(function, 1 + i);
+   thread_data_ptr = LLVMGetParam(function, 10);
+   vec_index = LLVMGetParam(function, 11);
+
+   lp_build_name(context_ptr, "context");
+   lp_build_name(thread_data_ptr, "thread_data");
+   lp_build_name(vec_index, "vec_index");
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   memset(&iface, 0, sizeof iface);
+
+#if GALLIVM_HAVE_CORO
+   if (use_coro) {
+      /* The legacy CoroSplit pass only looks at functions marked this way */
+      LLVMAddTargetDependentFunctionAttr(function, "coroutine.presplit", "0");
+      coro_id = lp_build_coro_id(gallivm);
+      coro_hdl = lp_build_coro_begin_alloc_mem(gallivm, coro_id);
+
+      iface.sus_info.suspend =
+         LLVMAppendBasicBlockInContext(gallivm->context, function, "suspend");
+      iface.sus_info.cleanup =
+         LLVMAppendBasicBlockInContext(gallivm->context, function, "cleanup");
+      iface.base.emit_barrier = cs_emit_barrier;
+   }
+#endif
+
+   /*
+    * Flatten the invocation index within the work group and split it into
+    * the x, y, z thread ids.
+    */
+   lp_build_context_init(&uint_bld, gallivm, lp_uint_type(cs_type));
+
+   for (i = 0; i < cs_type.length; i++)
+      lanes[i] = lp_build_const_int32(gallivm, i);
+
+   idx = LLVMBuildMul(builder, vec_index,
+                      lp_build_const_int32(gallivm, cs_type.length), "");
+   idx = lp_build_broadcast_scalar(&uint_bld, idx);
+   idx = LLVMBuildAdd(builder, idx,
+                      LLVMConstVector(lanes, cs_type.length), "idx");
+
+   for (i = 0; i < 3; i++)
+      block_size[i] = lp_build_broadcast_scalar(&uint_bld, block_size[i]);
+
+   memset(&system_values, 0, sizeof system_values);
+   system_values.thread_id[0] = LLVMBuildURem(builder, idx, block_size[0], "");
+   tmp = LLVMBuildUDiv(builder, idx, block_size[0], "");
+   system_values.thread_id[1] = LLVMBuildURem(builder, tmp, block_size[1], "");
+   system_values.thread_id[2] = LLVMBuildUDiv(builder, tmp, block_size[1], "");
+
+   for (i = 0; i < 3; i++) {
+      system_values.block_size[i] = LLVMGetParam(function, 1 + i);
+      system_values.block_id[i] = LLVMGetParam(function, 4 + i);
+      system_values.grid_size[i] = LLVMGetParam(function, 7 + i);
+   }
+
+   /* the last vector of the group may be partial */
+   total = LLVMBuildMul(builder, block_size[0], block_size[1], "");
+   total = LLVMBuildMul(builder, total, block_size[2], "");
+   mask_val = lp_build_cmp(&uint_bld, PIPE_FUNC_LESS, idx, total);
+
+   lp_build_mask_begin(&mask, gallivm, cs_type, mask_val);
+
+   consts_ptr = lp_jit_cs_context_constants(gallivm, context_ptr);
+   num_consts_ptr = lp_jit_cs_context_num_constants(gallivm, context_ptr);
+
+   iface.base.ssbo_ptr = lp_jit_cs_context_ssbos(gallivm, context_ptr);
+   iface.base.ssbo_sizes_ptr = lp_jit_cs_context_ssbo_sizes(gallivm, context_ptr);
+   iface.base.shared_ptr = lp_jit_cs_thread_data_shared(gallivm, thread_data_ptr);
+   iface.base.shared_size = lp_build_const_int32(gallivm,
+                                                 shader->base.req_local_mem);
+
+   sampler = lp_llvm_cs_sampler_soa_create(variant->key.state);
+   image = lp_llvm_image_soa_create(variant->key.image_state);
+   iface.base.image = image;
+
+   lp_build_tgsi_soa(gallivm, shader->tokens, cs_type, &mask,
+                     consts_ptr, num_consts_ptr, &system_values,
+                     NULL, NULL, /* no inputs nor outputs */
+                     context_ptr, thread_data_ptr,
+                     sampler,
+                     &shader->info.base, NULL, &iface.base);
+
+   lp_build_mask_end(&mask);
+
+   sampler->destroy(sampler);
+   image->destroy(image);
+
+#if GALLIVM_HAVE_CORO
+   if (use_coro) {
+      lp_build_coro_suspend_switch(gallivm, &iface.sus_info, NULL, TRUE);
+
+      LLVMPositionBuilderAtEnd(builder, iface.sus_info.cleanup);
+      lp_build_coro_free_mem(gallivm, coro_id, coro_hdl);
+      LLVMBuildBr(builder, iface.sus_info.suspend);
+
+      LLVMPositionBuilderAtEnd(builder, iface.sus_info.suspend);
+      lp_build_coro_end(gallivm, coro_hdl);
+      LLVMBuildRet(builder, coro_hdl);
+   }
+   else
+#endif
+   {
+      LLVMBuildRetVoid(builder);
+   }
+
+   gallivm_verify_function(gallivm, function);
+
+   return function;
+}
+
+
+/**
+ * Generate the function running one work group.
+ */
+static void
+generate_compute(struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant *variant)
+{
+   struct gallivm_state *gallivm = variant->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef arg_types[12];
+   LLVMTypeRef func_type;
+   LLVMValueRef function, body;
+   LLVMValueRef args[12];
+   LLVMValueRef total, num_vecs;
+   LLVMBasicBlockRef block;
+   struct lp_build_loop_state loop;
+   struct lp_type cs_type;
+   boolean use_coro;
+   unsigned i;
+
+   memset(&cs_type, 0, sizeof cs_type);
+   cs_type.floating = TRUE;      /* floating point values */
+   cs_type.sign = TRUE;          /* values are signed */
+   cs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
+   cs_type.width = 32;           /* 32-bit float */
+   cs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+
+   use_coro = cs_needs_coroutines(shader, cs_type.length);
+
+   /*
+    * Generate the function prototype. Any change here must be reflected in
+    * lp_jit.h's lp_jit_cs_func function pointer type, and vice-versa.
+    */
+   arg_types[0] = variant->jit_cs_context_ptr_type;       /* context */
+   arg_types[1] = int32_type;                             /* block_x_size */
+   arg_types[2] = int32_type;                             /* block_y_size */
+   arg_types[3] = int32_type;                             /* block_z_size */
+   arg_types[4] = int32_type;                             /* grid_x */
+   arg_types[5] = int32_type;                             /* grid_y */
+   arg_types[6] = int32_type;                             /* grid_z */
+   arg_types[7] = int32_type;                             /* grid_size_x */
+   arg_types[8] = int32_type;                             /* grid_size_y */
+   arg_types[9] = int32_type;                             /* grid_size_z */
+   arg_types[10] = variant->jit_cs_thread_data_ptr_type;  /* per thread data */
+   arg_types[11] = int32_type;                            /* vec_index (body only) */
+
+   func_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context),
+                                arg_types, ARRAY_SIZE(arg_types) - 1, 0);
+
+   /* The name must not depend on the shader number, as it's looked up
+    * again in code loaded from the disk cache.
+    */
+   function = LLVMAddFunction(gallivm->module, "cs_variant", func_type);
+   LLVMSetFunctionCallConv(function, LLVMCCallConv);
+
+   variant->function = function;
+
+   for (i = 0; i < ARRAY_SIZE(arg_types) - 1; ++i)
+      if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind)
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+
+   body = generate_compute_body(shader, variant, cs_type,
+                                arg_types, ARRAY_SIZE(arg_types), use_coro);
+
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   for (i = 0; i < ARRAY_SIZE(args) - 1; i++)
+      args[i] = LLVMGetParam(function, i);
+
+   total = LLVMBuildMul(builder, args[1], args[2], "");
+   total = LLVMBuildMul(builder, total, args[3], "");
+   num_vecs = LLVMBuildAdd(builder, total,
+                           lp_build_const_int32(gallivm, cs_type.length - 1), "");
+   num_vecs = LLVMBuildUDiv(builder, num_vecs,
+                            lp_build_const_int32(gallivm, cs_type.length),
+                            "num_vecs");
+
+   if (!use_coro) {
+      lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+      args[11] = loop.counter;
+      LLVMBuildCall(builder, body, args, ARRAY_SIZE(args), "");
+      lp_build_loop_end_cond(&loop, num_vecs, NULL, LLVMIntUGE);
+   }
+#if GALLIVM_HAVE_CORO
+   else {
+      LLVMTypeRef hdl_type =
+         LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+      LLVMBasicBlockRef resume_block, end_block, resume_all_block;
+      LLVMValueRef hdls, hdl_ptr, hdl, done;
+      struct lp_build_if_state ifthen;
+
+      /* Still in the entry block, so no need to go through
+       * lp_build_array_alloca, which can't take a non-constant count.
+       */
+      hdls = LLVMBuildArrayAlloca(builder, hdl_type, num_vecs, "coro_hdls");
+
+      /* run every vector up to its first barrier */
+      lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+      args[11] = loop.counter;
+      hdl = LLVMBuildCall(builder, body, args, ARRAY_SIZE(args), "");
+      hdl_ptr = LLVMBuildGEP(builder, hdls, &loop.counter, 1, "");
+      LLVMBuildStore(builder, hdl, hdl_ptr);
+      lp_build_loop_end_cond(&loop, num_vecs, NULL, LLVMIntUGE);
+
+      /*
+       * Then resume them in turn until they are finished.  Barriers are in
+       * uniform control flow, so all the vectors finish together.
+       */
+      resume_block = lp_build_insert_new_block(gallivm, "coro_resume");
+      resume_all_block = lp_build_insert_new_block(gallivm, "coro_resume_all");
+      end_block = lp_build_insert_new_block(gallivm, "coro_end");
+      LLVMBuildBr(builder, resume_block);
+
+      LLVMPositionBuilderAtEnd(builder, resume_block);
+      hdl = LLVMBuildLoad(builder, hdls, "");
+      done = lp_build_coro_done(gallivm, hdl);
+      LLVMBuildCondBr(builder, done, end_block, resume_all_block);
+
+      LLVMPositionBuilderAtEnd(builder, resume_all_block);
+      lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+      hdl_ptr = LLVMBuildGEP(builder, hdls, &loop.counter, 1, "");
+      hdl = LLVMBuildLoad(builder, hdl_ptr, "");
+      done = lp_build_coro_done(gallivm, hdl);
+      lp_build_if(&ifthen, gallivm, LLVMBuildNot(builder, done, ""));
+      lp_build_coro_resume(gallivm, hdl);
+      lp_build_endif(&ifthen);
+      lp_build_loop_end_cond(&loop, num_vecs, NULL, LLVMIntUGE);
+      LLVMBuildBr(builder, resume_block);
+
+      /* free the coroutine frames */
+      LLVMPositionBuilderAtEnd(builder, end_block);
+      lp_build_loop_begin(&loop, gallivm, lp_build_const_int32(gallivm, 0));
+      hdl_ptr = LLVMBuildGEP(builder, hdls, &loop.counter, 1, "");
+      hdl = LLVMBuildLoad(builder, hdl_ptr, "");
+      lp_build_coro_destroy(gallivm, hdl);
+      lp_build_loop_end_cond(&loop, num_vecs, NULL, LLVMIntUGE);
+   }
+#endif
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static struct lp_compute_shader_variant *
+generate_variant(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 const struct lp_compute_shader_variant_key *key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_compute_shader_variant *variant;
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
+   int64_t t0, t1;
+
+   variant = CALLOC_STRUCT(lp_compute_shader_variant);
+   if (!variant)
+      return NULL;
+
+   memcpy(&variant->key, key, shader->variant_key_size);
+
+   t0 = os_time_get();
+
+   util_snprintf(module_name, sizeof(module_name), "cs%u", shader->no);
+
+   if (screen->disk_shader_cache) {
+      struct mesa_sha1 ctx;
+
+      _mesa_sha1_init(&ctx);
+      _mesa_sha1_update(&ctx, shader->sha1, sizeof(shader->sha1));
+      _mesa_sha1_update(&ctx, &shader->base.req_local_mem,
+                        sizeof(shader->base.req_local_mem));
+      _mesa_sha1_update(&ctx, key, shader->variant_key_size);
+      _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+
+      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+      if (!cached.data_size)
+         needs_caching = TRUE;
+   }
+
+   variant->gallivm = gallivm_create(module_name, lp->context,
+                                     screen->disk_shader_cache ?
+                                     &cached : NULL);
+   if (!variant->gallivm) {
+      free(cached.data);
+      FREE(variant);
+      return NULL;
+   }
+
+   lp_jit_init_cs_types(variant);
+
+   generate_compute(shader, variant);
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   variant->jit_function = (lp_jit_cs_func)
+      gallivm_jit_function(variant->gallivm, variant->function);
+
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
+   gallivm_free_ir(variant->gallivm);
+
+   free(cached.data);
+
+   t1 = os_time_get();
+   LP_COUNT_ADD(llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(nr_llvm_compiles, 1);
+
+   return variant;
+}
+
+
+static void
+destroy_variant(struct lp_compute_shader_variant *variant)
+{
+   gallivm_destroy(variant->gallivm);
+   FREE(variant);
+}
+
+
+/**
+ * Build the part of the state the code of a compute shader depends on.
+ */
+static void
+make_variant_key(struct llvmpipe_context *lp,
+                 struct lp_compute_shader *shader,
+                 struct lp_compute_shader_variant_key *key)
+{
+   const struct tgsi_shader_info *info = &shader->info.base;
+   unsigned i;
+
+   memset(key, 0, shader->variant_key_size);
+
+   key->nr_samplers = info->file_max[TGSI_FILE_SAMPLER] + 1;
+
+   for (i = 0; i < key->nr_samplers; ++i) {
+      if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+         lp_sampler_static_sampler_state(&key->state[i].sampler_state,
+                                         lp->samplers[PIPE_SHADER_COMPUTE][i]);
+      }
+   }
+
+   /*
+    * GLSL translates to dx10-style opcodes, so there are sampler views
+    * whenever there are samplers, but don't rely on it.
+    */
+   if (info->file_max[TGSI_FILE_SAMPLER_VIEW] != -1) {
+      key->nr_sampler_views = info->file_max[TGSI_FILE_SAMPLER_VIEW] + 1;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+   else {
+      key->nr_sampler_views = key->nr_samplers;
+      for (i = 0; i < key->nr_sampler_views; ++i) {
+         if (info->file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
+            lp_sampler_static_texture_state(&key->state[i].texture_state,
+                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+         }
+      }
+   }
+
+   key->nr_images = info->file_max[TGSI_FILE_IMAGE] + 1;
+   for (i = 0; i < key->nr_images; ++i) {
+      if (info->file_mask[TGSI_FILE_IMAGE] & (1u << i)) {
+         lp_sampler_static_texture_state_image(&key->image_state[i],
+                                               &lp->images[PIPE_SHADER_COMPUTE][i]);
+      }
+   }
+}
+
+
+/**
+ * Find the variant of the bound compute shader matching the current
+ * state, compiling it if needed.
+ */
+static struct lp_compute_shader_variant *
+lookup_variant(struct llvmpipe_context *lp,
+               struct lp_compute_shader *shader)
+{
+   struct lp_compute_shader_variant_key key;
+   struct lp_compute_shader_variant *variant, **prev;
+
+   make_variant_key(lp, shader, &key);
+
+   for (prev = &shader->variants; (variant = *prev); prev = &variant->next) {
+      if (memcmp(&variant->key, &key, shader->variant_key_size) == 0) {
+         /* move it to the front, so that the least recently used go last */
+         *prev = variant->next;
+         variant->next = shader->variants;
+         shader->variants = variant;
+         return variant;
+      }
+   }
+
+   if (shader->nr_variants >= LP_MAX_CS_VARIANTS) {
+      /* drop the least recently used variant */
+      for (prev = &shader->variants; (*prev)->next; prev = &(*prev)->next)
+         ;
+      destroy_variant(*prev);
+      *prev = NULL;
+      shader->nr_variants--;
+   }
+
+   variant = generate_variant(lp, shader, &key);
+   if (!variant)
+      return NULL;
+
+   variant->next = shader->variants;
+   shader->variants = variant;
+   shader->nr_variants++;
+
+   return variant;
+}
+
+
+static void *
+llvmpipe_create_compute_state(struct pipe_context *pipe,
+                              const struct pipe_compute_state *templ)
+{
+   struct lp_compute_shader *shader;
+
+   /* Only TGSI is consumed for now */
+   if (templ->ir_type != PIPE_SHADER_IR_TGSI)
+      return NULL;
+
+   shader = CALLOC_STRUCT(lp_compute_shader);
+   if (!shader)
+      return NULL;
+
+   shader->base = *templ;
+   shader->no = cs_no++;
+
+   /* we need to keep a local copy of the tokens */
+   shader->tokens = tgsi_dup_tokens(templ->prog);
+   if (!shader->tokens) {
+      FREE(shader);
+      return NULL;
+   }
+   shader->base.prog = shader->tokens;
+
+   /* get/save the summary info for this shader */
+   lp_build_tgsi_info(shader->tokens, &shader->info);
+
+   shader->variant_key_size =
+      Offset(struct lp_compute_shader_variant_key,
+             state[MAX2(shader->info.base.file_max[TGSI_FILE_SAMPLER],
+                        shader->info.base.file_max[TGSI_FILE_SAMPLER_VIEW]) + 1]);
+
+   _mesa_sha1_compute(shader->tokens,
+                      tgsi_num_tokens(shader->tokens) *
+                      sizeof(struct tgsi_token),
+                      shader->sha1);
+
+   if (LP_DEBUG & DEBUG_TGSI) {
+      debug_printf("llvmpipe: Create compute shader #%u %p:\n",
+                   shader->no, (void *) shader);
+      tgsi_dump(shader->tokens, 0);
+   }
+
+   return shader;
+}
+
+
+static void
+llvmpipe_bind_compute_state(struct pipe_context *pipe,
+                            void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+
+   llvmpipe->cs = (struct lp_compute_shader *)cs;
+}
+
+
+static void
+llvmpipe_delete_compute_state(struct pipe_context *pipe,
+                              void *cs)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct lp_compute_shader *shader = cs;
+
+   if (llvmpipe->cs == shader)
+      llvmpipe->cs = NULL;
+
+   while (shader->variants) {
+      struct lp_compute_shader_variant *variant = shader->variants;
+
+      shader->variants = variant->next;
+      destroy_variant(variant);
+   }
+
+   FREE((void *) shader->tokens);
+   FREE(shader);
+}
+
+
+static void
+llvmpipe_set_shader_buffers(struct pipe_context *pipe,
+                            enum pipe_shader_type shader,
+                            unsigned start_slot, unsigned count,
+                            const struct pipe_shader_buffer *buffers)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(start_slot + count <= LP_MAX_TGSI_SHADER_BUFFERS);
+
+   for (i = 0; i < count; i++) {
+      struct pipe_shader_buffer *dst = &llvmpipe->ssbos[shader][start_slot + i];
+
+      if (buffers) {
+         pipe_resource_reference(&dst->buffer, buffers[i].buffer);
+         dst->buffer_offset = buffers[i].buffer_offset;
+         dst->buffer_size = buffers[i].buffer_size;
+      }
+      else {
+         pipe_resource_reference(&dst->buffer, NULL);
+         dst->buffer_offset = 0;
+         dst->buffer_size = 0;
+      }
+   }
+
+   if (shader == PIPE_SHADER_FRAGMENT)
+      llvmpipe->dirty |= LP_NEW_FS_SSBOS;
+}
+
+
+static void
+llvmpipe_set_shader_images(struct pipe_context *pipe,
+                           enum pipe_shader_type shader,
+                           unsigned start_slot, unsigned count,
+                           const struct pipe_image_view *images)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   unsigned i;
+
+   assert(shader < PIPE_SHADER_TYPES);
+   assert(start_slot + count <= PIPE_MAX_SHADER_IMAGES);
+
+   for (i = 0; i < count; i++) {
+      struct pipe_image_view *dst = &llvmpipe->images[shader][start_slot + i];
+
+      if (images) {
+         pipe_resource_reference(&dst->resource, images[i].resource);
+         dst->format = images[i].format;
+         dst->access = images[i].access;
+         dst->u = images[i].u;
+      }
+      else {
+         pipe_resource_reference(&dst->resource, NULL);
+         memset(dst, 0, sizeof *dst);
+      }
+   }
+}
+
+
+/**
+ * Everything the rasterizer threads need to run a grid.
+ */
+struct lp_cs_job
+{
+   const struct lp_compute_shader_variant *variant;
+   struct lp_jit_cs_context jit_context;
+
+   unsigned block[3];
+   unsigned grid[3];
+   unsigned shared_size;
+
+   /** Next work group to run, claimed atomically by the threads */
+   int64_t next_group;
+   int64_t num_groups;
+};
+
+
+static void
+cs_exec_job(void *data, unsigned thread_index)
+{
+   struct lp_cs_job *job = data;
+   struct lp_jit_cs_thread_data thread_data;
+   int64_t group;
+
+   /* Allocated by the thread itself, to be node local. */
+   thread_data.shared = NULL;
+   if (job->shared_size) {
+      thread_data.shared = align_malloc(job->shared_size, 16);
+      if (!thread_data.shared)
+         return; /* leave the groups to the other threads, or the caller */
+   }
+
+   while ((group = p_atomic_inc_return(&job->next_group) - 1) <
+          job->num_groups) {
+      unsigned x = group % job->grid[0];
+      unsigned y = (group / job->grid[0]) % job->grid[1];
+      unsigned z = group / ((int64_t)job->grid[0] * job->grid[1]);
+
+      job->variant->jit_function(&job->jit_context,
+                                 job->block[0], job->block[1], job->block[2],
+                                 x, y, z,
+                                 job->grid[0], job->grid[1], job->grid[2],
+                                 &thread_data);
+   }
+
+   align_free(thread_data.shared);
+}
+
+
+static void
+update_cs_jit_context(struct llvmpipe_context *llvmpipe,
+                      struct lp_jit_cs_context *jit_context)
+{
+   static const float fake_const_buf[4];
+   unsigned i;
+
+   for (i = 0; i < LP_MAX_TGSI_CONST_BUFFERS; ++i) {
+      const struct pipe_constant_buffer *cb =
+         &llvmpipe->constants[PIPE_SHADER_COMPUTE][i];
+      const ubyte *data = NULL;
+
+      if (cb->buffer)
+         data = (const ubyte *) llvmpipe_resource_data(cb->buffer);
+      else if (cb->user_buffer)
+         data = (const ubyte *) cb->user_buffer;
+
+      if (data) {
+         jit_context->constants[i] =
+            (const float *) (data + cb->buffer_offset);
+         jit_context->num_constants[i] =
+            MIN2(cb->buffer_size, LP_MAX_TGSI_CONST_BUFFER_SIZE) /
+            (sizeof(float) * 4);
+      }
+      else {
+         jit_context->constants[i] = fake_const_buf;
+         jit_context->num_constants[i] = 0;
+      }
+   }
+
+   for (i = 0; i < LP_MAX_TGSI_SHADER_BUFFERS; ++i) {
+      const struct pipe_shader_buffer *sb =
+         &llvmpipe->ssbos[PIPE_SHADER_COMPUTE][i];
+
+      if (sb->buffer) {
+         ubyte *data = (ubyte *) llvmpipe_resource_data(sb->buffer);
+
+         jit_context->ssbos[i] = (uint32_t *) (data + sb->buffer_offset);
+         jit_context->ssbo_sizes[i] = sb->buffer_size;
+      }
+      else {
+         jit_context->ssbos[i] = NULL;
+         jit_context->ssbo_sizes[i] = 0;
+      }
+   }
+
+   for (i = 0; i < PIPE_MAX_SHADER_SAMPLER_VIEWS; ++i) {
+      const struct pipe_sampler_view *view =
+         llvmpipe->sampler_views[PIPE_SHADER_COMPUTE][i];
+
+      if (view)
+         lp_jit_texture_from_pipe(&jit_context->textures[i], view);
+   }
+
+   for (i = 0; i < PIPE_MAX_SAMPLERS; ++i) {
+      const struct pipe_sampler_state *sampler =
+         llvmpipe->samplers[PIPE_SHADER_COMPUTE][i];
+
+      if (sampler)
+         lp_jit_sampler_from_pipe(&jit_context->samplers[i], sampler);
+   }
+
+   for (i = 0; i < PIPE_MAX_SHADER_IMAGES; ++i) {
+      const struct pipe_image_view *image =
+         &llvmpipe->images[PIPE_SHADER_COMPUTE][i];
+
+      if (image->resource)
+         lp_jit_image_from_pipe(&jit_context->images[i], image);
+   }
+}
+
+
+static void
+llvmpipe_launch_grid(struct pipe_context *pipe,
+                     const struct pipe_grid_info *info)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_compute_shader *shader = llvmpipe->cs;
+   struct lp_compute_shader_variant *variant;
+   struct lp_cs_job job;
+   unsigned i;
+
+   if (!shader)
+      return;
+
+   variant = lookup_variant(llvmpipe, shader);
+   if (!variant)
+      return;
+
+   /* Compute shaders may read what was rendered, and write resources
+    * which are then rendered from.
+    */
+   llvmpipe_flush(pipe, NULL, __FUNCTION__);
+
+   memset(&job, 0, sizeof job);
+   job.variant = variant;
+   job.shared_size = shader->base.req_local_mem;
+
+   for (i = 0; i < 3; i++) {
+      job.block[i] = info->block[i];
+      job.grid[i] = info->grid[i];
+   }
+
+   if (info->indirect) {
+      const uint32_t *grid;
+      struct pipe_transfer *transfer;
+
+      grid = pipe_buffer_map_range(pipe, info->indirect,
+                                   info->indirect_offset,
+                                   3 * sizeof(uint32_t),
+                                   PIPE_TRANSFER_READ, &transfer);
+      if (!grid)
+         return;
+
+      for (i = 0; i < 3; i++)
+         job.grid[i] = grid[i];
+
+      pipe_buffer_unmap(pipe, transfer);
+   }
+
+   job.num_groups = (int64_t)job.grid[0] * job.grid[1] * job.grid[2];
+   if (!job.num_groups)
+      return;
+
+   update_cs_jit_context(llvmpipe, &job.jit_context);
+
+   mtx_lock(&screen->rast_mutex);
+   lp_rast_run_job(screen->rast, cs_exec_job, &job);
+   mtx_unlock(&screen->rast_mutex);
+
+   /* If no thread could allocate its shared memory, not a single group
+    * was claimed: try once more from here before giving up.
+    */
+   if (job.next_group < job.num_groups) {
+      unsigned fpstate = util_fpstate_get();
+
+      util_fpstate_set_denorms_to_zero(fpstate);
+      cs_exec_job(&job, 0);
+      util_fpstate_set(fpstate);
+
+      if (job.next_group < job.num_groups) {
+         debug_printf("llvmpipe: out of memory for %u bytes of compute "
+                      "shared memory, grid not run\n", job.shared_size);
+         return;
+      }
+   }
+
+   llvmpipe->pipeline_statistics.cs_invocations +=
+      job.num_groups * job.block[0] * job.block[1] * job.block[2];
+}
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.create_compute_state = llvmpipe_create_compute_state;
+   llvmpipe->pipe.bind_compute_state = llvmpipe_bind_compute_state;
+   llvmpipe->pipe.delete_compute_state = llvmpipe_delete_compute_state;
+   llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
+   llvmpipe->pipe.set_shader_images = llvmpipe_set_shader_images;
+   llvmpipe->pipe.launch_grid = llvmpipe_launch_grid;
+}
+
+
+void
+llvmpipe_cleanup_compute(struct llvmpipe_context *llvmpipe)
+{
+   unsigned i, j;
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->ssbos); i++) {
+      for (j = 0; j < ARRAY_SIZE(llvmpipe->ssbos[i]); j++) {
+         pipe_resource_reference(&llvmpipe->ssbos[i][j].buffer, NULL);
+      }
+   }
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->images); i++) {
+      for (j = 0; j < ARRAY_SIZE(llvmpipe->images[i]); j++) {
+         pipe_resource_reference(&llvmpipe->images[i][j].resource, NULL);
+      }
+   }
+}
@@ -0,0 +1,102 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT. IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDERS, AUTHORS AND/OR ITS SUPPLIERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+ * USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ **************************************************************************/
+
+
+#ifndef LP_STATE_CS_H_
+#define LP_STATE_CS_H_
+
+
+#include "pipe/p_compiler.h"
+#include "pipe/p_state.h"
+#include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
+#include "lp_jit.h"
+#include "lp_state_fs.h" /* for struct lp_sampler_static_state */
+
+
+struct llvmpipe_context;
+
+
+struct lp_compute_shader_variant_key
+{
+   unsigned nr_samplers:8;      /* actually derivable from just the shader */
+   unsigned nr_sampler_views:8; /* actually derivable from just the shader */
+   unsigned nr_images:8;        /* actually derivable from just the shader */
+
+   struct lp_static_texture_state image_state[PIPE_MAX_SHADER_IMAGES];
+
+   /* must be last, only the used entries are part of the key */
+   struct lp_sampler_static_state state[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+};
+
+
+struct lp_compute_shader_variant
+{
+   struct lp_compute_shader_variant_key key;
+
+   struct gallivm_state *gallivm;
+
+   LLVMTypeRef jit_cs_context_ptr_type;
+   LLVMTypeRef jit_cs_thread_data_ptr_type;
+
+   LLVMValueRef function;
+   lp_jit_cs_func jit_function;
+
+   /* Total number of LLVM instructions generated */
+   unsigned nr_instrs;
+
+   /** Next variant of the same shader */
+   struct lp_compute_shader_variant *next;
+};
+
+
+/** Subclass of pipe_compute_state */
+struct lp_compute_shader
+{
+   struct pipe_compute_state base;
+
+   const struct tgsi_token *tokens;
+   struct lp_tgsi_info info;
+   unsigned char sha1[20];
+
+   unsigned no;
+
+   /** Size of the used part of the variant keys */
+   unsigned variant_key_size;
+
+   /** Variants, most recently used first */
+   struct lp_compute_shader_variant *variants;
+   unsigned nr_variants;
+};
+
+
+void
+llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe);
+
+void
+llvmpipe_cleanup_compute(struct llvmpipe_context *llvmpipe);
+
+
+#endif /* LP_STATE_CS_H_ */
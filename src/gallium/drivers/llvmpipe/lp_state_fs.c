@@ -68,6 +68,7 @@
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "tgsi/tgsi_dump.h"
@@ -100,6 +101,7 @@
 #include "lp_state.h"
 #include "lp_tex_sample.h"
 #include "lp_flush.h"
+#include "lp_screen.h"
 #include "lp_state_fs.h"
 #include "lp_rast.h"
 
@@ -320,6 +322,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
    LLVMValueRef outputs[PIPE_MAX_SHADER_OUTPUTS][TGSI_NUM_CHANNELS];
    struct lp_build_for_loop_state loop_state;
    struct lp_build_mask_context mask;
+   struct lp_build_tgsi_cs_iface buffers;
    /*
     * TODO: figure out if simple_shader optimization is really worthwile to
     * keep. Disabled because it may hide some real bugs in the (depth/stencil)
@@ -370,6 +373,14 @@ generate_fs_loop(struct gallivm_state *gallivm,
          depth_mode = LATE_DEPTH_TEST | LATE_DEPTH_WRITE;
       }
 
+      /*
+       * Stores and atomics must happen for fragments failing the depth
+       * test too, unless the shader asks for early fragment tests.
+       */
+      if (shader->info.base.writes_memory &&
+          !shader->info.base.properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL])
+         depth_mode = LATE_DEPTH_TEST | LATE_DEPTH_WRITE;
+
       if (!(key->depth.enabled && key->depth.writemask) &&
           !(key->stencil[0].enabled && (key->stencil[0].writemask ||
                                         (key->stencil[1].enabled &&
@@ -392,6 +403,10 @@ generate_fs_loop(struct gallivm_state *gallivm,
    consts_ptr = lp_jit_context_constants(gallivm, context_ptr);
    num_consts_ptr = lp_jit_context_num_constants(gallivm, context_ptr);
 
+   memset(&buffers, 0, sizeof buffers);
+   buffers.ssbo_ptr = lp_jit_context_ssbos(gallivm, context_ptr);
+   buffers.ssbo_sizes_ptr = lp_jit_context_ssbo_sizes(gallivm, context_ptr);
+
    lp_build_for_loop_begin(&loop_state, gallivm,
                            lp_build_const_int32(gallivm, 0),
                            LLVMIntULT,
@@ -479,7 +494,7 @@ generate_fs_loop(struct gallivm_state *gallivm,
                      consts_ptr, num_consts_ptr, &system_values,
                      interp->inputs,
                      outputs, context_ptr, thread_data_ptr,
-                     sampler, &shader->info.base, NULL);
+                     sampler, &shader->info.base, NULL, &buffers);
 
    /* Alpha test */
    if (key->alpha.enabled) {
@@ -2397,8 +2412,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2486,8 +2500,11 @@ generate_fragment(struct llvmpipe_context *lp,
 
    blend_vec_type = lp_build_vec_type(gallivm, blend_type);
 
-   util_snprintf(func_name, sizeof(func_name), "fs%u_variant%u_%s",
-                 shader->no, variant->no, partial_mask ? "partial" : "whole");
+   /* The name must not depend on the shader/variant numbers, as it's
+    * looked up again in code loaded from the disk cache.
+    */
+   util_snprintf(func_name, sizeof(func_name), "fs_variant_%s",
+                 partial_mask ? "partial" : "whole");
 
    arg_types[0] = variant->jit_context_ptr_type;       /* context */
    arg_types[1] = int32_type;                          /* x */
@@ -2807,33 +2824,205 @@ lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/**
+ * Build and JIT-compile the code of a fragment shader variant, in the given
+ * LLVM context.  This may run on a compile queue thread, so it must only
+ * touch the variant and immutable shader/screen state.
+ */
+static void
+compile_variant(struct llvmpipe_screen *screen,
+                struct lp_fragment_shader_variant *variant,
+                LLVMContextRef context)
+{
+   struct lp_fragment_shader *shader = variant->shader;
+   char module_name[64];
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
+   int64_t t0, t1;
+
+   t0 = os_time_get();
+
+   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+                 shader->no, variant->no);
+
+   if (screen->disk_shader_cache) {
+      struct mesa_sha1 ctx;
+
+      _mesa_sha1_init(&ctx);
+      _mesa_sha1_update(&ctx, shader->sha1, sizeof(shader->sha1));
+      _mesa_sha1_update(&ctx, &variant->key, shader->variant_key_size);
+      _mesa_sha1_final(&ctx, ir_sha1_cache_key);
+
+      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+      if (!cached.data_size)
+         needs_caching = TRUE;
+   }
+
+   variant->gallivm = gallivm_create(module_name, context,
+                                     screen->disk_shader_cache ?
+                                     &cached : NULL);
+   if (!variant->gallivm) {
+      free(cached.data);
+      return;
+   }
+
+   lp_jit_init_types(variant);
+
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(shader, variant, RAST_WHOLE);
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+               gallivm_jit_function(variant->gallivm,
+                                    variant->function[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   }
+
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
+   gallivm_free_ir(variant->gallivm);
+
+   free(cached.data);
+
+   t1 = os_time_get();
+   LP_COUNT_ADD(llvm_compile_time, t1 - t0);
+   LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+}
+
+
+/**
+ * Compile queue job.  Each queue thread has its own LLVM context, as
+ * contexts can't be used from several threads at once.
+ */
+static void
+compile_variant_job(void *data, int thread_index)
+{
+   struct lp_fragment_shader_variant *variant = data;
+   struct llvmpipe_screen *screen = variant->screen;
+
+   assert(thread_index < LP_MAX_COMPILE_THREADS);
+
+   if (!screen->compile_contexts[thread_index])
+      screen->compile_contexts[thread_index] = LLVMContextCreate();
+
+   if (screen->compile_contexts[thread_index])
+      compile_variant(screen, variant, screen->compile_contexts[thread_index]);
+}
+
+
+/**
+ * Stand-in for the code of a variant which failed to compile: the draws
+ * which were already binned with it don't write any fragments.
+ */
+static void
+null_fragment_shader(const struct lp_jit_context *context,
+                     uint32_t x,
+                     uint32_t y,
+                     uint32_t facing,
+                     const void *a0,
+                     const void *dadx,
+                     const void *dady,
+                     uint8_t **color,
+                     uint8_t *depth,
+                     uint32_t mask,
+                     struct lp_jit_thread_data *thread_data,
+                     unsigned *stride,
+                     unsigned depth_stride)
+{
+}
+
+
+/**
+ * Wait for all the fragment shader variants still being compiled in the
+ * background.  This must be done before the rasterizer may run them, and
+ * before any variant is destroyed.
+ */
+void
+llvmpipe_finish_fs_compiles(struct llvmpipe_context *lp)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   unsigned i;
+
+   for (i = 0; i < lp->num_pending_fs_variants; i++) {
+      struct lp_fragment_shader_variant *variant = lp->pending_fs_variants[i];
+
+      util_queue_fence_wait(&variant->ready);
+
+      /* Couldn't create the compile thread's LLVM context or module, so try
+       * again with our own.
+       */
+      if (!variant->gallivm)
+         compile_variant(screen, variant, lp->context);
+
+      /* The variant is already bound and may have been binned, so if it
+       * still has no code, skip the draws using it rather than calling
+       * through a NULL pointer.
+       */
+      if (!variant->jit_function[RAST_WHOLE] ||
+          !variant->jit_function[RAST_EDGE_TEST]) {
+         debug_printf("llvmpipe: failed to compile fs variant %u, "
+                      "skipping its draws\n", variant->no);
+         variant->jit_function[RAST_WHOLE] = null_fragment_shader;
+         variant->jit_function[RAST_EDGE_TEST] = null_fragment_shader;
+      }
+
+      lp->nr_fs_instrs += variant->nr_instrs;
+   }
+
+   lp->num_pending_fs_variants = 0;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * If the screen has a compile queue, the code is generated in the
+ * background and the variant can be bound right away: only the rasterizer
+ * needs the JIT code, so llvmpipe_finish_fs_compiles() is called before a
+ * scene is handed to it.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct lp_fragment_shader_variant *variant;
    const struct util_format_description *cbuf0_format_desc = NULL;
    boolean fullcolormask;
-   char module_name[64];
 
    variant = CALLOC_STRUCT(lp_fragment_shader_variant);
    if (!variant)
       return NULL;
 
-   util_snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-                 shader->no, shader->variants_created);
-
-   variant->gallivm = gallivm_create(module_name, lp->context);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
+   util_queue_fence_init(&variant->ready);
 
+   variant->screen = screen;
    variant->shader = shader;
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -2859,48 +3048,32 @@ generate_variant(struct llvmpipe_context *lp,
          !key->blend.alpha_to_coverage &&
          !key->depth.enabled &&
          !shader->info.base.uses_kill &&
-         !shader->info.base.writes_samplemask
+         !shader->info.base.writes_samplemask &&
+         !shader->info.base.writes_memory
       ? TRUE : FALSE;
 
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
-
-   /*
-    * Compile everything
-    */
-
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+   if (screen->num_compile_threads) {
+      if (lp->num_pending_fs_variants == ARRAY_SIZE(lp->pending_fs_variants))
+         llvmpipe_finish_fs_compiles(lp);
 
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
+      lp->pending_fs_variants[lp->num_pending_fs_variants++] = variant;
+      util_queue_add_job(&screen->compile_queue, variant, &variant->ready,
+                         compile_variant_job, NULL);
+      return variant;
    }
 
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   compile_variant(screen, variant, lp->context);
+   if (!variant->gallivm) {
+      util_queue_fence_destroy(&variant->ready);
+      FREE(variant);
+      return NULL;
    }
 
-   gallivm_free_ir(variant->gallivm);
+   lp->nr_fs_instrs += variant->nr_instrs;
 
    return variant;
 }
@@ -2929,6 +3102,11 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    /* we need to keep a local copy of the tokens */
    shader->base.tokens = tgsi_dup_tokens(templ->tokens);
 
+   _mesa_sha1_compute(shader->base.tokens,
+                      tgsi_num_tokens(shader->base.tokens) *
+                      sizeof(struct tgsi_token),
+                      shader->sha1);
+
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
       FREE((void *) shader->base.tokens);
@@ -3027,6 +3205,9 @@ void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
+   /* make sure nobody is still compiling it */
+   llvmpipe_finish_fs_compiles(lp);
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del fs #%u var %u v created %u v cached %u "
                    "v total cached %u inst %u total inst %u\n",
@@ -3037,6 +3218,7 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
    }
 
    gallivm_destroy(variant->gallivm);
+   util_queue_fence_destroy(&variant->ready);
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3128,7 +3310,7 @@ llvmpipe_set_constant_buffer(struct pipe_context *pipe,
       draw_set_mapped_constant_buffer(llvmpipe->draw, shader,
                                       index, data, size);
    }
-   else {
+   else if (shader == PIPE_SHADER_FRAGMENT) {
       llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
    }
 
@@ -3391,7 +3573,6 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    }
    else {
       /* variant not found, create it now */
-      int64_t t0, t1, dt;
       unsigned i;
       unsigned variants_to_cull;
 
@@ -3447,19 +3628,13 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       /*
        * Generate the new variant.
        */
-      t0 = os_time_get();
       variant = generate_variant(lp, shader, &key);
-      t1 = os_time_get();
-      dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
-      LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
       /* Put the new variant into the list */
       if (variant) {
          insert_at_head(&shader->variants, &variant->list_item_local);
          insert_at_head(&lp->fs_variants_list, &variant->list_item_global);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
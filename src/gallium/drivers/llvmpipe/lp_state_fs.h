@@ -32,6 +32,7 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_state.h"
+#include "util/u_queue.h"
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
@@ -40,6 +41,7 @@
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct llvmpipe_screen;
 
 
 /** Indexes into jit_function[] array */
@@ -114,6 +116,10 @@ struct lp_fragment_shader_variant
 
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
+   struct llvmpipe_screen *screen;
+
+   /** Signalled once the code has been compiled on the compile queue */
+   struct util_queue_fence ready;
 
    /* For debugging/profiling purposes */
    unsigned no;
@@ -131,6 +137,9 @@ struct lp_fragment_shader
 
    struct draw_fragment_shader *draw_data;
 
+   /** SHA1 of the tokens, for the disk cache */
+   unsigned char sha1[20];
+
    /* For debugging/profiling purposes */
    unsigned variant_key_size;
    unsigned no;
@@ -145,6 +154,9 @@ struct lp_fragment_shader
 void
 lp_debug_fs_variant(const struct lp_fragment_shader_variant *variant);
 
+void
+llvmpipe_finish_fs_compiles(struct llvmpipe_context *lp);
+
 void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant);
@@ -30,6 +30,7 @@
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/os_time.h"
+#include "util/mesa-sha1.h"
 #include "gallivm/lp_bld_arit.h"
 #include "gallivm/lp_bld_bitarit.h"
 #include "gallivm/lp_bld_const.h"
@@ -717,6 +718,10 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    LLVMBasicBlockRef block;
    LLVMBuilderRef builder;
    int64_t t0 = 0, t1;
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   unsigned char ir_sha1_cache_key[20];
+   struct lp_cached_code cached = { 0 };
+   boolean needs_caching = FALSE;
 
    if (0)
       goto fail;
@@ -727,10 +732,22 @@ generate_setup_variant(struct lp_setup_variant_key *key,
 
    variant->no = setup_no++;
 
-   util_snprintf(func_name, sizeof(func_name), "setup_variant_%u",
-                 variant->no);
+   /* The name must not depend on the variant number, as it's looked up
+    * again in code loaded from the disk cache.
+    */
+   util_snprintf(func_name, sizeof(func_name), "setup_variant");
+
+   if (screen->disk_shader_cache) {
+      _mesa_sha1_compute(key, key->size, ir_sha1_cache_key);
+
+      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
+      if (!cached.data_size)
+         needs_caching = TRUE;
+   }
 
-   variant->gallivm = gallivm = gallivm_create(func_name, lp->context);
+   variant->gallivm = gallivm = gallivm_create(func_name, lp->context,
+                                               screen->disk_shader_cache ?
+                                               &cached : NULL);
    if (!variant->gallivm) {
       goto fail;
    }
@@ -805,8 +822,13 @@ generate_setup_variant(struct lp_setup_variant_key *key,
    if (!variant->jit_function)
       goto fail;
 
+   if (needs_caching)
+      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+
    gallivm_free_ir(variant->gallivm);
 
+   free(cached.data);
+
    /*
     * Update timing information:
     */
@@ -826,6 +848,8 @@ fail:
       FREE(variant);
    }
 
+   free(cached.data);
+
    return NULL;
 }
 
@@ -0,0 +1,1166 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER(S) AND/OR ITS SUPPLIERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/**
+ * @file
+ * Unit tests for compute shaders, and for the shader buffers and images
+ * they share with fragment shaders.
+ *
+ * Unlike the other tests, these run whole shaders through a llvmpipe
+ * context, on top of the null winsys.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "util/u_box.h"
+#include "util/u_format.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_sampler.h"
+#include "util/u_string.h"
+#include "tgsi/tgsi_text.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+#define MAX_TOKENS 1024
+
+
+struct cs_test_context
+{
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   unsigned verbose;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *name, boolean success)
+{
+   fprintf(fp, "%s\t%s\n", success ? "pass" : "fail", name);
+
+   fflush(fp);
+}
+
+
+static void *
+create_shader(struct cs_test_context *ctx, const char *text,
+              unsigned req_local_mem)
+{
+   struct tgsi_token tokens[MAX_TOKENS];
+   struct pipe_compute_state cs;
+
+   if (!tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens))) {
+      fprintf(stderr, "failed to parse:\n%s", text);
+      return NULL;
+   }
+
+   memset(&cs, 0, sizeof cs);
+   cs.ir_type = PIPE_SHADER_IR_TGSI;
+   cs.prog = tokens;
+   cs.req_local_mem = req_local_mem;
+
+   return ctx->pipe->create_compute_state(ctx->pipe, &cs);
+}
+
+
+static struct pipe_resource *
+create_buffer(struct cs_test_context *ctx, unsigned size, const void *data)
+{
+   struct pipe_resource *buf;
+
+   buf = pipe_buffer_create(ctx->screen,
+                            PIPE_BIND_SHADER_BUFFER | PIPE_BIND_SHADER_IMAGE,
+                            PIPE_USAGE_DEFAULT, size);
+   if (buf && data)
+      pipe_buffer_write(ctx->pipe, buf, 0, size, data);
+
+   return buf;
+}
+
+
+static void
+set_buffers(struct cs_test_context *ctx, enum pipe_shader_type shader,
+            unsigned count, struct pipe_resource **bufs)
+{
+   struct pipe_shader_buffer sb[4];
+   unsigned i;
+
+   assert(count <= ARRAY_SIZE(sb));
+
+   memset(sb, 0, sizeof sb);
+   for (i = 0; i < count; i++) {
+      sb[i].buffer = bufs[i];
+      sb[i].buffer_size = bufs[i]->width0;
+   }
+
+   ctx->pipe->set_shader_buffers(ctx->pipe, shader, 0, count, sb);
+}
+
+
+static void
+launch(struct cs_test_context *ctx, void *cs,
+       unsigned bx, unsigned by, unsigned bz,
+       unsigned gx, unsigned gy, unsigned gz)
+{
+   struct pipe_grid_info info;
+
+   memset(&info, 0, sizeof info);
+   info.block[0] = bx;
+   info.block[1] = by;
+   info.block[2] = bz;
+   info.grid[0] = gx;
+   info.grid[1] = gy;
+   info.grid[2] = gz;
+
+   ctx->pipe->bind_compute_state(ctx->pipe, cs);
+   ctx->pipe->launch_grid(ctx->pipe, &info);
+}
+
+
+static struct pipe_resource *
+create_texture(struct cs_test_context *ctx,
+               enum pipe_texture_target target,
+               enum pipe_format format,
+               unsigned width, unsigned height, unsigned layers,
+               const void *data)
+{
+   struct pipe_resource templ, *tex;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = target;
+   templ.format = format;
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = layers;
+   templ.bind = PIPE_BIND_SAMPLER_VIEW | PIPE_BIND_SHADER_IMAGE;
+
+   tex = ctx->screen->resource_create(ctx->screen, &templ);
+   if (tex && data) {
+      unsigned stride = util_format_get_stride(format, width);
+      struct pipe_box box;
+
+      u_box_3d(0, 0, 0, width, height, layers, &box);
+      ctx->pipe->texture_subdata(ctx->pipe, tex, 0, 0, &box, data,
+                                 stride, stride * height);
+   }
+
+   return tex;
+}
+
+
+/**
+ * Read back a whole texture, tightly packed.
+ */
+static void
+read_texture(struct cs_test_context *ctx, struct pipe_resource *tex,
+             void *data)
+{
+   unsigned stride = util_format_get_stride(tex->format, tex->width0);
+   unsigned layers = tex->array_size;
+   struct pipe_transfer *transfer;
+   struct pipe_box box;
+   const uint8_t *map;
+   unsigned y, z;
+
+   u_box_3d(0, 0, 0, tex->width0, tex->height0, layers, &box);
+   map = ctx->pipe->transfer_map(ctx->pipe, tex, 0, PIPE_TRANSFER_READ,
+                                 &box, &transfer);
+   for (z = 0; z < layers; z++) {
+      for (y = 0; y < tex->height0; y++) {
+         memcpy((uint8_t *)data + (z * tex->height0 + y) * stride,
+                map + z * transfer->layer_stride + y * transfer->stride,
+                stride);
+      }
+   }
+   ctx->pipe->transfer_unmap(ctx->pipe, transfer);
+}
+
+
+static void
+set_image(struct cs_test_context *ctx, unsigned index,
+          struct pipe_resource *res, enum pipe_format format,
+          unsigned first_layer, unsigned last_layer)
+{
+   struct pipe_image_view view;
+
+   memset(&view, 0, sizeof view);
+   view.resource = res;
+   view.format = format;
+   view.access = PIPE_IMAGE_ACCESS_READ_WRITE;
+   if (res->target == PIPE_BUFFER) {
+      view.u.buf.offset = 0;
+      view.u.buf.size = res->width0;
+   }
+   else {
+      view.u.tex.first_layer = first_layer;
+      view.u.tex.last_layer = last_layer;
+   }
+
+   ctx->pipe->set_shader_images(ctx->pipe, PIPE_SHADER_COMPUTE, index, 1,
+                                &view);
+}
+
+
+/**
+ * Store the thread and block ids of every invocation, indexed by its
+ * flattened global id.
+ */
+static const char system_values_text[] =
+   "COMP\n"
+   "DCL SV[0], THREAD_ID\n"
+   "DCL SV[1], BLOCK_ID\n"
+   "DCL SV[2], BLOCK_SIZE\n"
+   "DCL SV[3], GRID_SIZE\n"
+   "DCL BUFFER[0]\n"
+   "DCL TEMP[0..2]\n"
+   "IMM[0] UINT32 {16, 0, 0, 0}\n"
+   /* flat block index, and number of invocations per block */
+   "UMAD TEMP[0].x, SV[1].yyyy, SV[3].xxxx, SV[1].xxxx\n"
+   "UMUL TEMP[0].y, SV[2].xxxx, SV[2].yyyy\n"
+   /* flat invocation index within the block */
+   "UMAD TEMP[0].z, SV[0].yyyy, SV[2].xxxx, SV[0].xxxx\n"
+   "UMAD TEMP[1].x, TEMP[0].xxxx, TEMP[0].yyyy, TEMP[0].zzzz\n"
+   "UMUL TEMP[1].x, TEMP[1].xxxx, IMM[0].xxxx\n"
+   "MOV TEMP[2].xy, SV[0].xyxx\n"
+   "MOV TEMP[2].zw, SV[1].xxxy\n"
+   "STORE BUFFER[0].xyzw, TEMP[1].xxxx, TEMP[2]\n"
+   "END\n";
+
+
+static boolean
+check_system_values(struct cs_test_context *ctx, struct pipe_resource *buf,
+                    const unsigned block[2], const unsigned grid[2])
+{
+   unsigned n = block[0] * block[1] * grid[0] * grid[1];
+   uint32_t *data = MALLOC(n * 16);
+   boolean success = TRUE;
+   unsigned i;
+
+   pipe_buffer_read(ctx->pipe, buf, 0, n * 16, data);
+
+   for (i = 0; i < n; i++) {
+      unsigned group = i / (block[0] * block[1]);
+      unsigned local = i % (block[0] * block[1]);
+      const uint32_t expected[4] = {
+         local % block[0], local / block[0],
+         group % grid[0], group / grid[0]
+      };
+
+      if (memcmp(&data[i * 4], expected, sizeof expected) != 0) {
+         if (ctx->verbose || success)
+            fprintf(stderr, "invocation %u: got %u %u %u %u, expected "
+                    "%u %u %u %u\n", i,
+                    data[i * 4 + 0], data[i * 4 + 1],
+                    data[i * 4 + 2], data[i * 4 + 3],
+                    expected[0], expected[1], expected[2], expected[3]);
+         success = FALSE;
+      }
+   }
+
+   FREE(data);
+   return success;
+}
+
+
+static boolean
+test_system_values(struct cs_test_context *ctx)
+{
+   static const unsigned block[2] = { 5, 3 };
+   static const unsigned grid[2] = { 3, 2 };
+   struct pipe_resource *buf;
+   boolean success;
+   void *cs;
+
+   cs = create_shader(ctx, system_values_text, 0);
+   buf = create_buffer(ctx, block[0] * block[1] * grid[0] * grid[1] * 16,
+                       NULL);
+   set_buffers(ctx, PIPE_SHADER_COMPUTE, 1, &buf);
+
+   launch(ctx, cs, block[0], block[1], 1, grid[0], grid[1], 1);
+
+   success = check_system_values(ctx, buf, block, grid);
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   pipe_resource_reference(&buf, NULL);
+   return success;
+}
+
+
+static boolean
+test_indirect_launch(struct cs_test_context *ctx)
+{
+   static const unsigned block[2] = { 4, 4 };
+   static const unsigned grid[2] = { 3, 5 };
+   const uint32_t indirect_data[4] = { 0xdead, grid[0], grid[1], 1 };
+   struct pipe_resource *buf, *indirect;
+   struct pipe_grid_info info;
+   boolean success;
+   void *cs;
+
+   cs = create_shader(ctx, system_values_text, 0);
+   buf = create_buffer(ctx, block[0] * block[1] * grid[0] * grid[1] * 16,
+                       NULL);
+   indirect = create_buffer(ctx, sizeof indirect_data, indirect_data);
+   set_buffers(ctx, PIPE_SHADER_COMPUTE, 1, &buf);
+
+   memset(&info, 0, sizeof info);
+   info.block[0] = block[0];
+   info.block[1] = block[1];
+   info.block[2] = 1;
+   info.indirect = indirect;
+   info.indirect_offset = 4;
+
+   ctx->pipe->bind_compute_state(ctx->pipe, cs);
+   ctx->pipe->launch_grid(ctx->pipe, &info);
+
+   success = check_system_values(ctx, buf, block, grid);
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   pipe_resource_reference(&buf, NULL);
+   pipe_resource_reference(&indirect, NULL);
+   return success;
+}
+
+
+static boolean
+test_buffer_atomics(struct cs_test_context *ctx)
+{
+   static const char text[] =
+      "COMP\n"
+      "DCL SV[0], THREAD_ID\n"
+      "DCL SV[1], BLOCK_ID\n"
+      "DCL BUFFER[0]\n"
+      "DCL BUFFER[1]\n"
+      "DCL TEMP[0..2]\n"
+      "IMM[0] UINT32 {4, 64, 0, 1}\n"
+      "UMAD TEMP[0].x, SV[1].xxxx, IMM[0].yyyy, SV[0].xxxx\n"
+      "ATOMUADD TEMP[1].x, BUFFER[0].xxxx, IMM[0].zzzz, IMM[0].wwww\n"
+      "ATOMUMAX TEMP[2].x, BUFFER[0].xxxx, IMM[0].xxxx, TEMP[0].xxxx\n"
+      "UMUL TEMP[0].x, TEMP[0].xxxx, IMM[0].xxxx\n"
+      "STORE BUFFER[1].x, TEMP[0].xxxx, TEMP[1].xxxx\n"
+      "END\n";
+   const unsigned n = 64 * 5;
+   struct pipe_resource *bufs[2];
+   uint32_t counters[2], *results;
+   unsigned char *seen;
+   boolean success = TRUE;
+   unsigned i;
+   void *cs;
+
+   cs = create_shader(ctx, text, 0);
+   bufs[0] = create_buffer(ctx, sizeof counters, NULL);
+   bufs[1] = create_buffer(ctx, n * 4, NULL);
+   set_buffers(ctx, PIPE_SHADER_COMPUTE, 2, bufs);
+
+   launch(ctx, cs, 64, 1, 1, 5, 1, 1);
+
+   pipe_buffer_read(ctx->pipe, bufs[0], 0, sizeof counters, counters);
+   if (counters[0] != n || counters[1] != n - 1) {
+      fprintf(stderr, "counters %u %u, expected %u %u\n",
+              counters[0], counters[1], n, n - 1);
+      success = FALSE;
+   }
+
+   /* every invocation must have got a different value */
+   results = MALLOC(n * 4);
+   seen = CALLOC(n, 1);
+   pipe_buffer_read(ctx->pipe, bufs[1], 0, n * 4, results);
+   for (i = 0; i < n; i++) {
+      if (results[i] >= n || seen[results[i]]++) {
+         fprintf(stderr, "invocation %u: unexpected value %u\n",
+                 i, results[i]);
+         success = FALSE;
+         break;
+      }
+   }
+   FREE(results);
+   FREE(seen);
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   pipe_resource_reference(&bufs[0], NULL);
+   pipe_resource_reference(&bufs[1], NULL);
+   return success;
+}
+
+
+/**
+ * Reverse the invocations of each work group through shared memory.  The
+ * groups are larger than a SIMD vector, so the barrier has to suspend the
+ * vectors which reach it first.
+ */
+static boolean
+test_shared_memory(struct cs_test_context *ctx)
+{
+   static const char text[] =
+      "COMP\n"
+      "PROPERTY CS_FIXED_BLOCK_WIDTH 64\n"
+      "PROPERTY CS_FIXED_BLOCK_HEIGHT 1\n"
+      "PROPERTY CS_FIXED_BLOCK_DEPTH 1\n"
+      "DCL SV[0], THREAD_ID\n"
+      "DCL SV[1], BLOCK_ID\n"
+      "DCL BUFFER[0]\n"
+      "DCL MEMORY[0], SHARED\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] UINT32 {4, 64, 63, 0}\n"
+      "UMUL TEMP[0].x, SV[0].xxxx, IMM[0].xxxx\n"
+      "UMAD TEMP[1].x, SV[1].xxxx, IMM[0].yyyy, SV[0].xxxx\n"
+      "STORE MEMORY[0].x, TEMP[0].xxxx, TEMP[1].xxxx\n"
+      "BARRIER\n"
+      "XOR TEMP[2].x, SV[0].xxxx, IMM[0].zzzz\n"
+      "UMUL TEMP[2].x, TEMP[2].xxxx, IMM[0].xxxx\n"
+      "LOAD TEMP[3].x, MEMORY[0], TEMP[2].xxxx\n"
+      "UMUL TEMP[1].x, TEMP[1].xxxx, IMM[0].xxxx\n"
+      "STORE BUFFER[0].x, TEMP[1].xxxx, TEMP[3].xxxx\n"
+      "END\n";
+   const unsigned groups = 7;
+   struct pipe_resource *buf;
+   uint32_t data[64 * 7];
+   boolean success = TRUE;
+   unsigned i;
+   void *cs;
+
+   cs = create_shader(ctx, text, 64 * 4);
+   buf = create_buffer(ctx, sizeof data, NULL);
+   set_buffers(ctx, PIPE_SHADER_COMPUTE, 1, &buf);
+
+   launch(ctx, cs, 64, 1, 1, groups, 1, 1);
+
+   pipe_buffer_read(ctx->pipe, buf, 0, sizeof data, data);
+   for (i = 0; i < ARRAY_SIZE(data); i++) {
+      unsigned expected = (i & ~63) + 63 - (i & 63);
+      if (data[i] != expected) {
+         fprintf(stderr, "invocation %u: got %u, expected %u\n",
+                 i, data[i], expected);
+         success = FALSE;
+         break;
+      }
+   }
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   pipe_resource_reference(&buf, NULL);
+   return success;
+}
+
+
+/**
+ * Fetch every texel of a texture both with TXF and with a point sampled TEX
+ * at the texel center.
+ */
+static boolean
+test_texture_format(struct cs_test_context *ctx, enum pipe_format format)
+{
+   static const char text[] =
+      "COMP\n"
+      "DCL SV[0], THREAD_ID\n"
+      "DCL SAMP[0]\n"
+      "DCL SVIEW[0], 2D, FLOAT\n"
+      "DCL BUFFER[0]\n"
+      "DCL TEMP[0..4]\n"
+      "IMM[0] UINT32 {8, 32, 16, 0}\n"
+      "IMM[1] FLT32 {0.5, 0.125, 0.0, 0.0}\n"
+      "MOV TEMP[0].xy, SV[0].xyxx\n"
+      "MOV TEMP[0].zw, IMM[0].wwww\n"
+      "TXF TEMP[1], TEMP[0], SAMP[0], 2D\n"
+      "U2F TEMP[2].xy, SV[0].xyxx\n"
+      "ADD TEMP[2].xy, TEMP[2].xyxx, IMM[1].xxxx\n"
+      "MUL TEMP[2].xy, TEMP[2].xyxx, IMM[1].yyyy\n"
+      "TEX TEMP[3], TEMP[2], SAMP[0], 2D\n"
+      "UMAD TEMP[4].x, SV[0].yyyy, IMM[0].xxxx, SV[0].xxxx\n"
+      "UMUL TEMP[4].x, TEMP[4].xxxx, IMM[0].yyyy\n"
+      "STORE BUFFER[0].xyzw, TEMP[4].xxxx, TEMP[1]\n"
+      "UADD TEMP[4].x, TEMP[4].xxxx, IMM[0].zzzz\n"
+      "STORE BUFFER[0].xyzw, TEMP[4].xxxx, TEMP[3]\n"
+      "END\n";
+   const unsigned size = 8;
+   struct pipe_sampler_view templ, *view;
+   struct pipe_sampler_state sampler_state;
+   struct pipe_resource *tex, *buf;
+   float texels[8 * 8][4], results[8 * 8][2][4];
+   uint8_t packed[8 * 8 * 16];
+   boolean success = TRUE;
+   void *sampler, *cs;
+   unsigned i, j;
+
+   for (i = 0; i < ARRAY_SIZE(texels); i++) {
+      for (j = 0; j < 4; j++)
+         texels[i][j] = (float)rand() / RAND_MAX;
+   }
+
+   /* round the reference to what the format can represent */
+   util_format_write_4f(format, &texels[0][0], size * 16,
+                        packed, util_format_get_stride(format, size),
+                        0, 0, size, size);
+   util_format_read_4f(format, &texels[0][0], size * 16,
+                       packed, util_format_get_stride(format, size),
+                       0, 0, size, size);
+
+   tex = create_texture(ctx, PIPE_TEXTURE_2D, format, size, size, 1, packed);
+   u_sampler_view_default_template(&templ, tex, format);
+   view = ctx->pipe->create_sampler_view(ctx->pipe, tex, &templ);
+   ctx->pipe->set_sampler_views(ctx->pipe, PIPE_SHADER_COMPUTE, 0, 1, &view);
+
+   memset(&sampler_state, 0, sizeof sampler_state);
+   sampler_state.wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   sampler_state.wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   sampler_state.wrap_r = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   sampler_state.min_img_filter = PIPE_TEX_FILTER_NEAREST;
+   sampler_state.mag_img_filter = PIPE_TEX_FILTER_NEAREST;
+   sampler_state.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   sampler_state.normalized_coords = 1;
+   sampler = ctx->pipe->create_sampler_state(ctx->pipe, &sampler_state);
+   ctx->pipe->bind_sampler_states(ctx->pipe, PIPE_SHADER_COMPUTE, 0, 1,
+                                  &sampler);
+
+   cs = create_shader(ctx, text, 0);
+   buf = create_buffer(ctx, sizeof results, NULL);
+   set_buffers(ctx, PIPE_SHADER_COMPUTE, 1, &buf);
+
+   launch(ctx, cs, size, size, 1, 1, 1, 1);
+
+   pipe_buffer_read(ctx->pipe, buf, 0, sizeof results, results);
+   for (i = 0; i < ARRAY_SIZE(texels) && success; i++) {
+      for (j = 0; j < 2; j++) {
+         if (memcmp(results[i][j], texels[i], sizeof texels[i]) != 0) {
+            fprintf(stderr, "%s: %s of texel %u got %f %f %f %f, "
+                    "expected %f %f %f %f\n",
+                    util_format_name(format), j ? "TEX" : "TXF", i,
+                    results[i][j][0], results[i][j][1],
+                    results[i][j][2], results[i][j][3],
+                    texels[i][0], texels[i][1], texels[i][2], texels[i][3]);
+            success = FALSE;
+            break;
+         }
+      }
+   }
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   ctx->pipe->delete_sampler_state(ctx->pipe, sampler);
+   pipe_sampler_view_reference(&view, NULL);
+   ctx->pipe->set_sampler_views(ctx->pipe, PIPE_SHADER_COMPUTE, 0, 1, &view);
+   pipe_resource_reference(&tex, NULL);
+   pipe_resource_reference(&buf, NULL);
+   return success;
+}
+
+
+static boolean
+test_textures(struct cs_test_context *ctx)
+{
+   /* each one is a different shader variant */
+   static const enum pipe_format formats[] = {
+      PIPE_FORMAT_R8G8B8A8_UNORM,
+      PIPE_FORMAT_R32G32B32A32_FLOAT,
+      PIPE_FORMAT_R16G16_FLOAT,
+   };
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(formats); i++) {
+      if (!test_texture_format(ctx, formats[i]))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+static void
+random_texels(enum pipe_format format, void *packed,
+              unsigned width, unsigned height)
+{
+   const struct util_format_description *desc = util_format_description(format);
+   unsigned stride = util_format_get_stride(format, width);
+   unsigned n = width * height;
+   unsigned i, j;
+
+   if (util_format_is_pure_uint(format)) {
+      unsigned *values = MALLOC(n * 16);
+      for (i = 0; i < n * 4; i++)
+         values[i] = rand();
+      util_format_write_4ui(format, values, width * 16, packed, stride,
+                            0, 0, width, height);
+      FREE(values);
+   }
+   else if (util_format_is_pure_sint(format)) {
+      int *values = MALLOC(n * 16);
+      for (i = 0; i < n * 4; i++)
+         values[i] = rand() - RAND_MAX / 2;
+      util_format_write_4i(format, values, width * 16, packed, stride,
+                           0, 0, width, height);
+      FREE(values);
+   }
+   else {
+      float *values = MALLOC(n * 16);
+      for (i = 0; i < n; i++) {
+         for (j = 0; j < 4; j++) {
+            float value = (float)rand() / RAND_MAX;
+            if (desc->channel[0].type == UTIL_FORMAT_TYPE_SIGNED)
+               value = value * 2.0f - 1.0f;
+            values[i * 4 + j] = value;
+         }
+      }
+      util_format_write_4f(format, values, width * 16, packed, stride,
+                           0, 0, width, height);
+      FREE(values);
+   }
+}
+
+
+/**
+ * Copy an image into another with LOAD and STORE, over a grid larger than
+ * the image, to check the format conversions both ways and the bounds
+ * checks.
+ */
+static boolean
+test_image_format(struct cs_test_context *ctx, enum pipe_format format)
+{
+   static const char text[] =
+      "COMP\n"
+      "DCL SV[0], THREAD_ID\n"
+      "DCL SV[1], BLOCK_ID\n"
+      "DCL SV[2], BLOCK_SIZE\n"
+      "DCL IMAGE[0], 2D, %s\n"
+      "DCL IMAGE[1], 2D, %s, WR\n"
+      "DCL TEMP[0..1]\n"
+      "UMAD TEMP[0].xy, SV[1].xyyy, SV[2].xyyy, SV[0].xyyy\n"
+      "LOAD TEMP[1], IMAGE[0], TEMP[0].xyyy, 2D, %s\n"
+      "STORE IMAGE[1], TEMP[0].xyyy, TEMP[1], 2D, %s\n"
+      "END\n";
+   const unsigned width = 7, height = 5;
+   const char *name = util_format_name(format);
+   unsigned size = util_format_get_stride(format, width) * height;
+   struct pipe_resource *src, *dst;
+   uint8_t *src_data, *dst_data;
+   char shader_text[1024];
+   boolean success = TRUE;
+   unsigned i;
+   void *cs;
+
+   if (!ctx->screen->is_format_supported(ctx->screen, format,
+                                         PIPE_TEXTURE_2D, 0, 0,
+                                         PIPE_BIND_SHADER_IMAGE)) {
+      fprintf(stderr, "%s: not supported for images\n", name);
+      return FALSE;
+   }
+
+   src_data = MALLOC(size);
+   dst_data = CALLOC(size, 1);
+   random_texels(format, src_data, width, height);
+
+   src = create_texture(ctx, PIPE_TEXTURE_2D, format, width, height, 1,
+                        src_data);
+   dst = create_texture(ctx, PIPE_TEXTURE_2D, format, width, height, 1,
+                        dst_data);
+   set_image(ctx, 0, src, format, 0, 0);
+   set_image(ctx, 1, dst, format, 0, 0);
+
+   util_snprintf(shader_text, sizeof shader_text, text,
+                 name, name, name, name);
+   cs = create_shader(ctx, shader_text, 0);
+
+   launch(ctx, cs, 4, 4, 1, 2, 2, 1);
+
+   read_texture(ctx, dst, dst_data);
+   for (i = 0; i < size; i++) {
+      if (src_data[i] != dst_data[i]) {
+         unsigned blocksize = util_format_get_blocksize(format);
+         fprintf(stderr, "%s: texel %u differs\n", name, i / blocksize);
+         success = FALSE;
+         break;
+      }
+   }
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   ctx->pipe->set_shader_images(ctx->pipe, PIPE_SHADER_COMPUTE, 0, 2, NULL);
+   pipe_resource_reference(&src, NULL);
+   pipe_resource_reference(&dst, NULL);
+   FREE(src_data);
+   FREE(dst_data);
+   return success;
+}
+
+
+static boolean
+test_images(struct cs_test_context *ctx)
+{
+   static const enum pipe_format formats[] = {
+      PIPE_FORMAT_R32G32B32A32_FLOAT,
+      PIPE_FORMAT_R32G32B32A32_UINT,
+      PIPE_FORMAT_R16G16B16A16_FLOAT,
+      PIPE_FORMAT_R16G16B16A16_SINT,
+      PIPE_FORMAT_R16G16B16A16_UNORM,
+      PIPE_FORMAT_R32G32_SINT,
+      PIPE_FORMAT_R16G16_SNORM,
+      PIPE_FORMAT_R8G8B8A8_UNORM,
+      PIPE_FORMAT_R8G8B8A8_SNORM,
+      PIPE_FORMAT_R8G8B8A8_UINT,
+      PIPE_FORMAT_B8G8R8A8_UNORM,
+      PIPE_FORMAT_R10G10B10A2_UNORM,
+      PIPE_FORMAT_R10G10B10A2_UINT,
+      PIPE_FORMAT_R11G11B10_FLOAT,
+      PIPE_FORMAT_R32_FLOAT,
+      PIPE_FORMAT_R16_UINT,
+      PIPE_FORMAT_R8_SINT,
+      PIPE_FORMAT_R8_UNORM,
+   };
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(formats); i++) {
+      if (!test_image_format(ctx, formats[i]))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+/**
+ * Store the layer index into the layers of an array image view which
+ * doesn't start at the first layer, and query its size.
+ */
+static boolean
+test_image_layers(struct cs_test_context *ctx)
+{
+   static const char text[] =
+      "COMP\n"
+      "DCL SV[0], THREAD_ID\n"
+      "DCL SV[1], BLOCK_ID\n"
+      "DCL IMAGE[0], 2D_ARRAY, PIPE_FORMAT_R32_UINT, WR\n"
+      "DCL BUFFER[0]\n"
+      "DCL TEMP[0..1]\n"
+      "IMM[0] UINT32 {0, 0, 0, 0}\n"
+      "MOV TEMP[0].xy, SV[0].xyyy\n"
+      "MOV TEMP[0].z, SV[1].zzzz\n"
+      "STORE IMAGE[0], TEMP[0].xyzz, SV[1].zzzz, 2D_ARRAY, "
+         "PIPE_FORMAT_R32_UINT\n"
+      "RESQ TEMP[1].xyz, IMAGE[0], 2D_ARRAY, PIPE_FORMAT_R32_UINT\n"
+      "STORE BUFFER[0].xyz, IMM[0].xxxx, TEMP[1]\n"
+      "END\n";
+   const unsigned width = 3, height = 2, layers = 4;
+   uint32_t data[4][2][3], sizes[3] = { 0 };
+   struct pipe_resource *tex, *buf;
+   boolean success = TRUE;
+   unsigned x, y, z;
+   void *cs;
+
+   for (z = 0; z < layers; z++)
+      for (y = 0; y < height; y++)
+         for (x = 0; x < width; x++)
+            data[z][y][x] = 0xdeadbeef;
+
+   tex = create_texture(ctx, PIPE_TEXTURE_2D_ARRAY, PIPE_FORMAT_R32_UINT,
+                        width, height, layers, data);
+   buf = create_buffer(ctx, sizeof sizes, NULL);
+   set_image(ctx, 0, tex, PIPE_FORMAT_R32_UINT, 1, 2);
+   set_buffers(ctx, PIPE_SHADER_COMPUTE, 1, &buf);
+
+   cs = create_shader(ctx, text, 0);
+
+   /* one group per layer, plus one out of bounds */
+   launch(ctx, cs, width, height, 1, 1, 1, 3);
+
+   read_texture(ctx, tex, data);
+   for (z = 0; z < layers; z++) {
+      uint32_t expected = z == 1 ? 0 : z == 2 ? 1 : 0xdeadbeef;
+      for (y = 0; y < height; y++) {
+         for (x = 0; x < width; x++) {
+            if (data[z][y][x] != expected && success) {
+               fprintf(stderr, "layer %u: got 0x%x, expected 0x%x\n",
+                       z, data[z][y][x], expected);
+               success = FALSE;
+            }
+         }
+      }
+   }
+
+   pipe_buffer_read(ctx->pipe, buf, 0, sizeof sizes, sizes);
+   if (sizes[0] != width || sizes[1] != height || sizes[2] != 2) {
+      fprintf(stderr, "image size %u %u %u, expected %u %u 2\n",
+              sizes[0], sizes[1], sizes[2], width, height);
+      success = FALSE;
+   }
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   ctx->pipe->set_shader_images(ctx->pipe, PIPE_SHADER_COMPUTE, 0, 1, NULL);
+   pipe_resource_reference(&tex, NULL);
+   pipe_resource_reference(&buf, NULL);
+   return success;
+}
+
+
+/**
+ * Count, through an image atomic, how many invocations hit every texel of
+ * a buffer image.
+ */
+static boolean
+test_image_atomics(struct cs_test_context *ctx)
+{
+   static const char text[] =
+      "COMP\n"
+      "DCL SV[0], THREAD_ID\n"
+      "DCL IMAGE[0], BUFFER, PIPE_FORMAT_R32_UINT, WR\n"
+      "DCL BUFFER[0]\n"
+      "DCL TEMP[0..1]\n"
+      "IMM[0] UINT32 {15, 1, 4, 0}\n"
+      "AND TEMP[0].x, SV[0].xxxx, IMM[0].xxxx\n"
+      "ATOMUADD TEMP[1].x, IMAGE[0], TEMP[0].xxxx, IMM[0].yyyy, BUFFER, "
+         "PIPE_FORMAT_R32_UINT\n"
+      "UMUL TEMP[0].x, SV[0].xxxx, IMM[0].zzzz\n"
+      "STORE BUFFER[0].x, TEMP[0].xxxx, TEMP[1].xxxx\n"
+      "END\n";
+   uint32_t counts[16], results[64];
+   unsigned sums[16] = { 0 };
+   struct pipe_resource *img, *buf;
+   boolean success = TRUE;
+   unsigned i;
+   void *cs;
+
+   img = create_buffer(ctx, sizeof counts, NULL);
+   buf = create_buffer(ctx, sizeof results, NULL);
+   set_image(ctx, 0, img, PIPE_FORMAT_R32_UINT, 0, 0);
+   set_buffers(ctx, PIPE_SHADER_COMPUTE, 1, &buf);
+
+   cs = create_shader(ctx, text, 0);
+
+   launch(ctx, cs, 64, 1, 1, 1, 1, 1);
+
+   pipe_buffer_read(ctx->pipe, img, 0, sizeof counts, counts);
+   pipe_buffer_read(ctx->pipe, buf, 0, sizeof results, results);
+
+   for (i = 0; i < 64; i++)
+      sums[i & 15] += results[i];
+
+   for (i = 0; i < 16; i++) {
+      /* each texel was incremented 4 times, returning 0, 1, 2 and 3 */
+      if (counts[i] != 4 || sums[i] != 6) {
+         fprintf(stderr, "texel %u: count %u, sum of results %u\n",
+                 i, counts[i], sums[i]);
+         success = FALSE;
+         break;
+      }
+   }
+
+   ctx->pipe->delete_compute_state(ctx->pipe, cs);
+   ctx->pipe->set_shader_images(ctx->pipe, PIPE_SHADER_COMPUTE, 0, 1, NULL);
+   pipe_resource_reference(&img, NULL);
+   pipe_resource_reference(&buf, NULL);
+   return success;
+}
+
+
+/**
+ * Count the fragments of a quad with a buffer atomic, while the depth test
+ * rejects them all: the atomics must still happen, unless the shader asks
+ * for early fragment tests.
+ */
+static boolean
+test_fragment_buffers(struct cs_test_context *ctx, boolean early_tests)
+{
+   static const char vs_text[] =
+      "VERT\n"
+      "DCL IN[0]\n"
+      "DCL OUT[0], POSITION\n"
+      "MOV OUT[0], IN[0]\n"
+      "END\n";
+   static const char fs_text[] =
+      "FRAG\n"
+      "PROPERTY FS_EARLY_DEPTH_STENCIL %u\n"
+      "DCL OUT[0], COLOR\n"
+      "DCL BUFFER[0]\n"
+      "DCL TEMP[0]\n"
+      "IMM[0] UINT32 {0, 1, 0, 0}\n"
+      "IMM[1] FLT32 {1.0, 0.0, 0.0, 1.0}\n"
+      "ATOMUADD TEMP[0].x, BUFFER[0].xxxx, IMM[0].xxxx, IMM[0].yyyy\n"
+      "MOV OUT[0], IMM[1]\n"
+      "END\n";
+   static const float vertices[4][4] = {
+      { -1.0f, -1.0f, 0.5f, 1.0f },
+      {  1.0f, -1.0f, 0.5f, 1.0f },
+      { -1.0f,  1.0f, 0.5f, 1.0f },
+      {  1.0f,  1.0f, 0.5f, 1.0f },
+   };
+   const unsigned size = 16;
+   struct pipe_context *pipe = ctx->pipe;
+   struct tgsi_token tokens[MAX_TOKENS];
+   char text[1024];
+   struct pipe_shader_state shader;
+   struct pipe_resource templ, *cbuf, *zsbuf, *vbuf, *buf;
+   struct pipe_surface surf_templ, *cbuf_surf, *zsbuf_surf;
+   struct pipe_framebuffer_state fb;
+   struct pipe_rasterizer_state rast;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element velem;
+   struct pipe_vertex_buffer vb;
+   struct pipe_draw_info info;
+   void *vs, *fs, *rast_state, *blend_state, *dsa_state, *velem_state;
+   uint32_t count = 0;
+   unsigned expected = early_tests ? 0 : size * size;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.width0 = size;
+   templ.height0 = size;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   cbuf = ctx->screen->resource_create(ctx->screen, &templ);
+   templ.format = PIPE_FORMAT_Z32_FLOAT;
+   templ.bind = PIPE_BIND_DEPTH_STENCIL;
+   zsbuf = ctx->screen->resource_create(ctx->screen, &templ);
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   cbuf_surf = pipe->create_surface(pipe, cbuf, &surf_templ);
+   surf_templ.format = PIPE_FORMAT_Z32_FLOAT;
+   zsbuf_surf = pipe->create_surface(pipe, zsbuf, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = size;
+   fb.height = size;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = cbuf_surf;
+   fb.zsbuf = zsbuf_surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast_state = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, rast_state);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   blend_state = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, blend_state);
+
+   memset(&dsa, 0, sizeof dsa);
+   dsa.depth.enabled = 1;
+   dsa.depth.writemask = 1;
+   dsa.depth.func = PIPE_FUNC_NEVER;
+   dsa_state = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, dsa_state);
+
+   viewport.scale[0] = size / 2.0f;
+   viewport.scale[1] = size / 2.0f;
+   viewport.scale[2] = 1.0f;
+   viewport.translate[0] = size / 2.0f;
+   viewport.translate[1] = size / 2.0f;
+   viewport.translate[2] = 0.0f;
+   pipe->set_viewport_states(pipe, 0, 1, &viewport);
+
+   memset(&shader, 0, sizeof shader);
+   shader.type = PIPE_SHADER_IR_TGSI;
+   shader.tokens = tokens;
+   tgsi_text_translate(vs_text, tokens, ARRAY_SIZE(tokens));
+   vs = pipe->create_vs_state(pipe, &shader);
+   pipe->bind_vs_state(pipe, vs);
+   util_snprintf(text, sizeof text, fs_text, early_tests);
+   tgsi_text_translate(text, tokens, ARRAY_SIZE(tokens));
+   fs = pipe->create_fs_state(pipe, &shader);
+   pipe->bind_fs_state(pipe, fs);
+
+   memset(&velem, 0, sizeof velem);
+   velem.src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velem_state = pipe->create_vertex_elements_state(pipe, 1, &velem);
+   pipe->bind_vertex_elements_state(pipe, velem_state);
+
+   vbuf = pipe_buffer_create(ctx->screen, PIPE_BIND_VERTEX_BUFFER,
+                             PIPE_USAGE_DEFAULT, sizeof vertices);
+   pipe_buffer_write(pipe, vbuf, 0, sizeof vertices, vertices);
+   memset(&vb, 0, sizeof vb);
+   vb.stride = sizeof vertices[0];
+   vb.buffer.resource = vbuf;
+   pipe->set_vertex_buffers(pipe, 0, 1, &vb);
+
+   buf = create_buffer(ctx, sizeof count, &count);
+   set_buffers(ctx, PIPE_SHADER_FRAGMENT, 1, &buf);
+
+   memset(&info, 0, sizeof info);
+   info.mode = PIPE_PRIM_TRIANGLE_STRIP;
+   info.count = 4;
+   info.instance_count = 1;
+   info.max_index = 3;
+   pipe->draw_vbo(pipe, &info);
+
+   /* no explicit flush: mapping the buffer must wait for the draw */
+   pipe_buffer_read(pipe, buf, 0, sizeof count, &count);
+
+   set_buffers(ctx, PIPE_SHADER_FRAGMENT, 0, NULL);
+   pipe->set_vertex_buffers(pipe, 0, 1, NULL);
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_fs_state(pipe, NULL);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->delete_fs_state(pipe, fs);
+   pipe->delete_vertex_elements_state(pipe, velem_state);
+   pipe->delete_rasterizer_state(pipe, rast_state);
+   pipe->delete_blend_state(pipe, blend_state);
+   pipe->delete_depth_stencil_alpha_state(pipe, dsa_state);
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe_surface_reference(&cbuf_surf, NULL);
+   pipe_surface_reference(&zsbuf_surf, NULL);
+   pipe_resource_reference(&cbuf, NULL);
+   pipe_resource_reference(&zsbuf, NULL);
+   pipe_resource_reference(&vbuf, NULL);
+   pipe_resource_reference(&buf, NULL);
+
+   if (count != expected) {
+      fprintf(stderr, "%s fragment tests: %u fragments counted, "
+              "expected %u\n", early_tests ? "early" : "late",
+              count, expected);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+test_fragment_buffers_late(struct cs_test_context *ctx)
+{
+   return test_fragment_buffers(ctx, FALSE);
+}
+
+
+static boolean
+test_fragment_buffers_early(struct cs_test_context *ctx)
+{
+   return test_fragment_buffers(ctx, TRUE);
+}
+
+
+static const struct
+{
+   const char *name;
+   boolean (*func)(struct cs_test_context *ctx);
+} tests[] = {
+   { "system_values", test_system_values },
+   { "indirect_launch", test_indirect_launch },
+   { "buffer_atomics", test_buffer_atomics },
+   { "shared_memory", test_shared_memory },
+   { "textures", test_textures },
+   { "images", test_images },
+   { "image_layers", test_image_layers },
+   { "image_atomics", test_image_atomics },
+   { "fragment_buffers_late", test_fragment_buffers_late },
+   { "fragment_buffers_early", test_fragment_buffers_early },
+};
+
+
+static boolean
+run_tests(unsigned verbose, FILE *fp, unsigned first, unsigned count)
+{
+   struct cs_test_context ctx;
+   struct sw_winsys *winsys;
+   boolean success = TRUE;
+   unsigned i;
+
+   memset(&ctx, 0, sizeof ctx);
+   ctx.verbose = verbose;
+
+   winsys = null_sw_create();
+   ctx.screen = llvmpipe_create_screen(winsys);
+   if (!ctx.screen)
+      return FALSE;
+
+   if (!ctx.screen->get_param(ctx.screen, PIPE_CAP_COMPUTE)) {
+      /* LLVM too old for coroutines */
+      printf("compute shaders not supported, skipping\n");
+      ctx.screen->destroy(ctx.screen);
+      return TRUE;
+   }
+
+   ctx.pipe = ctx.screen->context_create(ctx.screen, NULL, 0);
+
+   for (i = first; i < first + count; i++) {
+      boolean test_success = tests[i].func(&ctx);
+
+      if (verbose || !test_success)
+         printf("%s: %s\n", tests[i].name, test_success ? "pass" : "fail");
+
+      if (fp)
+         write_tsv_row(fp, tests[i].name, test_success);
+
+      if (!test_success)
+         success = FALSE;
+   }
+
+   ctx.pipe->destroy(ctx.pipe);
+   ctx.screen->destroy(ctx.screen);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return run_tests(verbose, fp, 0, ARRAY_SIZE(tests));
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   /* the tests are deterministic enough, no point in sampling them */
+   return test_all(verbose, fp);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return run_tests(verbose, fp, 0, 1);
+}
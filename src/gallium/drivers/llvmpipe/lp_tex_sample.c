@@ -65,6 +65,10 @@ struct llvmpipe_sampler_dynamic_state
    struct lp_sampler_dynamic_state base;
 
    const struct lp_sampler_static_state *static_state;
+
+   /** Indices of the textures and samplers arrays in the jit context */
+   unsigned textures_member;
+   unsigned samplers_member;
 };
 
 
@@ -79,6 +83,29 @@ struct lp_llvm_sampler_soa
 };
 
 
+/**
+ * This provides the bridge between the image state in lp_jit_cs_context
+ * and the image code generator.
+ */
+struct llvmpipe_image_dynamic_state
+{
+   struct lp_sampler_dynamic_state base;
+
+   const struct lp_static_texture_state *static_state;
+};
+
+
+/**
+ * This is the bridge between our images and the TGSI translator.
+ */
+struct lp_llvm_image_soa
+{
+   struct lp_build_image_soa base;
+
+   struct llvmpipe_image_dynamic_state dynamic_state;
+};
+
+
 /**
  * Fetch the specified member of the lp_jit_texture structure.
  * \param emit_load  if TRUE, emit the LLVM load instruction to actually
@@ -96,6 +123,8 @@ lp_llvm_texture_member(const struct lp_sampler_dynamic_state *base,
                        const char *member_name,
                        boolean emit_load)
 {
+   const struct llvmpipe_sampler_dynamic_state *state =
+      (const struct llvmpipe_sampler_dynamic_state *)base;
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef indices[4];
    LLVMValueRef ptr;
@@ -106,7 +135,7 @@ lp_llvm_texture_member(const struct lp_sampler_dynamic_state *base,
    /* context[0] */
    indices[0] = lp_build_const_int32(gallivm, 0);
    /* context[0].textures */
-   indices[1] = lp_build_const_int32(gallivm, LP_JIT_CTX_TEXTURES);
+   indices[1] = lp_build_const_int32(gallivm, state->textures_member);
    /* context[0].textures[unit] */
    indices[2] = lp_build_const_int32(gallivm, texture_unit);
    /* context[0].textures[unit].member */
@@ -174,6 +203,8 @@ lp_llvm_sampler_member(const struct lp_sampler_dynamic_state *base,
                        const char *member_name,
                        boolean emit_load)
 {
+   const struct llvmpipe_sampler_dynamic_state *state =
+      (const struct llvmpipe_sampler_dynamic_state *)base;
    LLVMBuilderRef builder = gallivm->builder;
    LLVMValueRef indices[4];
    LLVMValueRef ptr;
@@ -184,7 +215,7 @@ lp_llvm_sampler_member(const struct lp_sampler_dynamic_state *base,
    /* context[0] */
    indices[0] = lp_build_const_int32(gallivm, 0);
    /* context[0].samplers */
-   indices[1] = lp_build_const_int32(gallivm, LP_JIT_CTX_SAMPLERS);
+   indices[1] = lp_build_const_int32(gallivm, state->samplers_member);
    /* context[0].samplers[unit] */
    indices[2] = lp_build_const_int32(gallivm, sampler_unit);
    /* context[0].samplers[unit].member */
@@ -221,6 +252,63 @@ LP_LLVM_SAMPLER_MEMBER(lod_bias,   LP_JIT_SAMPLER_LOD_BIAS, TRUE)
 LP_LLVM_SAMPLER_MEMBER(border_color, LP_JIT_SAMPLER_BORDER_COLOR, FALSE)
 
 
+/**
+ * Fetch the specified member of the lp_jit_image structure.
+ */
+static LLVMValueRef
+lp_llvm_image_member(const struct lp_sampler_dynamic_state *base,
+                     struct gallivm_state *gallivm,
+                     LLVMValueRef context_ptr,
+                     unsigned image_unit,
+                     unsigned member_index,
+                     const char *member_name)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef indices[4];
+   LLVMValueRef ptr;
+   LLVMValueRef res;
+
+   assert(image_unit < PIPE_MAX_SHADER_IMAGES);
+
+   /* context[0] */
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   /* context[0].images */
+   indices[1] = lp_build_const_int32(gallivm, LP_JIT_CS_CTX_IMAGES);
+   /* context[0].images[unit] */
+   indices[2] = lp_build_const_int32(gallivm, image_unit);
+   /* context[0].images[unit].member */
+   indices[3] = lp_build_const_int32(gallivm, member_index);
+
+   ptr = LLVMBuildGEP(builder, context_ptr, indices, ARRAY_SIZE(indices), "");
+
+   res = LLVMBuildLoad(builder, ptr, "");
+
+   lp_build_name(res, "context.image%u.%s", image_unit, member_name);
+
+   return res;
+}
+
+
+#define LP_LLVM_IMAGE_MEMBER(_name, _index)  \
+   static LLVMValueRef \
+   lp_llvm_image_##_name( const struct lp_sampler_dynamic_state *base, \
+                          struct gallivm_state *gallivm, \
+                          LLVMValueRef context_ptr, \
+                          unsigned image_unit) \
+   { \
+      return lp_llvm_image_member(base, gallivm, context_ptr, \
+                                  image_unit, _index, #_name ); \
+   }
+
+
+LP_LLVM_IMAGE_MEMBER(width,      LP_JIT_IMAGE_WIDTH)
+LP_LLVM_IMAGE_MEMBER(height,     LP_JIT_IMAGE_HEIGHT)
+LP_LLVM_IMAGE_MEMBER(depth,      LP_JIT_IMAGE_DEPTH)
+LP_LLVM_IMAGE_MEMBER(base_ptr,   LP_JIT_IMAGE_BASE)
+LP_LLVM_IMAGE_MEMBER(row_stride, LP_JIT_IMAGE_ROW_STRIDE)
+LP_LLVM_IMAGE_MEMBER(img_stride, LP_JIT_IMAGE_IMG_STRIDE)
+
+
 #if LP_USE_TEXTURE_CACHE
 static LLVMValueRef
 lp_llvm_texture_cache_ptr(const struct lp_sampler_dynamic_state *base,
@@ -289,8 +377,10 @@ lp_llvm_sampler_soa_emit_size_query(const struct lp_build_sampler_soa *base,
 }
 
 
-struct lp_build_sampler_soa *
-lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
+static struct lp_build_sampler_soa *
+sampler_soa_create(const struct lp_sampler_static_state *static_state,
+                   unsigned textures_member,
+                   unsigned samplers_member)
 {
    struct lp_llvm_sampler_soa *sampler;
 
@@ -320,7 +410,96 @@ lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
 #endif
 
    sampler->dynamic_state.static_state = static_state;
+   sampler->dynamic_state.textures_member = textures_member;
+   sampler->dynamic_state.samplers_member = samplers_member;
 
    return &sampler->base;
 }
 
+
+struct lp_build_sampler_soa *
+lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state)
+{
+   return sampler_soa_create(static_state,
+                             LP_JIT_CTX_TEXTURES, LP_JIT_CTX_SAMPLERS);
+}
+
+
+/**
+ * Same as lp_llvm_sampler_soa_create(), for compute shaders.
+ */
+struct lp_build_sampler_soa *
+lp_llvm_cs_sampler_soa_create(const struct lp_sampler_static_state *static_state)
+{
+   return sampler_soa_create(static_state,
+                             LP_JIT_CS_CTX_TEXTURES, LP_JIT_CS_CTX_SAMPLERS);
+}
+
+
+static void
+lp_llvm_image_soa_destroy(struct lp_build_image_soa *image)
+{
+   FREE(image);
+}
+
+
+static void
+lp_llvm_image_soa_emit_op(const struct lp_build_image_soa *base,
+                          struct gallivm_state *gallivm,
+                          const struct lp_img_params *params)
+{
+   struct lp_llvm_image_soa *image = (struct lp_llvm_image_soa *)base;
+   unsigned image_index = params->image_index;
+
+   assert(image_index < PIPE_MAX_SHADER_IMAGES);
+
+   lp_build_img_op_soa(&image->dynamic_state.static_state[image_index],
+                       &image->dynamic_state.base,
+                       gallivm, params);
+}
+
+
+static void
+lp_llvm_image_soa_emit_size_query(const struct lp_build_image_soa *base,
+                                  struct gallivm_state *gallivm,
+                                  const struct lp_sampler_size_query_params *params)
+{
+   struct lp_llvm_image_soa *image = (struct lp_llvm_image_soa *)base;
+
+   assert(params->texture_unit < PIPE_MAX_SHADER_IMAGES);
+
+   lp_build_size_query_soa(gallivm,
+                           &image->dynamic_state.static_state[params->texture_unit],
+                           &image->dynamic_state.base,
+                           params);
+}
+
+
+/**
+ * Image code generator for compute shaders.
+ */
+struct lp_build_image_soa *
+lp_llvm_image_soa_create(const struct lp_static_texture_state *static_state)
+{
+   struct lp_llvm_image_soa *image;
+
+   image = CALLOC_STRUCT(lp_llvm_image_soa);
+   if (!image)
+      return NULL;
+
+   image->base.destroy = lp_llvm_image_soa_destroy;
+   image->base.emit_op = lp_llvm_image_soa_emit_op;
+   image->base.emit_size_query = lp_llvm_image_soa_emit_size_query;
+
+   image->dynamic_state.base.width = lp_llvm_image_width;
+   image->dynamic_state.base.height = lp_llvm_image_height;
+   image->dynamic_state.base.depth = lp_llvm_image_depth;
+   image->dynamic_state.base.base_ptr = lp_llvm_image_base_ptr;
+   image->dynamic_state.base.row_stride = lp_llvm_image_row_stride;
+   image->dynamic_state.base.img_stride = lp_llvm_image_img_stride;
+
+   image->dynamic_state.static_state = static_state;
+
+   return &image->base;
+}
+
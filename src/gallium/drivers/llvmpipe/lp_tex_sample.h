@@ -33,6 +33,7 @@
 
 
 struct lp_sampler_static_state;
+struct lp_static_texture_state;
 
 /**
  * Whether texture cache is used for s3tc textures.
@@ -46,4 +47,13 @@ struct lp_sampler_static_state;
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *key);
 
+struct lp_build_sampler_soa *
+lp_llvm_cs_sampler_soa_create(const struct lp_sampler_static_state *key);
+
+/**
+ * Shader image code generator, for compute shaders.
+ */
+struct lp_build_image_soa *
+lp_llvm_image_soa_create(const struct lp_static_texture_state *key);
+
 #endif /* LP_TEX_SAMPLE_H */
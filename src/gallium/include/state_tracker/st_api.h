@@ -349,6 +349,26 @@ struct st_framebuffer_iface
                                  struct st_framebuffer_iface *stfbi);
 };
 
+/**
+ * Maximum number of state atoms in struct st_atom_stats.
+ */
+#define ST_MAX_ATOMS 64
+
+/**
+ * Statistics of the state validation of a rendering context, per state atom.
+ *
+ * The context only collects them once enabled is set, either by itself or
+ * by the HUD showing them.  The counters only ever increase.
+ */
+struct st_atom_stats
+{
+   boolean enabled;
+   unsigned num_atoms;
+   const char *const *names;         /**< update function of each atom */
+   uint64_t calls[ST_MAX_ATOMS];     /**< number of updates of each atom */
+   uint64_t time_ns[ST_MAX_ATOMS];   /**< time spent updating each atom */
+};
+
 /**
  * Represent a rendering context.
  *
@@ -378,6 +398,11 @@ struct st_context_iface
     */
    struct pipe_context *pipe;
 
+   /**
+    * State validation statistics, for the HUD.  May be NULL.
+    */
+   struct st_atom_stats *atom_stats;
+
    /**
     * Destroy the context.
     */
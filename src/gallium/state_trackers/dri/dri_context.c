@@ -187,6 +187,8 @@ dri_create_context(gl_api api, const struct gl_config * visual,
       ctx->pp = pp_init(ctx->st->pipe, screen->pp_enabled, ctx->st->cso_context);
       ctx->hud = hud_create(ctx->st->cso_context,
                             share_ctx ? share_ctx->hud : NULL);
+      if (ctx->hud)
+         hud_add_atom_stats(ctx->hud, ctx->st->pipe, ctx->st->atom_stats);
    }
 
    /* Do this last. */
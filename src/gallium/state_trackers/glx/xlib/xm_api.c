@@ -1042,6 +1042,8 @@ XMesaContext XMesaCreateContext( XMesaVisual v, XMesaContext share_list,
    c->st->st_manager_private = (void *) c;
 
    c->hud = hud_create(c->st->cso_context, NULL);
+   if (c->hud)
+      hud_add_atom_stats(c->hud, c->st->pipe, c->st->atom_stats);
 
    return c;
 
@@ -279,6 +279,8 @@ stw_create_context_attribs(HDC hdc, INT iLayerPlane, DHGLRC hShareContext,
 
    if (ctx->st->cso_context) {
       ctx->hud = hud_create(ctx->st->cso_context, NULL);
+      if (ctx->hud)
+         hud_add_atom_stats(ctx->hud, ctx->st->pipe, ctx->st->atom_stats);
    }
 
    stw_lock_contexts(stw_dev);
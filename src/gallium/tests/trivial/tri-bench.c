@@ -0,0 +1,331 @@
+/**************************************************************************
+ *
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/*
+ * Measures the triangle throughput of the software driver on a large
+ * indexed mesh of small triangles, for an increasing number of draw module
+ * vertex shading threads (DRAW_NUM_THREADS).
+ *
+ * Usage: tri-bench [max threads]
+ */
+
+#define WIDTH 256
+#define HEIGHT 256
+#define GRID 512
+#define FRAMES 10
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* pipe_*_state structs */
+#include "pipe/p_state.h"
+/* pipe_context */
+#include "pipe/p_context.h"
+/* pipe_screen */
+#include "pipe/p_screen.h"
+/* PIPE_* */
+#include "pipe/p_defines.h"
+/* TGSI_SEMANTIC_{POSITION|GENERIC} */
+#include "pipe/p_shader_tokens.h"
+/* pipe_buffer_* helpers */
+#include "util/u_inlines.h"
+
+/* constant state object helper */
+#include "cso_cache/cso_context.h"
+
+/* util_draw_elements */
+#include "util/u_draw.h"
+/* FREE & CALLOC_STRUCT */
+#include "util/u_memory.h"
+/* util_make_[fragment|vertex]_passthrough_shader */
+#include "util/u_simple_shaders.h"
+/* os_time_get_nano */
+#include "util/os_time.h"
+/* to get a software pipe driver */
+#include "pipe-loader/pipe_loader.h"
+
+struct program
+{
+	struct pipe_loader_device *dev;
+	struct pipe_screen *screen;
+	struct pipe_context *pipe;
+	struct cso_context *cso;
+
+	struct pipe_blend_state blend;
+	struct pipe_depth_stencil_alpha_state depthstencil;
+	struct pipe_rasterizer_state rasterizer;
+	struct pipe_viewport_state viewport;
+	struct pipe_framebuffer_state framebuffer;
+	struct pipe_vertex_element velem[2];
+	struct pipe_vertex_buffer vbuf;
+
+	void *vs;
+	void *fs;
+
+	unsigned *indices;
+	unsigned num_indices;
+
+	struct pipe_resource *target;
+};
+
+static void init_mesh(struct program *p)
+{
+	float (*vertices)[2][4];
+	unsigned x, y, i;
+
+	vertices = MALLOC((GRID + 1) * (GRID + 1) * sizeof(*vertices));
+	p->indices = MALLOC(GRID * GRID * 6 * sizeof(unsigned));
+	assert(vertices && p->indices);
+
+	for (y = 0, i = 0; y <= GRID; y++) {
+		for (x = 0; x <= GRID; x++, i++) {
+			vertices[i][0][0] = 1.8f * x / GRID - 0.9f;
+			vertices[i][0][1] = 1.8f * y / GRID - 0.9f;
+			vertices[i][0][2] = 0.0f;
+			vertices[i][0][3] = 1.0f;
+			vertices[i][1][0] = (float)x / GRID;
+			vertices[i][1][1] = (float)y / GRID;
+			vertices[i][1][2] = 0.5f;
+			vertices[i][1][3] = 1.0f;
+		}
+	}
+
+	for (y = 0, i = 0; y < GRID; y++) {
+		for (x = 0; x < GRID; x++) {
+			unsigned v = y * (GRID + 1) + x;
+
+			p->indices[i++] = v;
+			p->indices[i++] = v + 1;
+			p->indices[i++] = v + GRID + 1;
+			p->indices[i++] = v + 1;
+			p->indices[i++] = v + GRID + 2;
+			p->indices[i++] = v + GRID + 1;
+		}
+	}
+	p->num_indices = i;
+
+	memset(&p->vbuf, 0, sizeof(p->vbuf));
+	p->vbuf.stride = sizeof(vertices[0]);
+	p->vbuf.buffer.resource =
+		pipe_buffer_create(p->screen, PIPE_BIND_VERTEX_BUFFER,
+				   PIPE_USAGE_DEFAULT,
+				   (GRID + 1) * (GRID + 1) * sizeof(*vertices));
+	pipe_buffer_write(p->pipe, p->vbuf.buffer.resource, 0,
+			  (GRID + 1) * (GRID + 1) * sizeof(*vertices), vertices);
+
+	FREE(vertices);
+}
+
+static void init_prog(struct program *p)
+{
+	struct pipe_surface surf_tmpl;
+
+	/* create the pipe driver context and cso context; the draw module of
+	 * the context picks DRAW_NUM_THREADS up
+	 */
+	p->pipe = p->screen->context_create(p->screen, NULL, 0);
+	p->cso = cso_create_context(p->pipe, 0);
+
+	init_mesh(p);
+
+	/* render target texture */
+	{
+		struct pipe_resource tmplt;
+		memset(&tmplt, 0, sizeof(tmplt));
+		tmplt.target = PIPE_TEXTURE_2D;
+		tmplt.format = PIPE_FORMAT_B8G8R8A8_UNORM; /* All drivers support this */
+		tmplt.width0 = WIDTH;
+		tmplt.height0 = HEIGHT;
+		tmplt.depth0 = 1;
+		tmplt.array_size = 1;
+		tmplt.last_level = 0;
+		tmplt.bind = PIPE_BIND_RENDER_TARGET;
+
+		p->target = p->screen->resource_create(p->screen, &tmplt);
+	}
+
+	/* disabled blending/masking */
+	memset(&p->blend, 0, sizeof(p->blend));
+	p->blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+	/* no-op depth/stencil/alpha */
+	memset(&p->depthstencil, 0, sizeof(p->depthstencil));
+
+	/* rasterizer */
+	memset(&p->rasterizer, 0, sizeof(p->rasterizer));
+	p->rasterizer.cull_face = PIPE_FACE_NONE;
+	p->rasterizer.half_pixel_center = 1;
+	p->rasterizer.bottom_edge_rule = 1;
+	p->rasterizer.depth_clip_near = 1;
+	p->rasterizer.depth_clip_far = 1;
+
+	surf_tmpl.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+	surf_tmpl.u.tex.level = 0;
+	surf_tmpl.u.tex.first_layer = 0;
+	surf_tmpl.u.tex.last_layer = 0;
+	/* drawing destination */
+	memset(&p->framebuffer, 0, sizeof(p->framebuffer));
+	p->framebuffer.width = WIDTH;
+	p->framebuffer.height = HEIGHT;
+	p->framebuffer.nr_cbufs = 1;
+	p->framebuffer.cbufs[0] = p->pipe->create_surface(p->pipe, p->target, &surf_tmpl);
+
+	/* viewport */
+	p->viewport.scale[0] = WIDTH / 2.0f;
+	p->viewport.scale[1] = HEIGHT / 2.0f;
+	p->viewport.scale[2] = 0.5f;
+	p->viewport.translate[0] = WIDTH / 2.0f;
+	p->viewport.translate[1] = HEIGHT / 2.0f;
+	p->viewport.translate[2] = 0.5f;
+
+	/* vertex elements state */
+	memset(p->velem, 0, sizeof(p->velem));
+	p->velem[0].src_offset = 0 * 4 * sizeof(float); /* offset 0, first element */
+	p->velem[0].instance_divisor = 0;
+	p->velem[0].vertex_buffer_index = 0;
+	p->velem[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	p->velem[1].src_offset = 1 * 4 * sizeof(float); /* offset 16, second element */
+	p->velem[1].instance_divisor = 0;
+	p->velem[1].vertex_buffer_index = 0;
+	p->velem[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+
+	/* vertex shader */
+	{
+		const enum tgsi_semantic semantic_names[] =
+			{ TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR };
+		const uint semantic_indexes[] = { 0, 0 };
+		p->vs = util_make_vertex_passthrough_shader(p->pipe, 2, semantic_names, semantic_indexes, FALSE);
+	}
+
+	/* fragment shader */
+	p->fs = util_make_fragment_passthrough_shader(p->pipe,
+                    TGSI_SEMANTIC_COLOR, TGSI_INTERPOLATE_PERSPECTIVE, TRUE);
+}
+
+static void close_prog(struct program *p)
+{
+	cso_destroy_context(p->cso);
+
+	p->pipe->delete_vs_state(p->pipe, p->vs);
+	p->pipe->delete_fs_state(p->pipe, p->fs);
+
+	pipe_surface_reference(&p->framebuffer.cbufs[0], NULL);
+	pipe_resource_reference(&p->target, NULL);
+	pipe_resource_reference(&p->vbuf.buffer.resource, NULL);
+	FREE(p->indices);
+
+	p->pipe->destroy(p->pipe);
+}
+
+static void draw(struct program *p)
+{
+	/* set the render target */
+	cso_set_framebuffer(p->cso, &p->framebuffer);
+
+	/* set misc state we care about */
+	cso_set_blend(p->cso, &p->blend);
+	cso_set_depth_stencil_alpha(p->cso, &p->depthstencil);
+	cso_set_rasterizer(p->cso, &p->rasterizer);
+	cso_set_viewport(p->cso, &p->viewport);
+
+	/* shaders */
+	cso_set_fragment_shader_handle(p->cso, p->fs);
+	cso_set_vertex_shader_handle(p->cso, p->vs);
+
+	/* vertex data */
+	cso_set_vertex_elements(p->cso, 2, p->velem);
+	cso_set_vertex_buffers(p->cso, 0, 1, &p->vbuf);
+
+	util_draw_elements(p->pipe, p->indices, sizeof(unsigned), 0,
+	                   PIPE_PRIM_TRIANGLES, 0, p->num_indices);
+}
+
+/* Returns the triangles drawn per second with the given number of draw
+ * threads.
+ */
+static double bench(struct program *p, unsigned num_threads)
+{
+	struct pipe_fence_handle *fence = NULL;
+	char value[16];
+	int64_t start, time;
+	unsigned i;
+
+	snprintf(value, sizeof(value), "%u", num_threads);
+	setenv("DRAW_NUM_THREADS", value, 1);
+	init_prog(p);
+
+	/* warm up, compiling the shader variants */
+	draw(p);
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+
+	start = os_time_get_nano();
+	for (i = 0; i < FRAMES; i++)
+		draw(p);
+	p->pipe->flush(p->pipe, &fence, 0);
+	p->screen->fence_finish(p->screen, NULL, fence, PIPE_TIMEOUT_INFINITE);
+	p->screen->fence_reference(p->screen, &fence, NULL);
+	time = os_time_get_nano() - start;
+
+	close_prog(p);
+
+	return FRAMES * (p->num_indices / 3) * 1e9 / time;
+}
+
+int main(int argc, char** argv)
+{
+	struct program *p = CALLOC_STRUCT(program);
+	unsigned max_threads = argc > 1 ? atoi(argv[1]) : 8;
+	unsigned num_threads;
+	double base = 0.0;
+	int ret;
+
+	/* the draw module only matters to the software drivers */
+	ret = pipe_loader_sw_probe(&p->dev, 1);
+	assert(ret);
+
+	p->screen = pipe_loader_create_screen(p->dev);
+	assert(p->screen);
+
+	printf("%u triangles per frame\n", GRID * GRID * 2);
+
+	for (num_threads = 0; num_threads <= max_threads;
+	     num_threads = num_threads ? num_threads * 2 : 1) {
+		double rate = bench(p, num_threads);
+
+		if (!num_threads)
+			base = rate;
+		printf("%2u draw threads: %8.2f Mtri/s  (%.2fx)\n",
+		       num_threads, rate / 1e6, rate / base);
+	}
+
+	p->screen->destroy(p->screen);
+	pipe_loader_release(&p->dev, 1);
+	FREE(p);
+
+	return 0;
+}
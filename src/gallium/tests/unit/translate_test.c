@@ -61,6 +61,9 @@ int main(int argc, char** argv)
    uint16_t *half_buffer;
    unsigned * elts;
    unsigned count = 4;
+   unsigned char* batch_buffer[2];
+   unsigned * batch_elts;
+   unsigned batch_count = 100;
    unsigned i, j, k;
    unsigned passed = 0;
    unsigned total = 0;
@@ -144,6 +147,10 @@ int main(int argc, char** argv)
 
    elts = align_malloc(count * sizeof *elts, 4096);
 
+   for (i = 0; i < ARRAY_SIZE(batch_buffer); ++i)
+      batch_buffer[i] = align_malloc(buffer_size, 4096);
+   batch_elts = align_malloc(batch_count * sizeof *batch_elts, 4096);
+
    key.nr_elements = 1;
    key.element[0].input_buffer = 0;
    key.element[0].input_offset = 0;
@@ -169,6 +176,9 @@ int main(int argc, char** argv)
    for (i = 0; i < count; ++i)
       elts[i] = i;
 
+   for (i = 0; i < batch_count; ++i)
+      batch_elts[i] = batch_count - 1 - i;
+
    for (output_format = 1; output_format < PIPE_FORMAT_COUNT; ++output_format)
    {
       const struct util_format_description* output_format_desc = util_format_description(output_format);
@@ -196,7 +206,9 @@ int main(int argc, char** argv)
          const struct util_format_description* input_format_desc = util_format_description(input_format);
          unsigned input_format_size;
          struct translate* translate[2];
+         struct translate* translate_ref;
          unsigned fail = 0;
+         unsigned batch_fail = 0;
          unsigned used_generic = 0;
          unsigned input_normalized = 0;
          boolean input_is_float = FALSE;
@@ -234,6 +246,21 @@ int main(int argc, char** argv)
          if (!translate[0])
             continue;
 
+         /* The vertices translated one at a time are the reference for the
+          * batched ones, so they are translated without the AVX2 fetch.
+          */
+         {
+            int has_avx2 = util_cpu_caps.has_avx2;
+            util_cpu_caps.has_avx2 = 0;
+            translate_ref = create_fn(&key);
+            util_cpu_caps.has_avx2 = has_avx2;
+            if (!translate_ref)
+            {
+               translate[0]->release(translate[0]);
+               continue;
+            }
+         }
+
          key.element[0].input_format = output_format;
          key.element[0].output_format = input_format;
          key.output_stride = input_format_size;
@@ -243,7 +270,11 @@ int main(int argc, char** argv)
             used_generic = 1;
             translate[1] = translate_generic_create(&key);
             if(!translate[1])
+            {
+               translate_ref->release(translate_ref);
+               translate[0]->release(translate[0]);
                continue;
+            }
          }
 
          for(i = 1; i < 5; ++i)
@@ -287,8 +318,42 @@ int main(int argc, char** argv)
             }
          }
 
+         /* Translating many vertices at once must give the same result as
+          * translating them one at a time, whether they are tightly packed
+          * or not, and when their indices get clamped.
+          */
+         for (k = 0; k < 2; ++k)
+         {
+            unsigned input_stride = input_format_size + k * 4;
+            unsigned max_index = batch_count - 1 - k * 10;
+            unsigned batch_size = batch_count * output_format_size;
+
+            translate_ref->set_buffer(translate_ref, 0, buffer[0], input_stride, max_index);
+            for (i = 0; i < batch_count; ++i)
+               translate_ref->run_elts(translate_ref, &batch_elts[i], 1, 0, 0,
+                                       batch_buffer[0] + i * output_format_size);
+
+            translate[0]->set_buffer(translate[0], 0, buffer[0], input_stride, max_index);
+
+            translate[0]->run_elts(translate[0], batch_elts, batch_count, 0, 0, batch_buffer[1]);
+            if (memcmp(batch_buffer[0], batch_buffer[1], batch_size))
+               batch_fail = 1;
+
+            /* The same vertices in the opposite order.  Linear runs don't
+             * have to clamp the indices, so only the vertices up to
+             * max_index are compared.
+             */
+            for (i = 0; i < batch_count; ++i)
+               memcpy(batch_buffer[1] + i * output_format_size,
+                      batch_buffer[0] + (batch_count - 1 - i) * output_format_size,
+                      output_format_size);
+            translate[0]->run(translate[0], 0, batch_count, 0, 0, batch_buffer[0]);
+            if (memcmp(batch_buffer[0], batch_buffer[1], (max_index + 1) * output_format_size))
+               batch_fail = 1;
+         }
+
          printf("%s%s: %s -> %s -> %s -> %s -> %s\n",
-               fail ? "FAIL" : "PASS",
+               fail ? "FAIL" : batch_fail ? "FAIL[BATCH]" : "PASS",
                used_generic ? "[GENERIC]" : "",
                input_format_desc->name, output_format_desc->name, input_format_desc->name, output_format_desc->name, input_format_desc->name);
 
@@ -310,12 +375,13 @@ int main(int argc, char** argv)
             }
          }
 
-         if (!fail)
+         if (!fail && !batch_fail)
             ++passed;
          ++total;
 
          if(translate[1])
             translate[1]->release(translate[1]);
+         translate_ref->release(translate_ref);
          translate[0]->release(translate[0]);
       }
    }
@@ -0,0 +1,221 @@
+/**************************************************************************
+ *
+ * Copyright 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE COPYRIGHT OWNER(S) AND/OR ITS SUPPLIERS BE
+ * LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+ * OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+
+/*
+ * Measure the throughput of the row conversions of the formats, with and
+ * without the SIMD code paths of the generated functions.
+ *
+ * Usage: u_format_bench [format_name ...]
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/u_format.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "util/os_time.h"
+
+
+#define WIDTH 1024
+#define HEIGHT 256
+#define ITERATIONS 8
+
+
+static const enum pipe_format default_formats[] = {
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_B8G8R8X8_UNORM,
+   PIPE_FORMAT_R16G16B16A16_UNORM,
+   PIPE_FORMAT_R32G32B32A32_FLOAT,
+   PIPE_FORMAT_B5G6R5_UNORM,
+};
+
+
+enum bench_func {
+   UNPACK_RGBA_FLOAT,
+   PACK_RGBA_FLOAT,
+   UNPACK_RGBA_8UNORM,
+   PACK_RGBA_8UNORM,
+   NUM_BENCH_FUNCS
+};
+
+static const char *bench_func_names[NUM_BENCH_FUNCS] = {
+   "unpack_rgba_float",
+   "pack_rgba_float",
+   "unpack_rgba_8unorm",
+   "pack_rgba_8unorm",
+};
+
+
+/**
+ * Return the number of pixels converted per second.
+ */
+static double
+bench_one(const struct util_format_description *format_desc,
+          enum bench_func func,
+          uint8_t *packed, unsigned packed_stride,
+          float *rgba_float, uint8_t *rgba_8unorm)
+{
+   int64_t start, end;
+   unsigned i;
+
+   start = os_time_get_nano();
+
+   for (i = 0; i < ITERATIONS; ++i) {
+      switch (func) {
+      case UNPACK_RGBA_FLOAT:
+         format_desc->unpack_rgba_float(rgba_float, WIDTH * 4 * sizeof(float),
+                                        packed, packed_stride,
+                                        WIDTH, HEIGHT);
+         break;
+      case PACK_RGBA_FLOAT:
+         format_desc->pack_rgba_float(packed, packed_stride,
+                                      rgba_float, WIDTH * 4 * sizeof(float),
+                                      WIDTH, HEIGHT);
+         break;
+      case UNPACK_RGBA_8UNORM:
+         format_desc->unpack_rgba_8unorm(rgba_8unorm, WIDTH * 4,
+                                         packed, packed_stride,
+                                         WIDTH, HEIGHT);
+         break;
+      case PACK_RGBA_8UNORM:
+         format_desc->pack_rgba_8unorm(packed, packed_stride,
+                                       rgba_8unorm, WIDTH * 4,
+                                       WIDTH, HEIGHT);
+         break;
+      default:
+         assert(0);
+      }
+   }
+
+   end = os_time_get_nano();
+
+   return (double)WIDTH * HEIGHT * ITERATIONS * 1e9 / (double)MAX2(end - start, 1);
+}
+
+
+static void
+bench_format(const struct util_format_description *format_desc,
+             uint8_t *packed, float *rgba_float, uint8_t *rgba_8unorm)
+{
+   const unsigned packed_stride = WIDTH * format_desc->block.bits / 8;
+   unsigned func, i;
+
+   if (!format_desc->unpack_rgba_float || !format_desc->pack_rgba_float ||
+       !format_desc->unpack_rgba_8unorm || !format_desc->pack_rgba_8unorm)
+      return;
+
+   for (i = 0; i < WIDTH * HEIGHT * 4; ++i) {
+      rgba_float[i] = (float)(i % 251) / 250.0f;
+      rgba_8unorm[i] = (uint8_t)(i * 7);
+   }
+   format_desc->pack_rgba_float(packed, packed_stride,
+                                rgba_float, WIDTH * 4 * sizeof(float),
+                                WIDTH, HEIGHT);
+
+   for (func = 0; func < NUM_BENCH_FUNCS; ++func) {
+      struct util_cpu_caps caps = util_cpu_caps;
+      double scalar, simd;
+
+      util_cpu_caps.has_sse2 = FALSE;
+      util_cpu_caps.has_avx2 = FALSE;
+      util_cpu_caps.has_neon = FALSE;
+      scalar = bench_one(format_desc, func, packed, packed_stride,
+                         rgba_float, rgba_8unorm);
+      util_cpu_caps = caps;
+      simd = bench_one(format_desc, func, packed, packed_stride,
+                       rgba_float, rgba_8unorm);
+
+      printf("%-24s %-20s %8.1f Mpix/s %8.1f Mpix/s %5.2fx\n",
+             format_desc->short_name, bench_func_names[func],
+             scalar * 1e-6, simd * 1e-6, simd / scalar);
+   }
+}
+
+
+int main(int argc, char **argv)
+{
+   uint8_t *packed;
+   float *rgba_float;
+   uint8_t *rgba_8unorm;
+   int i;
+
+   util_cpu_detect();
+
+   /* Large enough for R64G64B64A64_FLOAT */
+   packed = MALLOC(WIDTH * HEIGHT * 32);
+   rgba_float = MALLOC(WIDTH * HEIGHT * 4 * sizeof(float));
+   rgba_8unorm = MALLOC(WIDTH * HEIGHT * 4);
+   if (!packed || !rgba_float || !rgba_8unorm)
+      return 1;
+
+   printf("%-24s %-20s %15s %15s %6s\n",
+          "format", "function", "scalar", "simd", "");
+
+   if (argc > 1) {
+      for (i = 1; i < argc; ++i) {
+         enum pipe_format format;
+
+         for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+            const struct util_format_description *format_desc =
+               util_format_description(format);
+
+            if (format_desc &&
+                (!strcmp(argv[i], format_desc->name) ||
+                 !strcmp(argv[i], format_desc->short_name)))
+               break;
+         }
+         if (format == PIPE_FORMAT_COUNT) {
+            fprintf(stderr, "unknown format %s\n", argv[i]);
+            continue;
+         }
+         if (util_format_description(format)->layout !=
+             UTIL_FORMAT_LAYOUT_PLAIN) {
+            fprintf(stderr, "format %s is not a plain one\n", argv[i]);
+            continue;
+         }
+
+         bench_format(util_format_description(format),
+                      packed, rgba_float, rgba_8unorm);
+      }
+   }
+   else {
+      for (i = 0; i < ARRAY_SIZE(default_formats); ++i) {
+         bench_format(util_format_description(default_formats[i]),
+                      packed, rgba_float, rgba_8unorm);
+      }
+   }
+
+   FREE(packed);
+   FREE(rgba_float);
+   FREE(rgba_8unorm);
+
+   return 0;
+}
@@ -34,6 +34,7 @@
 #include "util/u_format.h"
 #include "util/u_format_tests.h"
 #include "util/u_format_s3tc.h"
+#include "util/u_cpu_detect.h"
 
 
 static boolean
@@ -668,6 +669,134 @@ test_format_pack_s_8uint(const struct util_format_description *format_desc,
 }
 
 
+/*
+ * Number of pixels in the rows converted at once, enough to go through the
+ * eight pixel AVX2 and NEON loops of the generated code, then the four pixel
+ * SSE2 one and the remainder.
+ */
+#define ROW_WIDTH 23
+
+
+static boolean
+is_row_format(const struct util_format_description *format_desc)
+{
+   return format_desc->layout == UTIL_FORMAT_LAYOUT_PLAIN &&
+          format_desc->block.width == 1 &&
+          format_desc->block.height == 1;
+}
+
+
+/*
+ * Check that the conversion of a row of pixels gives the same results as the
+ * conversion of a single one.
+ */
+static boolean
+test_format_row_rgba_float(const struct util_format_description *format_desc,
+                           const struct util_format_test_case *test)
+{
+   const unsigned bytes = format_desc->block.bits/8;
+   uint8_t packed[ROW_WIDTH][UTIL_FORMAT_MAX_PACKED_BYTES];
+   float unpacked[ROW_WIDTH][4];
+   uint8_t row_packed[ROW_WIDTH * UTIL_FORMAT_MAX_PACKED_BYTES];
+   float row_unpacked[ROW_WIDTH][4];
+   unsigned i, j, k;
+   boolean success = TRUE;
+
+   if (!is_row_format(format_desc))
+      return TRUE;
+
+   for (j = 0; j < ROW_WIDTH; ++j) {
+      memcpy(&row_packed[j * bytes], test->packed, bytes);
+      for (k = 0; k < 4; ++k)
+         row_unpacked[j][k] = (float) test->unpacked[0][0][k];
+   }
+
+   format_desc->unpack_rgba_float(&unpacked[0][0], 0, test->packed, 0, 1, 1);
+   format_desc->unpack_rgba_float(&row_unpacked[0][0], 0, row_packed, 0,
+                                  ROW_WIDTH, 1);
+   for (j = 0; j < ROW_WIDTH; ++j) {
+      if (memcmp(row_unpacked[j], unpacked[0], sizeof unpacked[0]))
+         success = FALSE;
+   }
+
+   for (j = 0; j < ROW_WIDTH; ++j) {
+      for (k = 0; k < 4; ++k)
+         unpacked[j][k] = (float) test->unpacked[0][0][k];
+   }
+
+   memset(packed, 0, sizeof packed);
+   memset(row_packed, 0, sizeof row_packed);
+   format_desc->pack_rgba_float(packed[0], 0, unpacked[0], 0, 1, 1);
+   format_desc->pack_rgba_float(row_packed, 0, unpacked[0], 0, ROW_WIDTH, 1);
+   for (j = 0; j < ROW_WIDTH; ++j) {
+      for (i = 0; i < bytes; ++i) {
+         if ((row_packed[j * bytes + i] & test->mask[i]) !=
+             (packed[0][i] & test->mask[i]))
+            success = FALSE;
+      }
+   }
+
+   if (!success) {
+      print_packed(format_desc, "FAILED: row conversion of ", test->packed,
+                   " differs\n");
+   }
+
+   return success;
+}
+
+
+static boolean
+test_format_row_rgba_8unorm(const struct util_format_description *format_desc,
+                            const struct util_format_test_case *test)
+{
+   const unsigned bytes = format_desc->block.bits/8;
+   uint8_t packed[UTIL_FORMAT_MAX_PACKED_BYTES];
+   uint8_t unpacked[4];
+   uint8_t row_packed[ROW_WIDTH * UTIL_FORMAT_MAX_PACKED_BYTES];
+   uint8_t row_unpacked[ROW_WIDTH][4];
+   unsigned i, j;
+   boolean success = TRUE;
+
+   if (!is_row_format(format_desc))
+      return TRUE;
+
+   for (j = 0; j < ROW_WIDTH; ++j)
+      memcpy(&row_packed[j * bytes], test->packed, bytes);
+
+   format_desc->unpack_rgba_8unorm(unpacked, 0, test->packed, 0, 1, 1);
+   format_desc->unpack_rgba_8unorm(&row_unpacked[0][0], 0, row_packed, 0,
+                                   ROW_WIDTH, 1);
+   for (j = 0; j < ROW_WIDTH; ++j) {
+      if (memcmp(row_unpacked[j], unpacked, sizeof unpacked))
+         success = FALSE;
+   }
+
+   /* Pack what was unpacked, as the test value may not be a unorm8 one. */
+   for (j = 0; j < ROW_WIDTH; ++j)
+      memcpy(row_unpacked[j], unpacked, sizeof unpacked);
+
+   memset(packed, 0, sizeof packed);
+   memset(row_packed, 0, sizeof row_packed);
+   format_desc->pack_rgba_8unorm(packed, 0, unpacked, 0, 1, 1);
+   format_desc->pack_rgba_8unorm(row_packed, 0, &row_unpacked[0][0], 0,
+                                 ROW_WIDTH, 1);
+   for (j = 0; j < ROW_WIDTH; ++j) {
+      for (i = 0; i < bytes; ++i) {
+         if ((row_packed[j * bytes + i] & test->mask[i]) !=
+             (packed[i] & test->mask[i]))
+            success = FALSE;
+      }
+   }
+
+   if (!success) {
+      print_packed(format_desc, "FAILED: row conversion of ", test->packed,
+                   " differs\n");
+   }
+
+   return success;
+}
+
+
 typedef boolean
 (*test_func_t)(const struct util_format_description *format_desc,
                const struct util_format_test_case *test);
@@ -730,6 +859,19 @@ test_all(void)
       TEST_ONE_FUNC(pack_rgba_8unorm);
       TEST_ONE_FUNC(unpack_rgba_8unorm);
 
+      if (format_desc->unpack_rgba_float && format_desc->pack_rgba_float) {
+         if (!test_one_func(format_desc, &test_format_row_rgba_float,
+                            "row_rgba_float")) {
+           success = FALSE;
+         }
+      }
+      if (format_desc->unpack_rgba_8unorm && format_desc->pack_rgba_8unorm) {
+         if (!test_one_func(format_desc, &test_format_row_rgba_8unorm,
+                            "row_rgba_8unorm")) {
+           success = FALSE;
+         }
+      }
+
       TEST_ONE_FUNC(unpack_z_32unorm);
       TEST_ONE_FUNC(pack_z_32unorm);
       TEST_ONE_FUNC(unpack_z_float);
@@ -744,11 +886,131 @@ test_all(void)
 }
 
 
+/*
+ * The direct conversion must give the same channel values as the conversion
+ * through rgba_float.
+ */
+static boolean
+compare_convert(float expected, float obtained)
+{
+   if (util_is_inf_or_nan(expected) || util_is_inf_or_nan(obtained))
+      return memcmp(&expected, &obtained, sizeof expected) == 0;
+
+   return expected == obtained;
+}
+
+
+static boolean
+test_format_convert_pixel(const struct util_format_description *src_desc,
+                          const struct util_format_description *dst_desc,
+                          util_format_convert_func convert,
+                          const uint8_t *src_packed)
+{
+   uint8_t packed[UTIL_FORMAT_MAX_PACKED_BYTES];
+   uint8_t expected_packed[UTIL_FORMAT_MAX_PACKED_BYTES];
+   float rgba[4], expected[4], obtained[4];
+   unsigned k;
+   boolean success = TRUE;
+
+   src_desc->fetch_rgba_float(rgba, src_packed, 0, 0);
+   memset(expected_packed, 0, sizeof expected_packed);
+   dst_desc->pack_rgba_float(expected_packed, 0, rgba, 0, 1, 1);
+   dst_desc->fetch_rgba_float(expected, expected_packed, 0, 0);
+
+   memset(packed, 0, sizeof packed);
+   convert(packed, 0, src_packed, 0, 1, 1);
+   dst_desc->fetch_rgba_float(obtained, packed, 0, 0);
+
+   for (k = 0; k < 4; ++k) {
+      if (!compare_convert(expected[k], obtained[k]))
+         success = FALSE;
+   }
+
+   if (!success) {
+      print_packed(src_desc, "FAILED: ", src_packed, " converted to ");
+      print_packed(dst_desc, "", packed, " obtained\n");
+      print_packed(dst_desc, "        ", expected_packed, " expected\n");
+   }
+
+   return success;
+}
+
+
+static boolean
+test_format_convert(const struct util_format_description *src_desc,
+                    const struct util_format_description *dst_desc,
+                    util_format_convert_func convert)
+{
+   /* Values in between the ones of the test cases, which are mostly 0 and 1 */
+   static const float values[][4] = {
+      {0.25f, 0.5f, 0.75f, 0.125f},
+      {0.1f, 0.2f, 0.3f, 0.4f},
+      {0.6f, 0.7f, 0.8f, 0.9f},
+      {0.01f, 0.99f, 0.001f, 0.5f},
+   };
+   unsigned i;
+   boolean success = TRUE;
+
+   printf("Testing util_format_%s_from_%s ...\n",
+          dst_desc->short_name, src_desc->short_name);
+   fflush(stdout);
+
+   for (i = 0; i < util_format_nr_test_cases; ++i) {
+      const struct util_format_test_case *test = &util_format_test_cases[i];
+
+      if (test->format == src_desc->format &&
+          !test_format_convert_pixel(src_desc, dst_desc, convert,
+                                     test->packed)) {
+         success = FALSE;
+      }
+   }
+
+   for (i = 0; i < ARRAY_SIZE(values); ++i) {
+      uint8_t packed[UTIL_FORMAT_MAX_PACKED_BYTES];
+
+      memset(packed, 0, sizeof packed);
+      src_desc->pack_rgba_float(packed, 0, values[i], 0, 1, 1);
+      if (!test_format_convert_pixel(src_desc, dst_desc, convert, packed))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+static boolean
+test_all_converts(void)
+{
+   enum pipe_format src_format, dst_format;
+   boolean success = TRUE;
+
+   for (src_format = 1; src_format < PIPE_FORMAT_COUNT; ++src_format) {
+      for (dst_format = 1; dst_format < PIPE_FORMAT_COUNT; ++dst_format) {
+         util_format_convert_func convert =
+            util_format_get_convert_func(dst_format, src_format);
+
+         if (convert &&
+             !test_format_convert(util_format_description(src_format),
+                                  util_format_description(dst_format),
+                                  convert)) {
+            success = FALSE;
+         }
+      }
+   }
+
+   return success;
+}
+
+
 int main(int argc, char **argv)
 {
    boolean success;
 
+   util_cpu_detect();
+
    success = test_all();
+   if (!test_all_converts())
+      success = FALSE;
 
    return success ? 0 : 1;
 }
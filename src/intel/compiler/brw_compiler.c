@@ -28,6 +28,7 @@
 #include "compiler/nir/nir.h"
 #include "main/errors.h"
 #include "util/debug.h"
+#include "util/u_queue.h"
 
 #define COMMON_OPTIONS                                                        \
    .lower_sub = true,                                                         \
@@ -111,6 +112,53 @@ static const struct nir_shader_compiler_options vector_nir_options_gen6 = {
    .max_unroll_iterations = 32,
 };
 
+struct brw_compile_queue {
+   mtx_t mutex;
+   unsigned num_threads;
+
+   /** Whether the threads were started, or failed to. */
+   bool started;
+   bool failed;
+
+   struct util_queue queue;
+};
+
+static void
+brw_compiler_destroy(void *ptr)
+{
+   struct brw_compiler *compiler = ptr;
+   struct brw_compile_queue *compile_queue = compiler->compile_queue;
+
+   if (compile_queue->started)
+      util_queue_destroy(&compile_queue->queue);
+   mtx_destroy(&compile_queue->mutex);
+   free(compile_queue);
+}
+
+struct util_queue *
+brw_get_compile_queue(const struct brw_compiler *compiler)
+{
+   struct brw_compile_queue *compile_queue = compiler->compile_queue;
+
+   if (!compile_queue)
+      return NULL;
+
+   /* Several contexts may compile with the same compiler at once. */
+   mtx_lock(&compile_queue->mutex);
+   if (!compile_queue->started && !compile_queue->failed) {
+      compile_queue->started =
+         util_queue_init(&compile_queue->queue, "brw_compile", 16,
+                         compile_queue->num_threads,
+                         UTIL_QUEUE_INIT_RESIZE_IF_FULL);
+      compile_queue->failed = !compile_queue->started;
+   }
+   struct util_queue *queue =
+      compile_queue->started ? &compile_queue->queue : NULL;
+   mtx_unlock(&compile_queue->mutex);
+
+   return queue;
+}
+
 struct brw_compiler *
 brw_compiler_create(void *mem_ctx, const struct gen_device_info *devinfo)
 {
@@ -124,6 +172,24 @@ brw_compiler_create(void *mem_ctx, const struct gen_device_info *devinfo)
 
    compiler->precise_trig = env_var_as_boolean("INTEL_PRECISE_TRIG", false);
 
+   /* The SIMD8 variant is compiled by the caller, so two threads are enough
+    * for the SIMD16 and SIMD32 ones.
+    */
+   const char *compile_threads_str = getenv("INTEL_COMPILE_THREADS");
+   unsigned compile_threads =
+      compile_threads_str ? strtoul(compile_threads_str, NULL, 0) : 2;
+   if (compile_threads > 0) {
+      /* The queue isn't allocated from the compiler because the children of
+       * a ralloc context are freed before its destructor runs.
+       */
+      compiler->compile_queue = calloc(1, sizeof(struct brw_compile_queue));
+      if (compiler->compile_queue) {
+         mtx_init(&compiler->compile_queue->mutex, mtx_plain);
+         compiler->compile_queue->num_threads = compile_threads;
+         ralloc_set_destructor(compiler, brw_compiler_destroy);
+      }
+   }
+
    if (devinfo->gen >= 10) {
       /* We don't support vec4 mode on Cannonlake. */
       for (int i = MESA_SHADER_VERTEX; i < MESA_SHADER_STAGES; i++)
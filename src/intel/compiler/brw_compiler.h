@@ -35,6 +35,8 @@ extern "C" {
 #endif
 
 struct ra_regs;
+struct brw_compile_queue;
+struct util_queue;
 struct nir_shader;
 struct brw_program;
 
@@ -118,6 +120,15 @@ struct brw_compiler {
     * whether nir_opt_large_constants will be run.
     */
    bool supports_shader_constants;
+
+   /**
+    * Threads compiling the SIMD16 and SIMD32 variants of fragment and compute
+    * shaders while the SIMD8 one is compiled by the caller, or NULL to
+    * compile them one after the other.  Set INTEL_COMPILE_THREADS=0 to
+    * disable them.  The threads are only started by the first compile which
+    * has variants to give them, see brw_get_compile_queue().
+    */
+   struct brw_compile_queue *compile_queue;
 };
 
 /**
@@ -1210,6 +1221,13 @@ DEFINE_PROG_DATA_DOWNCAST(sf)
 struct brw_compiler *
 brw_compiler_create(void *mem_ctx, const struct gen_device_info *devinfo);
 
+/**
+ * Returns the queue of the compile threads, starting them on the first call,
+ * or NULL if the compiler has none or they can't be started.
+ */
+struct util_queue *
+brw_get_compile_queue(const struct brw_compiler *compiler);
+
 /**
  * Returns a compiler configuration for use with disk shader cache
  *
@@ -39,7 +39,9 @@
 #include "compiler/glsl_types.h"
 #include "compiler/nir/nir_builder.h"
 #include "program/prog_parameter.h"
+#include "util/u_dynarray.h"
 #include "util/u_math.h"
+#include "util/u_queue.h"
 
 using namespace brw;
 
@@ -646,6 +648,23 @@ fs_visitor::fail(const char *format, ...)
    va_end(va);
 }
 
+void
+fs_visitor::perf_log(const char *format, ...)
+{
+   va_list va;
+
+   va_start(va, format);
+   char *msg = ralloc_vasprintf(mem_ctx, format, va);
+   va_end(va);
+
+   if (deferred_perf_log) {
+      util_dynarray_append(deferred_perf_log, char *, msg);
+   } else {
+      compiler->shader_perf_log(log_data, "%s", msg);
+      ralloc_free(msg);
+   }
+}
+
 /**
  * Mark this program as impossible to compile with dispatch width greater
  * than n.
@@ -664,9 +683,7 @@ fs_visitor::limit_dispatch_width(unsigned n, const char *msg)
       fail("%s", msg);
    } else {
       max_dispatch_width = n;
-      compiler->shader_perf_log(log_data,
-                                "Shader dispatch width limited to SIMD%d: %s",
-                                n, msg);
+      perf_log("Shader dispatch width limited to SIMD%d: %s", n, msg);
    }
 }
 
@@ -6255,6 +6272,10 @@ fs_visitor::optimize()
    assign_constant_locations();
    lower_constant_loads();
 
+   /* The wider variants waiting for our uniform layout can go on now. */
+   if (uniforms_ready)
+      util_queue_fence_signal(uniforms_ready);
+
    validate();
 
    split_virtual_grfs();
@@ -6422,12 +6443,23 @@ fs_visitor::allocate_registers(unsigned min_dispatch_width, bool allow_spilling)
 
    bool spill_all = allow_spilling && (INTEL_DEBUG & DEBUG_SPILL_FS);
 
+   /* The dependency DAG of the scheduler doesn't depend on the heuristic, so
+    * it is built once for all of them, unless a failed allocation spilled
+    * registers.  Each heuristic schedules the instructions from the order
+    * the DAG was built from.
+    */
+   void *scheduler_ctx = ralloc_context(NULL);
+   instruction_scheduler *sched = NULL;
+
    /* Try each scheduling heuristic to see if it can successfully register
     * allocate without spilling.  They should be ordered by decreasing
     * performance but increasing likelihood of allocating.
     */
    for (unsigned i = 0; i < ARRAY_SIZE(pre_modes); i++) {
-      schedule_instructions(pre_modes[i]);
+      if (!sched)
+         sched = prepare_scheduler(scheduler_ctx);
+
+      schedule_instructions_pre_ra(sched, pre_modes[i]);
 
       if (0) {
          assign_regs_trivial();
@@ -6437,8 +6469,15 @@ fs_visitor::allocate_registers(unsigned min_dispatch_width, bool allow_spilling)
       }
       if (allocated_without_spills)
          break;
+
+      if (spill_all) {
+         ralloc_free(sched);
+         sched = NULL;
+      }
    }
 
+   ralloc_free(scheduler_ctx);
+
    if (!allocated_without_spills) {
       if (!allow_spilling)
          fail("Failure to register allocate and spilling is not allowed.");
@@ -6451,11 +6490,10 @@ fs_visitor::allocate_registers(unsigned min_dispatch_width, bool allow_spilling)
          fail("Failure to register allocate.  Reduce number of "
               "live scalar values to avoid this.");
       } else {
-         compiler->shader_perf_log(log_data,
-                                   "%s shader triggered register spilling.  "
-                                   "Try reducing the number of live scalar "
-                                   "values to improve performance.\n",
-                                   stage_name);
+         perf_log("%s shader triggered register spilling.  "
+                  "Try reducing the number of live scalar "
+                  "values to improve performance.\n",
+                  stage_name);
       }
 
       /* Since we're out of heuristics, just go spill registers until we
@@ -7088,6 +7126,223 @@ brw_register_blocks(int reg_count)
    return ALIGN(reg_count, 16) / 16 - 1;
 }
 
+static nir_shader *
+compile_cs_to_nir(const struct brw_compiler *compiler,
+                  void *mem_ctx,
+                  const struct brw_cs_prog_key *key,
+                  const nir_shader *src_shader,
+                  unsigned dispatch_width)
+{
+   nir_shader *shader = nir_shader_clone(mem_ctx, src_shader);
+   shader = brw_nir_apply_sampler_key(shader, compiler, &key->tex, true);
+   brw_nir_lower_cs_intrinsics(shader, dispatch_width);
+   return brw_postprocess_nir(shader, compiler, true);
+}
+
+/**
+ * The compile of one SIMD variant of a fragment or compute shader.
+ *
+ * The narrowest variant decides on the uniform layout and is compiled on the
+ * calling thread, into the caller's memory context and prog_data.  When the
+ * compiler has compile threads, the wider variants are compiled in parallel
+ * on its threads, each into its own memory context and copy of the prog_data:
+ * they only wait for the uniform layout of the narrowest variant, which they
+ * import once it's final.  Otherwise they are compiled one after the other
+ * on the calling thread, exactly as if there were no jobs.
+ */
+struct simd_compile_job {
+   const struct brw_compiler *compiler;
+   void *log_data;
+   const void *key;
+   struct gl_program *prog;
+   const nir_shader *shader;
+   unsigned dispatch_width;
+   int shader_time_index;
+
+   /* Fragment shaders */
+   bool allow_spilling;
+   bool use_rep_send;
+
+   /* Compute shaders */
+   unsigned min_dispatch_width;
+
+   /** The job of the narrowest variant, or NULL if this is that one. */
+   struct simd_compile_job *first;
+
+   /** The compile threads, if the job runs on one of them, or NULL. */
+   struct util_queue *queue;
+
+   void *mem_ctx;
+   struct brw_stage_prog_data *prog_data;
+
+   fs_visitor *v;
+   bool compiled;
+
+   /**
+    * The perf log messages of a job run in parallel, which the log callback
+    * only gets from the calling thread once the job is finished.
+    */
+   struct util_dynarray perf_log;
+
+   /** Signalled once the uniform layout of the visitor is final. */
+   struct util_queue_fence uniforms_ready;
+   struct util_queue_fence fence;
+};
+
+static struct simd_compile_job *
+simd_compile_job_create(const struct brw_compiler *compiler, void *log_data,
+                        void *mem_ctx, const void *key,
+                        struct brw_stage_prog_data *prog_data,
+                        size_t prog_data_size, struct gl_program *prog,
+                        const nir_shader *shader, unsigned dispatch_width,
+                        int shader_time_index,
+                        struct simd_compile_job *first,
+                        bool allow_parallel)
+{
+   struct simd_compile_job *job = rzalloc(NULL, struct simd_compile_job);
+
+   job->compiler = compiler;
+   job->log_data = log_data;
+   job->key = key;
+   job->prog = prog;
+   job->shader = shader;
+   job->dispatch_width = dispatch_width;
+   job->shader_time_index = shader_time_index;
+   job->first = first;
+   if (first && allow_parallel)
+      job->queue = brw_get_compile_queue(compiler);
+
+   if (job->queue) {
+      /* Take the copy now, the narrowest variant is about to write to the
+       * prog_data of the caller.
+       */
+      job->mem_ctx = job;
+      job->prog_data = (struct brw_stage_prog_data *)
+         ralloc_size(job, prog_data_size);
+      memcpy(job->prog_data, prog_data, prog_data_size);
+      util_dynarray_init(&job->perf_log, job);
+   } else {
+      job->mem_ctx = mem_ctx;
+      job->prog_data = prog_data;
+   }
+
+   util_queue_fence_init(&job->uniforms_ready);
+   if (!first)
+      util_queue_fence_reset(&job->uniforms_ready);
+   util_queue_fence_init(&job->fence);
+
+   return job;
+}
+
+static void
+simd_compile_job_execute(void *data, int thread_index)
+{
+   struct simd_compile_job *job = (struct simd_compile_job *) data;
+   struct simd_compile_job *first = job->first;
+   const nir_shader *shader = job->shader;
+
+   /* The visitors only read the NIR, so all the fragment shader variants
+    * share it.
+    */
+   if (shader->info.stage == MESA_SHADER_COMPUTE) {
+      shader = compile_cs_to_nir(job->compiler, job->mem_ctx,
+                                 (const struct brw_cs_prog_key *) job->key,
+                                 shader, job->dispatch_width);
+   }
+
+   if (first) {
+      util_queue_fence_wait(&first->uniforms_ready);
+
+      /* The narrowest variant failed before deciding on the uniform layout,
+       * or found out that this variant is impossible.
+       */
+      if (!first->v->push_constant_loc ||
+          first->v->max_dispatch_width < job->dispatch_width)
+         return;
+
+      if (job->queue) {
+         const struct brw_stage_prog_data *first_prog_data =
+            first->prog_data;
+
+         job->prog_data->nr_params = first_prog_data->nr_params;
+         job->prog_data->param = first_prog_data->param;
+         job->prog_data->nr_pull_params = first_prog_data->nr_pull_params;
+         job->prog_data->pull_param = first_prog_data->pull_param;
+         memcpy(job->prog_data->ubo_ranges, first_prog_data->ubo_ranges,
+                sizeof(job->prog_data->ubo_ranges));
+      }
+   }
+
+   job->v = new fs_visitor(job->compiler, job->log_data, job->mem_ctx,
+                           job->key, job->prog_data, job->prog, shader,
+                           job->dispatch_width, job->shader_time_index);
+   if (first)
+      job->v->import_uniforms(first->v);
+   else
+      job->v->uniforms_ready = &job->uniforms_ready;
+   if (job->queue)
+      job->v->deferred_perf_log = &job->perf_log;
+
+   if (shader->info.stage == MESA_SHADER_COMPUTE)
+      job->compiled = job->v->run_cs(job->min_dispatch_width);
+   else
+      job->compiled = job->v->run_fs(job->allow_spilling, job->use_rep_send);
+
+   /* Don't leave the other variants waiting if we failed early. */
+   if (!util_queue_fence_is_signalled(&job->uniforms_ready))
+      util_queue_fence_signal(&job->uniforms_ready);
+}
+
+static void
+simd_compile_job_start(struct simd_compile_job *job)
+{
+   if (job->queue) {
+      util_queue_add_job(job->queue, job, &job->fence,
+                         simd_compile_job_execute, NULL);
+   }
+}
+
+/**
+ * Returns whether the variant compiled, compiling it now unless it was
+ * compiled in parallel.
+ */
+static bool
+simd_compile_job_finish(struct simd_compile_job *job,
+                        struct brw_stage_prog_data *prog_data)
+{
+   if (job->queue) {
+      util_queue_fence_wait(&job->fence);
+
+      /* Everything else the variants write to the prog_data is the same for
+       * all of them.
+       */
+      prog_data->total_scratch = MAX2(prog_data->total_scratch,
+                                      job->prog_data->total_scratch);
+
+      util_dynarray_foreach(&job->perf_log, char *, msg)
+         job->compiler->shader_perf_log(job->log_data, "%s", *msg);
+   } else {
+      simd_compile_job_execute(job, 0);
+   }
+
+   return job->compiled;
+}
+
+static void
+simd_compile_job_free(struct simd_compile_job *job)
+{
+   if (!job)
+      return;
+
+   if (job->queue)
+      util_queue_fence_wait(&job->fence);
+
+   delete job->v;
+   util_queue_fence_destroy(&job->fence);
+   util_queue_fence_destroy(&job->uniforms_ready);
+   ralloc_free(job);
+}
+
 const unsigned *
 brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
                void *mem_ctx,
@@ -7145,56 +7400,80 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
       brw_compute_barycentric_interp_modes(compiler->devinfo, shader);
 
    cfg_t *simd8_cfg = NULL, *simd16_cfg = NULL, *simd32_cfg = NULL;
+   struct simd_compile_job *job16 = NULL, *job32 = NULL;
 
-   fs_visitor v8(compiler, log_data, mem_ctx, key,
-                 &prog_data->base, prog, shader, 8,
-                 shader_time_index8);
-   if (!v8.run_fs(allow_spilling, false /* do_rep_send */)) {
+   struct simd_compile_job *job8 =
+      simd_compile_job_create(compiler, log_data, mem_ctx, key,
+                              &prog_data->base, sizeof(*prog_data), prog,
+                              shader, 8, shader_time_index8, NULL, false);
+   job8->allow_spilling = allow_spilling;
+
+   /* A repclear shader changes the prog_data in ways the SIMD8 one doesn't,
+    * so it is compiled after it.
+    */
+   if (likely(!(INTEL_DEBUG & DEBUG_NO16) || use_rep_send)) {
+      job16 = simd_compile_job_create(compiler, log_data, mem_ctx, key,
+                                      &prog_data->base, sizeof(*prog_data),
+                                      prog, shader, 16, shader_time_index16,
+                                      job8, !use_rep_send);
+      job16->allow_spilling = allow_spilling;
+      job16->use_rep_send = use_rep_send;
+      simd_compile_job_start(job16);
+   }
+
+   /* Currently, the compiler only supports SIMD32 on SNB+ */
+   if (!use_rep_send &&
+       compiler->devinfo->gen >= 6 &&
+       unlikely(INTEL_DEBUG & DEBUG_DO32)) {
+      job32 = simd_compile_job_create(compiler, log_data, mem_ctx, key,
+                                      &prog_data->base, sizeof(*prog_data),
+                                      prog, shader, 32, shader_time_index32,
+                                      job8, true);
+      job32->allow_spilling = allow_spilling;
+      simd_compile_job_start(job32);
+   }
+
+   if (!simd_compile_job_finish(job8, &prog_data->base)) {
       if (error_str)
-         *error_str = ralloc_strdup(mem_ctx, v8.fail_msg);
+         *error_str = ralloc_strdup(mem_ctx, job8->v->fail_msg);
 
+      simd_compile_job_free(job32);
+      simd_compile_job_free(job16);
+      simd_compile_job_free(job8);
       return NULL;
-   } else if (likely(!(INTEL_DEBUG & DEBUG_NO8))) {
-      simd8_cfg = v8.cfg;
-      prog_data->base.dispatch_grf_start_reg = v8.payload.num_regs;
-      prog_data->reg_blocks_8 = brw_register_blocks(v8.grf_used);
    }
 
-   if (v8.max_dispatch_width >= 16 &&
-       likely(!(INTEL_DEBUG & DEBUG_NO16) || use_rep_send)) {
+   fs_visitor *v8 = job8->v;
+
+   if (likely(!(INTEL_DEBUG & DEBUG_NO8))) {
+      simd8_cfg = v8->cfg;
+      prog_data->base.dispatch_grf_start_reg = v8->payload.num_regs;
+      prog_data->reg_blocks_8 = brw_register_blocks(v8->grf_used);
+   }
+
+   if (job16 && v8->max_dispatch_width >= 16) {
       /* Try a SIMD16 compile */
-      fs_visitor v16(compiler, log_data, mem_ctx, key,
-                     &prog_data->base, prog, shader, 16,
-                     shader_time_index16);
-      v16.import_uniforms(&v8);
-      if (!v16.run_fs(allow_spilling, use_rep_send)) {
+      if (!simd_compile_job_finish(job16, &prog_data->base)) {
          compiler->shader_perf_log(log_data,
                                    "SIMD16 shader failed to compile: %s",
-                                   v16.fail_msg);
+                                   job16->v->fail_msg);
       } else {
-         simd16_cfg = v16.cfg;
-         prog_data->dispatch_grf_start_reg_16 = v16.payload.num_regs;
-         prog_data->reg_blocks_16 = brw_register_blocks(v16.grf_used);
+         simd16_cfg = job16->v->cfg;
+         prog_data->dispatch_grf_start_reg_16 = job16->v->payload.num_regs;
+         prog_data->reg_blocks_16 = brw_register_blocks(job16->v->grf_used);
       }
    }
 
-   /* Currently, the compiler only supports SIMD32 on SNB+ */
-   if (v8.max_dispatch_width >= 32 && !use_rep_send &&
-       compiler->devinfo->gen >= 6 &&
-       unlikely(INTEL_DEBUG & DEBUG_DO32)) {
+   if (job32 && v8->max_dispatch_width >= 32) {
       /* Try a SIMD32 compile */
-      fs_visitor v32(compiler, log_data, mem_ctx, key,
-                     &prog_data->base, prog, shader, 32,
-                     shader_time_index32);
-      v32.import_uniforms(&v8);
-      if (!v32.run_fs(allow_spilling, false)) {
+      if (!simd_compile_job_finish(job32, &prog_data->base)) {
          compiler->shader_perf_log(log_data,
                                    "SIMD32 shader failed to compile: %s",
-                                   v32.fail_msg);
+                                   job32->v->fail_msg);
       } else {
-         simd32_cfg = v32.cfg;
-         prog_data->dispatch_grf_start_reg_32 = v32.payload.num_regs;
-         prog_data->reg_blocks_32 = brw_register_blocks(v32.grf_used);
+         simd32_cfg = job32->v->cfg;
+         prog_data->dispatch_grf_start_reg_32 = job32->v->payload.num_regs;
+         prog_data->reg_blocks_32 = brw_register_blocks(job32->v->grf_used);
       }
    }
 
@@ -7252,7 +7531,7 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
    brw_compute_flat_inputs(prog_data, shader);
 
    fs_generator g(compiler, log_data, mem_ctx, &prog_data->base,
-                  v8.promoted_constants, v8.runtime_check_aads_emit,
+                  v8->promoted_constants, v8->runtime_check_aads_emit,
                   MESA_SHADER_FRAGMENT);
 
    if (unlikely(INTEL_DEBUG & DEBUG_WM)) {
@@ -7277,7 +7556,13 @@ brw_compile_fs(const struct brw_compiler *compiler, void *log_data,
       prog_data->prog_offset_32 = g.generate_code(simd32_cfg, 32);
    }
 
-   return g.get_assembly();
+   const unsigned *assembly = g.get_assembly();
+
+   simd_compile_job_free(job32);
+   simd_compile_job_free(job16);
+   simd_compile_job_free(job8);
+
+   return assembly;
 }
 
 fs_reg *
@@ -7357,19 +7642,6 @@ cs_set_simd_size(struct brw_cs_prog_data *cs_prog_data, unsigned size)
    cs_prog_data->threads = (group_size + size - 1) / size;
 }
 
-static nir_shader *
-compile_cs_to_nir(const struct brw_compiler *compiler,
-                  void *mem_ctx,
-                  const struct brw_cs_prog_key *key,
-                  const nir_shader *src_shader,
-                  unsigned dispatch_width)
-{
-   nir_shader *shader = nir_shader_clone(mem_ctx, src_shader);
-   shader = brw_nir_apply_sampler_key(shader, compiler, &key->tex, true);
-   brw_nir_lower_cs_intrinsics(shader, dispatch_width);
-   return brw_postprocess_nir(shader, compiler, true);
-}
-
 const unsigned *
 brw_compile_cs(const struct brw_compiler *compiler, void *log_data,
                void *mem_ctx,
@@ -7392,47 +7664,71 @@ brw_compile_cs(const struct brw_compiler *compiler, void *log_data,
    min_dispatch_width = util_next_power_of_two(min_dispatch_width);
    assert(min_dispatch_width <= 32);
 
-   fs_visitor *v8 = NULL, *v16 = NULL, *v32 = NULL;
+   struct simd_compile_job *first = NULL;
+   struct simd_compile_job *job8 = NULL, *job16 = NULL, *job32 = NULL;
    cfg_t *cfg = NULL;
    const char *fail_msg = NULL;
    unsigned promoted_constants = 0;
 
    /* Now the main event: Visit the shader IR and generate our CS IR for it.
+    * The wider variants are compiled in parallel with the narrowest one when
+    * possible, and import its uniform layout.
     */
    if (min_dispatch_width <= 8) {
-      nir_shader *nir8 = compile_cs_to_nir(compiler, mem_ctx, key,
-                                           src_shader, 8);
-      v8 = new fs_visitor(compiler, log_data, mem_ctx, key, &prog_data->base,
-                          NULL, /* Never used in core profile */
-                          nir8, 8, shader_time_index);
-      if (!v8->run_cs(min_dispatch_width)) {
-         fail_msg = v8->fail_msg;
+      job8 = simd_compile_job_create(compiler, log_data, mem_ctx, key,
+                                     &prog_data->base, sizeof(*prog_data),
+                                     NULL, /* Never used in core profile */
+                                     src_shader, 8, shader_time_index,
+                                     first, true);
+      first = job8;
+   }
+
+   if (likely(!(INTEL_DEBUG & DEBUG_NO16)) && min_dispatch_width <= 16) {
+      job16 = simd_compile_job_create(compiler, log_data, mem_ctx, key,
+                                      &prog_data->base, sizeof(*prog_data),
+                                      NULL, /* Never used in core profile */
+                                      src_shader, 16, shader_time_index,
+                                      first, true);
+      if (!first)
+         first = job16;
+   }
+
+   if (min_dispatch_width > 16 || (INTEL_DEBUG & DEBUG_DO32)) {
+      job32 = simd_compile_job_create(compiler, log_data, mem_ctx, key,
+                                      &prog_data->base, sizeof(*prog_data),
+                                      NULL, /* Never used in core profile */
+                                      src_shader, 32, shader_time_index,
+                                      first, true);
+   }
+
+   struct simd_compile_job *jobs[] = { job8, job16, job32 };
+   for (unsigned i = 0; i < ARRAY_SIZE(jobs); i++) {
+      if (jobs[i]) {
+         jobs[i]->min_dispatch_width = min_dispatch_width;
+         simd_compile_job_start(jobs[i]);
+      }
+   }
+
+   if (job8) {
+      if (!simd_compile_job_finish(job8, &prog_data->base)) {
+         fail_msg = job8->v->fail_msg;
       } else {
          /* We should always be able to do SIMD32 for compute shaders */
-         assert(v8->max_dispatch_width >= 32);
+         assert(job8->v->max_dispatch_width >= 32);
 
-         cfg = v8->cfg;
+         cfg = job8->v->cfg;
          cs_set_simd_size(prog_data, 8);
          cs_fill_push_const_info(compiler->devinfo, prog_data);
-         promoted_constants = v8->promoted_constants;
+         promoted_constants = job8->v->promoted_constants;
       }
    }
 
-   if (likely(!(INTEL_DEBUG & DEBUG_NO16)) &&
-       !fail_msg && min_dispatch_width <= 16) {
+   if (job16 && !fail_msg) {
       /* Try a SIMD16 compile */
-      nir_shader *nir16 = compile_cs_to_nir(compiler, mem_ctx, key,
-                                            src_shader, 16);
-      v16 = new fs_visitor(compiler, log_data, mem_ctx, key, &prog_data->base,
-                           NULL, /* Never used in core profile */
-                           nir16, 16, shader_time_index);
-      if (v8)
-         v16->import_uniforms(v8);
-
-      if (!v16->run_cs(min_dispatch_width)) {
+      if (!simd_compile_job_finish(job16, &prog_data->base)) {
          compiler->shader_perf_log(log_data,
                                    "SIMD16 shader failed to compile: %s",
-                                   v16->fail_msg);
+                                   job16->v->fail_msg);
          if (!cfg) {
             fail_msg =
                "Couldn't generate SIMD16 program and not "
@@ -7440,44 +7736,31 @@ brw_compile_cs(const struct brw_compiler *compiler, void *log_data,
          }
       } else {
          /* We should always be able to do SIMD32 for compute shaders */
-         assert(v16->max_dispatch_width >= 32);
+         assert(job16->v->max_dispatch_width >= 32);
 
-         cfg = v16->cfg;
+         cfg = job16->v->cfg;
          cs_set_simd_size(prog_data, 16);
          cs_fill_push_const_info(compiler->devinfo, prog_data);
-         promoted_constants = v16->promoted_constants;
+         promoted_constants = job16->v->promoted_constants;
       }
    }
 
-   /* We should always be able to do SIMD32 for compute shaders */
-   assert(!v16 || v16->max_dispatch_width >= 32);
-
-   if (!fail_msg && (min_dispatch_width > 16 || (INTEL_DEBUG & DEBUG_DO32))) {
+   if (job32 && !fail_msg) {
       /* Try a SIMD32 compile */
-      nir_shader *nir32 = compile_cs_to_nir(compiler, mem_ctx, key,
-                                            src_shader, 32);
-      v32 = new fs_visitor(compiler, log_data, mem_ctx, key, &prog_data->base,
-                           NULL, /* Never used in core profile */
-                           nir32, 32, shader_time_index);
-      if (v8)
-         v32->import_uniforms(v8);
-      else if (v16)
-         v32->import_uniforms(v16);
-
-      if (!v32->run_cs(min_dispatch_width)) {
+      if (!simd_compile_job_finish(job32, &prog_data->base)) {
          compiler->shader_perf_log(log_data,
                                    "SIMD32 shader failed to compile: %s",
-                                   v16->fail_msg);
+                                   job32->v->fail_msg);
          if (!cfg) {
             fail_msg =
                "Couldn't generate SIMD32 program and not "
                "enough threads for SIMD16";
          }
       } else {
-         cfg = v32->cfg;
+         cfg = job32->v->cfg;
          cs_set_simd_size(prog_data, 32);
          cs_fill_push_const_info(compiler->devinfo, prog_data);
-         promoted_constants = v32->promoted_constants;
+         promoted_constants = job32->v->promoted_constants;
       }
    }
 
@@ -7502,9 +7785,9 @@ brw_compile_cs(const struct brw_compiler *compiler, void *log_data,
       ret = g.get_assembly();
    }
 
-   delete v8;
-   delete v16;
-   delete v32;
+   simd_compile_job_free(job32);
+   simd_compile_job_free(job16);
+   simd_compile_job_free(job8);
 
    return ret;
 }
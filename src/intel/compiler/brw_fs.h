@@ -43,6 +43,7 @@ namespace brw {
 }
 
 struct brw_gs_compile;
+struct util_queue_fence;
 
 static inline fs_reg
 offset(const fs_reg &reg, const brw::fs_builder &bld, unsigned delta)
@@ -153,6 +154,9 @@ public:
    bool opt_sampler_eot();
    bool virtual_grf_interferes(int a, int b);
    void schedule_instructions(instruction_scheduler_mode mode);
+   instruction_scheduler *prepare_scheduler(void *mem_ctx);
+   void schedule_instructions_pre_ra(instruction_scheduler *sched,
+                                     instruction_scheduler_mode mode);
    void insert_gen4_send_dependency_workarounds();
    void insert_gen4_pre_send_dependency_workarounds(bblock_t *block,
                                                     fs_inst *inst);
@@ -160,6 +164,7 @@ public:
                                                      fs_inst *inst);
    void vfail(const char *msg, va_list args);
    void fail(const char *msg, ...);
+   void perf_log(const char *msg, ...) PRINTFLIKE(2, 3);
    void limit_dispatch_width(unsigned n, const char *msg);
    void lower_uniform_pull_constant_loads();
    bool lower_load_payload();
@@ -320,6 +325,19 @@ public:
     */
    int *push_constant_loc;
 
+   /**
+    * Signalled once push_constant_loc and pull_constant_loc are final, for
+    * the wider variants compiled in parallel to import them, or NULL.
+    */
+   struct util_queue_fence *uniforms_ready;
+
+   /**
+    * Where to keep the perf log messages until the thread calling the
+    * compiler passes them to compiler->shader_perf_log, or NULL to pass them
+    * right away.
+    */
+   struct util_dynarray *deferred_perf_log;
+
    fs_reg subgroup_id;
    fs_reg frag_depth;
    fs_reg frag_stencil;
@@ -94,6 +94,51 @@ public:
     * successors is an exit node.
     */
    schedule_node *exit;
+
+   /**
+    * The parent_count and unblocked_time of the node once the DAG is built,
+    * so that the same DAG can be scheduled again with another heuristic.
+    */
+   int initial_parent_count;
+   int initial_unblocked_time;
+
+   /**
+    * Position of the node in the list of candidates: the lower, the closer
+    * to its head.
+    */
+   int ready_rank;
+
+   /**
+    * For exit nodes, the index of the ready heap holding the candidates
+    * whose preferred exit is this node.
+    */
+   int ready_heap_index;
+
+   /**
+    * Index of the candidate in its ready heap, or -1 if it isn't in one.
+    */
+   int ready_heap_pos;
+
+   /**
+    * get_register_pressure_benefit() of the candidate while choosing the
+    * next instruction to schedule.
+    */
+   int register_pressure_benefit;
+};
+
+/**
+ * A binary min-heap of candidates, ordered by the candidate_less_func of
+ * the heuristic, and then by their position in the list of candidates.
+ *
+ * The candidates are split into one heap per preferred exit node, since the
+ * unblocked_time of the exit nodes keeps changing while the candidates wait
+ * to be scheduled, but it is the same for all the candidates of a heap.
+ */
+struct ready_heap {
+   schedule_node *exit;
+   schedule_node **nodes;
+   int count;
+   int size;
 };
 
 /**
@@ -114,6 +159,115 @@ exit_unblocked_time(const schedule_node *n)
    return n->exit ? n->exit->unblocked_time : INT_MAX;
 }
 
+/**
+ * Whether candidate a is to be scheduled before candidate b.  This must be
+ * a strict weak ordering, which only depends on exit_unblocked_time() and
+ * on what doesn't change while a and b are candidates, besides the updates
+ * instruction_scheduler::update_candidate() is told about.
+ */
+typedef bool (*candidate_less_func)(const schedule_node *a,
+                                    const schedule_node *b);
+
+/**
+ * SCHEDULE_PRE and SCHEDULE_POST: the candidate most likely to unblock an
+ * early program exit, or the one ready to execute or the closest to being
+ * ready, or the oldest one.
+ */
+static bool
+latency_candidate_less(const schedule_node *a, const schedule_node *b)
+{
+   if (exit_unblocked_time(a) != exit_unblocked_time(b))
+      return exit_unblocked_time(a) < exit_unblocked_time(b);
+
+   return a->unblocked_time < b->unblocked_time ||
+          (a->unblocked_time == b->unblocked_time &&
+           a->ready_rank < b->ready_rank);
+}
+
+/**
+ * SCHEDULE_PRE_NON_LIFO and SCHEDULE_PRE_LIFO, as the list of candidates
+ * was scanned by fs_instruction_scheduler::choose_instruction_to_schedule():
+ * the candidate which reduces the register pressure the most, or with lifo
+ * the one which became a candidate last, or the one with the highest delay,
+ * or the one most likely to unblock an early program exit, or the oldest
+ * one.  A candidate which doesn't reduce the register pressure doesn't
+ * lose to one which increases it less.
+ */
+static inline bool
+pressure_candidate_less(const schedule_node *a, const schedule_node *b,
+                        bool lifo)
+{
+   const int a_benefit = MAX2(a->register_pressure_benefit, 0);
+   const int b_benefit = MAX2(b->register_pressure_benefit, 0);
+
+   if (a_benefit != b_benefit)
+      return a_benefit > b_benefit;
+
+   if (lifo && a->cand_generation != b->cand_generation)
+      return a->cand_generation > b->cand_generation;
+
+   if (a->delay != b->delay)
+      return a->delay > b->delay;
+
+   if (exit_unblocked_time(a) != exit_unblocked_time(b))
+      return exit_unblocked_time(a) < exit_unblocked_time(b);
+
+   return a->ready_rank < b->ready_rank;
+}
+
+static bool
+non_lifo_candidate_less(const schedule_node *a, const schedule_node *b)
+{
+   return pressure_candidate_less(a, b, false);
+}
+
+static bool
+lifo_candidate_less(const schedule_node *a, const schedule_node *b)
+{
+   return pressure_candidate_less(a, b, true);
+}
+
+static void
+ready_heap_sift_up(struct ready_heap *heap, int i, candidate_less_func less)
+{
+   schedule_node *n = heap->nodes[i];
+
+   while (i > 0) {
+      int parent = (i - 1) / 2;
+      if (!less(n, heap->nodes[parent]))
+         break;
+      heap->nodes[i] = heap->nodes[parent];
+      heap->nodes[i]->ready_heap_pos = i;
+      i = parent;
+   }
+
+   heap->nodes[i] = n;
+   n->ready_heap_pos = i;
+}
+
+static void
+ready_heap_sift_down(struct ready_heap *heap, int i, candidate_less_func less)
+{
+   schedule_node *n = heap->nodes[i];
+
+   for (;;) {
+      int child = 2 * i + 1;
+      if (child >= heap->count)
+         break;
+      if (child + 1 < heap->count &&
+          less(heap->nodes[child + 1], heap->nodes[child]))
+         child++;
+      if (!less(heap->nodes[child], n))
+         break;
+      heap->nodes[i] = heap->nodes[child];
+      heap->nodes[i]->ready_heap_pos = i;
+      i = child;
+   }
+
+   heap->nodes[i] = n;
+   n->ready_heap_pos = i;
+}
+
 void
 schedule_node::set_latency_gen4()
 {
@@ -429,6 +583,8 @@ schedule_node::set_latency_gen7(bool is_haswell)
 
 class instruction_scheduler {
 public:
+   DECLARE_RALLOC_CXX_OPERATORS(instruction_scheduler)
+
    instruction_scheduler(backend_shader *s, int grf_count,
                          int hw_reg_count, int block_count,
                          instruction_scheduler_mode mode)
@@ -441,6 +597,14 @@ public:
       this->instructions_to_schedule = 0;
       this->post_reg_alloc = (mode == SCHEDULE_POST);
       this->mode = mode;
+      this->nodes = NULL;
+      this->ready_heaps = NULL;
+      this->ready_heap_count = 0;
+      this->ready_heap_array_size = 0;
+      this->use_ready_heaps = false;
+      this->candidate_less = latency_candidate_less;
+      this->update_benefits = false;
+      this->next_ready_rank = 0;
       if (!post_reg_alloc) {
          this->reg_pressure_in = rzalloc_array(mem_ctx, int, block_count);
 
@@ -475,7 +639,7 @@ public:
       }
    }
 
-   ~instruction_scheduler()
+   virtual ~instruction_scheduler()
    {
       ralloc_free(this->mem_ctx);
    }
@@ -484,9 +648,19 @@ public:
    void add_dep(schedule_node *before, schedule_node *after);
 
    void run(cfg_t *cfg);
+   void build_dags(cfg_t *cfg);
    void add_insts_from_block(bblock_t *block);
    void compute_delays();
    void compute_exits();
+   void reset_block_dag(bblock_t *block);
+
+   void setup_ready_heaps(bblock_t *block);
+   struct ready_heap *get_ready_heap(schedule_node *n);
+   void add_candidate(schedule_node *n);
+   void remove_candidate(schedule_node *n);
+   void update_candidate(schedule_node *n);
+   void rebuild_ready_heaps();
+   schedule_node *choose_from_ready_heaps();
    virtual void calculate_deps() = 0;
    virtual schedule_node *choose_instruction_to_schedule() = 0;
 
@@ -504,6 +678,13 @@ public:
    virtual void update_register_pressure(backend_instruction *inst) = 0;
    virtual int get_register_pressure_benefit(backend_instruction *inst) = 0;
 
+   /**
+    * Finds the instructions of the block accessing each register, so that
+    * update_register_pressure() can update the candidates whose register
+    * pressure benefit it changes.
+    */
+   virtual void index_register_refs() = 0;
+
    void schedule_instructions(bblock_t *block);
 
    void *mem_ctx;
@@ -519,6 +700,28 @@ public:
 
    instruction_scheduler_mode mode;
 
+   /*
+    * The DAG nodes of all the instructions, indexed by IP in the order the
+    * DAGs were built from.
+    */
+
+   schedule_node **nodes;
+
+   /*
+    * The candidates, sorted by candidate_less for the heuristics that can
+    * order them with it.  The candidates are still in the instructions list
+    * too.  update_benefits is set when the order depends on the register
+    * pressure benefit of the candidates.
+    */
+
+   bool use_ready_heaps;
+   candidate_less_func candidate_less;
+   bool update_benefits;
+   struct ready_heap *ready_heaps;
+   int ready_heap_count;
+   int ready_heap_array_size;
+   int next_ready_rank;
+
    /*
     * The register pressure at the beginning of each basic block.
     */
@@ -578,6 +781,27 @@ public:
    void setup_liveness(cfg_t *cfg);
    void update_register_pressure(backend_instruction *inst);
    int get_register_pressure_benefit(backend_instruction *inst);
+   void index_register_refs();
+
+   void add_reg_ref(int *head, schedule_node *n);
+   void update_candidates(int ref);
+
+   /*
+    * The nodes of the block reading or writing each virtual GRF, and reading
+    * each hardware GRF, as lists of reg_refs starting at these indices, or
+    * -1 when empty.
+    */
+
+   int *grf_readers;
+   int *grf_writers;
+   int *hw_readers;
+
+   struct reg_ref {
+      schedule_node *n;
+      int next;
+   } *reg_refs;
+   int reg_ref_count;
+   int reg_ref_array_size;
 };
 
 fs_instruction_scheduler::fs_instruction_scheduler(fs_visitor *v,
@@ -587,6 +811,12 @@ fs_instruction_scheduler::fs_instruction_scheduler(fs_visitor *v,
    : instruction_scheduler(v, grf_count, hw_reg_count, block_count, mode),
      v(v)
 {
+   this->grf_readers = NULL;
+   this->grf_writers = NULL;
+   this->hw_readers = NULL;
+   this->reg_refs = NULL;
+   this->reg_ref_count = 0;
+   this->reg_ref_array_size = 0;
 }
 
 static bool
@@ -687,8 +917,14 @@ fs_instruction_scheduler::update_register_pressure(backend_instruction *be)
    if (!reads_remaining)
       return;
 
-   if (inst->dst.file == VGRF) {
+   /* Writing a register for the first time, or leaving a single read of
+    * it, raises the register pressure benefit of the candidates which also
+    * write or read it.
+    */
+   if (inst->dst.file == VGRF && !written[inst->dst.nr]) {
       written[inst->dst.nr] = true;
+      if (update_benefits)
+         update_candidates(grf_writers[inst->dst.nr]);
    }
 
    for (int i = 0; i < inst->sources; i++) {
@@ -696,15 +932,81 @@ fs_instruction_scheduler::update_register_pressure(backend_instruction *be)
           continue;
 
       if (inst->src[i].file == VGRF) {
-         reads_remaining[inst->src[i].nr]--;
+         if (--reads_remaining[inst->src[i].nr] == 1 && update_benefits)
+            update_candidates(grf_readers[inst->src[i].nr]);
       } else if (inst->src[i].file == FIXED_GRF &&
                  inst->src[i].nr < hw_reg_count) {
-         for (unsigned off = 0; off < regs_read(inst, i); off++)
-            hw_reads_remaining[inst->src[i].nr + off]--;
+         for (unsigned off = 0; off < regs_read(inst, i); off++) {
+            int reg = inst->src[i].nr + off;
+            if (--hw_reads_remaining[reg] == 1 && update_benefits &&
+                reg < hw_reg_count)
+               update_candidates(hw_readers[reg]);
+         }
+      }
+   }
+}
+
+void
+fs_instruction_scheduler::add_reg_ref(int *head, schedule_node *n)
+{
+   if (reg_ref_count == reg_ref_array_size) {
+      reg_ref_array_size = MAX2(64, reg_ref_array_size * 2);
+      reg_refs = reralloc(mem_ctx, reg_refs, struct reg_ref,
+                          reg_ref_array_size);
+   }
+
+   reg_refs[reg_ref_count].n = n;
+   reg_refs[reg_ref_count].next = *head;
+   *head = reg_ref_count++;
+}
+
+void
+fs_instruction_scheduler::index_register_refs()
+{
+   if (!grf_readers) {
+      grf_readers = ralloc_array(mem_ctx, int, grf_count);
+      grf_writers = ralloc_array(mem_ctx, int, grf_count);
+      hw_readers = ralloc_array(mem_ctx, int, hw_reg_count);
+   }
+
+   memset(grf_readers, -1, grf_count * sizeof(*grf_readers));
+   memset(grf_writers, -1, grf_count * sizeof(*grf_writers));
+   memset(hw_readers, -1, hw_reg_count * sizeof(*hw_readers));
+   reg_ref_count = 0;
+
+   foreach_in_list(schedule_node, n, &instructions) {
+      fs_inst *inst = (fs_inst *)n->inst;
+
+      if (inst->dst.file == VGRF)
+         add_reg_ref(&grf_writers[inst->dst.nr], n);
+
+      for (int i = 0; i < inst->sources; i++) {
+         if (is_src_duplicate(inst, i))
+            continue;
+
+         if (inst->src[i].file == VGRF) {
+            add_reg_ref(&grf_readers[inst->src[i].nr], n);
+         } else if (inst->src[i].file == FIXED_GRF &&
+                    inst->src[i].nr < hw_reg_count) {
+            for (unsigned off = 0; off < regs_read(inst, i); off++) {
+               if (inst->src[i].nr + off < (unsigned)hw_reg_count)
+                  add_reg_ref(&hw_readers[inst->src[i].nr + off], n);
+            }
+         }
       }
    }
 }
 
+/** Updates the candidates among the nodes of a list of reg_refs. */
+void
+fs_instruction_scheduler::update_candidates(int ref)
+{
+   for (; ref >= 0; ref = reg_refs[ref].next) {
+      if (reg_refs[ref].n->ready_heap_pos >= 0)
+         update_candidate(reg_refs[ref].n);
+   }
+}
+
 int
 fs_instruction_scheduler::get_register_pressure_benefit(backend_instruction *be)
 {
@@ -754,6 +1056,7 @@ public:
    void setup_liveness(cfg_t *cfg);
    void update_register_pressure(backend_instruction *inst);
    int get_register_pressure_benefit(backend_instruction *inst);
+   void index_register_refs();
 };
 
 vec4_instruction_scheduler::vec4_instruction_scheduler(vec4_visitor *v,
@@ -784,6 +1087,11 @@ vec4_instruction_scheduler::get_register_pressure_benefit(backend_instruction *)
    return 0;
 }
 
+void
+vec4_instruction_scheduler::index_register_refs()
+{
+}
+
 schedule_node::schedule_node(backend_instruction *inst,
                              instruction_scheduler *sched)
 {
@@ -799,6 +1107,12 @@ schedule_node::schedule_node(backend_instruction *inst,
    this->cand_generation = 0;
    this->delay = 0;
    this->exit = NULL;
+   this->initial_parent_count = 0;
+   this->initial_unblocked_time = 0;
+   this->ready_rank = 0;
+   this->ready_heap_index = 0;
+   this->ready_heap_pos = -1;
+   this->register_pressure_benefit = 0;
 
    /* We can't measure Gen6 timings directly but expect them to be much
     * closer to Gen7 than Gen4.
@@ -814,10 +1128,64 @@ schedule_node::schedule_node(backend_instruction *inst,
 void
 instruction_scheduler::add_insts_from_block(bblock_t *block)
 {
+   int ip = block->start_ip;
+
    foreach_inst_in_block(backend_instruction, inst, block) {
       schedule_node *n = new(mem_ctx) schedule_node(inst, this);
 
       instructions.push_tail(n);
+      nodes[ip++] = n;
+   }
+
+   this->instructions_to_schedule = block->end_ip - block->start_ip + 1;
+}
+
+/**
+ * Builds the DAG of each block, which only depends on the instructions and
+ * not on the heuristic, so that run() can then be called again with another
+ * mode as long as the instructions weren't changed by anything else than
+ * the scheduler.
+ */
+void
+instruction_scheduler::build_dags(cfg_t *cfg)
+{
+   nodes = ralloc_array(mem_ctx, schedule_node *,
+                        cfg->blocks[cfg->num_blocks - 1]->end_ip + 1);
+
+   if (!post_reg_alloc)
+      setup_liveness(cfg);
+
+   foreach_block(block, cfg) {
+      instructions.make_empty();
+      add_insts_from_block(block);
+
+      calculate_deps();
+
+      compute_delays();
+      compute_exits();
+
+      foreach_in_list(schedule_node, n, &instructions) {
+         n->initial_parent_count = n->parent_count;
+         n->initial_unblocked_time = n->unblocked_time;
+      }
+   }
+
+   instructions.make_empty();
+}
+
+/** Makes the list of instructions of a block from its unscheduled DAG. */
+void
+instruction_scheduler::reset_block_dag(bblock_t *block)
+{
+   instructions.make_empty();
+
+   for (int ip = block->start_ip; ip <= block->end_ip; ip++) {
+      schedule_node *n = nodes[ip];
+
+      n->parent_count = n->initial_parent_count;
+      n->unblocked_time = n->initial_unblocked_time;
+      n->cand_generation = 0;
+      instructions.push_tail(n);
    }
 
    this->instructions_to_schedule = block->end_ip - block->start_ip + 1;
@@ -1407,22 +1775,11 @@ fs_instruction_scheduler::choose_instruction_to_schedule()
 {
    schedule_node *chosen = NULL;
 
-   if (mode == SCHEDULE_PRE || mode == SCHEDULE_POST) {
-      int chosen_time = 0;
-
-      /* Of the instructions ready to execute or the closest to being ready,
-       * choose the one most likely to unblock an early program exit, or
-       * otherwise the oldest one.
+   if (use_ready_heaps) {
+      /* The heuristics below, except for the Gen4-6 preference of the LIFO
+       * one, are implemented by the candidate_less_func of the mode.
        */
-      foreach_in_list(schedule_node, n, &instructions) {
-         if (!chosen ||
-             exit_unblocked_time(n) < exit_unblocked_time(chosen) ||
-             (exit_unblocked_time(n) == exit_unblocked_time(chosen) &&
-              n->unblocked_time < chosen_time)) {
-            chosen = n;
-            chosen_time = n->unblocked_time;
-         }
-      }
+      chosen = choose_from_ready_heaps();
    } else {
       /* Before register allocation, we don't care about the latencies of
        * instructions.  All we care about is reducing live intervals of
@@ -1433,6 +1790,11 @@ fs_instruction_scheduler::choose_instruction_to_schedule()
       foreach_in_list(schedule_node, n, &instructions) {
          fs_inst *inst = (fs_inst *)n->inst;
 
+         /* Computed once per candidate rather than for each comparison with
+          * the chosen one.
+          */
+         n->register_pressure_benefit = get_register_pressure_benefit(n->inst);
+
          if (!chosen) {
             chosen = n;
             continue;
@@ -1441,9 +1803,9 @@ fs_instruction_scheduler::choose_instruction_to_schedule()
          /* Most important: If we can definitely reduce register pressure, do
           * so immediately.
           */
-         int register_pressure_benefit = get_register_pressure_benefit(n->inst);
+         int register_pressure_benefit = n->register_pressure_benefit;
          int chosen_register_pressure_benefit =
-            get_register_pressure_benefit(chosen->inst);
+            chosen->register_pressure_benefit;
 
          if (register_pressure_benefit > 0 &&
              register_pressure_benefit > chosen_register_pressure_benefit) {
@@ -1528,20 +1890,11 @@ fs_instruction_scheduler::choose_instruction_to_schedule()
 schedule_node *
 vec4_instruction_scheduler::choose_instruction_to_schedule()
 {
-   schedule_node *chosen = NULL;
-   int chosen_time = 0;
-
    /* Of the instructions ready to execute or the closest to being ready,
-    * choose the oldest one.
+    * choose the oldest one.  There are no exit nodes in vec4 shaders, so
+    * all of them are in the same ready heap.
     */
-   foreach_in_list(schedule_node, n, &instructions) {
-      if (!chosen || n->unblocked_time < chosen_time) {
-         chosen = n;
-         chosen_time = n->unblocked_time;
-      }
-   }
-
-   return chosen;
+   return choose_from_ready_heaps();
 }
 
 int
@@ -1561,6 +1914,123 @@ vec4_instruction_scheduler::issue_time(backend_instruction *)
    return 2;
 }
 
+/**
+ * Sets up a ready heap for the candidates without any preferred exit node,
+ * and one for each exit node of the block.
+ */
+void
+instruction_scheduler::setup_ready_heaps(bblock_t *block)
+{
+   int count = 1;
+
+   for (int ip = block->start_ip; ip <= block->end_ip; ip++) {
+      if (nodes[ip]->inst->opcode == FS_OPCODE_DISCARD_JUMP)
+         nodes[ip]->ready_heap_index = count++;
+   }
+
+   if (ready_heap_array_size < count) {
+      ready_heaps = reralloc(mem_ctx, ready_heaps, struct ready_heap, count);
+      for (int i = ready_heap_array_size; i < count; i++) {
+         ready_heaps[i].nodes = NULL;
+         ready_heaps[i].size = 0;
+      }
+      ready_heap_array_size = count;
+   }
+
+   ready_heap_count = count;
+   ready_heaps[0].exit = NULL;
+   ready_heaps[0].count = 0;
+
+   for (int ip = block->start_ip; ip <= block->end_ip; ip++) {
+      if (nodes[ip]->inst->opcode == FS_OPCODE_DISCARD_JUMP) {
+         ready_heaps[nodes[ip]->ready_heap_index].exit = nodes[ip];
+         ready_heaps[nodes[ip]->ready_heap_index].count = 0;
+      }
+   }
+}
+
+struct ready_heap *
+instruction_scheduler::get_ready_heap(schedule_node *n)
+{
+   return &ready_heaps[n->exit ? n->exit->ready_heap_index : 0];
+}
+
+void
+instruction_scheduler::add_candidate(schedule_node *n)
+{
+   struct ready_heap *heap = get_ready_heap(n);
+
+   if (heap->count == heap->size) {
+      heap->size = MAX2(16, heap->size * 2);
+      heap->nodes = reralloc(mem_ctx, heap->nodes, schedule_node *,
+                             heap->size);
+   }
+
+   if (update_benefits)
+      n->register_pressure_benefit = get_register_pressure_benefit(n->inst);
+
+   heap->nodes[heap->count++] = n;
+   ready_heap_sift_up(heap, heap->count - 1, candidate_less);
+}
+
+void
+instruction_scheduler::remove_candidate(schedule_node *n)
+{
+   struct ready_heap *heap = get_ready_heap(n);
+
+   /* Only the chosen candidates get removed, which are at the top. */
+   assert(heap->count > 0 && heap->nodes[0] == n);
+
+   n->ready_heap_pos = -1;
+   heap->nodes[0] = heap->nodes[--heap->count];
+   if (heap->count > 0)
+      ready_heap_sift_down(heap, 0, candidate_less);
+}
+
+/**
+ * Moves a candidate up its ready heap after the scheduled instructions
+ * changed its register pressure benefit, which can only increase it.
+ */
+void
+instruction_scheduler::update_candidate(schedule_node *n)
+{
+   const int benefit = get_register_pressure_benefit(n->inst);
+
+   assert(benefit >= n->register_pressure_benefit);
+   n->register_pressure_benefit = benefit;
+   ready_heap_sift_up(get_ready_heap(n), n->ready_heap_pos, candidate_less);
+}
+
+/** Restores the ordering after changing the unblocked_time of candidates. */
+void
+instruction_scheduler::rebuild_ready_heaps()
+{
+   for (int i = 0; i < ready_heap_count; i++) {
+      for (int j = ready_heaps[i].count / 2 - 1; j >= 0; j--)
+         ready_heap_sift_down(&ready_heaps[i], j, candidate_less);
+   }
+}
+
+/**
+ * Returns the first candidate according to candidate_less.
+ */
+schedule_node *
+instruction_scheduler::choose_from_ready_heaps()
+{
+   schedule_node *chosen = NULL;
+
+   for (int i = 0; i < ready_heap_count; i++) {
+      if (ready_heaps[i].count == 0)
+         continue;
+
+      schedule_node *n = ready_heaps[i].nodes[0];
+      if (!chosen || candidate_less(n, chosen))
+         chosen = n;
+   }
+
+   return chosen;
+}
+
 void
 instruction_scheduler::schedule_instructions(bblock_t *block)
 {
@@ -1570,11 +2040,21 @@ instruction_scheduler::schedule_instructions(bblock_t *block)
       reg_pressure = reg_pressure_in[block->num];
    block_idx = block->num;
 
+   if (use_ready_heaps)
+      setup_ready_heaps(block);
+
    /* Remove non-DAG heads from the list. */
+   int ready_rank = 0;
    foreach_in_list_safe(schedule_node, n, &instructions) {
-      if (n->parent_count != 0)
+      if (n->parent_count != 0) {
          n->remove();
+      } else {
+         n->ready_rank = ready_rank++;
+         if (use_ready_heaps)
+            add_candidate(n);
+      }
    }
+   next_ready_rank = -1;
 
    unsigned cand_generation = 1;
    while (!instructions.is_empty()) {
@@ -1583,6 +2063,8 @@ instruction_scheduler::schedule_instructions(bblock_t *block)
       /* Schedule this instruction. */
       assert(chosen);
       chosen->remove();
+      if (use_ready_heaps)
+         remove_candidate(chosen);
       chosen->inst->exec_node::remove();
       block->instructions.push_tail(chosen->inst);
       instructions_to_schedule--;
@@ -1634,7 +2116,10 @@ instruction_scheduler::schedule_instructions(bblock_t *block)
             if (debug) {
                fprintf(stderr, "\t\tnow available\n");
             }
+            child->ready_rank = next_ready_rank--;
             instructions.push_head(child);
+            if (use_ready_heaps)
+               add_candidate(child);
          }
       }
       cand_generation++;
@@ -1650,6 +2135,10 @@ instruction_scheduler::schedule_instructions(bblock_t *block)
                n->unblocked_time = MAX2(n->unblocked_time,
                                         time + chosen->latency);
          }
+
+         /* Only the latency heuristics look at the unblocked times. */
+         if (use_ready_heaps && candidate_less == latency_candidate_less)
+            rebuild_ready_heaps();
       }
    }
 
@@ -1683,8 +2172,28 @@ instruction_scheduler::run(cfg_t *cfg)
          bs->dump_instructions();
    }
 
-   if (!post_reg_alloc)
-      setup_liveness(cfg);
+   if (!nodes)
+      build_dags(cfg);
+
+   /* The ready heaps can keep the candidates sorted for all the heuristics
+    * but the Gen4-6 LIFO one, whose preference for instructions which don't
+    * write many registers depends on which candidate is compared first.
+    */
+   use_ready_heaps = !(mode == SCHEDULE_PRE_LIFO && bs->devinfo->gen < 7);
+
+   switch (mode) {
+   case SCHEDULE_PRE_NON_LIFO:
+      candidate_less = non_lifo_candidate_less;
+      break;
+   case SCHEDULE_PRE_LIFO:
+      candidate_less = lifo_candidate_less;
+      break;
+   default:
+      candidate_less = latency_candidate_less;
+      break;
+   }
+   update_benefits = use_ready_heaps &&
+                     candidate_less != latency_candidate_less;
 
    foreach_block(block, cfg) {
       if (reads_remaining) {
@@ -1698,12 +2207,10 @@ instruction_scheduler::run(cfg_t *cfg)
             count_reads_remaining(inst);
       }
 
-      add_insts_from_block(block);
+      reset_block_dag(block);
 
-      calculate_deps();
-
-      compute_delays();
-      compute_exits();
+      if (update_benefits)
+         index_register_refs();
 
       schedule_instructions(block);
    }
@@ -1736,6 +2243,38 @@ fs_visitor::schedule_instructions(instruction_scheduler_mode mode)
    invalidate_live_intervals();
 }
 
+/**
+ * Returns a pre-register-allocation scheduler which can schedule the
+ * instructions with several heuristics in turn, building the dependency DAG
+ * only once.  It must be thrown away if anything else than the scheduler
+ * changes the instructions.
+ */
+instruction_scheduler *
+fs_visitor::prepare_scheduler(void *mem_ctx)
+{
+   calculate_live_intervals();
+
+   return new(mem_ctx) fs_instruction_scheduler(this, alloc.count,
+                                                first_non_payload_grf,
+                                                cfg->num_blocks,
+                                                SCHEDULE_PRE);
+}
+
+void
+fs_visitor::schedule_instructions_pre_ra(instruction_scheduler *sched,
+                                         instruction_scheduler_mode mode)
+{
+   assert(mode != SCHEDULE_POST);
+
+   /* The register pressure tracking uses the live intervals from when the
+    * scheduler was prepared, as does the DAG.
+    */
+   sched->mode = mode;
+   sched->run(cfg);
+
+   invalidate_live_intervals();
+}
+
 void
 vec4_visitor::opt_schedule_instructions()
 {
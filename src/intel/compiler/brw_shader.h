@@ -188,6 +188,8 @@ enum instruction_scheduler_mode {
    SCHEDULE_POST,
 };
 
+class instruction_scheduler;
+
 struct backend_shader {
 protected:
 
@@ -0,0 +1,339 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that compiling the SIMD variants of a shader on the threads of the
+ * compiler gives the same program as compiling them one after the other.
+ */
+
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "brw_compiler.h"
+#include "brw_nir.h"
+#include "common/gen_debug.h"
+#include "compiler/nir/nir_builder.h"
+#include "dev/gen_device_info.h"
+
+/* Enough for the threads to get a chance to race with each other. */
+#define NUM_ITERATIONS 20
+
+class parallel_compile_test : public ::testing::Test {
+   virtual void SetUp();
+   virtual void TearDown();
+
+public:
+   void *mem_ctx;
+   struct gen_device_info devinfo;
+   struct brw_compiler *compiler;
+   uint64_t old_intel_debug;
+};
+
+static pthread_t test_thread;
+static std::vector<std::string> perf_log;
+
+static void
+discard_log(void *, const char *, ...)
+{
+}
+
+static void
+record_perf_log(void *, const char *fmt, ...)
+{
+   /* The callbacks don't have to be thread-safe. */
+   EXPECT_TRUE(pthread_equal(pthread_self(), test_thread));
+
+   va_list va;
+   va_start(va, fmt);
+   char *msg = ralloc_vasprintf(NULL, fmt, va);
+   va_end(va);
+
+   perf_log.push_back(msg);
+   ralloc_free(msg);
+}
+
+void parallel_compile_test::SetUp()
+{
+   mem_ctx = ralloc_context(NULL);
+
+   /* Skylake GT2 */
+   ASSERT_TRUE(gen_get_device_info(0x1912, &devinfo));
+
+   setenv("INTEL_COMPILE_THREADS", "2", 1);
+   compiler = brw_compiler_create(mem_ctx, &devinfo);
+   compiler->shader_debug_log = discard_log;
+   compiler->shader_perf_log = record_perf_log;
+   test_thread = pthread_self();
+   perf_log.clear();
+   ASSERT_TRUE(compiler->compile_queue != NULL);
+
+   /* Compile all the variants. */
+   old_intel_debug = INTEL_DEBUG;
+   INTEL_DEBUG |= DEBUG_DO32;
+}
+
+void parallel_compile_test::TearDown()
+{
+   INTEL_DEBUG = old_intel_debug;
+   ralloc_free(mem_ctx);
+}
+
+static nir_ssa_def *
+load_uniform_vec4(nir_builder *b)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_load_uniform);
+   load->num_components = 4;
+   load->src[0] = nir_src_for_ssa(nir_imm_int(b, 0));
+   nir_intrinsic_set_base(load, 0);
+   nir_intrinsic_set_range(load, 16);
+   nir_ssa_dest_init(&load->instr, &load->dest, 4, 32, NULL);
+   nir_builder_instr_insert(b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+static void
+init_params(void *mem_ctx, struct brw_stage_prog_data *prog_data)
+{
+   prog_data->nr_params = 4;
+   prog_data->param = rzalloc_array(mem_ctx, uint32_t, 4);
+   for (unsigned i = 0; i < 4; i++)
+      prog_data->param[i] = (1 << 16) + i;
+}
+
+static void
+expect_same_stage_prog_data(const struct brw_stage_prog_data *a,
+                            const struct brw_stage_prog_data *b)
+{
+   EXPECT_EQ(a->program_size, b->program_size);
+   EXPECT_EQ(a->nr_params, b->nr_params);
+   EXPECT_EQ(a->nr_pull_params, b->nr_pull_params);
+   EXPECT_EQ(a->curb_read_length, b->curb_read_length);
+   EXPECT_EQ(a->total_scratch, b->total_scratch);
+   EXPECT_EQ(a->dispatch_grf_start_reg, b->dispatch_grf_start_reg);
+
+   for (unsigned i = 0; i < MIN2(a->nr_params, b->nr_params); i++)
+      EXPECT_EQ(a->param[i], b->param[i]);
+}
+
+static nir_shader *
+create_fs(struct brw_compiler *compiler, void *mem_ctx)
+{
+   nir_builder b;
+   nir_builder_init_simple_shader(&b, mem_ctx, MESA_SHADER_FRAGMENT,
+      compiler->glsl_compiler_options[MESA_SHADER_FRAGMENT].NirOptions);
+   b.shader->num_uniforms = 16;
+
+   nir_variable *color =
+      nir_variable_create(b.shader, nir_var_shader_out, glsl_vec4_type(),
+                          "color");
+   color->data.location = FRAG_RESULT_DATA0;
+
+   nir_ssa_def *uniform = load_uniform_vec4(&b);
+   nir_ssa_def *value = nir_fmul(&b, uniform, uniform);
+   nir_store_var(&b, color, nir_fsin(&b, value), 0xf);
+
+   return brw_preprocess_nir(compiler, b.shader);
+}
+
+static nir_shader *
+create_discard_fs(struct brw_compiler *compiler, void *mem_ctx)
+{
+   nir_builder b;
+   nir_builder_init_simple_shader(&b, mem_ctx, MESA_SHADER_FRAGMENT,
+      compiler->glsl_compiler_options[MESA_SHADER_FRAGMENT].NirOptions);
+   b.shader->num_uniforms = 16;
+
+   nir_variable *color =
+      nir_variable_create(b.shader, nir_var_shader_out, glsl_vec4_type(),
+                          "color");
+   color->data.location = FRAG_RESULT_DATA0;
+
+   nir_ssa_def *uniform = load_uniform_vec4(&b);
+   nir_intrinsic_instr *discard =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_discard_if);
+   discard->src[0] =
+      nir_src_for_ssa(nir_flt(&b, nir_channel(&b, uniform, 0),
+                              nir_imm_float(&b, 0.0)));
+   nir_builder_instr_insert(&b, &discard->instr);
+   nir_store_var(&b, color, uniform, 0xf);
+
+   b.shader->info.fs.uses_discard = true;
+
+   return brw_preprocess_nir(compiler, b.shader);
+}
+
+static const unsigned *
+compile_fs(struct brw_compiler *compiler, void *mem_ctx,
+           const nir_shader *shader, struct brw_wm_prog_data *prog_data)
+{
+   struct brw_wm_prog_key key;
+   memset(&key, 0, sizeof(key));
+   key.nr_color_regions = 1;
+
+   memset(prog_data, 0, sizeof(*prog_data));
+   init_params(mem_ctx, &prog_data->base);
+
+   return brw_compile_fs(compiler, NULL, mem_ctx, &key, prog_data, shader,
+                         NULL, -1, -1, -1, true, false, NULL, NULL);
+}
+
+static nir_shader *
+create_cs(struct brw_compiler *compiler, void *mem_ctx)
+{
+   nir_builder b;
+   nir_builder_init_simple_shader(&b, mem_ctx, MESA_SHADER_COMPUTE,
+      compiler->glsl_compiler_options[MESA_SHADER_COMPUTE].NirOptions);
+   b.shader->num_uniforms = 16;
+   b.shader->info.cs.local_size[0] = 64;
+   b.shader->info.cs.local_size[1] = 1;
+   b.shader->info.cs.local_size[2] = 1;
+
+   nir_ssa_def *index = nir_load_local_invocation_index(&b);
+   nir_ssa_def *value = nir_fmul(&b, nir_channel(&b, load_uniform_vec4(&b), 0),
+                                 nir_u2f32(&b, index));
+
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(b.shader, nir_intrinsic_store_ssbo);
+   store->num_components = 1;
+   store->src[0] = nir_src_for_ssa(value);
+   store->src[1] = nir_src_for_ssa(nir_imm_int(&b, 0));
+   store->src[2] = nir_src_for_ssa(nir_imul(&b, index, nir_imm_int(&b, 4)));
+   nir_intrinsic_set_write_mask(store, 0x1);
+   nir_builder_instr_insert(&b, &store->instr);
+
+   return brw_preprocess_nir(compiler, b.shader);
+}
+
+static const unsigned *
+compile_cs(struct brw_compiler *compiler, void *mem_ctx,
+           const nir_shader *shader, struct brw_cs_prog_data *prog_data)
+{
+   struct brw_cs_prog_key key;
+   memset(&key, 0, sizeof(key));
+
+   memset(prog_data, 0, sizeof(*prog_data));
+   init_params(mem_ctx, &prog_data->base);
+
+   return brw_compile_cs(compiler, NULL, mem_ctx, &key, prog_data, shader,
+                         -1, NULL);
+}
+
+TEST_F(parallel_compile_test, fs)
+{
+   nir_shader *shader = create_fs(compiler, mem_ctx);
+
+   struct brw_compile_queue *queue = compiler->compile_queue;
+   struct brw_wm_prog_data serial_prog_data;
+   compiler->compile_queue = NULL;
+   const unsigned *serial =
+      compile_fs(compiler, mem_ctx, shader, &serial_prog_data);
+   compiler->compile_queue = queue;
+
+   ASSERT_TRUE(serial != NULL);
+   ASSERT_TRUE(serial_prog_data.dispatch_8);
+   ASSERT_TRUE(serial_prog_data.dispatch_16);
+   ASSERT_TRUE(serial_prog_data.dispatch_32);
+
+   for (unsigned i = 0; i < NUM_ITERATIONS; i++) {
+      struct brw_wm_prog_data prog_data;
+      const unsigned *program =
+         compile_fs(compiler, mem_ctx, shader, &prog_data);
+
+      ASSERT_TRUE(program != NULL);
+      expect_same_stage_prog_data(&serial_prog_data.base, &prog_data.base);
+      EXPECT_EQ(serial_prog_data.dispatch_16, prog_data.dispatch_16);
+      EXPECT_EQ(serial_prog_data.dispatch_32, prog_data.dispatch_32);
+      EXPECT_EQ(serial_prog_data.prog_offset_16, prog_data.prog_offset_16);
+      EXPECT_EQ(serial_prog_data.prog_offset_32, prog_data.prog_offset_32);
+      EXPECT_EQ(serial_prog_data.dispatch_grf_start_reg_16,
+                prog_data.dispatch_grf_start_reg_16);
+      EXPECT_EQ(serial_prog_data.dispatch_grf_start_reg_32,
+                prog_data.dispatch_grf_start_reg_32);
+      EXPECT_EQ(serial_prog_data.reg_blocks_8, prog_data.reg_blocks_8);
+      EXPECT_EQ(serial_prog_data.reg_blocks_16, prog_data.reg_blocks_16);
+      EXPECT_EQ(serial_prog_data.reg_blocks_32, prog_data.reg_blocks_32);
+      EXPECT_EQ(0, memcmp(serial, program,
+                          MIN2(serial_prog_data.base.program_size,
+                               prog_data.base.program_size)));
+   }
+}
+
+TEST_F(parallel_compile_test, cs)
+{
+   nir_shader *shader = create_cs(compiler, mem_ctx);
+
+   struct brw_compile_queue *queue = compiler->compile_queue;
+   struct brw_cs_prog_data serial_prog_data;
+   compiler->compile_queue = NULL;
+   const unsigned *serial =
+      compile_cs(compiler, mem_ctx, shader, &serial_prog_data);
+   compiler->compile_queue = queue;
+
+   ASSERT_TRUE(serial != NULL);
+   ASSERT_EQ(32u, serial_prog_data.simd_size);
+
+   for (unsigned i = 0; i < NUM_ITERATIONS; i++) {
+      struct brw_cs_prog_data prog_data;
+      const unsigned *program =
+         compile_cs(compiler, mem_ctx, shader, &prog_data);
+
+      ASSERT_TRUE(program != NULL);
+      expect_same_stage_prog_data(&serial_prog_data.base, &prog_data.base);
+      EXPECT_EQ(serial_prog_data.simd_size, prog_data.simd_size);
+      EXPECT_EQ(serial_prog_data.threads, prog_data.threads);
+      EXPECT_EQ(serial_prog_data.push.total.size, prog_data.push.total.size);
+      EXPECT_EQ(0, memcmp(serial, program,
+                          MIN2(serial_prog_data.base.program_size,
+                               prog_data.base.program_size)));
+   }
+}
+
+TEST_F(parallel_compile_test, perf_log)
+{
+   /* Discards limit the fragment shaders to SIMD16, which the SIMD8 and
+    * SIMD16 variants both report.
+    */
+   nir_shader *shader = create_discard_fs(compiler, mem_ctx);
+
+   struct brw_compile_queue *queue = compiler->compile_queue;
+   struct brw_wm_prog_data serial_prog_data;
+   compiler->compile_queue = NULL;
+   ASSERT_TRUE(compile_fs(compiler, mem_ctx, shader, &serial_prog_data));
+   compiler->compile_queue = queue;
+
+   ASSERT_TRUE(serial_prog_data.dispatch_16);
+   ASSERT_FALSE(serial_prog_data.dispatch_32);
+   std::vector<std::string> serial_perf_log = perf_log;
+   ASSERT_EQ(2u, serial_perf_log.size());
+
+   for (unsigned i = 0; i < NUM_ITERATIONS; i++) {
+      struct brw_wm_prog_data prog_data;
+
+      perf_log.clear();
+      ASSERT_TRUE(compile_fs(compiler, mem_ctx, shader, &prog_data));
+      EXPECT_EQ(serial_perf_log, perf_log);
+   }
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include "brw_fs.h"
+#include "brw_cfg.h"
+#include "program/program.h"
+
+using namespace brw;
+
+class scheduling_test : public ::testing::Test {
+   virtual void SetUp();
+
+public:
+   struct brw_compiler *compiler;
+   struct gen_device_info *devinfo;
+   struct gl_context *ctx;
+   struct brw_wm_prog_data *prog_data;
+   struct gl_shader_program *shader_prog;
+   fs_visitor *v;
+};
+
+class scheduling_fs_visitor : public fs_visitor
+{
+public:
+   scheduling_fs_visitor(struct brw_compiler *compiler,
+                         struct brw_wm_prog_data *prog_data,
+                         nir_shader *shader)
+      : fs_visitor(compiler, NULL, NULL, NULL,
+                   &prog_data->base, (struct gl_program *) NULL,
+                   shader, 8, -1) {}
+};
+
+
+void scheduling_test::SetUp()
+{
+   ctx = (struct gl_context *)calloc(1, sizeof(*ctx));
+   compiler = (struct brw_compiler *)calloc(1, sizeof(*compiler));
+   devinfo = (struct gen_device_info *)calloc(1, sizeof(*devinfo));
+   compiler->devinfo = devinfo;
+
+   prog_data = ralloc(NULL, struct brw_wm_prog_data);
+   nir_shader *shader =
+      nir_shader_create(NULL, MESA_SHADER_FRAGMENT, NULL, NULL);
+
+   v = new scheduling_fs_visitor(compiler, prog_data, shader);
+
+   devinfo->gen = 7;
+}
+
+static void
+schedule(fs_visitor *v, instruction_scheduler_mode mode)
+{
+   const bool print = getenv("TEST_DEBUG");
+
+   if (print) {
+      fprintf(stderr, "= Before =\n");
+      v->cfg->dump(v);
+   }
+
+   v->schedule_instructions(mode);
+
+   if (print) {
+      fprintf(stderr, "\n= After =\n");
+      v->cfg->dump(v);
+   }
+}
+
+/* Returns the instructions of the first block, in order. */
+static std::vector<fs_inst *>
+instructions(fs_visitor *v)
+{
+   std::vector<fs_inst *> insts;
+
+   foreach_inst_in_block(fs_inst, inst, v->cfg->blocks[0])
+      insts.push_back(inst);
+
+   return insts;
+}
+
+TEST_F(scheduling_test, independent_keep_order)
+{
+   const fs_builder &bld = v->bld;
+   fs_reg dst[4], src[4];
+   std::vector<fs_inst *> expected;
+
+   for (int i = 0; i < 4; i++) {
+      dst[i] = v->vgrf(glsl_type::float_type);
+      src[i] = v->vgrf(glsl_type::float_type);
+      expected.push_back(bld.MOV(dst[i], src[i]));
+   }
+
+   v->calculate_cfg();
+   schedule(v, SCHEDULE_PRE);
+
+   EXPECT_EQ(expected, instructions(v));
+}
+
+TEST_F(scheduling_test, hide_math_latency)
+{
+   const fs_builder &bld = v->bld;
+   fs_reg a = v->vgrf(glsl_type::float_type);
+   fs_reg b = v->vgrf(glsl_type::float_type);
+   fs_reg c = v->vgrf(glsl_type::float_type);
+   fs_reg d = v->vgrf(glsl_type::float_type);
+   fs_reg x = v->vgrf(glsl_type::float_type);
+   fs_reg y = v->vgrf(glsl_type::float_type);
+   fs_reg z = v->vgrf(glsl_type::float_type);
+   fs_reg w = v->vgrf(glsl_type::float_type);
+
+   fs_inst *rcp = bld.emit(SHADER_OPCODE_RCP, a, x);
+   fs_inst *add = bld.ADD(b, a, y);
+   fs_inst *mov0 = bld.MOV(c, z);
+   fs_inst *mov1 = bld.MOV(d, w);
+
+   /* = Before =
+    *
+    * 0: rcp(8)  a  x
+    * 1: add(8)  b  a  y
+    * 2: mov(8)  c  z
+    * 3: mov(8)  d  w
+    *
+    * = After =
+    * 0: rcp(8)  a  x
+    * 1: mov(8)  c  z
+    * 2: mov(8)  d  w
+    * 3: add(8)  b  a  y
+    */
+
+   v->calculate_cfg();
+   schedule(v, SCHEDULE_PRE);
+
+   std::vector<fs_inst *> expected = { rcp, mov0, mov1, add };
+   EXPECT_EQ(expected, instructions(v));
+}
+
+TEST_F(scheduling_test, exit_first)
+{
+   const fs_builder &bld = v->bld;
+   fs_reg a = v->vgrf(glsl_type::float_type);
+   fs_reg b = v->vgrf(glsl_type::float_type);
+   fs_reg x = v->vgrf(glsl_type::float_type);
+   fs_reg y = v->vgrf(glsl_type::float_type);
+   fs_reg zero(brw_imm_f(0.0f));
+
+   fs_inst *mov0 = bld.MOV(a, x);
+   fs_inst *mov1 = bld.MOV(b, x);
+   fs_inst *cmp = bld.CMP(bld.null_reg_f(), y, zero, BRW_CONDITIONAL_L);
+   fs_inst *jump = bld.emit(FS_OPCODE_DISCARD_JUMP);
+   jump->predicate = BRW_PREDICATE_NORMAL;
+
+   /* = Before =
+    *
+    * 0: mov(8)         a     x
+    * 1: mov(8)         b     x
+    * 2: cmp.l.f0(8)    null  y  0.0f
+    * 3: (+f0) discard_jump(8)
+    *
+    * = After =
+    * 0: cmp.l.f0(8)    null  y  0.0f
+    * 1: (+f0) discard_jump(8)
+    * 2: mov(8)         a     x
+    * 3: mov(8)         b     x
+    */
+
+   v->calculate_cfg();
+   schedule(v, SCHEDULE_PRE);
+
+   std::vector<fs_inst *> expected = { cmp, jump, mov0, mov1 };
+   EXPECT_EQ(expected, instructions(v));
+}
+
+TEST_F(scheduling_test, two_exits)
+{
+   const fs_builder &bld = v->bld;
+   fs_reg a = v->vgrf(glsl_type::float_type);
+   fs_reg b = v->vgrf(glsl_type::float_type);
+   fs_reg c = v->vgrf(glsl_type::float_type);
+   fs_reg x = v->vgrf(glsl_type::float_type);
+   fs_reg y = v->vgrf(glsl_type::float_type);
+   fs_reg zero(brw_imm_f(0.0f));
+
+   fs_inst *mov = bld.MOV(c, x);
+   fs_inst *sqrt = bld.emit(SHADER_OPCODE_SQRT, a, x);
+   fs_inst *cmp0 = bld.CMP(bld.null_reg_f(), a, zero, BRW_CONDITIONAL_L);
+   fs_inst *jump0 = bld.emit(FS_OPCODE_DISCARD_JUMP);
+   jump0->predicate = BRW_PREDICATE_NORMAL;
+   fs_inst *add = bld.ADD(b, y, y);
+   fs_inst *cmp1 = bld.CMP(bld.null_reg_f(), b, zero, BRW_CONDITIONAL_L);
+   fs_inst *jump1 = bld.emit(FS_OPCODE_DISCARD_JUMP);
+   jump1->predicate = BRW_PREDICATE_NORMAL;
+
+   /* = Before =
+    *
+    * 0: mov(8)         c     x
+    * 1: sqrt(8)        a     x
+    * 2: cmp.l.f0(8)    null  a  0.0f
+    * 3: (+f0) discard_jump(8)
+    * 4: add(8)         b     y  y
+    * 5: cmp.l.f0(8)    null  b  0.0f
+    * 6: (+f0) discard_jump(8)
+    *
+    * = After =
+    * 0: sqrt(8)        a     x
+    * 1: cmp.l.f0(8)    null  a  0.0f
+    * 2: (+f0) discard_jump(8)
+    * 3: add(8)         b     y  y
+    * 4: cmp.l.f0(8)    null  b  0.0f
+    * 5: (+f0) discard_jump(8)
+    * 6: mov(8)         c     x
+    *
+    * The candidates of each jump are in their own ready heap, and the mov,
+    * which leads to no jump, is scheduled last.
+    */
+
+   v->calculate_cfg();
+   schedule(v, SCHEDULE_PRE);
+
+   std::vector<fs_inst *> expected = {
+      sqrt, cmp0, jump0, add, cmp1, jump1, mov
+   };
+   EXPECT_EQ(expected, instructions(v));
+}
+
+TEST_F(scheduling_test, gen5_math_in_order)
+{
+   const fs_builder &bld = v->bld;
+   fs_reg a = v->vgrf(glsl_type::float_type);
+   fs_reg b = v->vgrf(glsl_type::float_type);
+   fs_reg c = v->vgrf(glsl_type::float_type);
+   fs_reg d = v->vgrf(glsl_type::float_type);
+   fs_reg x = v->vgrf(glsl_type::float_type);
+   fs_reg y = v->vgrf(glsl_type::float_type);
+
+   devinfo->gen = 5;
+
+   /* Each math instruction delays the others until it's done, which reorders
+    * the candidates already waiting.
+    */
+   fs_inst *rcp = bld.emit(SHADER_OPCODE_RCP, a, x);
+   fs_inst *sqrt = bld.emit(SHADER_OPCODE_SQRT, b, y);
+   fs_inst *add = bld.ADD(c, x, y);
+   fs_inst *mul = bld.MUL(d, a, b);
+
+   v->calculate_cfg();
+   schedule(v, SCHEDULE_PRE);
+
+   std::vector<fs_inst *> expected = { rcp, add, sqrt, mul };
+   EXPECT_EQ(expected, instructions(v));
+}
+
+TEST_F(scheduling_test, last_read_promoted)
+{
+   const fs_builder &bld = v->bld;
+   fs_reg a = v->vgrf(glsl_type::float_type);
+   fs_reg b = v->vgrf(glsl_type::float_type);
+   fs_reg c = v->vgrf(glsl_type::float_type);
+   fs_reg d = v->vgrf(glsl_type::float_type);
+   fs_reg x = v->vgrf(glsl_type::float_type);
+   fs_reg y = v->vgrf(glsl_type::float_type);
+   fs_reg z[4];
+
+   for (int i = 0; i < 4; i++)
+      z[i] = v->vgrf(glsl_type::float_type);
+
+   fs_inst *add0 = bld.ADD(a, x, z[0]);
+   fs_inst *add1 = bld.ADD(b, y, z[1]);
+   fs_inst *add2 = bld.ADD(c, x, z[2]);
+   fs_inst *add3 = bld.ADD(d, y, z[3]);
+
+   /* = Before =
+    *
+    * 0: add(8)  a  x  z0
+    * 1: add(8)  b  y  z1
+    * 2: add(8)  c  x  z2
+    * 3: add(8)  d  y  z3
+    *
+    * = After =
+    * 0: add(8)  a  x  z0
+    * 1: add(8)  c  x  z2
+    * 2: add(8)  b  y  z1
+    * 3: add(8)  d  y  z3
+    *
+    * Once the first add is scheduled, the last read of x frees a register,
+    * which moves the third one ahead of the candidates already waiting in
+    * the heap.
+    */
+
+   v->calculate_cfg();
+   schedule(v, SCHEDULE_PRE_NON_LIFO);
+
+   std::vector<fs_inst *> expected = { add0, add2, add1, add3 };
+   EXPECT_EQ(expected, instructions(v));
+}
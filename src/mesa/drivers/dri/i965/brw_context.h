@@ -1662,7 +1662,7 @@ brw_get_program_binary_driver_sha1(struct gl_context *ctx, uint8_t *sha1);
 void brw_serialize_program_binary(struct gl_context *ctx,
                                   struct gl_shader_program *sh_prog,
                                   struct gl_program *prog);
-extern void
+extern bool
 brw_deserialize_program_binary(struct gl_context *ctx,
                                struct gl_shader_program *shProg,
                                struct gl_program *prog);
@@ -235,12 +235,13 @@ brw_program_deserialize_driver_blob(struct gl_context *ctx,
 /* This is just a wrapper around brw_program_deserialize_nir() as i965
  * doesn't need gl_shader_program like other drivers do.
  */
-void
+bool
 brw_deserialize_program_binary(struct gl_context *ctx,
                                struct gl_shader_program *shProg,
                                struct gl_program *prog)
 {
    brw_program_deserialize_driver_blob(ctx, prog, prog->info.stage);
+   return true;
 }
 
 static void
@@ -1222,7 +1222,11 @@ struct dd_function_table {
                                             struct gl_shader_program *shProg,
                                             struct gl_program *prog);
 
-   void (*ProgramBinaryDeserializeDriverBlob)(struct gl_context *ctx,
+   /**
+    * Returns false if the driver blob is invalid, which makes
+    * glProgramBinary fail.
+    */
+   bool (*ProgramBinaryDeserializeDriverBlob)(struct gl_context *ctx,
                                               struct gl_shader_program *shProg,
                                               struct gl_program *prog);
    /*@}*/
@@ -40,6 +40,125 @@
 #include "util/hash_table.h"
 
 
+/*
+ * The array, and the objects stored in it, are published to the lookups that
+ * don't hold the mutex with release stores, and read by them with acquire
+ * loads.  p_atomic_set() and p_atomic_read() only have these semantics with
+ * USE_GCC_ATOMIC_BUILTINS, so the barriers are explicit.  Without a way to
+ * order the accesses, the lookups take the mutex.
+ */
+#if defined(USE_GCC_ATOMIC_BUILTINS)
+#define HASH_LOCK_FREE_LOOKUP
+#define hash_load_acquire(ptr) __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define hash_store_release(ptr, value) \
+   __atomic_store_n((ptr), (value), __ATOMIC_RELEASE)
+#elif defined(__GNUC__)
+#define HASH_LOCK_FREE_LOOKUP
+#define hash_load_acquire(ptr) __extension__ ({                            \
+   __typeof__(*(ptr)) _value = *(volatile __typeof__(*(ptr)) *)(ptr);      \
+   __sync_synchronize();                                                   \
+   _value;                                                                 \
+})
+#define hash_store_release(ptr, value) do {                                \
+   __sync_synchronize();                                                   \
+   *(volatile __typeof__(*(ptr)) *)(ptr) = (value);                        \
+} while (0)
+#else
+#define hash_load_acquire(ptr) (*(ptr))
+#define hash_store_release(ptr, value) (*(ptr) = (value))
+#endif
+
+
+/** Size of the array of a new table, enough for most of them. */
+#define HASH_ARRAY_MIN_SIZE 64
+
+/**
+ * Keys at or above this never go into the array, to bound its size when an
+ * application generates lots of names.
+ */
+#define HASH_ARRAY_MAX_SIZE (1 << 20)
+
+/**
+ * Dense storage of the objects of the keys below \c Size, indexed by key.
+ */
+struct _mesa_HashArray {
+   /**
+    * Array this one replaced when growing.  Lookups that don't hold the
+    * mutex may still be reading it, so it is only freed with the table.
+    */
+   struct _mesa_HashArray *Retired;
+   GLuint Size;
+   void *Data[];
+};
+
+
+static struct _mesa_HashArray *
+hash_array_create(GLuint size, struct _mesa_HashArray *retired)
+{
+   struct _mesa_HashArray *array =
+      calloc(1, sizeof(*array) + size * sizeof(array->Data[0]));
+
+   if (array) {
+      array->Retired = retired;
+      array->Size = size;
+   }
+
+   return array;
+}
+
+
+static void
+hash_array_destroy(struct _mesa_HashArray *array)
+{
+   while (array) {
+      struct _mesa_HashArray *retired = array->Retired;
+      free(array);
+      array = retired;
+   }
+}
+
+
+/**
+ * Double the size of the array so that it covers \p key, moving the objects
+ * of the keys it newly covers out of the hash table.
+ *
+ * The new array is published only once it is complete, so lookups that
+ * don't hold the mutex see either the old or the new one.
+ *
+ * \return the current array, which is the old one if we ran out of memory.
+ */
+static struct _mesa_HashArray *
+hash_array_grow(struct _mesa_HashTable *table, GLuint key)
+{
+   struct _mesa_HashArray *old_array = table->Array;
+   struct _mesa_HashArray *array;
+   struct hash_entry *entry;
+
+   assert(key < 2 * old_array->Size);
+
+   array = hash_array_create(2 * old_array->Size, old_array);
+   if (!array)
+      return old_array;
+
+   memcpy(array->Data, old_array->Data,
+          old_array->Size * sizeof(array->Data[0]));
+
+   hash_table_foreach(table->ht, entry) {
+      GLuint entry_key = (uintptr_t)entry->key;
+
+      if (entry_key < array->Size) {
+         array->Data[entry_key] = entry->data;
+         if (entry->data)
+            table->ArrayEntries++;
+         _mesa_hash_table_remove(table->ht, entry);
+      }
+   }
+
+   hash_store_release(&table->Array, array);
+   return array;
+}
+
+
 /**
  * Create a new hash table.
  * 
@@ -59,6 +178,14 @@ _mesa_NewHashTable(void)
          return NULL;
       }
 
+      table->Array = hash_array_create(HASH_ARRAY_MIN_SIZE, NULL);
+      if (table->Array == NULL) {
+         _mesa_hash_table_destroy(table->ht, NULL);
+         free(table);
+         _mesa_error_no_memory(__func__);
+         return NULL;
+      }
+
       _mesa_hash_table_set_deleted_key(table->ht, uint_key(DELETED_KEY_VALUE));
       /*
        * Needs to be recursive, since the callback in _mesa_HashWalk()
@@ -88,11 +215,13 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 {
    assert(table);
 
-   if (_mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
+   if (table->ArrayEntries ||
+       _mesa_hash_table_next_entry(table->ht, NULL) != NULL) {
       _mesa_problem(NULL, "In _mesa_DeleteHashTable, found non-freed data");
    }
 
    _mesa_hash_table_destroy(table->ht, NULL);
+   hash_array_destroy(table->Array);
 
    mtx_destroy(&table->Mutex);
    free(table);
@@ -107,13 +236,14 @@ _mesa_DeleteHashTable(struct _mesa_HashTable *table)
 static inline void *
 _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
 {
+   const struct _mesa_HashArray *array = table->Array;
    const struct hash_entry *entry;
 
    assert(table);
    assert(key);
 
-   if (key == DELETED_KEY_VALUE)
-      return table->deleted_key_data;
+   if (key < array->Size)
+      return array->Data[key];
 
    entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                               uint_hash(key),
@@ -132,11 +262,23 @@ _mesa_HashLookup_unlocked(struct _mesa_HashTable *table, GLuint key)
  * \param key the key.
  * 
  * \return pointer to user's data or NULL if key not in table
+ *
+ * The keys covered by the array are looked up without taking the mutex.
  */
 void *
 _mesa_HashLookup(struct _mesa_HashTable *table, GLuint key)
 {
    void *res;
+
+   assert(key);
+
+#ifdef HASH_LOCK_FREE_LOOKUP
+   const struct _mesa_HashArray *array = hash_load_acquire(&table->Array);
+
+   if (key < array->Size)
+      return hash_load_acquire(&array->Data[key]);
+#endif
+
    _mesa_HashLockMutex(table);
    res = _mesa_HashLookup_unlocked(table, key);
    _mesa_HashUnlockMutex(table);
@@ -165,6 +307,7 @@ _mesa_HashLookupLocked(struct _mesa_HashTable *table, GLuint key)
 static inline void
 _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
 {
+   struct _mesa_HashArray *array = table->Array;
    uint32_t hash = uint_hash(key);
    struct hash_entry *entry;
 
@@ -174,8 +317,16 @@ _mesa_HashInsert_unlocked(struct _mesa_HashTable *table, GLuint key, void *data)
    if (key > table->MaxKey)
       table->MaxKey = key;
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = data;
+   /* Grow the array when the key is right after it, which is what
+    * glGen*() does, and leave the sparse keys to the hash table.
+    */
+   if (key >= array->Size && key < 2 * array->Size &&
+       key < HASH_ARRAY_MAX_SIZE)
+      array = hash_array_grow(table, key);
+
+   if (key < array->Size) {
+      table->ArrayEntries += (data != NULL) - (array->Data[key] != NULL);
+      hash_store_release(&array->Data[key], data);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht, hash, uint_key(key));
       if (entry) {
@@ -244,8 +395,12 @@ _mesa_HashRemove_unlocked(struct _mesa_HashTable *table, GLuint key)
     */
    assert(!table->InDeleteAll);
 
-   if (key == DELETED_KEY_VALUE) {
-      table->deleted_key_data = NULL;
+   if (key < table->Array->Size) {
+      struct _mesa_HashArray *array = table->Array;
+
+      if (array->Data[key])
+         table->ArrayEntries--;
+      hash_store_release(&array->Data[key], NULL);
    } else {
       entry = _mesa_hash_table_search_pre_hashed(table->ht,
                                                  uint_hash(key),
@@ -288,14 +443,20 @@ _mesa_HashDeleteAll(struct _mesa_HashTable *table,
    assert(callback);
    _mesa_HashLockMutex(table);
    table->InDeleteAll = GL_TRUE;
+   for (GLuint key = 1; key < table->Array->Size; key++) {
+      struct _mesa_HashArray *array = table->Array;
+      void *data = array->Data[key];
+
+      if (data) {
+         callback(key, data, userData);
+         hash_store_release(&array->Data[key], NULL);
+      }
+   }
+   table->ArrayEntries = 0;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
       _mesa_hash_table_remove(table->ht, entry);
    }
-   if (table->deleted_key_data) {
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
-      table->deleted_key_data = NULL;
-   }
    table->InDeleteAll = GL_FALSE;
    _mesa_HashUnlockMutex(table);
 }
@@ -316,12 +477,20 @@ hash_walk_unlocked(const struct _mesa_HashTable *table,
    assert(table);
    assert(callback);
 
+   /* The callback may remove objects, and even insert some, so reload the
+    * array after each of them.
+    */
+   for (GLuint key = 1; key < table->Array->Size; key++) {
+      void *data = table->Array->Data[key];
+
+      if (data)
+         callback(key, data, userData);
+   }
+
    struct hash_entry *entry;
    hash_table_foreach(table->ht, entry) {
       callback((uintptr_t)entry->key, entry->data, userData);
    }
-   if (table->deleted_key_data)
-      callback(DELETED_KEY_VALUE, table->deleted_key_data, userData);
 }
 
 
@@ -360,8 +529,6 @@ debug_print_entry(GLuint key, void *data, void *userData)
 void
 _mesa_HashPrint(const struct _mesa_HashTable *table)
 {
-   if (table->deleted_key_data)
-      debug_print_entry(DELETED_KEY_VALUE, table->deleted_key_data, NULL);
    _mesa_HashWalk(table, debug_print_entry, NULL);
 }
 
@@ -418,12 +585,5 @@ _mesa_HashFindFreeKeyBlock(struct _mesa_HashTable *table, GLuint numKeys)
 GLuint
 _mesa_HashNumEntries(const struct _mesa_HashTable *table)
 {
-   GLuint count = 0;
-
-   if (table->deleted_key_data)
-      count++;
-
-   count += _mesa_hash_table_num_entries(table->ht);
-
-   return count;
+   return table->ArrayEntries + _mesa_hash_table_num_entries(table->ht);
 }
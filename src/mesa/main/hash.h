@@ -36,16 +36,20 @@
 #include "imports.h"
 #include "c11/threads.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /**
- * Magic GLuint object name that gets stored outside of the struct hash_table.
+ * Magic GLuint object name used as the deleted key of the struct hash_table.
  *
  * The hash table needs a particular pointer to be the marker for a key that
  * was deleted from the table, along with NULL for the "never allocated in the
  * table" marker.  Legacy GL allows any GLuint to be used as a GL object name,
- * and we use a 1:1 mapping from GLuints to key pointers, so we need to be
- * able to track a GLuint that happens to match the deleted key outside of
- * struct hash_table.  We tell the hash table to use "1" as the deleted key
- * value, so that we test the deleted-key-in-the-table path as best we can.
+ * and we use a 1:1 mapping from GLuints to key pointers, so the GLuint that
+ * happens to match the deleted key has to be tracked outside of struct
+ * hash_table.  Small keys always live in _mesa_HashTable::Array, so we tell
+ * the hash table to use "1" as the deleted key value.
  */
 #define DELETED_KEY_VALUE 1
 
@@ -93,16 +97,28 @@ uint_key(GLuint id)
 }
 /** @} */
 
+struct _mesa_HashArray;
+
 /**
  * The hash table data structure.
+ *
+ * GL object names are mostly small, dense integers handed out by glGen*(),
+ * so the keys below the size of \c Array are stored in that array, indexed
+ * by the key.  Only the keys above it, which come from applications picking
+ * sparse names themselves, are stored in \c ht.
+ *
+ * \c Array only grows, and is replaced by a bigger copy with the mutex held.
+ * The old copies are kept until the table is deleted, which lets
+ * _mesa_HashLookup() find the keys covered by the array without taking the
+ * mutex.
  */
 struct _mesa_HashTable {
-   struct hash_table *ht;
+   struct _mesa_HashArray *Array;        /**< objects of the small keys */
+   struct hash_table *ht;                /**< objects of the other keys */
    GLuint MaxKey;                        /**< highest key inserted so far */
+   GLuint ArrayEntries;                  /**< objects stored in Array */
    mtx_t Mutex;                          /**< mutual exclusion lock */
    GLboolean InDeleteAll;                /**< Debug check */
-   /** Value that would be in the table for DELETED_KEY_VALUE. */
-   void *deleted_key_data;
 };
 
 extern struct _mesa_HashTable *_mesa_NewHashTable(void);
@@ -175,5 +191,8 @@ _mesa_HashNumEntries(const struct _mesa_HashTable *table);
 
 extern void _mesa_test_hash_functions(void);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/**
+ * \name hash_table.cpp
+ *
+ * Exercise the GL object name table, both in the dense array covering the
+ * small names and in the hash table holding the sparse ones.
+ */
+
+#include <gtest/gtest.h>
+#include <thread>
+
+#include "main/hash.h"
+
+static void *
+value(GLuint key)
+{
+   return (void *)(uintptr_t)(2 * key + 1);
+}
+
+static void
+count_entry(GLuint key, void *data, void *userData)
+{
+   EXPECT_EQ(value(key), data);
+   (*(GLuint *)userData)++;
+}
+
+static void
+remove_entry(GLuint key, void *data, void *userData)
+{
+   _mesa_HashRemoveLocked((struct _mesa_HashTable *)userData, key);
+}
+
+class HashTableTest : public ::testing::Test {
+protected:
+   virtual void SetUp()
+   {
+      table = _mesa_NewHashTable();
+      ASSERT_TRUE(table != NULL);
+   }
+
+   virtual void TearDown()
+   {
+      _mesa_HashWalk(table, remove_entry, table);
+      EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+      _mesa_DeleteHashTable(table);
+   }
+
+   struct _mesa_HashTable *table;
+};
+
+TEST_F(HashTableTest, GenNames)
+{
+   for (unsigned i = 0; i < 10; i++) {
+      GLuint first = _mesa_HashFindFreeKeyBlock(table, 1000);
+      EXPECT_EQ(1 + 1000 * i, first);
+
+      for (GLuint key = first; key < first + 1000; key++)
+         _mesa_HashInsert(table, key, value(key));
+   }
+
+   EXPECT_EQ(10000u, _mesa_HashNumEntries(table));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 10001));
+   for (GLuint key = 1; key <= 10000; key++)
+      EXPECT_EQ(value(key), _mesa_HashLookup(table, key));
+
+   for (GLuint key = 1; key <= 10000; key += 2)
+      _mesa_HashRemove(table, key);
+
+   GLuint count = 0;
+   _mesa_HashWalk(table, count_entry, &count);
+   EXPECT_EQ(5000u, count);
+   EXPECT_EQ(5000u, _mesa_HashNumEntries(table));
+   for (GLuint key = 1; key <= 10000; key++)
+      EXPECT_EQ(key % 2 ? NULL : value(key), _mesa_HashLookup(table, key));
+}
+
+TEST_F(HashTableTest, SparseNames)
+{
+   static const GLuint keys[] = {
+      DELETED_KEY_VALUE, 200, 1000, 123456, 0x7fffffff, ~0u - 1,
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      _mesa_HashInsert(table, keys[i], value(keys[i]));
+
+   /* Filling the names below 200 moves it from the hash table to the array. */
+   for (GLuint key = 2; key < 200; key++)
+      _mesa_HashInsert(table, key, value(key));
+
+   for (GLuint key = 1; key < 200; key++)
+      EXPECT_EQ(value(key), _mesa_HashLookup(table, key));
+   for (unsigned i = 0; i < ARRAY_SIZE(keys); i++)
+      EXPECT_EQ(value(keys[i]), _mesa_HashLookup(table, keys[i]));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 201));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 0x80000000));
+   EXPECT_EQ(204u, _mesa_HashNumEntries(table));
+
+   _mesa_HashRemove(table, 200);
+   _mesa_HashRemove(table, 0x7fffffff);
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 200));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 0x7fffffff));
+
+   GLuint count = 0;
+   _mesa_HashWalk(table, count_entry, &count);
+   EXPECT_EQ(202u, count);
+
+   /* There is no room for another block after ~0u - 1. */
+   EXPECT_EQ(200u, _mesa_HashFindFreeKeyBlock(table, 10));
+}
+
+TEST_F(HashTableTest, DeleteAll)
+{
+   for (GLuint key = 1; key < 1000; key++)
+      _mesa_HashInsert(table, key, value(key));
+   _mesa_HashInsert(table, 1000000, value(1000000));
+
+   GLuint count = 0;
+   _mesa_HashDeleteAll(table, count_entry, &count);
+   EXPECT_EQ(1000u, count);
+   EXPECT_EQ(0u, _mesa_HashNumEntries(table));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 1));
+   EXPECT_EQ(NULL, _mesa_HashLookup(table, 1000000));
+}
+
+TEST_F(HashTableTest, LookupWhileGrowing)
+{
+   for (GLuint key = 1; key < 64; key++)
+      _mesa_HashInsert(table, key, value(key));
+
+   /* Lookups of the existing names have to keep working while another
+    * context generates new ones and the array is replaced.
+    */
+   std::thread reader([this]() {
+      for (unsigned i = 0; i < 1000; i++) {
+         for (GLuint key = 1; key < 64; key++)
+            ASSERT_EQ(value(key), _mesa_HashLookup(table, key));
+      }
+   });
+
+   for (GLuint key = 64; key < 100000; key++)
+      _mesa_HashInsert(table, key, value(key));
+
+   reader.join();
+   EXPECT_EQ(99999u, _mesa_HashNumEntries(table));
+}
@@ -26,14 +26,17 @@
  **************************************************************************/
 
 
+#include <inttypes.h>
 #include <stdio.h>
 #include "main/arrayobj.h"
 #include "main/glheader.h"
 #include "main/context.h"
 
 #include "pipe/p_defines.h"
+#include "util/os_time.h"
 #include "st_context.h"
 #include "st_atom.h"
+#include "st_debug.h"
 #include "st_program.h"
 #include "st_manager.h"
 
@@ -47,16 +50,85 @@ static const update_func_t update_functions[] =
 #undef ST_STATE
 };
 
+/* The names of the state update functions, for the statistics. */
+static const char *const update_names[] =
+{
+#define ST_STATE(FLAG, st_update) #st_update,
+#include "st_atom_list.h"
+#undef ST_STATE
+};
+
 
 void st_init_atoms( struct st_context *st )
 {
    STATIC_ASSERT(ARRAY_SIZE(update_functions) <= 64);
+   STATIC_ASSERT(ARRAY_SIZE(update_functions) <= ST_MAX_ATOMS);
+
+   st->atom_stats.num_atoms = ARRAY_SIZE(update_functions);
+   st->atom_stats.names = update_names;
+   st->atom_stats.enabled = (ST_DEBUG & DEBUG_ATOMS) != 0;
+}
+
+
+static void print_atom_stats( const struct st_atom_stats *stats )
+{
+   unsigned order[ST_MAX_ATOMS];
+   uint64_t total_ns = 0;
+   unsigned i, j;
+
+   /* Sort the atoms by decreasing time. */
+   for (i = 0; i < stats->num_atoms; i++) {
+      for (j = i; j > 0 && stats->time_ns[order[j - 1]] < stats->time_ns[i]; j--)
+         order[j] = order[j - 1];
+      order[j] = i;
+      total_ns += stats->time_ns[i];
+   }
+
+   debug_printf("st: state validation, %.3f ms in total:\n",
+                total_ns / 1000000.0);
+   debug_printf("   %-32s %10s %12s %10s %6s\n",
+                "atom", "updates", "time (ms)", "ns/update", "%");
+
+   for (i = 0; i < stats->num_atoms; i++) {
+      unsigned atom = order[i];
+
+      if (!stats->calls[atom])
+         continue;
+
+      debug_printf("   %-32s %10"PRIu64" %12.3f %10"PRIu64" %6.2f\n",
+                   stats->names[atom], stats->calls[atom],
+                   stats->time_ns[atom] / 1000000.0,
+                   stats->time_ns[atom] / stats->calls[atom],
+                   total_ns ? stats->time_ns[atom] * 100.0 / total_ns : 0.0);
+   }
 }
 
 
 void st_destroy_atoms( struct st_context *st )
 {
-   /* no-op */
+   if (ST_DEBUG & DEBUG_ATOMS)
+      print_atom_stats(&st->atom_stats);
+}
+
+
+/**
+ * Run the update functions of the dirty atoms like st_validate_state, but
+ * record how many times and for how long each of them runs.
+ */
+static void
+update_atoms_with_stats(struct st_context *st, uint64_t dirty)
+{
+   struct st_atom_stats *stats = &st->atom_stats;
+
+   while (dirty) {
+      unsigned atom = u_bit_scan64(&dirty);
+      int64_t start = os_time_get_nano();
+
+      update_functions[atom](st);
+
+      stats->time_ns[atom] += os_time_get_nano() - start;
+      stats->calls[atom]++;
+   }
 }
 
 
@@ -248,17 +320,21 @@ void st_validate_state( struct st_context *st, enum st_pipeline pipeline )
    if (!dirty)
       return;
 
-   dirty_lo = dirty;
-   dirty_hi = dirty >> 32;
+   if (unlikely(st->atom_stats.enabled)) {
+      update_atoms_with_stats(st, dirty);
+   } else {
+      dirty_lo = dirty;
+      dirty_hi = dirty >> 32;
 
-   /* Update states.
-    *
-    * Don't use u_bit_scan64, it may be slower on 32-bit.
-    */
-   while (dirty_lo)
-      update_functions[u_bit_scan(&dirty_lo)](st);
-   while (dirty_hi)
-      update_functions[32 + u_bit_scan(&dirty_hi)](st);
+      /* Update states.
+       *
+       * Don't use u_bit_scan64, it may be slower on 32-bit.
+       */
+      while (dirty_lo)
+         update_functions[u_bit_scan(&dirty_lo)](st);
+      while (dirty_hi)
+         update_functions[32 + u_bit_scan(&dirty_hi)](st);
+   }
 
    /* Clear the render or compute state bits. */
    st->dirty &= ~pipeline_mask;
@@ -51,6 +51,7 @@
 #include "st_context.h"
 #include "st_atom.h"
 #include "st_program.h"
+#include "st_shader_cache.h"
 #include "st_texture.h"
 
 
@@ -268,6 +269,7 @@ st_update_cp( struct st_context *st )
    if (st->shader_has_one_variant[MESA_SHADER_COMPUTE] && stcp->variants) {
       shader = stcp->variants->driver_shader;
    } else {
+      st_deserialise_deferred_nir(st->ctx, &stcp->Base);
       shader = st_get_cp_variant(st, &stcp->tgsi,
                                  &stcp->variants)->driver_shader;
    }
@@ -199,6 +199,9 @@ struct st_context
    bool gfx_shaders_may_be_dirty;
    bool compute_shader_may_be_dirty;
 
+   /** Per-atom cost of st_validate_state, see ST_DEBUG=atoms. */
+   struct st_atom_stats atom_stats;
+
    GLboolean vertdata_edgeflags;
    GLboolean edgeflag_culls_prims;
 
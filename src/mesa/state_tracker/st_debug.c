@@ -60,6 +60,7 @@ static const struct debug_named_value st_debug_flags[] = {
    { "precompile",  DEBUG_PRECOMPILE, NULL },
    { "gremedy",  DEBUG_GREMEDY, "Enable GREMEDY debug extensions" },
    { "noreadpixcache", DEBUG_NOREADPIXCACHE, NULL },
+   { "atoms",    DEBUG_ATOMS, "Print the cost of each state atom at context destruction" },
    DEBUG_NAMED_VALUE_END
 };
 
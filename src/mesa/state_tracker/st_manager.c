@@ -960,6 +960,7 @@ st_api_create_context(struct st_api *stapi, struct st_manager *smapi,
    st->iface.st_context_private = (void *) smapi;
    st->iface.cso_context = st->cso_context;
    st->iface.pipe = st->pipe;
+   st->iface.atom_stats = &st->atom_stats;
    st->iface.state_manager = smapi;
 
    *error = ST_CONTEXT_SUCCESS;
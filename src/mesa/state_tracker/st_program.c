@@ -558,6 +558,7 @@ st_create_vp_variant(struct st_context *st,
    vpv->num_inputs = stvp->num_inputs;
 
    if (stvp->tgsi.type == PIPE_SHADER_IR_NIR) {
+      st_deserialise_deferred_nir(st->ctx, &stvp->Base);
       vpv->tgsi.type = PIPE_SHADER_IR_NIR;
       vpv->tgsi.ir.nir = nir_shader_clone(NULL, stvp->tgsi.ir.nir);
       if (key->clamp_color)
@@ -1031,6 +1032,7 @@ st_create_fp_variant(struct st_context *st,
       return NULL;
 
    if (stfp->tgsi.type == PIPE_SHADER_IR_NIR) {
+      st_deserialise_deferred_nir(st->ctx, &stfp->Base);
       tgsi.type = PIPE_SHADER_IR_NIR;
       tgsi.ir.nir = nir_shader_clone(NULL, stfp->tgsi.ir.nir);
 
@@ -1538,6 +1540,7 @@ st_get_basic_variant(struct st_context *st,
       if (v) {
 
 	 if (prog->tgsi.type == PIPE_SHADER_IR_NIR) {
+            st_deserialise_deferred_nir(st->ctx, &prog->Base);
 	    tgsi.type = PIPE_SHADER_IR_NIR;
 	    tgsi.ir.nir = nir_shader_clone(NULL, prog->tgsi.ir.nir);
             tgsi.stream_output = prog->tgsi.stream_output;
@@ -1967,6 +1970,7 @@ st_precompile_shader_variant(struct st_context *st,
 
    case GL_COMPUTE_PROGRAM_NV: {
       struct st_compute_program *p = (struct st_compute_program *)prog;
+      st_deserialise_deferred_nir(st->ctx, prog);
       st_get_cp_variant(st, &p->tgsi, &p->variants);
       break;
    }
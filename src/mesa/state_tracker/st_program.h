@@ -153,6 +153,9 @@ struct st_fragment_program
 
    /* Used by the shader cache and ARB_get_program_binary */
    unsigned num_tgsi_tokens;
+
+   /** NIR in Base.driver_cache_blob, see st_deserialise_deferred_nir() */
+   const uint8_t *deferred_nir;
 };
 
 
@@ -233,6 +236,9 @@ struct st_vertex_program
 
    /* Used by the shader cache and ARB_get_program_binary */
    unsigned num_tgsi_tokens;
+
+   /** NIR in Base.driver_cache_blob, see st_deserialise_deferred_nir() */
+   const uint8_t *deferred_nir;
 };
 
 
@@ -278,6 +284,9 @@ struct st_common_program
 
    /* Used by the shader cache and ARB_get_program_binary */
    unsigned num_tgsi_tokens;
+
+   /** NIR in Base.driver_cache_blob, see st_deserialise_deferred_nir() */
+   const uint8_t *deferred_nir;
 };
 
 
@@ -301,6 +310,9 @@ struct st_compute_program
 
    /* Used by the shader cache and ARB_get_program_binary */
    unsigned num_tgsi_tokens;
+
+   /** NIR in Base.driver_cache_blob, see st_deserialise_deferred_nir() */
+   const uint8_t *deferred_nir;
 };
 
 
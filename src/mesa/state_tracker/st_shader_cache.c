@@ -186,7 +186,146 @@ read_tgsi_from_cache(struct blob_reader *blob_reader,
    blob_copy_bytes(blob_reader, (uint8_t *) *tokens, tokens_size);
 }
 
+static nir_shader *
+deserialise_nir(struct gl_context *ctx, struct gl_program *prog,
+                const uint8_t *deferred_nir)
+{
+   const struct nir_shader_compiler_options *options =
+      ctx->Const.ShaderCompilerOptions[prog->info.stage].NirOptions;
+   const uint8_t *end =
+      (const uint8_t *) prog->driver_cache_blob + prog->driver_cache_blob_size;
+
+   struct blob_reader blob_reader;
+   blob_reader_init(&blob_reader, deferred_nir, end - deferred_nir);
+
+   nir_shader *nir = nir_deserialize(NULL, options, &blob_reader);
+   if (nir && (blob_reader.current != blob_reader.end ||
+               blob_reader.overrun)) {
+      ralloc_free(nir);
+      nir = NULL;
+   }
+
+   return nir;
+}
+
+/**
+ * Check the NIR, which is always at the end of the blob, and skip over it.
+ * Lots of programs loaded from the cache are never drawn with, so the NIR is
+ * only kept in the blob, which is much smaller than the shader, and built
+ * again when their first variant is created, by st_deserialise_deferred_nir.
+ * Until then, the blob must be kept.
+ *
+ * The whole shader is read here rather than only its header, so that a bad
+ * cache item makes the program get linked from the source like on a cache
+ * miss, instead of failing at draw time.
+ */
+static const uint8_t *
+defer_nir_from_cache(struct gl_context *ctx, struct blob_reader *blob_reader,
+                     struct gl_program *prog)
+{
+   const uint8_t *deferred_nir = blob_reader->current;
+   struct shader_info info;
+   nir_shader *nir;
+
+   prog->nir = NULL;
+
+   if (!nir_deserialize_shader_info(blob_reader, &info) ||
+       info.stage != prog->info.stage ||
+       !(nir = deserialise_nir(ctx, prog, deferred_nir))) {
+      blob_reader->overrun = true;
+      return NULL;
+   }
+
+   ralloc_free(nir);
+   blob_skip_bytes(blob_reader, blob_reader->end - blob_reader->current);
+
+   return deferred_nir;
+}
+
+/**
+ * Return where the NIR of \p prog is kept until it's deserialised.
+ */
+static const uint8_t **
+get_deferred_nir(struct gl_program *prog)
+{
+   switch (prog->info.stage) {
+   case MESA_SHADER_VERTEX:
+      return &((struct st_vertex_program *) prog)->deferred_nir;
+   case MESA_SHADER_TESS_CTRL:
+   case MESA_SHADER_TESS_EVAL:
+   case MESA_SHADER_GEOMETRY:
+      return &((struct st_common_program *) prog)->deferred_nir;
+   case MESA_SHADER_FRAGMENT:
+      return &((struct st_fragment_program *) prog)->deferred_nir;
+   case MESA_SHADER_COMPUTE:
+      return &((struct st_compute_program *) prog)->deferred_nir;
+   default:
+      unreachable("Unsupported stage");
+   }
+}
+
+/**
+ * Install the NIR of \p prog, now that it was read, and drop the blob it
+ * was kept in.
+ */
 static void
+set_deferred_nir(struct gl_program *prog, const uint8_t **deferred_nir,
+                 nir_shader *nir)
+{
+   switch (prog->info.stage) {
+   case MESA_SHADER_VERTEX:
+      ((struct st_vertex_program *) prog)->tgsi.ir.nir = nir;
+      break;
+   case MESA_SHADER_TESS_CTRL:
+   case MESA_SHADER_TESS_EVAL:
+   case MESA_SHADER_GEOMETRY:
+      ((struct st_common_program *) prog)->tgsi.ir.nir = nir;
+      break;
+   case MESA_SHADER_FRAGMENT:
+      ((struct st_fragment_program *) prog)->tgsi.ir.nir = nir;
+      break;
+   case MESA_SHADER_COMPUTE:
+      ((struct st_compute_program *) prog)->tgsi.prog = nir;
+      break;
+   default:
+      unreachable("Unsupported stage");
+   }
+
+   prog->nir = nir;
+   *deferred_nir = NULL;
+
+   /* We don't need the cached blob anymore so free it */
+   ralloc_free(prog->driver_cache_blob);
+   prog->driver_cache_blob = NULL;
+   prog->driver_cache_blob_size = 0;
+}
+
+/**
+ * Deserialise the NIR of a program loaded from the cache, if it wasn't yet.
+ * This must be called before using the NIR of the program.
+ *
+ * Programs may be shared between contexts, so this is serialised by the
+ * mutex of the shared state.
+ */
+void
+st_deserialise_deferred_nir(struct gl_context *ctx, struct gl_program *prog)
+{
+   const uint8_t **deferred_nir = get_deferred_nir(prog);
+
+   simple_mtx_lock(&ctx->Shared->Mutex);
+
+   if (*deferred_nir) {
+      /* The same blob was already read back by defer_nir_from_cache. */
+      nir_shader *nir = deserialise_nir(ctx, prog, *deferred_nir);
+      assert(nir);
+
+      set_deferred_nir(prog, deferred_nir, nir);
+   }
+
+   simple_mtx_unlock(&ctx->Shared->Mutex);
+}
+
+static bool
 st_deserialise_ir_program(struct gl_context *ctx,
                           struct gl_shader_program *shProg,
                           struct gl_program *prog, bool nir)
@@ -194,8 +333,6 @@ st_deserialise_ir_program(struct gl_context *ctx,
    struct st_context *st = st_context(ctx);
    size_t size = prog->driver_cache_blob_size;
    uint8_t *buffer = (uint8_t *) prog->driver_cache_blob;
-   const struct nir_shader_compiler_options *options =
-      ctx->Const.ShaderCompilerOptions[prog->info.stage].NirOptions;
 
    assert(prog->driver_cache_blob && prog->driver_cache_blob_size > 0);
 
@@ -221,8 +358,8 @@ st_deserialise_ir_program(struct gl_context *ctx,
       if (nir) {
          stvp->tgsi.type = PIPE_SHADER_IR_NIR;
          stvp->shader_program = shProg;
-         stvp->tgsi.ir.nir = nir_deserialize(NULL, options, &blob_reader);
-         prog->nir = stvp->tgsi.ir.nir;
+         stvp->tgsi.ir.nir = NULL;
+         stvp->deferred_nir = defer_nir_from_cache(ctx, &blob_reader, prog);
       } else {
          read_tgsi_from_cache(&blob_reader, &stvp->tgsi.tokens,
                               &stvp->num_tgsi_tokens);
@@ -244,8 +381,8 @@ st_deserialise_ir_program(struct gl_context *ctx,
       if (nir) {
          sttcp->tgsi.type = PIPE_SHADER_IR_NIR;
          sttcp->shader_program = shProg;
-         sttcp->tgsi.ir.nir = nir_deserialize(NULL, options, &blob_reader);
-         prog->nir = sttcp->tgsi.ir.nir;
+         sttcp->tgsi.ir.nir = NULL;
+         sttcp->deferred_nir = defer_nir_from_cache(ctx, &blob_reader, prog);
       } else {
          read_tgsi_from_cache(&blob_reader, &sttcp->tgsi.tokens,
                               &sttcp->num_tgsi_tokens);
@@ -267,8 +404,8 @@ st_deserialise_ir_program(struct gl_context *ctx,
       if (nir) {
          sttep->tgsi.type = PIPE_SHADER_IR_NIR;
          sttep->shader_program = shProg;
-         sttep->tgsi.ir.nir = nir_deserialize(NULL, options, &blob_reader);
-         prog->nir = sttep->tgsi.ir.nir;
+         sttep->tgsi.ir.nir = NULL;
+         sttep->deferred_nir = defer_nir_from_cache(ctx, &blob_reader, prog);
       } else {
          read_tgsi_from_cache(&blob_reader, &sttep->tgsi.tokens,
                               &sttep->num_tgsi_tokens);
@@ -290,8 +427,8 @@ st_deserialise_ir_program(struct gl_context *ctx,
       if (nir) {
          stgp->tgsi.type = PIPE_SHADER_IR_NIR;
          stgp->shader_program = shProg;
-         stgp->tgsi.ir.nir = nir_deserialize(NULL, options, &blob_reader);
-         prog->nir = stgp->tgsi.ir.nir;
+         stgp->tgsi.ir.nir = NULL;
+         stgp->deferred_nir = defer_nir_from_cache(ctx, &blob_reader, prog);
       } else {
          read_tgsi_from_cache(&blob_reader, &stgp->tgsi.tokens,
                               &stgp->num_tgsi_tokens);
@@ -310,8 +447,8 @@ st_deserialise_ir_program(struct gl_context *ctx,
       if (nir) {
          stfp->tgsi.type = PIPE_SHADER_IR_NIR;
          stfp->shader_program = shProg;
-         stfp->tgsi.ir.nir = nir_deserialize(NULL, options, &blob_reader);
-         prog->nir = stfp->tgsi.ir.nir;
+         stfp->tgsi.ir.nir = NULL;
+         stfp->deferred_nir = defer_nir_from_cache(ctx, &blob_reader, prog);
       } else {
          read_tgsi_from_cache(&blob_reader, &stfp->tgsi.tokens,
                               &stfp->num_tgsi_tokens);
@@ -330,8 +467,8 @@ st_deserialise_ir_program(struct gl_context *ctx,
       if (nir) {
          stcp->tgsi.ir_type = PIPE_SHADER_IR_NIR;
          stcp->shader_program = shProg;
-         stcp->tgsi.prog = nir_deserialize(NULL, options, &blob_reader);
-         prog->nir = (nir_shader *) stcp->tgsi.prog;
+         stcp->tgsi.prog = NULL;
+         stcp->deferred_nir = defer_nir_from_cache(ctx, &blob_reader, prog);
       } else {
          read_tgsi_from_cache(&blob_reader,
                               (const struct tgsi_token**) &stcp->tgsi.prog,
@@ -351,17 +488,16 @@ st_deserialise_ir_program(struct gl_context *ctx,
       unreachable("Unsupported stage");
    }
 
-   /* Make sure we don't try to read more data than we wrote. This should
-    * never happen in release builds but its useful to have this check to
-    * catch development bugs.
+   /* Make sure we don't try to read more data than we wrote.  The caller
+    * falls back to compiling the program from the source if we did.
     */
    if (blob_reader.current != blob_reader.end || blob_reader.overrun) {
-      assert(!"Invalid TGSI shader disk cache item!");
-
       if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
          fprintf(stderr, "Error reading program from cache (invalid "
                  "TGSI cache item)\n");
       }
+
+      return false;
    }
 
    st_set_prog_affected_state_flags(prog);
@@ -371,6 +507,8 @@ st_deserialise_ir_program(struct gl_context *ctx,
    if (ST_DEBUG & DEBUG_PRECOMPILE ||
        st->shader_has_one_variant[prog->info.stage])
       st_precompile_shader_variant(st, prog);
+
+   return true;
 }
 
 bool
@@ -392,12 +530,17 @@ st_load_ir_from_disk_cache(struct gl_context *ctx,
          continue;
 
       struct gl_program *glprog = prog->_LinkedShaders[i]->Program;
-      st_deserialise_ir_program(ctx, prog, glprog, nir);
-
-      /* We don't need the cached blob anymore so free it */
-      ralloc_free(glprog->driver_cache_blob);
-      glprog->driver_cache_blob = NULL;
-      glprog->driver_cache_blob_size = 0;
+      if (!st_deserialise_ir_program(ctx, prog, glprog, nir))
+         goto fallback_recompile;
+
+      /* We don't need the cached blob anymore so free it, unless the NIR in
+       * it still has to be deserialised.
+       */
+      if (!nir) {
+         ralloc_free(glprog->driver_cache_blob);
+         glprog->driver_cache_blob = NULL;
+         glprog->driver_cache_blob_size = 0;
+      }
 
       if (ctx->_Shader->Flags & GLSL_CACHE_INFO) {
          fprintf(stderr, "%s state tracker IR retrieved from cache\n",
@@ -405,6 +548,19 @@ st_load_ir_from_disk_cache(struct gl_context *ctx,
       }
    }
 
+   return true;
+
+fallback_recompile:
+   if (ctx->_Shader->Flags & GLSL_CACHE_INFO)
+      fprintf(stderr, "state tracker IR cache falling back to recompile\n");
+
+   /* Drop the bad item, so that the program is linked again like on a cache
+    * miss: the GLSL metadata lookup fails, the shaders get compiled and the
+    * new IR ends up in the cache.
+    */
+   disk_cache_remove(ctx->Cache, prog->data->sha1);
+   _mesa_glsl_link_shader(ctx, prog);
+
    return true;
 }
 
@@ -422,12 +578,12 @@ st_serialise_tgsi_program_binary(struct gl_context *ctx,
    st_serialise_ir_program(ctx, prog, false);
 }
 
-void
+bool
 st_deserialise_tgsi_program(struct gl_context *ctx,
                             struct gl_shader_program *shProg,
                             struct gl_program *prog)
 {
-   st_deserialise_ir_program(ctx, shProg, prog, false);
+   return st_deserialise_ir_program(ctx, shProg, prog, false);
 }
 
 void
@@ -441,13 +597,17 @@ st_serialise_nir_program_binary(struct gl_context *ctx,
                                 struct gl_shader_program *shProg,
                                 struct gl_program *prog)
 {
+   /* The blob gets freed once the binary is written, so the NIR can't stay
+    * in it.
+    */
+   st_deserialise_deferred_nir(ctx, prog);
    st_serialise_ir_program(ctx, prog, true);
 }
 
-void
+bool
 st_deserialise_nir_program(struct gl_context *ctx,
                            struct gl_shader_program *shProg,
                            struct gl_program *prog)
 {
-   st_deserialise_ir_program(ctx, shProg, prog, true);
+   return st_deserialise_ir_program(ctx, shProg, prog, true);
 }
@@ -43,7 +43,7 @@ st_serialise_tgsi_program_binary(struct gl_context *ctx,
                                  struct gl_shader_program *shProg,
                                  struct gl_program *prog);
 
-void
+bool
 st_deserialise_tgsi_program(struct gl_context *ctx,
                             struct gl_shader_program *shProg,
                             struct gl_program *prog);
@@ -56,11 +56,14 @@ st_serialise_nir_program_binary(struct gl_context *ctx,
                                 struct gl_shader_program *shProg,
                                 struct gl_program *prog);
 
-void
+bool
 st_deserialise_nir_program(struct gl_context *ctx,
                            struct gl_shader_program *shProg,
                            struct gl_program *prog);
 
+void
+st_deserialise_deferred_nir(struct gl_context *ctx, struct gl_program *prog);
+
 bool
 st_load_ir_from_disk_cache(struct gl_context *ctx,
                            struct gl_shader_program *prog,
@@ -39,8 +39,14 @@
 #include <dirent.h>
 #include "zlib.h"
 
+#ifdef HAVE_ZSTD
+#include "zstd.h"
+#endif
+
 #include "util/crc32.h"
 #include "util/debug.h"
+#include "util/hash_table.h"
+#include "util/list.h"
 #include "util/rand_xor.h"
 #include "util/u_atomic.h"
 #include "util/u_queue.h"
@@ -50,6 +56,7 @@
 #include "main/errors.h"
 
 #include "disk_cache.h"
+#include "disk_cache_db.h"
 
 /* Number of bits to mask off from a cache key to get an index. */
 #define CACHE_INDEX_KEY_BITS 16
@@ -72,7 +79,29 @@
  * - There is no strict requirement that cache versions be backwards
  *   compatible but effort should be taken to limit disruption where possible.
  */
-#define CACHE_VERSION 1
+#define CACHE_VERSION 2
+
+/* How the data of a cache entry is compressed, this is recorded in each
+ * entry so that changing it doesn't invalidate the existing entries.
+ */
+enum cache_compression {
+   CACHE_COMPRESSION_NONE = 0,
+   CACHE_COMPRESSION_ZLIB = 1,
+   CACHE_COMPRESSION_ZSTD = 2,
+};
+
+/* Higher ZSTD levels cost a lot more time for little gain on shader
+ * binaries.
+ */
+#define ZSTD_COMPRESSION_LEVEL 1
+
+/* Entries read ahead by disk_cache_prefetch() are kept in memory up to this
+ * size, the least recently read ones being dropped first.
+ */
+#define CACHE_PREFETCH_MAX_SIZE (64 * 1024 * 1024)
+
+/* Number of threads reading and decompressing entries ahead. */
+#define CACHE_PREFETCH_THREADS 4
 
 struct disk_cache {
    /* The path to the cache directory. */
@@ -98,6 +127,24 @@ struct disk_cache {
    /* Maximum size of all cached objects (in bytes). */
    uint64_t max_size;
 
+   /* Single-file database holding the cache entries, when enabled in
+    * place of one file per entry.
+    */
+   struct disk_cache_db *db;
+
+   /* How new entries are compressed. */
+   enum cache_compression compression;
+
+   /* Entries read ahead by disk_cache_prefetch(), waiting to be returned by
+    * disk_cache_get(). The queue and table are created on first use, and
+    * prefetch_lock protects the table, the list and the size.
+    */
+   struct util_queue prefetch_queue;
+   mtx_t prefetch_lock;
+   struct hash_table *prefetched;
+   struct list_head prefetch_lru;
+   size_t prefetched_size;
+
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
@@ -122,6 +169,25 @@ struct disk_cache_put_job {
    struct cache_item_metadata cache_item_metadata;
 };
 
+struct prefetched_entry {
+   cache_key key;
+
+   /* Data of the entry, NULL until read. */
+   void *data;
+   size_t size;
+
+   /* Link in disk_cache::prefetch_lru, once read. */
+   struct list_head link;
+};
+
+struct disk_cache_prefetch_job {
+   struct util_queue_fence fence;
+
+   struct disk_cache *cache;
+
+   cache_key key;
+};
+
 /* Create a directory named 'path' if it does not already exist.
  *
  * Returns: 0 if path already exists as a directory or if created.
@@ -188,6 +254,29 @@ do {                                       \
    _dst += _src_size;                      \
 } while (0);
 
+static enum cache_compression
+get_cache_compression(void)
+{
+   const char *compression = getenv("MESA_GLSL_CACHE_COMPRESSION");
+
+   if (compression) {
+      if (strcmp(compression, "none") == 0)
+         return CACHE_COMPRESSION_NONE;
+      if (strcmp(compression, "zlib") == 0)
+         return CACHE_COMPRESSION_ZLIB;
+#ifdef HAVE_ZSTD
+      if (strcmp(compression, "zstd") == 0)
+         return CACHE_COMPRESSION_ZSTD;
+#endif
+   }
+
+#ifdef HAVE_ZSTD
+   return CACHE_COMPRESSION_ZSTD;
+#else
+   return CACHE_COMPRESSION_ZLIB;
+#endif
+}
+
 struct disk_cache *
 disk_cache_create(const char *gpu_name, const char *timestamp,
                   uint64_t driver_flags)
@@ -370,6 +459,15 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
 
    cache->max_size = max_size;
 
+   cache->compression = get_cache_compression();
+
+   /* With large caches, one file per entry means many syscalls and slow
+    * evictions.  The single-file database avoids both.  If it can't be
+    * opened, fall back to one file per entry.
+    */
+   if (env_var_as_boolean("MESA_GLSL_CACHE_SINGLE_FILE", false))
+      cache->db = disk_cache_db_open(cache->path, cache->max_size);
+
    /* 1 thread was chosen because we don't really care about getting things
     * to disk quickly just that it's not blocking other tasks.
     *
@@ -380,6 +478,8 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
                    UTIL_QUEUE_INIT_RESIZE_IF_FULL |
                    UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY);
 
+   (void) mtx_init(&cache->prefetch_lock, mtx_plain);
+
    cache->path_init_failed = false;
 
  path_fail:
@@ -431,11 +531,28 @@ disk_cache_create(const char *gpu_name, const char *timestamp,
    return NULL;
 }
 
+static void
+free_prefetched_entry(struct hash_entry *he)
+{
+   struct prefetched_entry *entry = he->data;
+
+   free(entry->data);
+   free(entry);
+}
+
 void
 disk_cache_destroy(struct disk_cache *cache)
 {
    if (cache && !cache->path_init_failed) {
+      if (cache->prefetched) {
+         /* Let the queued reads complete, so that their jobs get freed. */
+         util_queue_finish(&cache->prefetch_queue);
+         util_queue_destroy(&cache->prefetch_queue);
+         _mesa_hash_table_destroy(cache->prefetched, free_prefetched_entry);
+      }
+      mtx_destroy(&cache->prefetch_lock);
       util_queue_destroy(&cache->cache_queue);
+      disk_cache_db_close(cache->db);
       munmap(cache->index_mmap, cache->index_mmap_size);
    }
 
@@ -666,11 +783,60 @@ evict_lru_item(struct disk_cache *cache)
       p_atomic_add(cache->size, - (uint64_t)size);
 }
 
+/**
+ * Removes the entry read ahead under \p key, if any, returning its data.
+ *
+ * If the entry is still being read, it's dropped and NULL is returned: the
+ * caller is better off reading it directly than waiting behind the other
+ * queued reads.
+ */
+static void *
+take_prefetched_entry(struct disk_cache *cache, const cache_key key,
+                      size_t *size)
+{
+   struct prefetched_entry *entry;
+   struct hash_entry *he;
+   void *data = NULL;
+
+   mtx_lock(&cache->prefetch_lock);
+
+   if (cache->prefetched) {
+      he = _mesa_hash_table_search(cache->prefetched, key);
+      if (he) {
+         entry = he->data;
+         _mesa_hash_table_remove(cache->prefetched, he);
+
+         if (entry->data) {
+            list_del(&entry->link);
+            cache->prefetched_size -= entry->size;
+
+            data = entry->data;
+            if (size)
+               *size = entry->size;
+         }
+
+         free(entry);
+      }
+   }
+
+   mtx_unlock(&cache->prefetch_lock);
+
+   return data;
+}
+
 void
 disk_cache_remove(struct disk_cache *cache, const cache_key key)
 {
    struct stat sb;
 
+   if (!cache->path_init_failed)
+      free(take_prefetched_entry(cache, key, NULL));
+
+   if (cache->db) {
+      disk_cache_db_remove(cache->db, key);
+      return;
+   }
+
    char *filename = get_cache_file(cache, key);
    if (filename == NULL) {
       return;
@@ -787,6 +953,101 @@ deflate_and_write_to_disk(const void *in_data, size_t in_data_size, int dest,
    return compressed_size;
 }
 
+/**
+ * Returns the maximum size of \p size bytes once compressed.
+ */
+static size_t
+compress_bound(enum cache_compression compression, size_t size)
+{
+   switch (compression) {
+   case CACHE_COMPRESSION_ZLIB:
+      return compressBound(size);
+#ifdef HAVE_ZSTD
+   case CACHE_COMPRESSION_ZSTD:
+      return ZSTD_compressBound(size);
+#endif
+   default:
+      return size;
+   }
+}
+
+/**
+ * Compresses cache entry in memory. Returns the compressed size, or 0 on
+ * failure.
+ */
+static size_t
+compress_cache_data(enum cache_compression compression,
+                    const void *in_data, size_t in_data_size,
+                    uint8_t *out_data, size_t out_data_size)
+{
+   switch (compression) {
+   case CACHE_COMPRESSION_NONE:
+      if (out_data_size < in_data_size)
+         return 0;
+      memcpy(out_data, in_data, in_data_size);
+      return in_data_size;
+   case CACHE_COMPRESSION_ZLIB: {
+      uLongf compressed_size = out_data_size;
+      if (compress2(out_data, &compressed_size, in_data, in_data_size,
+                    Z_BEST_COMPRESSION) != Z_OK)
+         return 0;
+      return compressed_size;
+   }
+#ifdef HAVE_ZSTD
+   case CACHE_COMPRESSION_ZSTD: {
+      size_t compressed_size = ZSTD_compress(out_data, out_data_size,
+                                             in_data, in_data_size,
+                                             ZSTD_COMPRESSION_LEVEL);
+      if (ZSTD_isError(compressed_size))
+         return 0;
+      return compressed_size;
+   }
+#endif
+   default:
+      return 0;
+   }
+}
+
+/**
+ * Compresses cache entry and writes it to disk. Returns the size of the
+ * data written to disk.
+ */
+static size_t
+compress_and_write_to_disk(enum cache_compression compression,
+                           const void *in_data, size_t in_data_size,
+                           int dest, const char *filename)
+{
+   size_t out_size, compressed_size;
+   uint8_t *out;
+
+   switch (compression) {
+   case CACHE_COMPRESSION_NONE:
+      if (write_all(dest, in_data, in_data_size) == -1)
+         return 0;
+      return in_data_size;
+   case CACHE_COMPRESSION_ZLIB:
+      /* Streamed rather than compressed in memory, as it's the slowest. */
+      return deflate_and_write_to_disk(in_data, in_data_size, dest,
+                                       filename);
+   default:
+      break;
+   }
+
+   out_size = compress_bound(compression, in_data_size);
+   out = malloc(out_size);
+   if (!out)
+      return 0;
+
+   compressed_size = compress_cache_data(compression, in_data, in_data_size,
+                                         out, out_size);
+   if (compressed_size && write_all(dest, out, compressed_size) == -1)
+      compressed_size = 0;
+
+   free(out);
+
+   return compressed_size;
+}
+
 static struct disk_cache_put_job *
 create_put_job(struct disk_cache *cache, const cache_key key,
                const void *data, size_t size,
@@ -846,8 +1107,45 @@ destroy_put_job(void *job, int thread_index)
 struct cache_entry_file_data {
    uint32_t crc32;
    uint32_t uncompressed_size;
+   uint32_t compression;
 };
 
+/**
+ * Compresses cache entry in memory and stores it in the cache database,
+ * preceded by its cache_entry_file_data.
+ *
+ * The cache item metadata isn't stored, it's only meant for 3rd party tools
+ * reading the cache files.
+ */
+static void
+cache_put_db(struct disk_cache_put_job *dc_job)
+{
+   enum cache_compression compression = dc_job->cache->compression;
+   struct cache_entry_file_data *cf_data;
+   size_t compressed_size = compress_bound(compression, dc_job->size);
+   uint8_t *entry;
+
+   entry = malloc(sizeof(*cf_data) + compressed_size);
+   if (!entry)
+      return;
+
+   cf_data = (struct cache_entry_file_data *) entry;
+   cf_data->crc32 = util_hash_crc32(dc_job->data, dc_job->size);
+   cf_data->uncompressed_size = dc_job->size;
+   cf_data->compression = compression;
+
+   compressed_size = compress_cache_data(compression, dc_job->data,
+                                         dc_job->size,
+                                         entry + sizeof(*cf_data),
+                                         compressed_size);
+   if (compressed_size) {
+      disk_cache_db_put(dc_job->cache->db, dc_job->key, entry,
+                        sizeof(*cf_data) + compressed_size);
+   }
+
+   free(entry);
+}
+
 static void
 cache_put(void *job, int thread_index)
 {
@@ -858,6 +1156,11 @@ cache_put(void *job, int thread_index)
    char *filename = NULL, *filename_tmp = NULL;
    struct disk_cache_put_job *dc_job = (struct disk_cache_put_job *) job;
 
+   if (dc_job->cache->db) {
+      cache_put_db(dc_job);
+      return;
+   }
+
    filename = get_cache_file(dc_job->cache, dc_job->key);
    if (filename == NULL)
       goto done;
@@ -961,6 +1264,7 @@ cache_put(void *job, int thread_index)
    struct cache_entry_file_data cf_data;
    cf_data.crc32 = util_hash_crc32(dc_job->data, dc_job->size);
    cf_data.uncompressed_size = dc_job->size;
+   cf_data.compression = dc_job->cache->compression;
 
    size_t cf_data_size = sizeof(cf_data);
    ret = write_all(fd, &cf_data, cf_data_size);
@@ -973,8 +1277,9 @@ cache_put(void *job, int thread_index)
     * rename them atomically to the destination filename, and also
     * perform an atomic increment of the total cache size.
     */
-   size_t file_size = deflate_and_write_to_disk(dc_job->data, dc_job->size,
-                                                fd, filename_tmp);
+   size_t file_size = compress_and_write_to_disk(dc_job->cache->compression,
+                                                 dc_job->data, dc_job->size,
+                                                 fd, filename_tmp);
    if (file_size == 0) {
       unlink(filename_tmp);
       goto done;
@@ -1068,8 +1373,95 @@ inflate_cache_data(uint8_t *in_data, size_t in_data_size,
    return true;
 }
 
-void *
-disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+/**
+ * Decompresses cache entry with the given compression, returns true if
+ * successful.
+ */
+static bool
+uncompress_cache_data(enum cache_compression compression,
+                      uint8_t *in_data, size_t in_data_size,
+                      uint8_t *out_data, size_t out_data_size)
+{
+   switch (compression) {
+   case CACHE_COMPRESSION_NONE:
+      if (in_data_size != out_data_size)
+         return false;
+      memcpy(out_data, in_data, out_data_size);
+      return true;
+   case CACHE_COMPRESSION_ZLIB:
+      return inflate_cache_data(in_data, in_data_size, out_data,
+                                out_data_size);
+#ifdef HAVE_ZSTD
+   case CACHE_COMPRESSION_ZSTD:
+      return ZSTD_decompress(out_data, out_data_size, in_data,
+                             in_data_size) == out_data_size;
+#endif
+   default:
+      return false;
+   }
+}
+
+/**
+ * Reads and decompresses an entry stored by cache_put_db().
+ */
+static void *
+cache_get_db(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   struct cache_entry_file_data cf_data;
+   uint8_t *entry, *uncompressed_data = NULL;
+   size_t entry_size;
+
+   entry = disk_cache_db_get(cache->db, key, &entry_size);
+   if (!entry)
+      return NULL;
+
+   if (entry_size < sizeof(cf_data))
+      goto fail;
+
+   memcpy(&cf_data, entry, sizeof(cf_data));
+
+   if (cf_data.compression == CACHE_COMPRESSION_NONE) {
+      /* Hand out the entry itself, without its header. */
+      if (entry_size - sizeof(cf_data) != cf_data.uncompressed_size)
+         goto fail;
+
+      memmove(entry, entry + sizeof(cf_data), cf_data.uncompressed_size);
+      uncompressed_data = entry;
+      entry = NULL;
+   } else {
+      uncompressed_data = malloc(cf_data.uncompressed_size);
+      if (!uncompressed_data)
+         goto fail;
+
+      if (!uncompress_cache_data(cf_data.compression,
+                                 entry + sizeof(cf_data),
+                                 entry_size - sizeof(cf_data),
+                                 uncompressed_data,
+                                 cf_data.uncompressed_size))
+         goto fail;
+   }
+
+   /* Check the data for corruption */
+   if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
+                                        cf_data.uncompressed_size))
+      goto fail;
+
+   free(entry);
+
+   if (size)
+      *size = cf_data.uncompressed_size;
+
+   return uncompressed_data;
+
+ fail:
+   free(uncompressed_data);
+   free(entry);
+
+   return NULL;
+}
+
+static void *
+read_cache_entry(struct disk_cache *cache, const cache_key key, size_t *size)
 {
    int fd = -1, ret;
    struct stat sb;
@@ -1103,6 +1495,9 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
       return blob;
    }
 
+   if (cache->db)
+      return cache_get_db(cache, key, size);
+
    filename = get_cache_file(cache, key);
    if (filename == NULL)
       goto fail;
@@ -1114,10 +1509,6 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    if (fstat(fd, &sb) == -1)
       goto fail;
 
-   data = malloc(sb.st_size);
-   if (data == NULL)
-      goto fail;
-
    size_t ck_size = cache->driver_keys_blob_size;
    file_header = malloc(ck_size);
    if (!file_header)
@@ -1171,16 +1562,35 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    /* Load the actual cache data. */
    size_t cache_data_size =
       sb.st_size - cf_data_size - ck_size - cache_item_md_size;
-   ret = read_all(fd, data, cache_data_size);
-   if (ret == -1)
-      goto fail;
 
-   /* Uncompress the cache data */
    uncompressed_data = malloc(cf_data.uncompressed_size);
-   if (!inflate_cache_data(data, cache_data_size, uncompressed_data,
-                           cf_data.uncompressed_size))
+   if (uncompressed_data == NULL)
       goto fail;
 
+   if (cf_data.compression == CACHE_COMPRESSION_NONE) {
+      /* Nothing to uncompress, read the data in place. */
+      if (cache_data_size != cf_data.uncompressed_size)
+         goto fail;
+
+      ret = read_all(fd, uncompressed_data, cache_data_size);
+      if (ret == -1)
+         goto fail;
+   } else {
+      data = malloc(cache_data_size);
+      if (data == NULL)
+         goto fail;
+
+      ret = read_all(fd, data, cache_data_size);
+      if (ret == -1)
+         goto fail;
+
+      /* Uncompress the cache data */
+      if (!uncompress_cache_data(cf_data.compression, data, cache_data_size,
+                                 uncompressed_data,
+                                 cf_data.uncompressed_size))
+         goto fail;
+   }
+
    /* Check the data for corruption */
    if (cf_data.crc32 != util_hash_crc32(uncompressed_data,
                                         cf_data.uncompressed_size))
@@ -1211,6 +1621,150 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return NULL;
 }
 
+void *
+disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
+{
+   if (!cache->path_init_failed) {
+      void *data = take_prefetched_entry(cache, key, size);
+      if (data)
+         return data;
+   }
+
+   return read_cache_entry(cache, key, size);
+}
+
+static uint32_t
+cache_key_hash(const void *key)
+{
+   /* Keys are SHA-1 hashes, any 32 bits of them will do. */
+   uint32_t hash;
+
+   memcpy(&hash, key, sizeof(hash));
+   return hash;
+}
+
+static bool
+cache_key_equals(const void *a, const void *b)
+{
+   return memcmp(a, b, CACHE_KEY_SIZE) == 0;
+}
+
+static void
+prefetch_entry(void *job, int thread_index)
+{
+   struct disk_cache_prefetch_job *pf_job =
+      (struct disk_cache_prefetch_job *) job;
+   struct disk_cache *cache = pf_job->cache;
+   struct prefetched_entry *entry;
+   struct hash_entry *he;
+   void *data;
+   size_t size;
+
+   data = read_cache_entry(cache, pf_job->key, &size);
+
+   mtx_lock(&cache->prefetch_lock);
+
+   /* disk_cache_get() may have given up on the entry in the meantime, and
+    * disk_cache_prefetch() been asked for the key again: the entry found
+    * may then belong to a later job, which may already have filled it.
+    */
+   he = _mesa_hash_table_search(cache->prefetched, pf_job->key);
+   if (he && !((struct prefetched_entry *) he->data)->data) {
+      entry = he->data;
+
+      if (data) {
+         entry->data = data;
+         entry->size = size;
+         list_addtail(&entry->link, &cache->prefetch_lru);
+         cache->prefetched_size += size;
+         data = NULL;
+
+         while (cache->prefetched_size > CACHE_PREFETCH_MAX_SIZE) {
+            struct prefetched_entry *lru =
+               LIST_ENTRY(struct prefetched_entry, cache->prefetch_lru.next,
+                          link);
+
+            list_del(&lru->link);
+            cache->prefetched_size -= lru->size;
+            _mesa_hash_table_remove_key(cache->prefetched, lru->key);
+            free(lru->data);
+            free(lru);
+         }
+      } else {
+         /* Not in the cache, let disk_cache_get() find that out. */
+         _mesa_hash_table_remove(cache->prefetched, he);
+         free(entry);
+      }
+   }
+
+   mtx_unlock(&cache->prefetch_lock);
+
+   free(data);
+}
+
+static void
+destroy_prefetch_job(void *job, int thread_index)
+{
+   free(job);
+}
+
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   unsigned i;
+
+   if (cache->blob_get_cb || cache->path_init_failed)
+      return;
+
+   mtx_lock(&cache->prefetch_lock);
+
+   if (!cache->prefetched) {
+      if (!util_queue_init(&cache->prefetch_queue, "disk_pf",
+                           32, CACHE_PREFETCH_THREADS,
+                           UTIL_QUEUE_INIT_RESIZE_IF_FULL))
+         goto done;
+
+      cache->prefetched = _mesa_hash_table_create(NULL, cache_key_hash,
+                                                  cache_key_equals);
+      if (!cache->prefetched) {
+         util_queue_destroy(&cache->prefetch_queue);
+         goto done;
+      }
+
+      list_inithead(&cache->prefetch_lru);
+   }
+
+   for (i = 0; i < num_keys; i++) {
+      struct prefetched_entry *entry;
+      struct disk_cache_prefetch_job *pf_job;
+
+      /* Already read or being read. */
+      if (_mesa_hash_table_search(cache->prefetched, keys[i]))
+         continue;
+
+      entry = calloc(1, sizeof(*entry));
+      pf_job = malloc(sizeof(*pf_job));
+      if (!entry || !pf_job) {
+         free(entry);
+         free(pf_job);
+         break;
+      }
+
+      memcpy(entry->key, keys[i], CACHE_KEY_SIZE);
+      _mesa_hash_table_insert(cache->prefetched, entry->key, entry);
+
+      pf_job->cache = cache;
+      memcpy(pf_job->key, keys[i], CACHE_KEY_SIZE);
+      util_queue_fence_init(&pf_job->fence);
+      util_queue_add_job(&cache->prefetch_queue, pf_job, &pf_job->fence,
+                         prefetch_entry, destroy_prefetch_job);
+   }
+
+ done:
+   mtx_unlock(&cache->prefetch_lock);
+}
+
 void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
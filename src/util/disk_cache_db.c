@@ -0,0 +1,690 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifdef ENABLE_SHADER_CACHE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "c11/threads.h"
+#include "util/macros.h"
+#include "util/u_atomic.h"
+
+#include "disk_cache_db.h"
+
+#define DB_DATA_FILE_NAME "mesa_cache.db"
+#define DB_INDEX_FILE_NAME "mesa_cache.idx"
+
+#define DB_MAGIC 0x4244434d /* "MCDB" */
+
+/* Bump whenever the layout of either file changes, existing files are then
+ * discarded.
+ */
+#define DB_VERSION 1
+
+/* Number of slots in the index hash table. */
+#define DB_INDEX_ENTRIES (1 << 17)
+#define DB_INDEX_MASK (DB_INDEX_ENTRIES - 1)
+
+/* Give up looking for a key, or a free slot, after this many slots. */
+#define DB_MAX_PROBES 64
+
+struct db_file_header {
+   uint32_t magic;
+   uint32_t version;
+};
+
+struct db_index_header {
+   uint32_t magic;
+   uint32_t version;
+
+   /* Bumped whenever the data file is replaced by a compacted copy, so that
+    * other processes know to reopen it.
+    */
+   uint64_t generation;
+
+   /* Source of the last_access stamps, for LRU eviction. */
+   uint64_t access_clock;
+
+   /* Number of live entries in the table. */
+   uint64_t num_entries;
+
+   uint8_t pad[32];
+};
+
+/* An index slot is empty when offset is 0, and holds a removed entry when
+ * size is 0.
+ */
+struct db_index_entry {
+   uint8_t key[CACHE_KEY_SIZE];
+   uint32_t size;
+   uint64_t offset;
+   uint64_t last_access;
+};
+
+/* Precedes every entry in the data file. */
+struct db_record_header {
+   uint8_t key[CACHE_KEY_SIZE];
+   uint32_t size;
+};
+
+struct disk_cache_db {
+   char *data_path;
+   char *index_path;
+
+   /* Maximum size of the data file, in bytes. */
+   uint64_t max_size;
+
+   int index_fd;
+   int data_fd;
+
+   /* Generation of the data file data_fd refers to. */
+   uint64_t generation;
+
+   void *index_mmap;
+   size_t index_mmap_size;
+   struct db_index_header *header;
+   struct db_index_entry *entries;
+
+   /* flock only serializes processes, this serializes our threads. */
+   mtx_t mutex;
+};
+
+static ssize_t
+pread_all(int fd, void *buf, size_t count, off_t offset)
+{
+   char *in = buf;
+   ssize_t read_ret;
+   size_t done;
+
+   for (done = 0; done < count; done += read_ret) {
+      read_ret = pread(fd, in + done, count - done, offset + done);
+      if (read_ret == -1 || read_ret == 0)
+         return -1;
+   }
+   return done;
+}
+
+static ssize_t
+pwrite_all(int fd, const void *buf, size_t count, off_t offset)
+{
+   const char *out = buf;
+   ssize_t written;
+   size_t done;
+
+   for (done = 0; done < count; done += written) {
+      written = pwrite(fd, out + done, count - done, offset + done);
+      if (written == -1)
+         return -1;
+   }
+   return done;
+}
+
+static uint32_t
+key_hash(const cache_key key)
+{
+   /* Keys are SHA-1 hashes, so any of their bits will do. */
+   return key[0] | key[1] << 8 | key[2] << 16 | (uint32_t) key[3] << 24;
+}
+
+static struct db_index_entry *
+find_entry(struct disk_cache_db *db, const cache_key key)
+{
+   uint32_t i = key_hash(key);
+   unsigned probe;
+
+   for (probe = 0; probe < DB_MAX_PROBES; probe++, i++) {
+      struct db_index_entry *entry = &db->entries[i & DB_INDEX_MASK];
+
+      if (!entry->offset)
+         return NULL;
+
+      if (entry->size && memcmp(entry->key, key, CACHE_KEY_SIZE) == 0)
+         return entry;
+   }
+
+   return NULL;
+}
+
+/* Must only be called once the key is known not to be in the table. */
+static struct db_index_entry *
+find_free_entry(struct disk_cache_db *db, const cache_key key)
+{
+   uint32_t i = key_hash(key);
+   unsigned probe;
+
+   for (probe = 0; probe < DB_MAX_PROBES; probe++, i++) {
+      struct db_index_entry *entry = &db->entries[i & DB_INDEX_MASK];
+
+      if (!entry->offset || !entry->size)
+         return entry;
+   }
+
+   return NULL;
+}
+
+/* Fill a free slot.  The fields are written in an order which keeps the
+ * entry invisible to lock-less readers until it's complete.
+ */
+static void
+set_entry(struct disk_cache_db *db, struct db_index_entry *entry,
+          const cache_key key, uint32_t size, uint64_t offset,
+          uint64_t last_access)
+{
+   memcpy(entry->key, key, CACHE_KEY_SIZE);
+   entry->last_access = last_access;
+   entry->offset = offset;
+   p_atomic_set(&entry->size, size);
+
+   db->header->num_entries++;
+}
+
+/* Empty both files.  Called with the index flock held. */
+static bool
+reset_db(struct disk_cache_db *db)
+{
+   struct db_file_header file_header = { DB_MAGIC, DB_VERSION };
+   uint64_t generation = db->header->generation;
+
+   memset(db->index_mmap, 0, db->index_mmap_size);
+
+   if (ftruncate(db->data_fd, 0) == -1 ||
+       pwrite_all(db->data_fd, &file_header, sizeof(file_header), 0) == -1)
+      return false;
+
+   db->header->generation = generation + 1;
+   db->header->version = DB_VERSION;
+   db->header->magic = DB_MAGIC;
+
+   return true;
+}
+
+/* Reopen the data file if another process replaced it. */
+static bool
+update_data_file(struct disk_cache_db *db)
+{
+   uint64_t generation = p_atomic_read(&db->header->generation);
+   int fd;
+
+   if (generation == db->generation)
+      return true;
+
+   fd = open(db->data_path, O_RDWR | O_CLOEXEC);
+   if (fd == -1)
+      return false;
+
+   close(db->data_fd);
+   db->data_fd = fd;
+   db->generation = generation;
+
+   return true;
+}
+
+static int
+compare_last_access(const void *a, const void *b)
+{
+   const struct db_index_entry *entry_a = a;
+   const struct db_index_entry *entry_b = b;
+
+   /* Most recently used first */
+   if (entry_a->last_access != entry_b->last_access)
+      return entry_a->last_access > entry_b->last_access ? -1 : 1;
+   return 0;
+}
+
+static int
+compare_offset(const void *a, const void *b)
+{
+   const struct db_index_entry *entry_a = a;
+   const struct db_index_entry *entry_b = b;
+
+   if (entry_a->offset != entry_b->offset)
+      return entry_a->offset < entry_b->offset ? -1 : 1;
+   return 0;
+}
+
+/**
+ * Evict the least recently used entries, so that \p needed more bytes fit
+ * comfortably.  The kept entries are copied to a new data file, which then
+ * replaces the current one, and the index is rebuilt.
+ *
+ * Called with the index flock held.
+ */
+static bool
+compact_db(struct disk_cache_db *db, uint64_t needed)
+{
+   const uint64_t target_size = db->max_size / 4 * 3;
+   struct db_file_header file_header = { DB_MAGIC, DB_VERSION };
+   struct db_index_entry *live;
+   unsigned num_live = 0, num_kept, i;
+   uint64_t kept_size = sizeof(file_header) + needed;
+   uint64_t offset;
+   char *tmp_path = NULL;
+   void *buf = NULL;
+   size_t buf_size = 0;
+   int fd = -1;
+   bool ret = false;
+
+   live = malloc(DB_INDEX_ENTRIES * sizeof(*live));
+   if (!live)
+      return false;
+
+   for (i = 0; i < DB_INDEX_ENTRIES; i++) {
+      if (db->entries[i].offset && db->entries[i].size)
+         live[num_live++] = db->entries[i];
+   }
+
+   /* Keep the most recently used entries, leaving room to grow. */
+   qsort(live, num_live, sizeof(*live), compare_last_access);
+
+   for (num_kept = 0; num_kept < num_live; num_kept++) {
+      uint64_t record_size =
+         sizeof(struct db_record_header) + live[num_kept].size;
+
+      if (num_kept >= DB_INDEX_ENTRIES / 4 ||
+          kept_size + record_size > target_size)
+         break;
+
+      kept_size += record_size;
+   }
+
+   /* Copy in file order, so reads are sequential. */
+   qsort(live, num_kept, sizeof(*live), compare_offset);
+
+   if (asprintf(&tmp_path, "%s.tmp", db->data_path) == -1) {
+      tmp_path = NULL;
+      goto done;
+   }
+
+   fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd == -1)
+      goto done;
+
+   if (pwrite_all(fd, &file_header, sizeof(file_header), 0) == -1)
+      goto done;
+
+   offset = sizeof(file_header);
+   for (i = 0; i < num_kept; i++) {
+      size_t record_size = sizeof(struct db_record_header) + live[i].size;
+      struct db_record_header *record;
+
+      if (record_size > buf_size) {
+         void *tmp = realloc(buf, record_size);
+         if (!tmp)
+            goto done;
+         buf = tmp;
+         buf_size = record_size;
+      }
+
+      /* Drop whatever doesn't look right. */
+      record = buf;
+      if (pread_all(db->data_fd, buf, record_size, live[i].offset) == -1 ||
+          memcmp(record->key, live[i].key, CACHE_KEY_SIZE) != 0 ||
+          record->size != live[i].size) {
+         live[i].size = 0;
+         continue;
+      }
+
+      if (pwrite_all(fd, buf, record_size, offset) == -1)
+         goto done;
+
+      live[i].offset = offset;
+      offset += record_size;
+   }
+
+   if (rename(tmp_path, db->data_path) == -1)
+      goto done;
+
+   /* From now on the index must refer to the new file. */
+   memset(db->entries, 0, DB_INDEX_ENTRIES * sizeof(*db->entries));
+   db->header->num_entries = 0;
+
+   for (i = 0; i < num_kept; i++) {
+      struct db_index_entry *entry;
+
+      if (!live[i].size)
+         continue;
+
+      entry = find_free_entry(db, live[i].key);
+      if (entry) {
+         set_entry(db, entry, live[i].key, live[i].size, live[i].offset,
+                   live[i].last_access);
+      }
+   }
+
+   close(db->data_fd);
+   db->data_fd = fd;
+   fd = -1;
+   db->generation = p_atomic_inc_return(&db->header->generation);
+
+   ret = true;
+
+ done:
+   if (fd != -1) {
+      close(fd);
+      unlink(tmp_path);
+   }
+   free(tmp_path);
+   free(buf);
+   free(live);
+
+   return ret;
+}
+
+static void
+free_db(struct disk_cache_db *db)
+{
+   if (db->index_mmap != MAP_FAILED)
+      munmap(db->index_mmap, db->index_mmap_size);
+   if (db->data_fd != -1)
+      close(db->data_fd);
+   if (db->index_fd != -1)
+      close(db->index_fd);
+
+   mtx_destroy(&db->mutex);
+
+   free(db->data_path);
+   free(db->index_path);
+   free(db);
+}
+
+struct disk_cache_db *
+disk_cache_db_open(const char *path, uint64_t max_size)
+{
+   struct disk_cache_db *db;
+   struct db_file_header file_header;
+   struct stat sb;
+   bool reset = false;
+
+   STATIC_ASSERT(sizeof(struct db_index_header) == 64);
+   STATIC_ASSERT(sizeof(struct db_index_entry) == 40);
+
+   db = calloc(1, sizeof(*db));
+   if (!db)
+      return NULL;
+
+   db->index_fd = -1;
+   db->data_fd = -1;
+   db->index_mmap = MAP_FAILED;
+   db->max_size = max_size;
+   mtx_init(&db->mutex, mtx_plain);
+
+   if (asprintf(&db->data_path, "%s/%s", path, DB_DATA_FILE_NAME) == -1) {
+      db->data_path = NULL;
+      goto fail;
+   }
+
+   if (asprintf(&db->index_path, "%s/%s", path, DB_INDEX_FILE_NAME) == -1) {
+      db->index_path = NULL;
+      goto fail;
+   }
+
+   db->index_fd = open(db->index_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (db->index_fd == -1)
+      goto fail;
+
+   /* Released when the file is closed, on failure. */
+   if (flock(db->index_fd, LOCK_EX) == -1)
+      goto fail;
+
+   db->data_fd = open(db->data_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (db->data_fd == -1)
+      goto fail;
+
+   if (fstat(db->index_fd, &sb) == -1)
+      goto fail;
+
+   db->index_mmap_size = sizeof(struct db_index_header) +
+                         DB_INDEX_ENTRIES * sizeof(struct db_index_entry);
+
+   if (sb.st_size != db->index_mmap_size) {
+      if (ftruncate(db->index_fd, 0) == -1 ||
+          ftruncate(db->index_fd, db->index_mmap_size) == -1)
+         goto fail;
+      reset = true;
+   }
+
+   /* Mapped shared, so that all processes see the same index. */
+   db->index_mmap = mmap(NULL, db->index_mmap_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, db->index_fd, 0);
+   if (db->index_mmap == MAP_FAILED)
+      goto fail;
+
+   db->header = db->index_mmap;
+   db->entries = (struct db_index_entry *) (db->header + 1);
+
+   if (db->header->magic != DB_MAGIC || db->header->version != DB_VERSION)
+      reset = true;
+
+   if (pread_all(db->data_fd, &file_header, sizeof(file_header), 0) == -1 ||
+       file_header.magic != DB_MAGIC || file_header.version != DB_VERSION)
+      reset = true;
+
+   if (reset && !reset_db(db))
+      goto fail;
+
+   db->generation = db->header->generation;
+
+   flock(db->index_fd, LOCK_UN);
+
+   return db;
+
+ fail:
+   free_db(db);
+
+   return NULL;
+}
+
+void
+disk_cache_db_close(struct disk_cache_db *db)
+{
+   if (db)
+      free_db(db);
+}
+
+bool
+disk_cache_db_put(struct disk_cache_db *db, const cache_key key,
+                  const void *data, size_t size)
+{
+   struct db_record_header record;
+   struct db_index_entry *entry;
+   uint64_t record_size = sizeof(record) + size;
+   off_t offset;
+   bool ret = false;
+
+   /* An entry which can't fit even in an empty file is never stored. */
+   if (size == 0 || size > UINT32_MAX ||
+       sizeof(struct db_file_header) + record_size > db->max_size)
+      return false;
+
+   mtx_lock(&db->mutex);
+
+   if (flock(db->index_fd, LOCK_EX) == -1) {
+      mtx_unlock(&db->mutex);
+      return false;
+   }
+
+   if (!update_data_file(db))
+      goto done;
+
+   if (find_entry(db, key)) {
+      ret = true;
+      goto done;
+   }
+
+   offset = lseek(db->data_fd, 0, SEEK_END);
+   if (offset == -1)
+      goto done;
+
+   entry = find_free_entry(db, key);
+
+   if (!entry || offset + record_size > db->max_size ||
+       db->header->num_entries >= DB_INDEX_ENTRIES / 2) {
+      if (!compact_db(db, record_size))
+         goto done;
+
+      offset = lseek(db->data_fd, 0, SEEK_END);
+      if (offset == -1)
+         goto done;
+
+      entry = find_free_entry(db, key);
+      if (!entry)
+         goto done;
+   }
+
+   memcpy(record.key, key, CACHE_KEY_SIZE);
+   record.size = size;
+
+   if (pwrite_all(db->data_fd, &record, sizeof(record), offset) == -1 ||
+       pwrite_all(db->data_fd, data, size, offset + sizeof(record)) == -1) {
+      /* Don't leave a partial record behind, it would only waste space. */
+      MAYBE_UNUSED int err = ftruncate(db->data_fd, offset);
+      goto done;
+   }
+
+   set_entry(db, entry, key, size, offset,
+             p_atomic_inc_return(&db->header->access_clock));
+
+   ret = true;
+
+ done:
+   flock(db->index_fd, LOCK_UN);
+   mtx_unlock(&db->mutex);
+
+   return ret;
+}
+
+void *
+disk_cache_db_get(struct disk_cache_db *db, const cache_key key,
+                  size_t *size)
+{
+   struct db_index_entry *entry;
+   struct db_record_header *record = NULL;
+   uint64_t offset, generation;
+   uint32_t data_size;
+   unsigned attempt;
+   bool valid = false;
+   int fd;
+
+   if (size)
+      *size = 0;
+
+   /* The lock is only held to look the entry up, not while reading it, so
+    * that readers don't wait on each other's I/O.  If the data file got
+    * replaced meanwhile, fd may have been closed, or even reused: what we
+    * read is then discarded, and the entry looked up again.
+    */
+   for (attempt = 0; attempt < 2 && !valid; attempt++) {
+      mtx_lock(&db->mutex);
+
+      if (!update_data_file(db)) {
+         mtx_unlock(&db->mutex);
+         return NULL;
+      }
+
+      entry = find_entry(db, key);
+      if (!entry) {
+         mtx_unlock(&db->mutex);
+         return NULL;
+      }
+
+      offset = entry->offset;
+      data_size = p_atomic_read(&entry->size);
+      fd = db->data_fd;
+      generation = db->generation;
+
+      mtx_unlock(&db->mutex);
+
+      /* Another process may have removed the entry as we read it. */
+      if (!data_size)
+         return NULL;
+
+      /* Read the record header along with the data, it's how we know the
+       * entry was still valid when we read it.
+       */
+      free(record);
+      record = malloc(sizeof(*record) + data_size);
+      if (!record)
+         return NULL;
+
+      if (pread_all(fd, record, sizeof(*record) + data_size, offset) != -1 &&
+          memcmp(record->key, key, CACHE_KEY_SIZE) == 0 &&
+          record->size == data_size)
+         valid = true;
+
+      mtx_lock(&db->mutex);
+
+      if (db->generation != generation) {
+         valid = false;
+      } else if (valid) {
+         entry = find_entry(db, key);
+         if (entry)
+            entry->last_access = p_atomic_inc_return(&db->header->access_clock);
+      }
+
+      mtx_unlock(&db->mutex);
+   }
+
+   if (!valid) {
+      free(record);
+      return NULL;
+   }
+
+   memmove(record, record + 1, data_size);
+
+   if (size)
+      *size = data_size;
+
+   return record;
+}
+
+void
+disk_cache_db_remove(struct disk_cache_db *db, const cache_key key)
+{
+   struct db_index_entry *entry;
+
+   mtx_lock(&db->mutex);
+
+   if (flock(db->index_fd, LOCK_EX) == 0) {
+      entry = find_entry(db, key);
+      if (entry) {
+         /* The data stays in the file until the next compaction. */
+         p_atomic_set(&entry->size, 0);
+         db->header->num_entries--;
+      }
+
+      flock(db->index_fd, LOCK_UN);
+   }
+
+   mtx_unlock(&db->mutex);
+}
+
+#endif /* ENABLE_SHADER_CACHE */
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/**
+ * Single-file storage backend for the disk cache.
+ *
+ * All the entries are appended to one data file, and located through an
+ * mmapped hash table kept in a separate index file.  A lookup is an index
+ * probe plus a single pread.  Eviction compacts the data file, keeping the
+ * most recently used entries, instead of scanning the cache directory.
+ *
+ * The files are shared between processes: writers serialize on an flock of
+ * the index file, while readers don't lock at all and instead validate the
+ * key stored with each entry.
+ */
+
+#ifndef DISK_CACHE_DB_H
+#define DISK_CACHE_DB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "disk_cache.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct disk_cache_db;
+
+/**
+ * Open, creating them as needed, the database files in the cache directory
+ * \p path.  The data file is compacted to stay within \p max_size bytes.
+ *
+ * Returns NULL on any error.
+ */
+struct disk_cache_db *
+disk_cache_db_open(const char *path, uint64_t max_size);
+
+void
+disk_cache_db_close(struct disk_cache_db *db);
+
+/**
+ * Store \p size bytes of \p data under \p key, unless the key is already
+ * present.
+ */
+bool
+disk_cache_db_put(struct disk_cache_db *db, const cache_key key,
+                  const void *data, size_t size);
+
+/**
+ * Return a malloc'ed copy of the data stored under \p key, or NULL.
+ */
+void *
+disk_cache_db_get(struct disk_cache_db *db, const cache_key key,
+                  size_t *size);
+
+void
+disk_cache_db_remove(struct disk_cache_db *db, const cache_key key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DISK_CACHE_DB_H */
@@ -66,6 +66,11 @@ struct
    unsigned canary;
 #endif
 
+   /* SLAB_* flags and size class of the allocations owned by a slab context,
+    * zero for the other ones.
+    */
+   unsigned slab_flags;
+
    struct ralloc_header *parent;
 
    /* The first child (head of a linked list) */
@@ -80,8 +85,18 @@ struct
 
 typedef struct ralloc_header ralloc_header;
 
+/* A slot in a page of a slab context, in use. */
+#define SLAB_SLOT     (1 << 0)
+/* Too large for the slots, allocated as a child of the slab context. */
+#define SLAB_LARGE    (1 << 1)
+/* Marked as live since the last ralloc_slab_sweep(). */
+#define SLAB_LIVE     (1 << 2)
+#define SLAB_OWNED    (SLAB_SLOT | SLAB_LARGE)
+#define SLAB_CLASS_SHIFT 8
+
 static void unlink_block(ralloc_header *info);
 static void unsafe_free(ralloc_header *info);
+static void free_slab_slot(ralloc_header *info);
 
 static ralloc_header *
 get_header(const void *ptr)
@@ -130,6 +145,7 @@ ralloc_size(const void *ctx, size_t size)
     * the multiplication overflow checking?), so clear things
     * manually
     */
+   info->slab_flags = 0;
    info->parent = NULL;
    info->child = NULL;
    info->prev = NULL;
@@ -165,6 +181,7 @@ resize(void *ptr, size_t size)
    ralloc_header *child, *old, *info;
 
    old = get_header(ptr);
+   assert(!(old->slab_flags & SLAB_OWNED));
    info = realloc(old, size + sizeof(ralloc_header));
 
    if (info == NULL)
@@ -235,7 +252,11 @@ ralloc_free(void *ptr)
       return;
 
    info = get_header(ptr);
-   unlink_block(info);
+
+   /* Slots aren't linked to the slab context they belong to. */
+   if (!(info->slab_flags & SLAB_SLOT))
+      unlink_block(info);
+
    unsafe_free(info);
 }
 
@@ -273,7 +294,10 @@ unsafe_free(ralloc_header *info)
    if (info->destructor != NULL)
       info->destructor(PTR_FROM_HEADER(info));
 
-   free(info);
+   if (info->slab_flags & SLAB_SLOT)
+      free_slab_slot(info);
+   else
+      free(info);
 }
 
 void
@@ -287,6 +311,7 @@ ralloc_steal(const void *new_ctx, void *ptr)
    info = get_header(ptr);
    parent = new_ctx ? get_header(new_ctx) : NULL;
 
+   assert(!(info->slab_flags & SLAB_OWNED));
    unlink_block(info);
 
    add_child(parent, info);
@@ -330,6 +355,13 @@ ralloc_parent(const void *ptr)
       return NULL;
 
    info = get_header(ptr);
+
+   /* The parent of the allocations owned by a slab context is the one of the
+    * slab context.
+    */
+   if (info->slab_flags & SLAB_OWNED)
+      info = info->parent;
+
    return info->parent ? PTR_FROM_HEADER(info->parent) : NULL;
 }
 
@@ -535,6 +567,271 @@ ralloc_vasprintf_rewrite_tail(char **str, size_t *start, const char *fmt,
    return true;
 }
 
+/***************************************************************************
+ * Slab allocator for many small allocations.
+ ***************************************************************************
+ *
+ * Allocations are rounded up to a multiple of SLAB_GRANULARITY bytes, and
+ * each of these size classes has its pages of slots, which are ralloc headers
+ * followed by room for the allocation, and a list of free slots.
+ *
+ * The slots in use point to the slab context as their parent, so that it can
+ * be found when they are freed, but aren't in its list of children.  Instead,
+ * ralloc_slab_sweep() and the destructor of the slab context find them by
+ * walking the pages.  Allocations too large for the slots are regular
+ * children of the slab context.
+ *
+ * This doesn't use util/slab.c, because its pools have a single item size
+ * and put their own header in front of each element to support frees from
+ * other threads, while the slots here have to be ralloc headers so that they
+ * can own children and have destructors.  slab.c also has no way to walk the
+ * elements of a pool, which the sweep needs to find the slots that weren't
+ * marked.
+ */
+
+#define SLAB_GRANULARITY 16
+#define SLAB_NUM_CLASSES 33
+#define SLAB_MIN_PAGE_SIZE 8192
+#define SLAB_MIN_SLOTS_PER_PAGE 8
+
+struct ralloc_slab_page {
+   struct ralloc_slab_page *next;
+   unsigned num_slots;
+};
+
+/* Keep the slots at least as aligned as the ralloc headers. */
+#define SLAB_PAGE_HEADER_SIZE ALIGN_POT(sizeof(struct ralloc_slab_page), 16)
+
+struct ralloc_slab_ctx {
+   struct ralloc_slab_page *pages[SLAB_NUM_CLASSES];
+   ralloc_header *free_slots[SLAB_NUM_CLASSES];
+};
+
+static inline unsigned
+slab_slot_size(unsigned size_class)
+{
+   return sizeof(ralloc_header) + size_class * SLAB_GRANULARITY;
+}
+
+static inline ralloc_header *
+slab_page_slot(struct ralloc_slab_page *page, unsigned size_class,
+               unsigned i)
+{
+   return (ralloc_header *) ((char *) page + SLAB_PAGE_HEADER_SIZE +
+                             i * slab_slot_size(size_class));
+}
+
+/* Free the children of a slot in use and call its destructor. */
+static void
+release_slab_slot(ralloc_header *info)
+{
+   ralloc_header *temp;
+   while (info->child != NULL) {
+      temp = info->child;
+      info->child = temp->next;
+      unsafe_free(temp);
+   }
+
+   if (info->destructor != NULL)
+      info->destructor(PTR_FROM_HEADER(info));
+}
+
+static void
+free_slab_slot(ralloc_header *info)
+{
+   ralloc_slab_ctx *slab = (ralloc_slab_ctx *) PTR_FROM_HEADER(info->parent);
+   unsigned size_class = info->slab_flags >> SLAB_CLASS_SHIFT;
+
+   info->slab_flags = size_class << SLAB_CLASS_SHIFT;
+   info->next = slab->free_slots[size_class];
+   slab->free_slots[size_class] = info;
+}
+
+static bool
+add_slab_page(ralloc_slab_ctx *slab, unsigned size_class)
+{
+   const unsigned slot_size = slab_slot_size(size_class);
+   unsigned num_slots = (SLAB_MIN_PAGE_SIZE - SLAB_PAGE_HEADER_SIZE) / slot_size;
+   struct ralloc_slab_page *page;
+
+   if (num_slots < SLAB_MIN_SLOTS_PER_PAGE)
+      num_slots = SLAB_MIN_SLOTS_PER_PAGE;
+
+   page = malloc(SLAB_PAGE_HEADER_SIZE + num_slots * slot_size);
+   if (unlikely(page == NULL))
+      return false;
+
+   page->num_slots = num_slots;
+   page->next = slab->pages[size_class];
+   slab->pages[size_class] = page;
+
+   /* Hand out the slots in address order. */
+   for (unsigned i = num_slots; i-- > 0;) {
+      ralloc_header *info = slab_page_slot(page, size_class, i);
+
+      info->slab_flags = size_class << SLAB_CLASS_SHIFT;
+      info->next = slab->free_slots[size_class];
+      slab->free_slots[size_class] = info;
+   }
+
+   return true;
+}
+
+static void
+slab_ctx_destructor(void *ptr)
+{
+   ralloc_slab_ctx *slab = ptr;
+
+   for (unsigned c = 0; c < SLAB_NUM_CLASSES; c++) {
+      struct ralloc_slab_page *page, *next;
+
+      for (page = slab->pages[c]; page != NULL; page = next) {
+         next = page->next;
+
+         for (unsigned i = 0; i < page->num_slots; i++) {
+            ralloc_header *info = slab_page_slot(page, c, i);
+            if (info->slab_flags & SLAB_SLOT)
+               release_slab_slot(info);
+         }
+
+         free(page);
+      }
+   }
+}
+
+ralloc_slab_ctx *
+ralloc_slab_context(const void *ctx)
+{
+   ralloc_slab_ctx *slab = rzalloc(ctx, ralloc_slab_ctx);
+
+   if (likely(slab))
+      ralloc_set_destructor(slab, slab_ctx_destructor);
+
+   return slab;
+}
+
+void *
+ralloc_slab_size(ralloc_slab_ctx *slab, size_t size)
+{
+   const size_t size_class = DIV_ROUND_UP(size, SLAB_GRANULARITY);
+   ralloc_header *info;
+
+   if (unlikely(size_class >= SLAB_NUM_CLASSES)) {
+      void *ptr = ralloc_size(slab, size);
+
+      if (likely(ptr))
+         get_header(ptr)->slab_flags = SLAB_LARGE;
+      return ptr;
+   }
+
+   if (unlikely(slab->free_slots[size_class] == NULL) &&
+       !add_slab_page(slab, size_class))
+      return NULL;
+
+   info = slab->free_slots[size_class];
+   slab->free_slots[size_class] = info->next;
+
+   info->slab_flags = SLAB_SLOT | size_class << SLAB_CLASS_SHIFT;
+   info->parent = get_header(slab);
+   info->child = NULL;
+   info->prev = NULL;
+   info->next = NULL;
+   info->destructor = NULL;
+
+#ifdef DEBUG
+   info->canary = CANARY;
+#endif
+
+   return PTR_FROM_HEADER(info);
+}
+
+void *
+rzalloc_slab_size(ralloc_slab_ctx *slab, size_t size)
+{
+   void *ptr = ralloc_slab_size(slab, size);
+
+   if (likely(ptr))
+      memset(ptr, 0, size);
+
+   return ptr;
+}
+
+void
+ralloc_slab_mark_live(const void *ptr)
+{
+   ralloc_header *info = get_header(ptr);
+
+   assert(info->slab_flags & SLAB_OWNED);
+   info->slab_flags |= SLAB_LIVE;
+}
+
+void
+ralloc_slab_sweep(ralloc_slab_ctx *slab)
+{
+   ralloc_header *slab_info = get_header(slab);
+   ralloc_header *info, *next;
+
+   for (info = slab_info->child; info != NULL; info = next) {
+      next = info->next;
+
+      if (info->slab_flags & SLAB_LIVE)
+         info->slab_flags &= ~SLAB_LIVE;
+      else
+         ralloc_free(PTR_FROM_HEADER(info));
+   }
+
+   for (unsigned c = 0; c < SLAB_NUM_CLASSES; c++) {
+      struct ralloc_slab_page **link, *page;
+      ralloc_header **free_tail;
+
+      for (page = slab->pages[c]; page != NULL; page = page->next) {
+         for (unsigned i = 0; i < page->num_slots; i++) {
+            info = slab_page_slot(page, c, i);
+
+            if (info->slab_flags & SLAB_LIVE) {
+               info->slab_flags &= ~SLAB_LIVE;
+            } else if (info->slab_flags & SLAB_SLOT) {
+               release_slab_slot(info);
+               info->slab_flags = c << SLAB_CLASS_SHIFT;
+            }
+         }
+      }
+
+      /* Rebuild the list of free slots in address order, so that the next
+       * allocations are close to each other, and give the empty pages back.
+       */
+      slab->free_slots[c] = NULL;
+      free_tail = &slab->free_slots[c];
+      link = &slab->pages[c];
+
+      while ((page = *link) != NULL) {
+         ralloc_header **page_tail = free_tail;
+         bool empty = true;
+
+         for (unsigned i = 0; i < page->num_slots; i++) {
+            info = slab_page_slot(page, c, i);
+
+            if (info->slab_flags & SLAB_SLOT) {
+               empty = false;
+            } else {
+               *free_tail = info;
+               free_tail = &info->next;
+            }
+         }
+
+         if (empty) {
+            free_tail = page_tail;
+            *link = page->next;
+            free(page);
+         } else {
+            link = &page->next;
+         }
+      }
+
+      *free_tail = NULL;
+   }
+}
+
 /***************************************************************************
  * Linear allocator for short-lived allocations.
  ***************************************************************************
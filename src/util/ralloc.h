@@ -466,6 +466,49 @@ public:                                                                  \
    DECLARE_ALLOC_CXX_OPERATORS_TEMPLATE(type, linear_zalloc_child)
 
 
+/**
+ * An allocator for many small objects which are regularly garbage collected,
+ * like the instructions of a shader.
+ *
+ * The allocations come out of pages of slots sorted by size instead of one
+ * malloc() each, but are still ralloc contexts: they can have children and
+ * destructors, and can be freed with ralloc_free().  They belong to the slab
+ * context though, which is what ralloc_parent() returns the parent of, and
+ * can't be stolen by another context.
+ *
+ * The allocations which are still needed can be marked as live with
+ * ralloc_slab_mark_live(), and then all the other ones freed at once with
+ * ralloc_slab_sweep().
+ */
+typedef struct ralloc_slab_ctx ralloc_slab_ctx;
+
+/**
+ * Create a slab context, which is freed along with \p ctx.
+ */
+ralloc_slab_ctx *ralloc_slab_context(const void *ctx);
+
+/**
+ * Allocate memory from a slab context.
+ */
+void *ralloc_slab_size(ralloc_slab_ctx *slab, size_t size) MALLOCLIKE;
+
+/**
+ * Same as ralloc_slab_size, but also clears memory.
+ */
+void *rzalloc_slab_size(ralloc_slab_ctx *slab, size_t size) MALLOCLIKE;
+
+/**
+ * Keep an allocation of a slab context across the next ralloc_slab_sweep().
+ */
+void ralloc_slab_mark_live(const void *ptr);
+
+/**
+ * Free all the allocations of a slab context which weren't marked as live
+ * since the last sweep, and give its empty pages back to the system.
+ */
+void ralloc_slab_sweep(ralloc_slab_ctx *slab);
+
+
 /**
  * Do a fast allocation from the linear buffer, also known as the child node
  * from the allocator's point of view. It can't be freed directly. You have
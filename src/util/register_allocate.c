@@ -71,11 +71,21 @@
  */
 
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
 
 #include "ralloc.h"
 #include "main/imports.h"
 #include "main/macros.h"
 #include "util/bitset.h"
+#include "util/u_atomic.h"
 #include "register_allocate.h"
 
 #define NO_REG ~0U
@@ -125,8 +135,11 @@ struct ra_node {
     *
     * List of which nodes this node interferes with.  This should be
     * symmetric with the other node.
+    *
+    * Rather than looking for an interference each time one is added, which
+    * takes either an adjacency matrix or a hash set, the ones added more
+    * than once are removed by ra_allocate().
     */
-   BITSET_WORD *adjacency;
    unsigned int *adjacency_list;
    unsigned int adjacency_list_size;
    unsigned int adjacency_count;
@@ -393,14 +406,8 @@ ra_set_finalize(struct ra_regs *regs, unsigned int **q_values)
 static void
 ra_add_node_adjacency(struct ra_graph *g, unsigned int n1, unsigned int n2)
 {
-   BITSET_SET(g->nodes[n1].adjacency, n2);
-
    assert(n1 != n2);
 
-   int n1_class = g->nodes[n1].class;
-   int n2_class = g->nodes[n2].class;
-   g->nodes[n1].q_total += g->regs->classes[n1_class]->q[n2_class];
-
    if (g->nodes[n1].adjacency_count >=
        g->nodes[n1].adjacency_list_size) {
       g->nodes[n1].adjacency_list_size *= 2;
@@ -427,9 +434,6 @@ ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
    g->stack = rzalloc_array(g, unsigned int, count);
 
    for (i = 0; i < count; i++) {
-      int bitset_count = BITSET_WORDS(count);
-      g->nodes[i].adjacency = rzalloc_array(g, BITSET_WORD, bitset_count);
-
       g->nodes[i].adjacency_list_size = 4;
       g->nodes[i].adjacency_list =
          ralloc_array(g, unsigned int, g->nodes[i].adjacency_list_size);
@@ -463,7 +467,7 @@ void
 ra_add_node_interference(struct ra_graph *g,
                          unsigned int n1, unsigned int n2)
 {
-   if (n1 != n2 && !BITSET_TEST(g->nodes[n1].adjacency, n2)) {
+   if (n1 != n2) {
       ra_add_node_adjacency(g, n1, n2);
       ra_add_node_adjacency(g, n2, n1);
    }
@@ -477,8 +481,120 @@ pq_test(struct ra_graph *g, unsigned int n)
    return g->nodes[n].q_total < g->regs->classes[n_class]->p;
 }
 
+/**
+ * The state of ra_simplify(), which keeps track of the nodes which pass the
+ * pq test instead of scanning all the nodes for them again after each push.
+ */
+struct ra_simplify_state {
+   /** Nodes to push which passed the pq test. */
+   BITSET_WORD *trivial;
+   unsigned int trivial_count;
+
+   /**
+    * Binary min-heap of the nodes to push which didn't pass the pq test,
+    * ordered by ra_heap_key(), and the position of each node in it or ~0.
+    */
+   unsigned int *heap;
+   unsigned int heap_count;
+   unsigned int *heap_pos;
+};
+
+/* The lowest q total first, and then the highest index. */
+static uint64_t
+ra_heap_key(struct ra_graph *g, unsigned int n)
+{
+   return (uint64_t) g->nodes[n].q_total << 32 | (UINT32_MAX - n);
+}
+
+static void
+ra_heap_set(struct ra_simplify_state *state, unsigned int i, unsigned int n)
+{
+   state->heap[i] = n;
+   state->heap_pos[n] = i;
+}
+
+static void
+ra_heap_sift_up(struct ra_graph *g, struct ra_simplify_state *state,
+                unsigned int i)
+{
+   const unsigned int n = state->heap[i];
+   const uint64_t key = ra_heap_key(g, n);
+
+   while (i > 0 && ra_heap_key(g, state->heap[(i - 1) / 2]) > key) {
+      ra_heap_set(state, i, state->heap[(i - 1) / 2]);
+      i = (i - 1) / 2;
+   }
+   ra_heap_set(state, i, n);
+}
+
+static void
+ra_heap_sift_down(struct ra_graph *g, struct ra_simplify_state *state,
+                  unsigned int i)
+{
+   const unsigned int n = state->heap[i];
+   const uint64_t key = ra_heap_key(g, n);
+
+   while (2 * i + 1 < state->heap_count) {
+      unsigned int child = 2 * i + 1;
+      if (child + 1 < state->heap_count &&
+          ra_heap_key(g, state->heap[child + 1]) <
+          ra_heap_key(g, state->heap[child]))
+         child++;
+
+      if (key <= ra_heap_key(g, state->heap[child]))
+         break;
+
+      ra_heap_set(state, i, state->heap[child]);
+      i = child;
+   }
+   ra_heap_set(state, i, n);
+}
+
 static void
-decrement_q(struct ra_graph *g, unsigned int n)
+ra_heap_remove(struct ra_graph *g, struct ra_simplify_state *state,
+               unsigned int n)
+{
+   const unsigned int i = state->heap_pos[n];
+   const unsigned int last = state->heap[--state->heap_count];
+
+   state->heap_pos[n] = ~0;
+   if (last == n)
+      return;
+
+   ra_heap_set(state, i, last);
+   ra_heap_sift_up(g, state, i);
+   ra_heap_sift_down(g, state, state->heap_pos[last]);
+}
+
+/**
+ * Files a node still to be simplified, whose q total is new or decreased,
+ * as trivially colorable or not.
+ */
+static void
+ra_simplify_update_node(struct ra_graph *g, struct ra_simplify_state *state,
+                        unsigned int n)
+{
+   if (g->nodes[n].in_stack || g->nodes[n].reg != NO_REG ||
+       BITSET_TEST(state->trivial, n))
+      return;
+
+   if (pq_test(g, n)) {
+      if (state->heap_pos[n] != ~0U)
+         ra_heap_remove(g, state, n);
+
+      BITSET_SET(state->trivial, n);
+      state->trivial_count++;
+   } else if (state->heap_pos[n] != ~0U) {
+      ra_heap_sift_up(g, state, state->heap_pos[n]);
+   } else {
+      ra_heap_set(state, state->heap_count++, n);
+      ra_heap_sift_up(g, state, state->heap_count - 1);
+   }
+}
+
+static void
+decrement_q(struct ra_graph *g, struct ra_simplify_state *state,
+            unsigned int n)
 {
    unsigned int i;
    int n_class = g->nodes[n].class;
@@ -490,10 +606,21 @@ decrement_q(struct ra_graph *g, unsigned int n)
       if (!g->nodes[n2].in_stack) {
          assert(g->nodes[n2].q_total >= g->regs->classes[n2_class]->q[n_class]);
          g->nodes[n2].q_total -= g->regs->classes[n2_class]->q[n_class];
+         ra_simplify_update_node(g, state, n2);
       }
    }
 }
 
+static void
+ra_simplify_push(struct ra_graph *g, struct ra_simplify_state *state,
+                 unsigned int n)
+{
+   decrement_q(g, state, n);
+   g->stack[g->stack_count] = n;
+   g->stack_count++;
+   g->nodes[n].in_stack = true;
+}
+
 /**
  * Simplifies the interference graph by pushing all
  * trivially-colorable nodes into a stack of nodes to be colored,
@@ -503,52 +630,80 @@ decrement_q(struct ra_graph *g, unsigned int n)
  * we optimistically choose a node and push it on the stack. We heuristically
  * push the node with the lowest total q value, since it has the fewest
  * neighbors and therefore is most likely to be allocated.
+ *
+ * The nodes are pushed in the order of passes over all the nodes from the
+ * highest index down, each pushing the nodes passing the pq test when the
+ * pass reaches them, or else the one with the lowest q total and the highest
+ * index, but only the nodes which pass the pq test or have the lowest q
+ * total are looked at.
  */
-static void
+static bool
 ra_simplify(struct ra_graph *g)
 {
-   bool progress = true;
    unsigned int stack_optimistic_start = UINT_MAX;
-   int i;
-
-   while (progress) {
-      unsigned int best_optimistic_node = ~0;
-      unsigned int lowest_q_total = ~0;
-
-      progress = false;
-
-      for (i = g->count - 1; i >= 0; i--) {
-	 if (g->nodes[i].in_stack || g->nodes[i].reg != NO_REG)
-	    continue;
-
-	 if (pq_test(g, i)) {
-	    decrement_q(g, i);
-	    g->stack[g->stack_count] = i;
-	    g->stack_count++;
-	    g->nodes[i].in_stack = true;
-	    progress = true;
-	 } else {
-	    unsigned int new_q_total = g->nodes[i].q_total;
-	    if (new_q_total < lowest_q_total) {
-	       best_optimistic_node = i;
-	       lowest_q_total = new_q_total;
-	    }
-	 }
-      }
+   struct ra_simplify_state state = { 0 };
+   unsigned int i;
+
+   state.trivial = calloc(BITSET_WORDS(g->count), sizeof(BITSET_WORD));
+   state.heap = malloc(g->count * sizeof(*state.heap));
+   state.heap_pos = malloc(g->count * sizeof(*state.heap_pos));
+   if (!state.trivial || !state.heap || !state.heap_pos) {
+      free(state.trivial);
+      free(state.heap);
+      free(state.heap_pos);
+      return false;
+   }
 
-      if (!progress && best_optimistic_node != ~0U) {
-         if (stack_optimistic_start == UINT_MAX)
-            stack_optimistic_start = g->stack_count;
+   memset(state.heap_pos, 0xff, g->count * sizeof(*state.heap_pos));
 
-	 decrement_q(g, best_optimistic_node);
-	 g->stack[g->stack_count] = best_optimistic_node;
-	 g->stack_count++;
-	 g->nodes[best_optimistic_node].in_stack = true;
-	 progress = true;
+   for (i = 0; i < g->count; i++)
+      ra_simplify_update_node(g, &state, i);
+
+   while (true) {
+      bool progress = false;
+
+      for (int w = BITSET_WORDS(g->count) - 1;
+           w >= 0 && state.trivial_count > 0; w--) {
+         /* The nodes above the position of the pass are left to the next
+          * one.
+          */
+         BITSET_WORD below = ~0;
+
+         while (state.trivial[w] & below) {
+            const unsigned int bit = util_last_bit(state.trivial[w] & below) - 1;
+            const unsigned int n = w * BITSET_WORDBITS + bit;
+
+            below = (1u << bit) - 1;
+            BITSET_CLEAR(state.trivial, n);
+            state.trivial_count--;
+
+            ra_simplify_push(g, &state, n);
+            progress = true;
+         }
       }
+
+      if (progress)
+         continue;
+
+      if (state.heap_count == 0)
+         break;
+
+      const unsigned int best_optimistic_node = state.heap[0];
+      ra_heap_remove(g, &state, best_optimistic_node);
+
+      if (stack_optimistic_start == UINT_MAX)
+         stack_optimistic_start = g->stack_count;
+
+      ra_simplify_push(g, &state, best_optimistic_node);
    }
 
+   free(state.trivial);
+   free(state.heap);
+   free(state.heap_pos);
+
    g->stack_optimistic_start = stack_optimistic_start;
+
+   return true;
 }
 
 static bool
@@ -676,10 +831,136 @@ ra_select(struct ra_graph *g)
    return true;
 }
 
+/**
+ * Removes the interferences added more than once from the adjacency lists,
+ * keeping the first ones in place, and computes the q totals.  Returns false
+ * if it runs out of memory.
+ */
+static bool
+ra_finish_adjacency(struct ra_graph *g)
+{
+   /* The last node found adjacent to each node. */
+   unsigned int *adjacent_to = malloc(g->count * sizeof(*adjacent_to));
+   unsigned int i, j;
+
+   if (!adjacent_to)
+      return false;
+
+   memset(adjacent_to, 0xff, g->count * sizeof(*adjacent_to));
+
+   for (i = 0; i < g->count; i++) {
+      struct ra_node *node = &g->nodes[i];
+      unsigned int *q = g->regs->classes[node->class]->q;
+      unsigned int count = 0;
+
+      node->q_total = 0;
+
+      for (j = 0; j < node->adjacency_count; j++) {
+         unsigned int n2 = node->adjacency_list[j];
+
+         if (adjacent_to[n2] == i)
+            continue;
+
+         adjacent_to[n2] = i;
+         node->adjacency_list[count++] = n2;
+         node->q_total += q[g->nodes[n2].class];
+      }
+
+      node->adjacency_count = count;
+   }
+
+   free(adjacent_to);
+
+   return true;
+}
+
+/**
+ * Writes the register set and the interference graph to a new file of the
+ * given directory, in the text format read back by
+ * src/util/tests/register_allocate/ra_bench.c, so that the allocation of
+ * real shaders can be replayed.  Which register a node is given by the
+ * select_reg_callback is not recorded.
+ */
+static void
+ra_dump_graph(struct ra_graph *g, const char *dir)
+{
+   static unsigned int dump_count;
+   struct ra_regs *regs = g->regs;
+   unsigned int i, j;
+   char *filename;
+   FILE *f;
+
+   filename = ralloc_asprintf(NULL, "%s/ra-%d-%u.txt", dir, (int) getpid(),
+                              p_atomic_inc_return(&dump_count));
+   if (!filename)
+      return;
+
+   f = fopen(filename, "w");
+   if (!f) {
+      fprintf(stderr, "Failed to open %s for writing\n", filename);
+      ralloc_free(filename);
+      return;
+   }
+   ralloc_free(filename);
+
+   fprintf(f, "regs %u %u %u\n", regs->count, regs->class_count,
+           regs->round_robin);
+
+   for (i = 0; i < regs->class_count; i++) {
+      fprintf(f, "class %u", i);
+      for (j = 0; j < regs->count; j++) {
+         if (reg_belongs_to_class(j, regs->classes[i]))
+            fprintf(f, " %u", j);
+      }
+      fprintf(f, "\nq %u", i);
+      for (j = 0; j < regs->class_count; j++)
+         fprintf(f, " %u", regs->classes[i]->q[j]);
+      fprintf(f, "\n");
+   }
+
+   /* Registers always conflict with themselves. */
+   for (i = 0; i < regs->count; i++) {
+      fprintf(f, "conflicts %u", i);
+      for (j = 0; j < regs->count; j++) {
+         if (j != i && BITSET_TEST(regs->regs[i].conflicts, j))
+            fprintf(f, " %u", j);
+      }
+      fprintf(f, "\n");
+   }
+
+   fprintf(f, "nodes %u\n", g->count);
+   for (i = 0; i < g->count; i++) {
+      fprintf(f, "node %u %u %d %.9g\n", i, g->nodes[i].class,
+              g->nodes[i].reg == NO_REG ? -1 : (int) g->nodes[i].reg,
+              g->nodes[i].spill_cost);
+   }
+
+   /* Each interference once, from the lower node. */
+   for (i = 0; i < g->count; i++) {
+      fprintf(f, "adjacency %u", i);
+      for (j = 0; j < g->nodes[i].adjacency_count; j++) {
+         if (g->nodes[i].adjacency_list[j] > i)
+            fprintf(f, " %u", g->nodes[i].adjacency_list[j]);
+      }
+      fprintf(f, "\n");
+   }
+
+   fclose(f);
+}
+
 bool
 ra_allocate(struct ra_graph *g)
 {
-   ra_simplify(g);
+   if (!ra_finish_adjacency(g))
+      return false;
+
+   const char *dump_dir = getenv("MESA_RA_DUMP_DIR");
+   if (dump_dir)
+      ra_dump_graph(g, dump_dir);
+
+   if (!ra_simplify(g))
+      return false;
+
    return ra_select(g);
 }
 
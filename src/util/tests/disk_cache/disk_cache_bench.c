@@ -0,0 +1,186 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Compares the put and get throughput of the disk cache for each of the
+ * supported entry compressions.
+ *
+ * Usage: disk_cache_bench [directory]
+ *
+ * The caches are created in a temporary directory within the given directory
+ * (the current one by default), which is removed afterwards.
+ */
+
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "disk_cache.h"
+#include "macros.h"
+#include "os_time.h"
+
+#define NUM_ENTRIES 512
+#define ENTRY_SIZE (32 * 1024)
+
+static const char *compressions[] = {
+   "none",
+   "zlib",
+#ifdef HAVE_ZSTD
+   "zstd",
+#endif
+};
+
+static int
+remove_entry(const char *path, const struct stat *sb, int typeflag,
+             struct FTW *ftwbuf)
+{
+   return remove(path);
+}
+
+/* Fill an entry with something compressing about as well as a shader
+ * binary: a small set of opcodes with varying operands.
+ */
+static void
+fill_entry(uint32_t *data, unsigned seed)
+{
+   srand(seed);
+   for (unsigned i = 0; i < ENTRY_SIZE / sizeof(uint32_t); i++)
+      data[i] = (rand() % 16) << 24 | (rand() % 128) << 8 | (i & 0xff);
+}
+
+static bool
+wait_until_written(struct disk_cache *cache, const cache_key key)
+{
+   for (unsigned retries = 0; retries < 1000; retries++) {
+      void *result = disk_cache_get(cache, key, NULL);
+      if (result) {
+         free(result);
+         return true;
+      }
+
+      os_time_sleep(10000);
+   }
+
+   return false;
+}
+
+static bool
+run_benchmark(const char *dir, const char *compression, uint32_t **entries)
+{
+   cache_key keys[NUM_ENTRIES];
+   struct disk_cache *cache;
+   char *cache_dir;
+   int64_t start, put_time, get_time;
+   unsigned i;
+
+   if (asprintf(&cache_dir, "%s/%s", dir, compression) == -1)
+      return false;
+
+   setenv("MESA_GLSL_CACHE_DIR", cache_dir, 1);
+   setenv("MESA_GLSL_CACHE_COMPRESSION", compression, 1);
+   free(cache_dir);
+
+   cache = disk_cache_create("bench", "disk_cache_bench", 0);
+   if (!cache)
+      return false;
+
+   for (i = 0; i < NUM_ENTRIES; i++)
+      disk_cache_compute_key(cache, entries[i], ENTRY_SIZE, keys[i]);
+
+   /* The entries are written in order by a single thread, so the last one
+    * landing means that all of them did.
+    */
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_ENTRIES; i++)
+      disk_cache_put(cache, keys[i], entries[i], ENTRY_SIZE, NULL);
+   if (!wait_until_written(cache, keys[NUM_ENTRIES - 1])) {
+      disk_cache_destroy(cache);
+      return false;
+   }
+   put_time = os_time_get_nano() - start;
+
+   start = os_time_get_nano();
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      size_t size;
+      void *result = disk_cache_get(cache, keys[i], &size);
+
+      if (!result || size != ENTRY_SIZE ||
+          memcmp(result, entries[i], ENTRY_SIZE) != 0) {
+         fprintf(stderr, "%s: entry %u was not read back\n", compression, i);
+         free(result);
+         disk_cache_destroy(cache);
+         return false;
+      }
+
+      free(result);
+   }
+   get_time = os_time_get_nano() - start;
+
+   disk_cache_destroy(cache);
+
+   printf("%-6s put %8.1f MB/s   get %8.1f MB/s\n", compression,
+          (double) NUM_ENTRIES * ENTRY_SIZE / put_time * 1000.0,
+          (double) NUM_ENTRIES * ENTRY_SIZE / get_time * 1000.0);
+
+   return true;
+}
+
+int
+main(int argc, char **argv)
+{
+   uint32_t *entries[NUM_ENTRIES];
+   char *dir;
+   bool ok = true;
+   unsigned i;
+
+   if (asprintf(&dir, "%s/disk_cache_bench.XXXXXX",
+                argc > 1 ? argv[1] : ".") == -1)
+      return 1;
+
+   if (!mkdtemp(dir)) {
+      fprintf(stderr, "Failed to create %s: %s\n", dir, strerror(errno));
+      free(dir);
+      return 1;
+   }
+
+   for (i = 0; i < NUM_ENTRIES; i++) {
+      entries[i] = malloc(ENTRY_SIZE);
+      fill_entry(entries[i], i);
+   }
+
+   printf("%u entries of %u bytes\n", NUM_ENTRIES, ENTRY_SIZE);
+
+   for (i = 0; i < ARRAY_SIZE(compressions) && ok; i++)
+      ok = run_benchmark(dir, compressions[i], entries);
+
+   for (i = 0; i < NUM_ENTRIES; i++)
+      free(entries[i]);
+
+   nftw(dir, remove_entry, 64, FTW_DEPTH | FTW_PHYS);
+   free(dir);
+
+   return ok ? 0 : 1;
+}
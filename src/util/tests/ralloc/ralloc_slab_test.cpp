@@ -0,0 +1,183 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include "util/ralloc.h"
+
+static unsigned num_destroyed;
+
+static void
+count_destructor(void *ptr)
+{
+   num_destroyed++;
+}
+
+class ralloc_slab_test : public ::testing::Test {
+protected:
+   ralloc_slab_test();
+   ~ralloc_slab_test();
+
+   void *mem_ctx;
+   ralloc_slab_ctx *slab;
+};
+
+ralloc_slab_test::ralloc_slab_test()
+{
+   mem_ctx = ralloc_context(NULL);
+   slab = ralloc_slab_context(mem_ctx);
+   num_destroyed = 0;
+}
+
+ralloc_slab_test::~ralloc_slab_test()
+{
+   ralloc_free(mem_ctx);
+}
+
+TEST_F(ralloc_slab_test, parent)
+{
+   void *ptr = ralloc_slab_size(slab, 24);
+   void *large = ralloc_slab_size(slab, 4096);
+
+   /* The allocations belong to the parent of the slab context. */
+   EXPECT_EQ(ralloc_parent(ptr), mem_ctx);
+   EXPECT_EQ(ralloc_parent(large), mem_ctx);
+}
+
+TEST_F(ralloc_slab_test, size_class_reuse)
+{
+   void *a = ralloc_slab_size(slab, 20);
+   void *b = ralloc_slab_size(slab, 20);
+
+   EXPECT_NE(a, b);
+
+   /* A freed slot is handed out again for the same size class... */
+   ralloc_free(a);
+   void *c = ralloc_slab_size(slab, 32);
+   EXPECT_EQ(c, a);
+
+   /* ...but not for another one. */
+   ralloc_free(c);
+   void *d = ralloc_slab_size(slab, 48);
+   EXPECT_NE(d, a);
+   void *e = ralloc_slab_size(slab, 17);
+   EXPECT_EQ(e, a);
+}
+
+TEST_F(ralloc_slab_test, zeroed)
+{
+   char *a = (char *) ralloc_slab_size(slab, 64);
+   memset(a, 0xff, 64);
+   ralloc_free(a);
+
+   char *b = (char *) rzalloc_slab_size(slab, 64);
+   ASSERT_EQ(b, a);
+   for (unsigned i = 0; i < 64; i++)
+      EXPECT_EQ(b[i], 0);
+}
+
+TEST_F(ralloc_slab_test, many_pages)
+{
+   const unsigned num = 2000;
+   unsigned **ptrs = (unsigned **) malloc(num * sizeof(*ptrs));
+
+   /* Enough for several pages, which must not overlap. */
+   for (unsigned i = 0; i < num; i++) {
+      ptrs[i] = (unsigned *) ralloc_slab_size(slab, 40);
+      for (unsigned j = 0; j < 10; j++)
+         ptrs[i][j] = i;
+   }
+
+   for (unsigned i = 0; i < num; i++) {
+      for (unsigned j = 0; j < 10; j++)
+         EXPECT_EQ(ptrs[i][j], i);
+   }
+
+   free(ptrs);
+}
+
+TEST_F(ralloc_slab_test, mark_and_sweep)
+{
+   const unsigned num = 1000;
+   unsigned **ptrs = (unsigned **) malloc(num * sizeof(*ptrs));
+
+   for (unsigned i = 0; i < num; i++) {
+      /* Some too large for the slots. */
+      size_t size = i % 10 == 0 ? 1024 : 8 + i % 100;
+
+      ptrs[i] = (unsigned *) ralloc_slab_size(slab, size);
+      ptrs[i][0] = i;
+      ralloc_set_destructor(ptrs[i], count_destructor);
+
+      /* Children are freed along with their slot. */
+      void *child = ralloc_size(ptrs[i], 16);
+      ralloc_set_destructor(child, count_destructor);
+   }
+
+   for (unsigned i = 0; i < num; i += 3)
+      ralloc_slab_mark_live(ptrs[i]);
+
+   ralloc_slab_sweep(slab);
+
+   unsigned num_live = (num + 2) / 3;
+   EXPECT_EQ(num_destroyed, 2 * (num - num_live));
+
+   for (unsigned i = 0; i < num; i += 3)
+      EXPECT_EQ(ptrs[i][0], i);
+
+   /* The marks only last for one sweep. */
+   num_destroyed = 0;
+   ralloc_slab_sweep(slab);
+   EXPECT_EQ(num_destroyed, 2 * num_live);
+
+   free(ptrs);
+}
+
+TEST_F(ralloc_slab_test, reuse_after_sweep)
+{
+   void *a = ralloc_slab_size(slab, 24);
+   void *b = ralloc_slab_size(slab, 24);
+   void *c = ralloc_slab_size(slab, 24);
+
+   ralloc_slab_mark_live(b);
+   ralloc_slab_sweep(slab);
+
+   /* The free slots are handed out in address order. */
+   void *first = a < c ? a : c;
+   void *second = a < c ? c : a;
+   EXPECT_EQ(ralloc_slab_size(slab, 24), first);
+   EXPECT_EQ(ralloc_slab_size(slab, 24), second);
+}
+
+TEST_F(ralloc_slab_test, freed_with_parent)
+{
+   for (unsigned i = 0; i < 100; i++) {
+      void *ptr = ralloc_slab_size(slab, i % 2 ? 24 : 2048);
+      ralloc_set_destructor(ptr, count_destructor);
+   }
+
+   ralloc_free(mem_ctx);
+   mem_ctx = NULL;
+
+   EXPECT_EQ(num_destroyed, 100u);
+}
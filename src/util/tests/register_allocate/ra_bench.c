@@ -0,0 +1,444 @@
+/*
+ * Copyright © 2026 agent
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Times building interference graphs and allocating their registers.
+ *
+ * Usage: ra_bench [graph file...]
+ *
+ * The graph files are the ones written by the allocator when the
+ * MESA_RA_DUMP_DIR environment variable is set.  Without them, random graphs
+ * of increasing sizes are allocated with a register set laid out like the
+ * one of the Intel FS backend.
+ *
+ * The colorings are checked, and a checksum of them is printed so that
+ * changes to the allocator which should not change its results can be
+ * compared.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/ralloc.h"
+#include "util/register_allocate.h"
+
+#define BASE_REG_COUNT 128
+#define MAX_CLASS_SIZE 16
+#define REPEAT 5
+
+struct graph {
+   struct ra_regs *regs;
+   unsigned class_count;
+   /* For the checks, the registers conflicting with each register, or the
+    * first base register and the size of each register of a set made by
+    * make_fs_regs().
+    */
+   unsigned **conflicts;
+   unsigned *conflict_count;
+   unsigned *reg_base;
+   unsigned *reg_size;
+   /* Registers of each class, for the checks. */
+   bool **class_regs;
+
+   unsigned node_count;
+   unsigned *node_class;
+   int *node_reg;
+   float *spill_cost;
+
+   /* Interfering pairs of nodes. */
+   unsigned (*edges)[2];
+   unsigned edge_count;
+};
+
+static void
+add_conflict(struct graph *graph, unsigned r1, unsigned r2)
+{
+   graph->conflicts[r1] = reralloc(graph, graph->conflicts[r1], unsigned,
+                                   graph->conflict_count[r1] + 1);
+   graph->conflicts[r1][graph->conflict_count[r1]++] = r2;
+}
+
+static void
+add_edge(struct graph *graph, unsigned n1, unsigned n2, unsigned *size)
+{
+   if (graph->edge_count == *size) {
+      *size = MAX2(*size * 2, 1024);
+      graph->edges = reralloc_size(graph, graph->edges,
+                                   *size * sizeof(graph->edges[0]));
+   }
+
+   graph->edges[graph->edge_count][0] = n1;
+   graph->edges[graph->edge_count][1] = n2;
+   graph->edge_count++;
+}
+
+/* Builds a register set like brw_alloc_reg_set() does for gen6+: classes of
+ * 1 to 16 contiguous registers out of 128.
+ */
+static void
+make_fs_regs(struct graph *graph)
+{
+   unsigned count = 0;
+   for (unsigned size = 1; size <= MAX_CLASS_SIZE; size++)
+      count += BASE_REG_COUNT - (size - 1);
+
+   graph->regs = ra_alloc_reg_set(graph, count, false);
+   ra_set_allocate_round_robin(graph->regs);
+   graph->class_count = MAX_CLASS_SIZE;
+   graph->reg_base = ralloc_array(graph, unsigned, count);
+   graph->reg_size = ralloc_array(graph, unsigned, count);
+   graph->class_regs = ralloc_array(graph, bool *, MAX_CLASS_SIZE);
+
+   unsigned **q_values = ralloc_array(graph, unsigned *, MAX_CLASS_SIZE);
+   unsigned reg = 0;
+   for (unsigned c = 0; c < MAX_CLASS_SIZE; c++) {
+      const unsigned size = c + 1;
+
+      q_values[c] = ralloc_array(q_values, unsigned, MAX_CLASS_SIZE);
+      for (unsigned c2 = 0; c2 < MAX_CLASS_SIZE; c2++)
+         q_values[c][c2] = size + (c2 + 1) - 1;
+
+      ra_alloc_reg_class(graph->regs);
+      graph->class_regs[c] = rzalloc_array(graph, bool, count);
+
+      for (unsigned base = 0; base + size <= BASE_REG_COUNT; base++) {
+         ra_class_add_reg(graph->regs, c, reg);
+         graph->class_regs[c][reg] = true;
+         graph->reg_base[reg] = base;
+         graph->reg_size[reg] = size;
+
+         /* The registers of the first class are the base registers. */
+         for (unsigned i = base; i < base + size; i++)
+            ra_add_reg_conflict(graph->regs, i, reg);
+         reg++;
+      }
+   }
+
+   for (unsigned base = 0; base < BASE_REG_COUNT; base++)
+      ra_make_reg_conflicts_transitive(graph->regs, base);
+
+   ra_set_finalize(graph->regs, q_values);
+}
+
+static unsigned
+random_next(unsigned *state)
+{
+   *state = *state * 1103515245 + 12345;
+   return *state >> 8;
+}
+
+/* Nodes live over random ranges of a program, mostly of one register like
+ * after splitting the virtual GRFs, with some vectors and texturing results.
+ */
+static struct graph *
+make_random_graph(unsigned node_count, unsigned seed)
+{
+   struct graph *graph = rzalloc(NULL, struct graph);
+   unsigned *start = ralloc_array(graph, unsigned, node_count);
+   unsigned *end = ralloc_array(graph, unsigned, node_count);
+   unsigned program_length = node_count / 3;
+   unsigned edges_size = 0;
+
+   make_fs_regs(graph);
+
+   graph->node_count = node_count;
+   graph->node_class = ralloc_array(graph, unsigned, node_count);
+   graph->node_reg = ralloc_array(graph, int, node_count);
+   graph->spill_cost = ralloc_array(graph, float, node_count);
+
+   for (unsigned n = 0; n < node_count; n++) {
+      const unsigned r = random_next(&seed) % 100;
+      const unsigned size = r < 70 ? 1 : r < 85 ? 2 : r < 95 ? 4 : 8;
+
+      graph->node_class[n] = size - 1;
+      graph->node_reg[n] = -1;
+      graph->spill_cost[n] = 1.0f + random_next(&seed) % 16;
+
+      /* About 100 registers live on average. */
+      start[n] = random_next(&seed) % program_length;
+      end[n] = MIN2(start[n] + 1 + random_next(&seed) % (70 / size),
+                    program_length);
+   }
+
+   for (unsigned n1 = 0; n1 < node_count; n1++) {
+      for (unsigned n2 = 0; n2 < n1; n2++) {
+         if (start[n1] < end[n2] && start[n2] < end[n1])
+            add_edge(graph, n2, n1, &edges_size);
+      }
+   }
+
+   return graph;
+}
+
+static unsigned *
+parse_list(char *line, unsigned *count, void *mem_ctx)
+{
+   unsigned *list = NULL;
+   char *token, *save;
+
+   *count = 0;
+   for (token = strtok_r(line, " \n", &save); token;
+        token = strtok_r(NULL, " \n", &save)) {
+      list = reralloc(mem_ctx, list, unsigned, *count + 1);
+      list[(*count)++] = strtoul(token, NULL, 10);
+   }
+
+   return list;
+}
+
+/* Reads a graph in the format of ra_dump_graph(). */
+static struct graph *
+read_graph(const char *filename)
+{
+   FILE *f = fopen(filename, "r");
+   if (!f) {
+      fprintf(stderr, "Failed to open %s\n", filename);
+      return NULL;
+   }
+
+   struct graph *graph = rzalloc(NULL, struct graph);
+   unsigned **q_values = NULL;
+   unsigned reg_count = 0, edges_size = 0, round_robin, i, n, count;
+   int reg;
+   char *line = NULL;
+   size_t line_size = 0;
+   float cost;
+   bool ok = true;
+
+   while (ok && getline(&line, &line_size, f) != -1) {
+      char *rest;
+      unsigned *list;
+
+      if (sscanf(line, "regs %u %u %u", &reg_count, &graph->class_count,
+                 &round_robin) == 3) {
+         graph->regs = ra_alloc_reg_set(graph, reg_count, false);
+         if (round_robin)
+            ra_set_allocate_round_robin(graph->regs);
+         graph->conflicts = rzalloc_array(graph, unsigned *, reg_count);
+         graph->conflict_count = rzalloc_array(graph, unsigned, reg_count);
+         graph->class_regs = ralloc_array(graph, bool *, graph->class_count);
+         q_values = ralloc_array(graph, unsigned *, graph->class_count);
+         for (i = 0; i < graph->class_count; i++) {
+            ra_alloc_reg_class(graph->regs);
+            graph->class_regs[i] = rzalloc_array(graph, bool, reg_count);
+         }
+      } else if (sscanf(line, "class %u", &i) == 1) {
+         rest = strchr(line + strlen("class "), ' ');
+         list = rest ? parse_list(rest, &count, graph) : NULL;
+         ok = graph->regs && i < graph->class_count;
+         for (n = 0; ok && list && n < count; n++) {
+            ok = list[n] < reg_count;
+            if (ok) {
+               ra_class_add_reg(graph->regs, i, list[n]);
+               graph->class_regs[i][list[n]] = true;
+            }
+         }
+      } else if (sscanf(line, "q %u", &i) == 1) {
+         rest = strchr(line + strlen("q "), ' ');
+         ok = graph->regs && i < graph->class_count && rest;
+         if (ok) {
+            q_values[i] = parse_list(rest, &count, q_values);
+            ok = count == graph->class_count;
+         }
+      } else if (sscanf(line, "conflicts %u", &i) == 1) {
+         rest = strchr(line + strlen("conflicts "), ' ');
+         list = rest ? parse_list(rest, &count, graph) : NULL;
+         ok = graph->regs && i < reg_count;
+         for (n = 0; ok && list && n < count; n++) {
+            ok = list[n] < reg_count;
+            if (ok) {
+               ra_add_reg_conflict(graph->regs, i, list[n]);
+               add_conflict(graph, i, list[n]);
+            }
+         }
+      } else if (sscanf(line, "nodes %u", &count) == 1) {
+         for (i = 0; ok && i < graph->class_count; i++)
+            ok = q_values[i] != NULL;
+         if (!ok)
+            break;
+         ra_set_finalize(graph->regs, q_values);
+         graph->node_count = count;
+         graph->node_class = rzalloc_array(graph, unsigned, count);
+         graph->node_reg = ralloc_array(graph, int, count);
+         graph->spill_cost = rzalloc_array(graph, float, count);
+         memset(graph->node_reg, -1, count * sizeof(int));
+      } else if (sscanf(line, "node %u %u %d %f", &n, &i, &reg, &cost) == 4) {
+         ok = n < graph->node_count && i < graph->class_count &&
+              reg < (int) reg_count;
+         if (ok) {
+            graph->node_class[n] = i;
+            graph->node_reg[n] = reg;
+            graph->spill_cost[n] = cost;
+         }
+      } else if (sscanf(line, "adjacency %u", &n) == 1) {
+         rest = strchr(line + strlen("adjacency "), ' ');
+         list = rest ? parse_list(rest, &count, graph) : NULL;
+         ok = n < graph->node_count;
+         for (i = 0; ok && list && i < count; i++) {
+            ok = list[i] < graph->node_count;
+            if (ok)
+               add_edge(graph, n, list[i], &edges_size);
+         }
+      } else {
+         ok = false;
+      }
+   }
+
+   free(line);
+   fclose(f);
+
+   if (!ok || !graph->node_class) {
+      fprintf(stderr, "%s is not a valid graph\n", filename);
+      ralloc_free(graph);
+      return NULL;
+   }
+
+   return graph;
+}
+
+static bool
+regs_conflict(const struct graph *graph, unsigned r1, unsigned r2)
+{
+   if (r1 == r2)
+      return true;
+
+   if (graph->reg_base) {
+      return graph->reg_base[r1] < graph->reg_base[r2] + graph->reg_size[r2] &&
+             graph->reg_base[r2] < graph->reg_base[r1] + graph->reg_size[r1];
+   }
+
+   for (unsigned i = 0; i < graph->conflict_count[r1]; i++) {
+      if (graph->conflicts[r1][i] == r2)
+         return true;
+   }
+
+   return false;
+}
+
+/* Allocates the graph, returning whether it succeeded and adding the times
+ * taken and a checksum of the registers.
+ */
+static bool
+allocate(const struct graph *graph, int64_t *build_time,
+         int64_t *allocate_time, uint32_t *checksum, bool *valid)
+{
+   int64_t start = os_time_get_nano();
+
+   struct ra_graph *g = ra_alloc_interference_graph(graph->regs,
+                                                    graph->node_count);
+   for (unsigned n = 0; n < graph->node_count; n++) {
+      ra_set_node_class(g, n, graph->node_class[n]);
+      if (graph->node_reg[n] >= 0)
+         ra_set_node_reg(g, n, graph->node_reg[n]);
+      ra_set_node_spill_cost(g, n, graph->spill_cost[n]);
+   }
+
+   for (unsigned i = 0; i < graph->edge_count; i++)
+      ra_add_node_interference(g, graph->edges[i][0], graph->edges[i][1]);
+
+   *build_time += os_time_get_nano() - start;
+   start = os_time_get_nano();
+
+   bool success = ra_allocate(g);
+   if (!success)
+      *checksum = *checksum * 31 + ra_get_best_spill_node(g);
+
+   *allocate_time += os_time_get_nano() - start;
+
+   for (unsigned n = 0; success && n < graph->node_count; n++) {
+      const unsigned reg = ra_get_node_reg(g, n);
+
+      *checksum = *checksum * 31 + reg;
+      if (graph->node_reg[n] < 0 && !graph->class_regs[graph->node_class[n]][reg])
+         *valid = false;
+   }
+
+   for (unsigned i = 0; success && i < graph->edge_count; i++) {
+      if (regs_conflict(graph, ra_get_node_reg(g, graph->edges[i][0]),
+                        ra_get_node_reg(g, graph->edges[i][1])))
+         *valid = false;
+   }
+
+   ralloc_free(g);
+
+   return success;
+}
+
+static bool
+run(const char *name, const struct graph *graph)
+{
+   int64_t build_time = 0, allocate_time = 0;
+   uint32_t checksum = 0;
+   bool valid = true, success = false;
+
+   for (unsigned i = 0; i < REPEAT; i++) {
+      checksum = 0;
+      success = allocate(graph, &build_time, &allocate_time, &checksum,
+                         &valid);
+   }
+
+   printf("%-24s %6u nodes %8u edges  build %8.3f ms  allocate %8.3f ms  "
+          "%s %08x\n", name, graph->node_count, graph->edge_count,
+          build_time / 1000000.0 / REPEAT, allocate_time / 1000000.0 / REPEAT,
+          success ? "colored" : "spills ", checksum);
+
+   if (!valid)
+      fprintf(stderr, "%s: invalid coloring\n", name);
+
+   return valid;
+}
+
+int
+main(int argc, char **argv)
+{
+   bool ok = true;
+
+   if (argc > 1) {
+      for (int i = 1; i < argc; i++) {
+         struct graph *graph = read_graph(argv[i]);
+         if (!graph) {
+            ok = false;
+            continue;
+         }
+
+         const char *name = strrchr(argv[i], '/');
+         ok &= run(name ? name + 1 : argv[i], graph);
+         ralloc_free(graph);
+      }
+   } else {
+      static const unsigned sizes[] = { 250, 1000, 4000, 16000 };
+
+      for (unsigned i = 0; i < ARRAY_SIZE(sizes); i++) {
+         struct graph *graph = make_random_graph(sizes[i], i + 1);
+         char name[32];
+
+         snprintf(name, sizeof(name), "random-%u", sizes[i]);
+         ok &= run(name, graph);
+         ralloc_free(graph);
+      }
+   }
+
+   return ok ? 0 : 1;
+}
@@ -109,10 +109,20 @@ util_queue_fence_reset(struct util_queue_fence *fence)
 #endif
 }
 
+/**
+ * Whether the fence is signalled.  What the signalling thread wrote before
+ * util_queue_fence_signal() is visible once this returns true.
+ */
 static inline bool
 util_queue_fence_is_signalled(struct util_queue_fence *fence)
 {
-   return fence->val == 0;
+#ifdef USE_GCC_ATOMIC_BUILTINS
+   return p_atomic_read(&fence->val) == 0;
+#else
+   bool signalled = *(volatile uint32_t *) &fence->val == 0;
+   __sync_synchronize();
+   return signalled;
+#endif
 }
 #endif
 